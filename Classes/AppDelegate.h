@@ -35,6 +35,8 @@
 -(void)loadSettings;
 -(void) saveSettings;
 -(void)createHostsFile;
+-(void)applyEnumSettings;
+-(void)loadEnumData:(AppSettings *)enumSettings;
 
 
 @end
@@ -11,6 +11,7 @@
 #import <QuartzCore/QuartzCore.h>
 #import "ModalAlert.h"
 #import "ContactsViewController.h"
+#import "DnsResolver.h"
 
 @implementation AppDelegate
 
@@ -124,6 +125,43 @@
 			NSString *value = [lineParts objectAtIndex:1];
 			settings.countrycode = [value stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
 			
+		}else if([key rangeOfString:@"dnssuffixes"].location != NSNotFound) {
+			//ENUM trees to ask at once, comma separated, in order of priority
+			NSString *value = [lineParts objectAtIndex:1];
+			NSMutableArray *list = [NSMutableArray array];
+			for (NSString *part in [value componentsSeparatedByString:@","]) {
+				part = [part stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+				if ([part length] > 0) {
+					[list addObject:part];
+				}
+			}
+			settings.suffixes = [list count] > 0 ? list : nil;
+			
+		}else if([key rangeOfString:@"enummerge"].location != NSNotFound) {
+			//union takes the records of all trees, otherwise the first that has any counts
+			NSString *value = [lineParts objectAtIndex:1];
+			settings.mergeSuffixes = [[value stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]] isEqualToString:@"union"];
+			
+		}else if([key rangeOfString:@"enumzone"].location != NSNotFound) {
+			//ENUM zone file to answer numbers from locally
+			NSString *value = [lineParts objectAtIndex:1];
+			settings.enumZone = [value stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+			
+		}else if([key rangeOfString:@"enumsnapshot"].location != NSNotFound) {
+			//ENUM zone snapshot to answer numbers from locally
+			NSString *value = [lineParts objectAtIndex:1];
+			settings.enumSnapshot = [value stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+			
+		}else if([key rangeOfString:@"enummaster"].location != NSNotFound) {
+			//master to transfer the ENUM zone from
+			NSString *value = [lineParts objectAtIndex:1];
+			settings.enumMaster = [value stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+			
+		}else if([key rangeOfString:@"enumfilter"].location != NSNotFound) {
+			//seconds between rebuilds of the filter of the snapshot numbers
+			NSString *value = [lineParts objectAtIndex:1];
+			settings.enumFilterInterval = [[value stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]] doubleValue];
+			
 		}else if([key rangeOfString:@"dnssuffix"].location != NSNotFound) {
 			//default dns suffix found, use this instead of .e164.arpa
 			NSString *value = [lineParts objectAtIndex:1];
@@ -138,6 +176,7 @@
 	//create a temp hosts file, the dns resolver can use
 	[self createHostsFile];
 
+	[self applyEnumSettings];
 	
 }
 
@@ -168,11 +207,82 @@
 		content = [content stringByAppendingString:suffix];
 	}
 	
+	if ([self.settings.suffixes count] > 0) {
+		NSString *suffixes = [NSString stringWithFormat:@"dnssuffixes=%@\n", [self.settings.suffixes componentsJoinedByString:@","]];
+		content = [content stringByAppendingString:suffixes];
+		if (self.settings.mergeSuffixes) {
+			content = [content stringByAppendingString:@"enummerge=union\n"];
+		}
+	}
+	
+	if ([self.settings.enumZone length] > 0) {
+		NSString *zone = [NSString stringWithFormat:@"enumzone=%@\n", self.settings.enumZone];
+		content = [content stringByAppendingString:zone];
+	}
+	if ([self.settings.enumMaster length] > 0) {
+		NSString *master = [NSString stringWithFormat:@"enummaster=%@\n", self.settings.enumMaster];
+		content = [content stringByAppendingString:master];
+	}
+	if ([self.settings.enumSnapshot length] > 0) {
+		NSString *snapshot = [NSString stringWithFormat:@"enumsnapshot=%@\n", self.settings.enumSnapshot];
+		content = [content stringByAppendingString:snapshot];
+	}
+	if (self.settings.enumFilterInterval > 0) {
+		NSString *filter = [NSString stringWithFormat:@"enumfilter=%.0f\n", self.settings.enumFilterInterval];
+		content = [content stringByAppendingString:filter];
+	}
+	
 	//save content to the documents directory
 	[content writeToFile:fileName atomically:NO encoding:NSStringEncodingConversionAllowLossy error:nil];
 	
 	[self createHostsFile];
 	
+	[self applyEnumSettings];
+	
+}
+
+-(void)applyEnumSettings{
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES);
+	NSString *documentsDirectory = [paths objectAtIndex:0];
+	
+	//the filter is rebuilt by a timer, which runs on the main run loop
+	if (self.settings.enumFilterInterval > 0) {
+		NSString *snapshot = [self.settings.enumSnapshot length] > 0 ? self.settings.enumSnapshot : @"appEnum.snap";
+		[DnsResolver rebuildEnumFilter:[documentsDirectory stringByAppendingPathComponent:snapshot] every:self.settings.enumFilterInterval];
+	} else {
+		[DnsResolver rebuildEnumFilter:nil every:0];
+	}
+	
+	//read the local ENUM data before the first lookup needs it
+	[self performSelectorInBackground:@selector(loadEnumData:) withObject:self.settings];
+}
+
+-(void)loadEnumData:(AppSettings *)enumSettings{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES);
+	NSString *documentsDirectory = [paths objectAtIndex:0];
+	
+	//the resolvers made after this answer the numbers of the zone from the
+	//master or the files locally, without them they take appEnum.zone and
+	//appEnum.snap
+	if ([enumSettings.enumMaster length] > 0) {
+		if (![DnsResolver loadLocalZoneFromMaster:enumSettings.enumMaster suffix:enumSettings.suffix]) {
+			NSLog(@"Error: ENUM zone not transferred from %@", enumSettings.enumMaster);
+		}
+	} else if ([enumSettings.enumZone length] > 0) {
+		NSString *zonePath = [documentsDirectory stringByAppendingPathComponent:enumSettings.enumZone];
+		if (![DnsResolver loadLocalZone:zonePath suffix:enumSettings.suffix]) {
+			NSLog(@"Error: ENUM zone %@ not loaded", zonePath);
+		}
+	}
+	if ([enumSettings.enumSnapshot length] > 0) {
+		NSString *snapshotPath = [documentsDirectory stringByAppendingPathComponent:enumSettings.enumSnapshot];
+		if (![DnsResolver loadLocalSnapshot:snapshotPath]) {
+			NSLog(@"Error: ENUM snapshot %@ not loaded", snapshotPath);
+		}
+	}
+	
+	[pool release];
 }
 
 -(void)createHostsFile{
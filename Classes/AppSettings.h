@@ -14,10 +14,31 @@
 	NSString *server;
 	NSString *suffix;
 	NSString *countrycode;
+	NSArray *suffixes;
+	BOOL mergeSuffixes;
+	NSString *enumZone;
+	NSString *enumSnapshot;
+	NSString *enumMaster;
+	NSTimeInterval enumFilterInterval;
 }
 
 @property (nonatomic, retain) NSString *server;
 @property (nonatomic, retain) NSString *suffix;
 @property (nonatomic, retain) NSString *countrycode;
+//the ENUM trees to look numbers up in at once, nil for suffix alone
+@property (nonatomic, retain) NSArray *suffixes;
+//take the records of all of them, not just of the first that has any
+@property (nonatomic) BOOL mergeSuffixes;
+//ENUM zone file and zone snapshot in the documents directory to answer
+//numbers from before the network is asked, nil for appEnum.zone and
+//appEnum.snap
+@property (nonatomic, retain) NSString *enumZone;
+@property (nonatomic, retain) NSString *enumSnapshot;
+//address of the master to transfer the ENUM zone of suffix from, in place
+//of enumZone
+@property (nonatomic, retain) NSString *enumMaster;
+//seconds between rebuilds of the filter that skips the numbers not in the
+//snapshot, 0 for no filter. Only for a snapshot of the whole ENUM tree
+@property (nonatomic) NSTimeInterval enumFilterInterval;
 
 @end
@@ -15,6 +15,12 @@
 @synthesize server;
 @synthesize suffix;
 @synthesize countrycode;
+@synthesize suffixes;
+@synthesize mergeSuffixes;
+@synthesize enumZone;
+@synthesize enumSnapshot;
+@synthesize enumMaster;
+@synthesize enumFilterInterval;
 
 -(id)init{
 	self = [super init];
@@ -92,6 +92,8 @@ NSInteger servicecount;
 	
 	DnsResolver *dns = [[[DnsResolver alloc] init] autorelease];
     dns.suffix = appDelegate.settings.suffix;
+    dns.suffixes = appDelegate.settings.suffixes;
+    dns.enumMergePolicy = appDelegate.settings.mergeSuffixes ? EnumMergeUnion : EnumMergeFirstNonEmpty;
 	
 	//remove all non digits and non + character
 	self.number = [[self.number componentsSeparatedByCharactersInSet:[[NSCharacterSet characterSetWithCharactersInString:@"0123456789+"] invertedSet]] componentsJoinedByString:@""];
@@ -134,53 +136,45 @@ NSInteger servicecount;
 			return;
 		}
 		
-		if ([[rec serviceDescription] rangeOfString:@"vcard:"].location != NSNotFound) {
-			//detected vcard record
-			if(rec.uriContent != nil){
-				self.vcard = [[Vcard alloc] initWithUrl:rec.uriContent];
-				servicecount++;
-			}
-		}else if( [[rec serviceDescription] isEqual:@"web:http" ]){
-			//web location found
-			if(rec.uriContent != nil){
-				EnumService *es = [EnumServiceManager createEnumServiceWithUrl:rec.uriContent andType:SERVICE_WEB];
-				if(es){
-					[self.enumServices addObject:es];
+		//map the kind of service ldns found to the enum service to show
+		int type;
+		switch (rec.serviceClass) {
+			case LDNS_ENUM_SERVICE_VCARD:
+				//detected vcard record
+				if(rec.uriContent != nil){
+					self.vcard = [[Vcard alloc] initWithUrl:rec.uriContent];
 					servicecount++;
 				}
-				
-				
-			}
-		}else if( [[rec serviceDescription] isEqual:@"key:http" ]){
-			//public key found
-			EnumService *es = [EnumServiceManager createEnumServiceWithUrl:rec.uriContent andType:SERVICE_KEY];
-			if(es){
-				[self.enumServices addObject:es];
-				servicecount++;
-			}
-		}else if( [[rec serviceDescription] isEqual:@"loc:geo" ]){
-			//map location found
-			EnumService *es = [EnumServiceManager createEnumServiceWithUrl:rec.uriContent andType:SERVICE_LOC];
-			if(es){
-				[self.enumServices addObject:es];
-				servicecount++;
-			}
-		}else if( [[rec serviceDescription] isEqual:@"Email" ]){
-			//map location found
-			EnumService *es = [EnumServiceManager createEnumServiceWithUrl:rec.uriContent andType:SERVICE_MAIL];
-			if(es){
-				[self.enumServices addObject:es];
-				servicecount++;
-			}
-		}else if( [[rec serviceDescription] isEqual:@"voice" ]){
-			//map location found
-			EnumService *es = [EnumServiceManager createEnumServiceWithUrl:rec.uriContent andType:SERVICE_VOICE];
-			if(es){
-				[self.enumServices addObject:es];
-				servicecount++;
-			}
+				continue;
+			case LDNS_ENUM_SERVICE_WEB:
+				//web location found
+				if(rec.uriContent == nil){
+					continue;
+				}
+				type = SERVICE_WEB;
+				break;
+			case LDNS_ENUM_SERVICE_KEY:
+				//public key found
+				type = SERVICE_KEY;
+				break;
+			case LDNS_ENUM_SERVICE_LOC:
+				//map location found
+				type = SERVICE_LOC;
+				break;
+			case LDNS_ENUM_SERVICE_MAIL:
+				type = SERVICE_MAIL;
+				break;
+			case LDNS_ENUM_SERVICE_VOICE:
+				type = SERVICE_VOICE;
+				break;
+			default:
+				continue;
+		}
+		EnumService *es = [EnumServiceManager createEnumServiceWithUrl:rec.uriContent andType:type];
+		if(es){
+			[self.enumServices addObject:es];
+			servicecount++;
 		}
-		
 	}
 }
 			 
@@ -29,17 +29,277 @@
 
 extern NSString * const ENUM_E164_SUFFIX;
 
+
+/**
+ * A place doEnumQuery looks for NAPTR records before it asks the network.
+ * DnsResolver asks its lookupSources in order and takes the first answer.
+ */
+@protocol EnumLookupSource <NSObject>
+
+/**
+ * Looks up the NAPTR records of a number
+ * @param number  the digits of the number, nil when domain is the
+ *                replacement of a non-terminal NAPTR
+ * @param domain  the ENUM domain of the number, or the replacement
+ * @param date    set to the time the TTLs of the records count from
+ * @return a new list, freed by the caller with ldns_rr_list_deep_free,
+ *         or NULL when the source has no answer
+ */
+- (ldns_rr_list *)naptrsForNumber:(NSString *)number domain:(ldns_rdf *)domain date:(NSDate **)date;
+
+@optional
+
+/**
+ * Offered the records the network answered with
+ * @param naptrs  the records, the list stays with the caller
+ * @param domain  the ENUM domain they are for
+ * @param date    the time of the answer
+ */
+- (void)storeNaptrs:(ldns_rr_list *)naptrs forDomain:(ldns_rdf *)domain date:(NSDate *)date;
+
+@end
+
+
+/**
+ * Answers from an ENUM zone file, with ldns_zone_enum_index.
+ * The zone can be kept up to date with incremental transfers (IXFR) from
+ * its master.
+ * The zone is indexed for the numbers of every suffix it is asked for, so
+ * resolvers with different suffixes can share it.
+ */
+@interface EnumZoneSource : NSObject <EnumLookupSource> {
+	ldns_zone *zone;
+	// an index of the zone for every suffix in indexSuffixes, NULL where
+	// it could not be built
+	ldns_zone_enum_index **indexes;
+	size_t indexCount;
+	NSMutableArray *indexSuffixes;
+	NSString *suffix;
+	NSString *master;
+	NSTimeInterval updateInterval;
+}
+
+// the address initWithMaster transferred the zone from, nil for a file
+@property(readonly)NSString *master;
+// seconds until the zone is to be updated from the master: the SOA refresh
+// interval after a transfer, the retry interval after a failed one
+@property(readonly)NSTimeInterval updateInterval;
+
+- (id)initWithPath:(NSString *)path suffix:(NSString *)enumSuffix;
+
+/**
+ * Loads the zone with a zone transfer (AXFR) from its master. The records
+ * are taken from the messages as they arrive, so the transfer needs no
+ * more memory than the zone itself and one message.
+ * @param address  the IPv4 or IPv6 address of the master
+ * @param enumSuffix  the zone, e.g. e164.arpa
+ */
+- (id)initWithMaster:(NSString *)address suffix:(NSString *)enumSuffix;
+
+/**
+ * Asks the master of the zone for the changes since the SOA serial of
+ * ours and applies them, or takes the whole zone when the master has no
+ * increments for it. Lookups go on with the old version meanwhile.
+ * @param address  the IPv4 or IPv6 address of the master
+ * @return NO when the transfer failed, the zone is left as it was
+ */
+- (BOOL)updateFromMaster:(NSString *)address;
+
+/**
+ * Indexes the zone for the numbers under another suffix as well. The
+ * index is built from the records in memory, the zone is not read or
+ * transferred again.
+ * @param aSuffix  the suffix, e.g. e164.arpa
+ * @return NO when the suffix is not a name or the index could not be
+ *         built
+ */
+- (BOOL)indexSuffix:(NSString *)aSuffix;
+
+@end
+
+
+/**
+ * Answers from a zone snapshot (see ldns_zone_snapshot_write), which is
+ * mapped and not parsed.
+ * The snapshot is treated like the copy a secondary server keeps: its
+ * records are answered as fresh, their TTLs counting from the lookup,
+ * until the SOA expire time has passed since the file was written. After
+ * every SOA refresh interval the file is opened again if its SOA serial
+ * changed, or after the retry interval when it could not be read. That is
+ * done on a background thread, the lookups meanwhile use the old snapshot.
+ * The file is mapped, so it has to be replaced by renaming a new one over
+ * it (ldns_zone_snapshot_write_file), never rewritten in place.
+ */
+@interface EnumSnapshotSource : NSObject <EnumLookupSource> {
+	NSString *path;
+	ldns_zone_snapshot *snapshot;
+	uint32_t serial;
+	NSTimeInterval retry;
+	NSDate *refreshDate;
+	NSDate *expireDate;
+	BOOL reloading;
+}
+
+@property(readonly)uint32_t serial;
+
+- (id)initWithPath:(NSString *)aPath;
+
+/**
+ * Opens the file again if its SOA serial is not the one in use
+ * @return NO if it could not be read, the old snapshot stays
+ */
+- (BOOL)reload;
+
+@end
+
+
+/**
+ * Keeps the network answers until their smallest TTL runs out. When it is
+ * full the expired ones make room, or else the one that expires first
+ */
+@interface EnumCacheSource : NSObject <EnumLookupSource> {
+	NSMutableDictionary *entries;
+	NSUInteger capacity;
+}
+
+- (id)initWithCapacity:(NSUInteger)aCapacity;
+
+@end
+
+
+/**
+ * A filter of the numbers under a suffix in a zone snapshot, see
+ * ldns_zone_enum_filter, and how it did. The resolvers of the suffix share
+ * it. Until it is built it rules out no numbers
+ */
+@interface EnumNumberFilter : NSObject {
+	NSString *path;
+	NSString *suffix;
+	ldns_zone_enum_filter *filter;
+	NSUInteger skipped;
+	NSUInteger passed;
+	NSUInteger falsePositives;
+}
+
+@property(readonly)NSString *path;
+@property(readonly)NSString *suffix;
+// numbers ruled out, numbers let through and how many of those had no
+// records, since the last build
+@property(readonly)NSUInteger skipped;
+@property(readonly)NSUInteger passed;
+@property(readonly)NSUInteger falsePositives;
+
+- (id)initWithPath:(NSString *)aPath suffix:(NSString *)aSuffix;
+
+/**
+ * Builds the filter from the snapshot and puts it in place of the old one
+ * @return NO if the snapshot could not be read, the old filter stays
+ */
+- (BOOL)rebuild;
+
+/**
+ * @return NO when the number is not in the snapshot
+ */
+- (BOOL)mayContain:(NSString *)number;
+
+// a number it let through had no records
+- (void)countFalsePositive;
+
+/**
+ * The share of numbers without records the filter let through, as seen
+ * by the lookups, and as the filter itself expects it to be
+ */
+- (double)falsePositiveRate;
+- (double)expectedFalsePositiveRate;
+
+@end
+
+
+/**
+ * An ENUM tree doEnumQuery looks numbers up in, e.g. e164.arpa or the
+ * tree of a carrier, and how those lookups went
+ */
+@interface EnumTree : NSObject {
+	NSString *suffix;
+	ldns_rdf *suffixName;
+	EnumCacheSource *cache;
+	NSUInteger lookups;
+	NSUInteger cacheHits;
+	NSUInteger answers;
+	NSUInteger emptyAnswers;
+	NSUInteger failures;
+	NSUInteger skipped;
+}
+
+@property(readonly)NSString *suffix;
+// the suffix as a dname, NULL when it is no valid name
+@property(readonly)ldns_rdf *suffixName;
+// the records of this tree only, shared by the trees of the same suffix of
+// all resolvers. nil for the tree of DnsResolver's suffix, which uses the
+// lookupSources
+@property(readonly)EnumCacheSource *cache;
+// numbers looked up, and of those the ones the cache or the lookupSources
+// had, the network answered with records, answered without, failed or did
+// not answer, and the ones the tree was not asked for
+@property(readonly)NSUInteger lookups;
+@property(readonly)NSUInteger cacheHits;
+@property(readonly)NSUInteger answers;
+@property(readonly)NSUInteger emptyAnswers;
+@property(readonly)NSUInteger failures;
+@property(readonly)NSUInteger skipped;
+
+- (id)initWithSuffix:(NSString *)aSuffix cache:(EnumCacheSource *)aCache;
+
+@end
+
+
+// how doEnumQuery combines the records of several trees
+typedef enum {
+	// those of the first tree in suffixes that has records
+	EnumMergeFirstNonEmpty,
+	// those of all trees, in the order of suffixes
+	EnumMergeUnion
+} EnumMergePolicy;
+
+
 @interface DnsResolver : NSObject {
 
 	ldns_resolver *res;
 	NSString *suffix;
+	NSArray *suffixes;
+	NSArray *enumTrees;
+	EnumMergePolicy enumMergePolicy;
+	NSMutableArray *lookupSources;
+	EnumNumberFilter *enumFilter;
 }
 
 @property(nonatomic, retain)NSString *suffix;
+// the ENUM trees doEnumQuery asks at the same time, in order of priority.
+// nil for the suffix alone; suffix, or ENUM_E164_SUFFIX, may be one of
+// them and is the one the lookupSources and the filter are for
+@property(nonatomic, copy)NSArray *suffixes;
+@property EnumMergePolicy enumMergePolicy;
+// an EnumTree for every suffix, in the order of suffixes
+@property(readonly)NSArray *enumTrees;
+// the EnumLookupSources doEnumQuery tries, in order, before the network.
+// By default the snapshot and the zone of loadLocalSnapshot and
+// loadLocalZone, or else an appEnum.snap snapshot and an appEnum.zone zone
+// in the documents directory when they are there, and a cache. Those are
+// made once and shared by all the resolvers of the process
+@property(retain)NSMutableArray *lookupSources;
+// the filter of the suffix, nil when rebuildEnumFilter was not called
+@property(readonly)EnumNumberFilter *enumFilter;
+// numbers the filter ruled out, numbers it let through and how many of
+// those had no records, counted by all resolvers of the suffix
+@property(readonly)NSUInteger enumFilterSkipped;
+@property(readonly)NSUInteger enumFilterPassed;
+@property(readonly)NSUInteger enumFilterFalsePositives;
 
 /**
  * Retrieves all NAPTR records in a domain and adds them to the provided
  * array. NAPTR records are encapsulated in the RecordNaptr class.
+ * A domain of one label is looked for under the names of the search list
+ * of resolv.conf first, all at once, with ldns_resolver_search.
  * 
  * @param domain       the domain to query
  * @param naptrArray   the array to add the naptrs to
@@ -60,17 +320,78 @@ extern NSString * const ENUM_E164_SUFFIX;
  *   <code>9.8.7.6.5.4.3.2.1.1.3.e164.arpa.
  * 
  * @param key The Application Unique String
- * @return    The AUS converted to ENUM database format (e.g. a domain name)
+ * @return    The AUS converted to ENUM database format (e.g. a domain name),
+ *            nil when it has no digits
  * 
  */
 - (NSString *)convertPhone2Enum:(NSString *)key; 
 
 /**
  * Perform a enum query for a phonenumber
- * @return a array with the enum records for the phonenumber
+ * The number is looked up in all enumTrees at once, the records are
+ * combined as enumMergePolicy says.
+ * Non-terminal NAPTRs are followed, LDNS_ENUM_CHASE_DEPTH deep, and
+ * replaced by the records they point to.
+ * @return a array with the enum records for the phonenumber, in the
+ *         order to use them in
  */
 -(NSArray *)doEnumQuery:(NSString *)forNumber;
 
+/**
+ * Loads an ENUM zone file to answer numbers from without asking the
+ * network. The resolvers made after this have it in front of their other
+ * lookupSources, in place of appEnum.zone or the zone loaded before.
+ * The zone is indexed for the suffix of a resolver when it is set.
+ * @param path the zone file
+ * @param aSuffix the suffix the numbers are under, nil for e164.arpa
+ * @return NO if the zone could not be read, the old one stays
+ */
++ (BOOL)loadLocalZone:(NSString *)path suffix:(NSString *)aSuffix;
+
+/**
+ * Like loadLocalZone, with the zone transferred from its master (AXFR),
+ * see EnumZoneSource. It does not return before the transfer is done.
+ * After that the zone is updated from the master (IXFR) on a background
+ * thread every SOA refresh interval, or retry interval after a failure,
+ * for as long as it is the local zone. The updates are timed on the main
+ * run loop
+ * @param address the IPv4 or IPv6 address of the master
+ * @param aSuffix the zone, nil for e164.arpa
+ * @return NO if the transfer failed, the old zone stays
+ */
++ (BOOL)loadLocalZoneFromMaster:(NSString *)address suffix:(NSString *)aSuffix;
+
+/**
+ * Like loadLocalZone, with a zone snapshot. The snapshot stays in use as
+ * long as the file is replaced and not rewritten, see EnumSnapshotSource
+ * @param path the snapshot file
+ * @return NO if the snapshot could not be read, the old one stays
+ */
++ (BOOL)loadLocalSnapshot:(NSString *)path;
+
+/**
+ * Has doEnumQuery skip the numbers that are not in a zone snapshot (see
+ * ldns_zone_snapshot_write). The resolvers made after this build a filter
+ * of the numbers under their suffix on a background thread when they
+ * first need it, one for every suffix, which the others of that suffix
+ * share. Until it is built no numbers are ruled out.
+ * The filters are built again every interval seconds, by a timer on the
+ * run loop of the calling thread, which also stops it
+ * @param path the snapshot file, replaced as the zone changes. nil for
+ *             no filter
+ * @param interval seconds between rebuilds, 0 to build them once
+ */
++ (void)rebuildEnumFilter:(NSString *)path every:(NSTimeInterval)interval;
+
++ (void)stopEnumFilterRebuild;
+
+/**
+ * The share of numbers without records the filter let through, as seen
+ * by doEnumQuery, and as the filter itself expects it to be
+ */
+- (double)enumFilterFalsePositiveRate;
+- (double)enumFilterExpectedFalsePositiveRate;
+
 /**
  * Check if there is a network connection available
  */
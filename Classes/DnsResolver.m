@@ -14,24 +14,298 @@ NSString * const ENUM_E164_SUFFIX =  @"e164.arpa";
 
 - (ldns_resolver *)createLdnsResolver;
 - (ldns_rr_list *)retrieveResourceRecordsOfType:(ldns_rr_type)rrType fromDomain:(NSString *)domain;
+- (ldns_rr_list *)retrieveResourceRecordsOfType:(ldns_rr_type)rrType fromDname:(ldns_rdf *)domain;
+- (void)addNaptrs:(ldns_rr_list *)naptrs toArray:(NSMutableArray *)naptrArray date:(NSDate *)lookupDate aus:(NSString *)aus;
+- (void)addChasedNaptrs:(ldns_rr_list *)naptrs toArray:(NSMutableArray *)naptrArray sources:(NSArray *)sources date:(NSDate *)lookupDate number:(NSString *)number taken:(ldns_rr_list *)taken;
++ (EnumCacheSource *)sharedCacheForSuffix:(NSString *)aSuffix;
++ (EnumZoneSource *)sharedZoneSourceWithPath:(NSString *)path suffix:(NSString *)aSuffix;
++ (EnumSnapshotSource *)sharedSnapshotSourceWithPath:(NSString *)path;
++ (void)setSharedSource:(id)source forKey:(NSString *)key;
++ (EnumNumberFilter *)sharedFilterForSuffix:(NSString *)aSuffix;
++ (void)enumFilterTimerFired:(NSTimer *)timer;
++ (void)scheduleLocalZoneUpdate:(EnumZoneSource *)source;
++ (void)startLocalZoneUpdate:(EnumZoneSource *)source;
++ (void)updateLocalZone:(EnumZoneSource *)source;
+- (BOOL)enumFilterMayContain:(NSString *)number;
 
 @end
 
+// how the lookup of a number in an EnumTree went
+typedef enum {
+	EnumTreeCacheHit,
+	EnumTreeAnswer,
+	EnumTreeEmptyAnswer,
+	EnumTreeFailure,
+	EnumTreeSkipped
+} EnumTreeOutcome;
+
+@interface EnumTree (Counting)
+
+- (void)countLookup:(EnumTreeOutcome)outcome;
+
+@end
+
+@interface EnumZoneSource (Updating)
+
+- (NSTimeInterval)soaInterval:(size_t)field;
+- (BOOL)transferChangesFromMaster:(NSString *)address;
+
+@end
+
+// the lookup of a number in one EnumTree, see doEnumQuery
+typedef struct {
+	EnumTree *tree;
+	NSArray *sources;
+	ldns_rdf *domain;
+	ldns_rr_list *naptrs;
+	NSDate *date;
+	BOOL asked;
+	size_t answerIndex;
+} EnumTreeLookup;
+
+// the trees that are asked at once
+typedef struct {
+	EnumTreeLookup *lookups;
+	NSUInteger count;
+	ldns_pkt **answers;
+	BOOL stopped;
+} EnumTreeQuery;
+
+// copies the NAPTRs of an answer that are for name to naptrs, when it is
+// not NULL, and returns how many there are. The CNAMEs of the answer
+// section are followed from name, a DNAME comes with the CNAME it makes
+static size_t enumAnswerNaptrs(ldns_pkt *answer, const ldns_rdf *name, ldns_rr_list *naptrs) {
+	ldns_rr_list *section = ldns_pkt_answer(answer);
+	size_t i, hops, found = 0, count = ldns_rr_list_rr_count(section);
+	
+	if (ldns_pkt_get_rcode(answer) != LDNS_RCODE_NOERROR) {
+		return 0;
+	}
+	for (hops = 0; hops < 8; hops++) {
+		for (i = 0; i < count; i++) {
+			ldns_rr *rr = ldns_rr_list_rr(section, i);
+			if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_CNAME && ldns_rr_rd_count(rr) > 0 &&
+				ldns_dname_compare(ldns_rr_owner(rr), name) == 0) {
+				name = ldns_rr_rdf(rr, 0);
+				break;
+			}
+		}
+		if (i == count) {
+			break;
+		}
+	}
+	for (i = 0; i < count; i++) {
+		ldns_rr *rr = ldns_rr_list_rr(section, i);
+		if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_NAPTR && ldns_dname_compare(ldns_rr_owner(rr), name) == 0) {
+			ldns_rr *copy = naptrs ? ldns_rr_clone(rr) : NULL;
+			if (copy && !ldns_rr_list_push_rr(naptrs, copy)) {
+				ldns_rr_free(copy);
+			}
+			found++;
+		}
+	}
+	return found;
+}
+
+// the answers of the trees after the first one with records are not waited for
+static bool enumTreeAnswered(size_t index, void *arg) {
+	EnumTreeQuery *query = (EnumTreeQuery *)arg;
+	NSUInteger i;
+	
+	for (i = 0; i < query->count; i++) {
+		EnumTreeLookup *lookup = &query->lookups[i];
+		if (lookup->asked) {
+			ldns_pkt *answer = query->answers[lookup->answerIndex];
+			if (!answer) {
+				return true;
+			}
+			//a CNAME alone, or NAPTRs of another name, are no records
+			if (enumAnswerNaptrs(answer, lookup->domain, NULL) > 0) {
+				break;
+			}
+		} else if (lookup->naptrs && ldns_rr_list_rr_count(lookup->naptrs) > 0) {
+			break;
+		}
+	}
+	query->stopped = i < query->count;
+	return !query->stopped;
+}
+
+// whether a record with the same fields as rr is in list
+static BOOL enumNaptrTaken(ldns_rr_list *list, ldns_rr *rr) {
+	size_t i, j;
+	
+	for (i = 0; i < ldns_rr_list_rr_count(list); i++) {
+		ldns_rr *other = ldns_rr_list_rr(list, i);
+		if (ldns_rr_rd_count(other) != ldns_rr_rd_count(rr)) {
+			continue;
+		}
+		for (j = 0; j < ldns_rr_rd_count(rr); j++) {
+			if (ldns_rdf_compare(ldns_rr_rdf(other, j), ldns_rr_rdf(rr, j)) != 0) {
+				break;
+			}
+		}
+		if (j == ldns_rr_rd_count(rr)) {
+			return YES;
+		}
+	}
+	return NO;
+}
+
+// what non-terminal NAPTRs are followed with, see doEnumQuery
+typedef struct {
+	NSArray *sources;
+	NSDate *date;
+} EnumChaseContext;
+
+static ldns_rr_list *enumChaseLookup(const ldns_rdf *name, void *arg) {
+	EnumChaseContext *context = (EnumChaseContext *)arg;
+	NSDate *date = nil;
+	
+	for (id<EnumLookupSource> source in context->sources) {
+		ldns_rr_list *naptrs = [source naptrsForNumber:nil domain:(ldns_rdf *)name date:&date];
+		if (naptrs) {
+			//the records of a chase all count from the oldest lookup in it
+			if ([date compare:context->date] == NSOrderedAscending) {
+				context->date = date;
+			}
+			return naptrs;
+		}
+	}
+	return NULL;
+}
+
+static void enumChaseStore(const ldns_rdf *name, const ldns_rr_list *naptrs, void *arg) {
+	EnumChaseContext *context = (EnumChaseContext *)arg;
+	NSDate *date = [NSDate date];
+	
+	for (id<EnumLookupSource> source in context->sources) {
+		if ([source respondsToSelector:@selector(storeNaptrs:forDomain:date:)]) {
+			[source storeNaptrs:(ldns_rr_list *)naptrs forDomain:(ldns_rdf *)name date:date];
+		}
+	}
+}
+
+// the lookup sources made from files and the caches, by what they were made
+// from. Every DnsResolver of the process uses these, so a file is read once
+static NSMutableDictionary *sharedSources = nil;
+
+// the filters of the numbers in the snapshot of rebuildEnumFilter, by suffix
+static NSString *enumFilterPath = nil;
+static NSMutableDictionary *sharedFilters = nil;
+static NSTimer *enumFilterTimer = nil;
+
 @implementation DnsResolver
 
 @synthesize suffix;
+@synthesize suffixes;
+@synthesize enumMergePolicy;
+@synthesize lookupSources;
 
 - (id)init {
 	self = [super init];
 	res = [self createLdnsResolver];
+	
+	lookupSources = [[NSMutableArray alloc] initWithObjects:[DnsResolver sharedCacheForSuffix:nil], nil];
+	
+	//answer numbers locally from the zone and the snapshot loadLocalZone and
+	//loadLocalSnapshot loaded, or else from appEnum.zone and appEnum.snap if
+	//they are there. The first resolver of the process reads those and the
+	//others share them
+	EnumZoneSource *zoneSource;
+	EnumSnapshotSource *snapshotSource;
+	@synchronized([DnsResolver class]) {
+		zoneSource = [[[sharedSources objectForKey:@"zone"] retain] autorelease];
+		snapshotSource = [[[sharedSources objectForKey:@"snapshot"] retain] autorelease];
+	}
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES);
+	NSString *zoneFilePath = [NSString stringWithFormat:@"%@/appEnum.zone", [paths objectAtIndex:0]];
+	if (!zoneSource && [[NSFileManager defaultManager] fileExistsAtPath:zoneFilePath]) {
+		zoneSource = [DnsResolver sharedZoneSourceWithPath:zoneFilePath suffix:ENUM_E164_SUFFIX];
+	}
+	if (zoneSource) {
+		[lookupSources insertObject:zoneSource atIndex:0];
+	}
+	NSString *snapshotFilePath = [NSString stringWithFormat:@"%@/appEnum.snap", [paths objectAtIndex:0]];
+	if (!snapshotSource && [[NSFileManager defaultManager] fileExistsAtPath:snapshotFilePath]) {
+		snapshotSource = [DnsResolver sharedSnapshotSourceWithPath:snapshotFilePath];
+	}
+	if (snapshotSource) {
+		[lookupSources insertObject:snapshotSource atIndex:0];
+	}
 	return self;
 }
 
 - (void)dealloc {
 	ldns_resolver_deep_free(res);
+	[enumFilter release];
+	[lookupSources release];
+	[suffix release];
+	[suffixes release];
+	[enumTrees release];
 	[super dealloc];
 }
 
+- (void)setSuffix:(NSString *)aSuffix {
+	NSString *newSuffix = aSuffix ? aSuffix : ENUM_E164_SUFFIX;
+	NSArray *sources = nil;
+	
+	@synchronized(self) {
+		NSString *oldSuffix = suffix ? suffix : ENUM_E164_SUFFIX;
+		if ([oldSuffix caseInsensitiveCompare:newSuffix] != NSOrderedSame) {
+			sources = [[self.lookupSources retain] autorelease];
+		}
+		[aSuffix retain];
+		[suffix release];
+		suffix = aSuffix;
+		//the trees are made again, for the new suffix
+		[enumTrees release];
+		enumTrees = nil;
+		//a filter of another suffix rules out the wrong numbers
+		[enumFilter release];
+		enumFilter = [[DnsResolver sharedFilterForSuffix:newSuffix] retain];
+	}
+	//the local zone was indexed for the numbers of the old suffix, without
+	//an index for the new one it has no answers. The zone is in memory, it
+	//is indexed from there
+	for (id source in sources) {
+		if ([source isKindOfClass:[EnumZoneSource class]]) {
+			[source indexSuffix:newSuffix];
+		}
+	}
+}
+
+- (void)setSuffixes:(NSArray *)someSuffixes {
+	@synchronized(self) {
+		NSArray *copy = [someSuffixes copy];
+		[suffixes release];
+		suffixes = copy;
+		[enumTrees release];
+		enumTrees = nil;
+	}
+}
+
+- (NSArray *)enumTrees {
+	@synchronized(self) {
+		if (!enumTrees) {
+			NSString *mainSuffix = suffix ? suffix : ENUM_E164_SUFFIX;
+			NSArray *names = [suffixes count] > 0 ? suffixes : [NSArray arrayWithObject:mainSuffix];
+			NSMutableArray *trees = [NSMutableArray arrayWithCapacity:[names count]];
+			
+			//the tree of the suffix has the lookupSources, the others a cache of their own
+			for (NSString *name in names) {
+				BOOL isMain = [name caseInsensitiveCompare:mainSuffix] == NSOrderedSame;
+				EnumTree *tree = [[EnumTree alloc] initWithSuffix:name cache:(isMain ? nil : [DnsResolver sharedCacheForSuffix:name])];
+				[trees addObject:tree];
+				[tree release];
+			}
+			enumTrees = [trees copy];
+		}
+		return [[enumTrees retain] autorelease];
+	}
+	return nil;
+}
+
 
 - (void)getNAPTRList:(NSString *)domain inArray:(NSMutableArray *)naptrArray {
 	ldns_rr_list *naptrs = [self retrieveResourceRecordsOfType:LDNS_RR_TYPE_NAPTR fromDomain:domain];
@@ -39,47 +313,177 @@ NSString * const ENUM_E164_SUFFIX =  @"e164.arpa";
 		return;
 	}
 	
-	NSDate *lookupDate = [[NSDate date] retain];
+	[self addNaptrs:naptrs toArray:naptrArray date:[NSDate date] aus:nil];
+	ldns_rr_list_deep_free(naptrs);
+	[naptrArray sortUsingSelector:@selector(comparator:)];
+}
+
+- (void)addChasedNaptrs:(ldns_rr_list *)naptrs toArray:(NSMutableArray *)naptrArray sources:(NSArray *)sources date:(NSDate *)lookupDate number:(NSString *)number taken:(ldns_rr_list *)taken {
+	//non-terminal records make way for those they point to, the siblings
+	//are asked for at once and the sources keep them for the next time
+	EnumChaseContext context = { sources, lookupDate };
+	ldns_rr_list *chased = NULL;
+	if (ldns_enum_naptr_chase(&chased, res, naptrs, LDNS_ENUM_CHASE_DEPTH, enumChaseLookup, enumChaseStore, &context) != LDNS_STATUS_OK) {
+		chased = ldns_rr_list_clone(naptrs);
+		if (!chased) {
+			return;
+		}
+	}
+	
+	//they come in the order to use them in, without those another tree had
+	ldns_rr_list *fresh = ldns_rr_list_new();
+	size_t i, count = ldns_rr_list_rr_count(chased);
+	for (i = 0; i < count; i++) {
+		ldns_rr *rr = ldns_rr_list_rr(chased, i);
+		if (fresh && !enumNaptrTaken(taken, rr) && ldns_rr_list_push_rr(taken, rr)) {
+			ldns_rr_list_push_rr(fresh, rr);
+		} else {
+			ldns_rr_free(rr);
+		}
+	}
+	ldns_rr_list_free(chased);
+	if (fresh) {
+		[self addNaptrs:fresh toArray:naptrArray date:context.date aus:[@"+" stringByAppendingString:number]];
+		ldns_rr_list_free(fresh);
+	}
+}
+
+- (void)addNaptrs:(ldns_rr_list *)naptrs toArray:(NSMutableArray *)naptrArray date:(NSDate *)lookupDate aus:(NSString *)aus {
 	NSUInteger i, count = ldns_rr_list_rr_count(naptrs);
 	
 	for (i = 0; i < count; i++) {
-		RecordNaptr *theRec = [RecordNaptr recordWithRr:ldns_rr_list_rr(naptrs, i) date:lookupDate];
+		RecordNaptr *theRec = [RecordNaptr recordWithRr:ldns_rr_list_rr(naptrs, i) date:lookupDate aus:aus];
 		if (theRec.isValid)
 			[naptrArray addObject:theRec];
 	}
+}
+
++ (EnumCacheSource *)sharedCacheForSuffix:(NSString *)aSuffix {
+	//nil is the cache of the lookupSources, the entries are by domain so it
+	//serves any suffix
+	NSString *key = [NSString stringWithFormat:@"cache:%@", (aSuffix ? [aSuffix lowercaseString] : @"")];
 	
-	[naptrArray sortUsingSelector:@selector(comparator:)];
-		
-	ldns_rr_list_deep_free(naptrs);
-	[lookupDate release];
+	@synchronized([DnsResolver class]) {
+		EnumCacheSource *cache = [sharedSources objectForKey:key];
+		if (!cache) {
+			cache = [[[EnumCacheSource alloc] initWithCapacity:1000] autorelease];
+			[DnsResolver setSharedSource:cache forKey:key];
+		}
+		return [[cache retain] autorelease];
+	}
+	return nil;
+}
+
++ (EnumZoneSource *)sharedZoneSourceWithPath:(NSString *)path suffix:(NSString *)aSuffix {
+	NSString *key = [NSString stringWithFormat:@"zone:%@", path];
 	
-	return;
+	//the lock is held while the zone is read, the others want the same one
+	@synchronized([DnsResolver class]) {
+		id source = [sharedSources objectForKey:key];
+		if (!source) {
+			source = [[[EnumZoneSource alloc] initWithPath:path suffix:aSuffix] autorelease];
+			//a file that could not be read is not tried again for every lookup
+			[DnsResolver setSharedSource:(source ? source : [NSNull null]) forKey:key];
+		} else if (source != [NSNull null]) {
+			//it may have been read for another suffix
+			[source indexSuffix:aSuffix];
+		}
+		return source == [NSNull null] ? nil : [[source retain] autorelease];
+	}
+	return nil;
+}
+
++ (EnumSnapshotSource *)sharedSnapshotSourceWithPath:(NSString *)path {
+	NSString *key = [NSString stringWithFormat:@"snapshot:%@", path];
 	
+	@synchronized([DnsResolver class]) {
+		id source = [sharedSources objectForKey:key];
+		if (!source) {
+			source = [[[EnumSnapshotSource alloc] initWithPath:path] autorelease];
+			[DnsResolver setSharedSource:(source ? source : [NSNull null]) forKey:key];
+		}
+		return source == [NSNull null] ? nil : [[source retain] autorelease];
+	}
+	return nil;
 }
 
++ (void)setSharedSource:(id)source forKey:(NSString *)key {
+	@synchronized([DnsResolver class]) {
+		if (!sharedSources) {
+			sharedSources = [[NSMutableDictionary alloc] init];
+		}
+		[sharedSources setObject:source forKey:key];
+	}
+}
 
-#pragma mark ------------ Enum number conversion methods ----------
++ (BOOL)loadLocalZone:(NSString *)path suffix:(NSString *)aSuffix {
+	EnumZoneSource *source = [[EnumZoneSource alloc] initWithPath:path suffix:(aSuffix ? aSuffix : ENUM_E164_SUFFIX)];
+	if (!source) {
+		return NO;
+	}
+	//init takes it from here, the resolvers made before keep the old one
+	[DnsResolver setSharedSource:source forKey:@"zone"];
+	[source release];
+	return YES;
+}
 
++ (BOOL)loadLocalZoneFromMaster:(NSString *)address suffix:(NSString *)aSuffix {
+	EnumZoneSource *source = [[EnumZoneSource alloc] initWithMaster:address suffix:(aSuffix ? aSuffix : ENUM_E164_SUFFIX)];
+	if (!source) {
+		return NO;
+	}
+	[DnsResolver setSharedSource:source forKey:@"zone"];
+	[DnsResolver performSelectorOnMainThread:@selector(scheduleLocalZoneUpdate:) withObject:source waitUntilDone:NO];
+	[source release];
+	return YES;
+}
 
-- (NSString *)convertPhone2Enum:(NSString *)aus{
-	
-	NSMutableString *key = [NSMutableString stringWithCapacity:15];
-	int len = [aus length];
++ (void)scheduleLocalZoneUpdate:(EnumZoneSource *)source {
+	[self performSelector:@selector(startLocalZoneUpdate:) withObject:source afterDelay:source.updateInterval];
+}
+
++ (void)startLocalZoneUpdate:(EnumZoneSource *)source {
+	[self performSelectorInBackground:@selector(updateLocalZone:) withObject:source];
+}
+
++ (void)updateLocalZone:(EnumZoneSource *)source {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	BOOL current;
 	
-	for (int pos = len-1; pos >= 0; pos--) {
-		
-		NSString *element = [NSString stringWithFormat:@"%C",[aus characterAtIndex:pos]];
-		[key appendString:element];
-		[key appendString:@"."];
+	//a zone that was replaced is not kept up to date any more
+	@synchronized([DnsResolver class]) {
+		current = [sharedSources objectForKey:@"zone"] == source;
 	}
-	if (self.suffix) {
-		[key appendString:self.suffix];
-	}else {
-		[key appendString:ENUM_E164_SUFFIX];
+	if (current) {
+		[source updateFromMaster:source.master];
+		[self performSelectorOnMainThread:@selector(scheduleLocalZoneUpdate:) withObject:source waitUntilDone:NO];
 	}
+	[pool release];
+}
 
++ (BOOL)loadLocalSnapshot:(NSString *)path {
+	EnumSnapshotSource *source = [[EnumSnapshotSource alloc] initWithPath:path];
+	if (!source) {
+		return NO;
+	}
+	[DnsResolver setSharedSource:source forKey:@"snapshot"];
+	[source release];
+	return YES;
+}
+
+
+#pragma mark ------------ Enum number conversion methods ----------
+
+
+- (NSString *)convertPhone2Enum:(NSString *)aus{
 	
-	return key;
+	char *key = ldns_enum_number2str([aus UTF8String], [(self.suffix ? self.suffix : ENUM_E164_SUFFIX) UTF8String]);
+	if (!key) {
+		return nil;
+	}
+	NSString *result = [NSString stringWithUTF8String:key];
+	LDNS_FREE(key);
+	return result;
 }
 
 
@@ -87,13 +491,242 @@ NSString * const ENUM_E164_SUFFIX =  @"e164.arpa";
 -(NSArray *)doEnumQuery:(NSString *)forNumber{
 	NSString *cleanNumber = [[forNumber componentsSeparatedByCharactersInSet:[[NSCharacterSet characterSetWithCharactersInString:@"0123456789"] invertedSet]] componentsJoinedByString:@""];
 	NSLog(@"doEnumQuery:cleanNumber %@", cleanNumber);
-	NSString *e164number = [self convertPhone2Enum:cleanNumber];
 	NSMutableArray *results = [NSMutableArray arrayWithCapacity:15];
-	[self getNAPTRList:e164number inArray:results];
-		
+	NSArray *trees = self.enumTrees;
+	NSUInteger i, count = [trees count], askCount = 0;
+	BOOL found = NO;
+	
+	NSArray *sources;
+	@synchronized(self) {
+		sources = [[self.lookupSources retain] autorelease];
+	}
+	EnumTreeLookup *lookups = LDNS_XMALLOC(EnumTreeLookup, count);
+	if (!lookups) {
+		return results;
+	}
+	
+	//the local sources of every tree first, then the network. When the first
+	//tree with records is all that counts, the ones after it are not needed
+	for (i = 0; i < count; i++) {
+		EnumTreeLookup *lookup = &lookups[i];
+		EnumTree *tree = [trees objectAtIndex:i];
+		lookup->tree = tree;
+		lookup->sources = tree.cache ? [NSArray arrayWithObject:tree.cache] : sources;
+		lookup->domain = tree.suffixName ? ldns_enum_dname_new_frm_number([cleanNumber UTF8String], tree.suffixName) : NULL;
+		lookup->naptrs = NULL;
+		lookup->date = nil;
+		lookup->asked = NO;
+		if (!lookup->domain || (found && enumMergePolicy == EnumMergeFirstNonEmpty)) {
+			[tree countLookup:EnumTreeSkipped];
+			continue;
+		}
+		for (id<EnumLookupSource> source in lookup->sources) {
+			lookup->naptrs = [source naptrsForNumber:cleanNumber domain:lookup->domain date:&lookup->date];
+			if (lookup->naptrs) {
+				break;
+			}
+		}
+		if (lookup->naptrs) {
+			[tree countLookup:EnumTreeCacheHit];
+			found = found || ldns_rr_list_rr_count(lookup->naptrs) > 0;
+		} else if (!tree.cache && ![self enumFilterMayContain:cleanNumber]) {
+			//the filter is of the zone of the suffix
+			[tree countLookup:EnumTreeSkipped];
+		} else {
+			lookup->asked = YES;
+			lookup->answerIndex = askCount++;
+		}
+	}
+	
+	//the trees are asked at the same time
+	ldns_rdf **names = LDNS_XMALLOC(ldns_rdf *, askCount);
+	ldns_rr_type *types = LDNS_XMALLOC(ldns_rr_type, askCount);
+	ldns_pkt **answers = LDNS_XMALLOC(ldns_pkt *, askCount);
+	if (askCount > 0 && names && types && answers) {
+		EnumTreeQuery query = { lookups, count, answers, NO };
+		for (i = 0; i < count; i++) {
+			if (lookups[i].asked) {
+				names[lookups[i].answerIndex] = lookups[i].domain;
+				types[lookups[i].answerIndex] = LDNS_RR_TYPE_NAPTR;
+			}
+		}
+		if (!res || ldns_resolver_query_parallel(answers, res, names, types, askCount, LDNS_RR_CLASS_IN, LDNS_RD, 
+												 (enumMergePolicy == EnumMergeFirstNonEmpty ? enumTreeAnswered : NULL), &query) != LDNS_STATUS_OK) {
+			for (i = 0; i < askCount; i++) {
+				answers[i] = NULL;
+			}
+		}
+		NSDate *lookupDate = [NSDate date];
+		for (i = 0; i < count; i++) {
+			EnumTreeLookup *lookup = &lookups[i];
+			if (!lookup->asked) {
+				continue;
+			}
+			ldns_pkt *answer = answers[lookup->answerIndex];
+			BOOL answered = NO;
+			if (answer) {
+				lookup->naptrs = ldns_rr_list_new();
+				if (lookup->naptrs && enumAnswerNaptrs(answer, lookup->domain, lookup->naptrs) == 0) {
+					ldns_rr_list_free(lookup->naptrs);
+					lookup->naptrs = NULL;
+				}
+				lookup->date = lookupDate;
+				//no records is an answer, a server failure is not
+				answered = ldns_pkt_get_rcode(answer) == LDNS_RCODE_NOERROR || ldns_pkt_get_rcode(answer) == LDNS_RCODE_NXDOMAIN;
+				ldns_pkt_free(answer);
+			} else if (query.stopped) {
+				//a tree before it had records
+				[lookup->tree countLookup:EnumTreeSkipped];
+				continue;
+			}
+			if (lookup->naptrs) {
+				[lookup->tree countLookup:EnumTreeAnswer];
+				for (id<EnumLookupSource> source in lookup->sources) {
+					if ([source respondsToSelector:@selector(storeNaptrs:forDomain:date:)]) {
+						[source storeNaptrs:lookup->naptrs forDomain:lookup->domain date:lookupDate];
+					}
+				}
+			} else {
+				[lookup->tree countLookup:(answered ? EnumTreeEmptyAnswer : EnumTreeFailure)];
+				if (answered && !lookup->tree.cache) {
+					[self.enumFilter countFalsePositive];
+				}
+			}
+		}
+	}
+	LDNS_FREE(names);
+	LDNS_FREE(types);
+	LDNS_FREE(answers);
+	
+	//the records of the trees in order, of all or of the first with any
+	ldns_rr_list *taken = ldns_rr_list_new();
+	BOOL merged = NO;
+	for (i = 0; i < count; i++) {
+		EnumTreeLookup *lookup = &lookups[i];
+		if (taken && lookup->naptrs && ldns_rr_list_rr_count(lookup->naptrs) > 0 &&
+			(enumMergePolicy == EnumMergeUnion || !merged)) {
+			[self addChasedNaptrs:lookup->naptrs toArray:results sources:lookup->sources date:lookup->date number:cleanNumber taken:taken];
+			merged = YES;
+		}
+		if (lookup->naptrs) {
+			ldns_rr_list_deep_free(lookup->naptrs);
+		}
+		if (lookup->domain) {
+			ldns_rdf_deep_free(lookup->domain);
+		}
+	}
+	if (taken) {
+		ldns_rr_list_deep_free(taken);
+	}
+	LDNS_FREE(lookups);
+	
 	return results;
 }
 
+#pragma mark ------------ Enum number filter -------------------
+
+
++ (void)rebuildEnumFilter:(NSString *)path every:(NSTimeInterval)interval {
+	[DnsResolver stopEnumFilterRebuild];
+	@synchronized([DnsResolver class]) {
+		[enumFilterPath release];
+		enumFilterPath = [path copy];
+		//the filters of the old file go, the resolvers ask for new ones
+		[sharedFilters removeAllObjects];
+	}
+	if (path && interval > 0) {
+		enumFilterTimer = [[NSTimer scheduledTimerWithTimeInterval:interval 
+															target:self 
+														  selector:@selector(enumFilterTimerFired:) 
+														  userInfo:nil 
+														   repeats:YES] retain];
+	}
+}
+
++ (void)stopEnumFilterRebuild {
+	if (enumFilterTimer != nil) {
+		[enumFilterTimer invalidate];
+		[enumFilterTimer release];
+		enumFilterTimer = nil;
+	}
+}
+
++ (void)enumFilterTimerFired:(NSTimer *)timer {
+	NSArray *filters;
+	
+	@synchronized([DnsResolver class]) {
+		filters = [sharedFilters allValues];
+	}
+	for (EnumNumberFilter *filter in filters) {
+		[filter performSelectorInBackground:@selector(rebuildInBackground) withObject:nil];
+	}
+}
+
++ (EnumNumberFilter *)sharedFilterForSuffix:(NSString *)aSuffix {
+	NSString *key = [aSuffix lowercaseString];
+	EnumNumberFilter *filter;
+	
+	@synchronized([DnsResolver class]) {
+		if (!enumFilterPath) {
+			return nil;
+		}
+		filter = [sharedFilters objectForKey:key];
+		if (filter) {
+			return [[filter retain] autorelease];
+		}
+		filter = [[[EnumNumberFilter alloc] initWithPath:enumFilterPath suffix:aSuffix] autorelease];
+		if (!sharedFilters) {
+			sharedFilters = [[NSMutableDictionary alloc] init];
+		}
+		[sharedFilters setObject:filter forKey:key];
+	}
+	//the lookups do not wait for the first build
+	[filter performSelectorInBackground:@selector(rebuildInBackground) withObject:nil];
+	return filter;
+}
+
+- (EnumNumberFilter *)enumFilter {
+	@synchronized(self) {
+		NSString *filterSuffix = suffix ? suffix : ENUM_E164_SUFFIX;
+		//the suffix may have changed since the filter was taken
+		if (enumFilter && [enumFilter.suffix caseInsensitiveCompare:filterSuffix] != NSOrderedSame) {
+			[enumFilter release];
+			enumFilter = nil;
+		}
+		if (!enumFilter) {
+			enumFilter = [[DnsResolver sharedFilterForSuffix:filterSuffix] retain];
+		}
+		return [[enumFilter retain] autorelease];
+	}
+	return nil;
+}
+
+- (BOOL)enumFilterMayContain:(NSString *)number {
+	EnumNumberFilter *filter = self.enumFilter;
+	
+	return !filter || [filter mayContain:number];
+}
+
+- (NSUInteger)enumFilterSkipped {
+	return self.enumFilter.skipped;
+}
+
+- (NSUInteger)enumFilterPassed {
+	return self.enumFilter.passed;
+}
+
+- (NSUInteger)enumFilterFalsePositives {
+	return self.enumFilter.falsePositives;
+}
+
+- (double)enumFilterFalsePositiveRate {
+	return [self.enumFilter falsePositiveRate];
+}
+
+- (double)enumFilterExpectedFalsePositiveRate {
+	return [self.enumFilter expectedFalsePositiveRate];
+}
+
 #pragma mark ------------ private methods -------------------
 
 
@@ -147,26 +780,37 @@ NSString * const ENUM_E164_SUFFIX =  @"e164.arpa";
 	/* on the iphone we may not have a resolv.conf so we provide one */
 
 	s = ldns_resolver_new_frm_file(&resolver, [resolverFilePath cStringUsingEncoding:NSASCIIStringEncoding]);
+	if (s == LDNS_STATUS_OK) {
+		//the names of the search list are asked for at once, not one after the other
+		ldns_resolver_set_search_parallel(resolver, true);
+	}
 	return resolver;
 }
 
 - (ldns_rr_list *)retrieveResourceRecordsOfType:(ldns_rr_type)rrType fromDomain:(NSString *)domain {
 	
-	ldns_rr_list *rrlist;
-	
 	ldns_rdf *ldnsdomain = ldns_dname_new_frm_str([domain UTF8String]);
 	
 	if (!ldnsdomain) {
-		return rrlist;
+		return NULL;
 	}
 	
+	ldns_rr_list *rrlist = [self retrieveResourceRecordsOfType:rrType fromDname:ldnsdomain];
+	ldns_rdf_deep_free(ldnsdomain);
+	return rrlist;
+}
+
+- (ldns_rr_list *)retrieveResourceRecordsOfType:(ldns_rr_type)rrType fromDname:(ldns_rdf *)ldnsdomain {
+	
+	ldns_rr_list *rrlist = NULL;
+	
 	ldns_pkt *p;
 	
-	p = ldns_resolver_query(res,
-							ldnsdomain,
-							rrType,
-							LDNS_RR_CLASS_IN,
-							LDNS_RD);
+	p = ldns_resolver_search(res,
+							 ldnsdomain,
+							 rrType,
+							 LDNS_RR_CLASS_IN,
+							 LDNS_RD);
 	
 	
 	if (!p)  {
@@ -189,3 +833,689 @@ NSString * const ENUM_E164_SUFFIX =  @"e164.arpa";
 }
 
 @end
+
+
+#pragma mark ------------ Enum lookup sources -------------------
+
+
+@implementation EnumTree
+
+@synthesize suffix, suffixName, cache;
+@synthesize lookups, cacheHits, answers, emptyAnswers, failures, skipped;
+
+- (id)initWithSuffix:(NSString *)aSuffix cache:(EnumCacheSource *)aCache {
+	self = [super init];
+	suffix = [aSuffix copy];
+	//numbers are made names with the suffix in wire format, so it is parsed once here
+	suffixName = ldns_dname_new_frm_str([aSuffix UTF8String]);
+	cache = [aCache retain];
+	return self;
+}
+
+- (void)dealloc {
+	if (suffixName) {
+		ldns_rdf_deep_free(suffixName);
+	}
+	[cache release];
+	[suffix release];
+	[super dealloc];
+}
+
+- (void)countLookup:(EnumTreeOutcome)outcome {
+	@synchronized(self) {
+		lookups++;
+		switch (outcome) {
+			case EnumTreeCacheHit:
+				cacheHits++;
+				break;
+			case EnumTreeAnswer:
+				answers++;
+				break;
+			case EnumTreeEmptyAnswer:
+				emptyAnswers++;
+				break;
+			case EnumTreeFailure:
+				failures++;
+				break;
+			case EnumTreeSkipped:
+				skipped++;
+				break;
+		}
+	}
+}
+
+@end
+
+
+// the shortest time between updates from the master, for zones with a
+// refresh or retry of 0
+#define ENUM_ZONE_MIN_UPDATE_INTERVAL 60
+
+@implementation EnumZoneSource
+
+@synthesize master;
+
+- (id)initWithPath:(NSString *)path suffix:(NSString *)enumSuffix {
+	int line_nr = 0;
+	
+	self = [super init];
+	indexSuffixes = [[NSMutableArray alloc] init];
+	if (ldns_zone_new_frm_file_l(&zone, [path fileSystemRepresentation], NULL, 0, LDNS_RR_CLASS_IN, &line_nr) != LDNS_STATUS_OK) {
+		NSLog(@"EnumZoneSource: %@ unreadable at line %d", path, line_nr);
+		zone = NULL;
+		[self release];
+		return nil;
+	}
+	suffix = [enumSuffix copy];
+	if (![self indexSuffix:enumSuffix]) {
+		[self release];
+		return nil;
+	}
+	return self;
+}
+
+- (id)initWithMaster:(NSString *)address suffix:(NSString *)enumSuffix {
+	ldns_resolver *resolver;
+	ldns_rdf *suffixName;
+	ldns_status s;
+	
+	self = [super init];
+	indexSuffixes = [[NSMutableArray alloc] init];
+	suffix = [enumSuffix copy];
+	master = [address copy];
+	resolver = [EnumZoneSource newResolverForMaster:address];
+	suffixName = ldns_dname_new_frm_str([enumSuffix UTF8String]);
+	if (!resolver || !suffixName) {
+		if (resolver) {
+			ldns_resolver_deep_free(resolver);
+		}
+		if (suffixName) {
+			ldns_rdf_deep_free(suffixName);
+		}
+		[self release];
+		return nil;
+	}
+	//the records go into the zone as the messages come in
+	s = ldns_zone_new_frm_axfr(&zone, resolver, suffixName, LDNS_RR_CLASS_IN);
+	ldns_rdf_deep_free(suffixName);
+	ldns_resolver_deep_free(resolver);
+	if (s != LDNS_STATUS_OK) {
+		NSLog(@"EnumZoneSource: transfer of %@ from %@ failed: %s", enumSuffix, address, ldns_get_errorstr_by_id(s));
+		zone = NULL;
+		[self release];
+		return nil;
+	}
+	if (![self indexSuffix:enumSuffix]) {
+		[self release];
+		return nil;
+	}
+	updateInterval = [self soaInterval:3];
+	return self;
+}
+
+// a time field of the SOA of the zone, 3 for the refresh and 4 for the retry
+- (NSTimeInterval)soaInterval:(size_t)field {
+	ldns_rr *soa = ldns_zone_soa(zone);
+	NSTimeInterval interval = 0;
+	
+	if (soa && ldns_rr_rd_count(soa) > field) {
+		interval = ldns_rdf2native_int32(ldns_rr_rdf(soa, field));
+	}
+	return interval < ENUM_ZONE_MIN_UPDATE_INTERVAL ? ENUM_ZONE_MIN_UPDATE_INTERVAL : interval;
+}
+
+- (NSTimeInterval)updateInterval {
+	@synchronized(self) {
+		return updateInterval;
+	}
+	return 0;
+}
+
++ (ldns_resolver *)newResolverForMaster:(NSString *)address {
+	ldns_resolver *resolver;
+	ldns_rdf *master;
+	
+	master = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_A, [address UTF8String]);
+	if (!master) {
+		master = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_AAAA, [address UTF8String]);
+	}
+	resolver = master ? ldns_resolver_new() : NULL;
+	if (!resolver || ldns_resolver_push_nameserver(resolver, master) != LDNS_STATUS_OK) {
+		NSLog(@"EnumZoneSource: bad master address %@", address);
+		if (resolver) {
+			ldns_resolver_deep_free(resolver);
+			resolver = NULL;
+		}
+	}
+	if (master) {
+		ldns_rdf_deep_free(master);
+	}
+	return resolver;
+}
+
+- (void)dealloc {
+	size_t i;
+	
+	for (i = 0; i < indexCount; i++) {
+		ldns_zone_enum_index_free(indexes[i]);
+	}
+	LDNS_FREE(indexes);
+	if (zone) {
+		ldns_zone_deep_free(zone);
+	}
+	[indexSuffixes release];
+	[suffix release];
+	[master release];
+	[super dealloc];
+}
+
++ (ldns_zone_enum_index *)newIndexForZone:(ldns_zone *)aZone suffix:(NSString *)aSuffix {
+	ldns_zone_enum_index *newIndex;
+	ldns_rdf *suffixName = ldns_dname_new_frm_str([aSuffix UTF8String]);
+	
+	if (!suffixName) {
+		return NULL;
+	}
+	newIndex = ldns_zone_enum_index_new(aZone, suffixName);
+	ldns_rdf_deep_free(suffixName);
+	return newIndex;
+}
+
+- (BOOL)indexSuffix:(NSString *)aSuffix {
+	ldns_zone_enum_index **newIndexes, **oldIndexes;
+	ldns_zone_enum_index *newIndex;
+	
+	//the zone and the indexes are only changed with indexSuffixes locked,
+	//lookups just need the swap locked
+	@synchronized(indexSuffixes) {
+		for (NSString *indexed in indexSuffixes) {
+			if ([indexed caseInsensitiveCompare:aSuffix] == NSOrderedSame) {
+				return YES;
+			}
+		}
+		newIndex = [EnumZoneSource newIndexForZone:zone suffix:aSuffix];
+		newIndexes = newIndex ? LDNS_XMALLOC(ldns_zone_enum_index *, indexCount + 1) : NULL;
+		if (!newIndexes) {
+			ldns_zone_enum_index_free(newIndex);
+			return NO;
+		}
+		if (indexCount > 0) {
+			memcpy(newIndexes, indexes, indexCount * sizeof(ldns_zone_enum_index *));
+		}
+		newIndexes[indexCount] = newIndex;
+		@synchronized(self) {
+			oldIndexes = indexes;
+			indexes = newIndexes;
+			indexCount++;
+			[indexSuffixes addObject:aSuffix];
+		}
+		LDNS_FREE(oldIndexes);
+	}
+	return YES;
+}
+
+- (BOOL)updateFromMaster:(NSString *)address {
+	BOOL updated = [self transferChangesFromMaster:address];
+	NSTimeInterval interval;
+	
+	//the next update is due after the refresh of the zone now in use, or
+	//sooner after the retry when this one failed
+	@synchronized(indexSuffixes) {
+		interval = [self soaInterval:(updated ? 3 : 4)];
+	}
+	@synchronized(self) {
+		updateInterval = interval;
+	}
+	return updated;
+}
+
+- (BOOL)transferChangesFromMaster:(NSString *)address {
+	ldns_resolver *resolver;
+	ldns_zone *newZone, *oldZone;
+	ldns_rr_list *removed;
+	ldns_zone_enum_index **newIndexes, **oldIndexes;
+	size_t i, count, missing;
+	ldns_status s;
+	
+	resolver = [EnumZoneSource newResolverForMaster:address];
+	if (!resolver) {
+		return NO;
+	}
+	
+	@synchronized(indexSuffixes) {
+		count = indexCount;
+		s = ldns_zone_ixfr(resolver, zone, &newZone, &removed);
+		ldns_resolver_deep_free(resolver);
+		if (s != LDNS_STATUS_OK) {
+			NSLog(@"EnumZoneSource: transfer from %@ failed: %s", address, ldns_get_errorstr_by_id(s));
+			return NO;
+		}
+		//every suffix is indexed again for the new version, or where the
+		//index of the last update could not be built
+		newIndexes = LDNS_XMALLOC(ldns_zone_enum_index *, count);
+		if (!newIndexes) {
+			if (newZone) {
+				ldns_zone_free(newZone);
+				ldns_rr_list_free(removed);
+			}
+			return NO;
+		}
+		missing = 0;
+		for (i = 0; i < count; i++) {
+			if (newZone || !indexes[i]) {
+				newIndexes[i] = [EnumZoneSource newIndexForZone:(newZone ? newZone : zone) suffix:[indexSuffixes objectAtIndex:i]];
+			} else {
+				newIndexes[i] = indexes[i];
+			}
+			if (!newIndexes[i]) {
+				missing++;
+			}
+		}
+		oldZone = NULL;
+		@synchronized(self) {
+			oldIndexes = indexes;
+			indexes = newIndexes;
+			if (newZone) {
+				oldZone = zone;
+				zone = newZone;
+			}
+		}
+		for (i = 0; i < count; i++) {
+			if (oldIndexes[i] != newIndexes[i]) {
+				ldns_zone_enum_index_free(oldIndexes[i]);
+			}
+		}
+		LDNS_FREE(oldIndexes);
+		if (oldZone) {
+			ldns_zone_free(oldZone);
+			ldns_rr_list_deep_free(removed);
+			NSLog(@"EnumZoneSource: %@ now at serial %u", suffix, ldns_rdf2native_int32(ldns_rr_rdf(ldns_zone_soa(newZone), 2)));
+		}
+	}
+	if (missing > 0) {
+		NSLog(@"EnumZoneSource: %lu suffixes of %@ not indexed, not answering them until the next update", (unsigned long)missing, suffix);
+		return NO;
+	}
+	return YES;
+}
+
+- (ldns_rr_list *)naptrsForNumber:(NSString *)number domain:(ldns_rdf *)domain date:(NSDate **)date {
+	ldns_rr_list *copy = NULL;
+	size_t i;
+	
+	@synchronized(self) {
+		//the index of the suffix the domain is under has it
+		for (i = 0; i < indexCount && !copy; i++) {
+			ldns_rr_list *naptrs = indexes[i] ? ldns_zone_enum_index_naptrs_frm_dname(indexes[i], domain) : NULL;
+			if (naptrs) {
+				//the zone is authoritative, its records are as fresh as the lookup
+				copy = ldns_rr_list_clone(naptrs);
+				ldns_rr_list_free(naptrs);
+			}
+		}
+	}
+	if (!copy) {
+		return NULL;
+	}
+	*date = [NSDate date];
+	return copy;
+}
+
+@end
+
+
+@implementation EnumSnapshotSource
+
+@synthesize serial;
+
+- (id)initWithPath:(NSString *)aPath {
+	self = [super init];
+	path = [aPath copy];
+	if (![self reload]) {
+		[self release];
+		return nil;
+	}
+	return self;
+}
+
+- (void)dealloc {
+	ldns_zone_snapshot_free(snapshot);
+	[path release];
+	[refreshDate release];
+	[expireDate release];
+	[super dealloc];
+}
+
+- (BOOL)reload {
+	ldns_zone_snapshot *newSnapshot;
+	ldns_rr *soa;
+	ldns_status s;
+	
+	s = ldns_zone_snapshot_new_frm_file(&newSnapshot, [path fileSystemRepresentation]);
+	if (s != LDNS_STATUS_OK) {
+		NSLog(@"EnumSnapshotSource: %@ %s", path, ldns_get_errorstr_by_id(s));
+		return NO;
+	}
+	//without an SOA there is no telling how long the data is good
+	soa = ldns_zone_snapshot_soa(newSnapshot);
+	if (!soa || ldns_rr_rd_count(soa) < 7) {
+		NSLog(@"EnumSnapshotSource: %@ has no SOA", path);
+		if (soa) {
+			ldns_rr_free(soa);
+		}
+		ldns_zone_snapshot_free(newSnapshot);
+		return NO;
+	}
+	uint32_t newSerial = ldns_rdf2native_int32(ldns_rr_rdf(soa, 2));
+	NSTimeInterval refresh = ldns_rdf2native_int32(ldns_rr_rdf(soa, 3));
+	NSTimeInterval newRetry = ldns_rdf2native_int32(ldns_rr_rdf(soa, 4));
+	NSTimeInterval expire = ldns_rdf2native_int32(ldns_rr_rdf(soa, 5));
+	ldns_rr_free(soa);
+	
+	NSDate *written = [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL] fileModificationDate];
+	if (!written) {
+		written = [NSDate date];
+	}
+	
+	@synchronized(self) {
+		if (snapshot && newSerial == serial) {
+			//the same data, keep the mapping that is in use
+			ldns_zone_snapshot_free(newSnapshot);
+		} else {
+			ldns_zone_snapshot_free(snapshot);
+			snapshot = newSnapshot;
+			serial = newSerial;
+			retry = newRetry;
+			[expireDate release];
+			expireDate = [[written addTimeInterval:expire] retain];
+		}
+		[refreshDate release];
+		refreshDate = [[NSDate dateWithTimeIntervalSinceNow:refresh] retain];
+	}
+	return YES;
+}
+
+- (void)reloadInBackground {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	BOOL loaded = [self reload];
+	
+	@synchronized(self) {
+		if (!loaded) {
+			[refreshDate release];
+			refreshDate = [[NSDate dateWithTimeIntervalSinceNow:retry] retain];
+		}
+		reloading = NO;
+	}
+	[pool release];
+}
+
+- (ldns_rr_list *)naptrsForNumber:(NSString *)number domain:(ldns_rdf *)domain date:(NSDate **)date {
+	NSDate *now = [NSDate date];
+	ldns_rr_list *naptrs = NULL;
+	BOOL reloadDue = NO;
+	
+	@synchronized(self) {
+		//the file is read on another thread, the lookups go on with the
+		//snapshot in use until reload swaps in the new one
+		if (!reloading && [now compare:refreshDate] != NSOrderedAscending) {
+			reloading = YES;
+			reloadDue = YES;
+		}
+		if ([now compare:expireDate] == NSOrderedAscending) {
+			naptrs = ldns_zone_snapshot_rrset(snapshot, domain, LDNS_RR_TYPE_NAPTR);
+		}
+	}
+	if (reloadDue) {
+		[self performSelectorInBackground:@selector(reloadInBackground) withObject:nil];
+	}
+	if (naptrs) {
+		*date = now;
+	}
+	return naptrs;
+}
+
+@end
+
+
+@implementation EnumNumberFilter
+
+@synthesize path, suffix;
+
+- (id)initWithPath:(NSString *)aPath suffix:(NSString *)aSuffix {
+	self = [super init];
+	path = [aPath copy];
+	suffix = [aSuffix copy];
+	return self;
+}
+
+- (void)dealloc {
+	ldns_zone_enum_filter_free(filter);
+	[path release];
+	[suffix release];
+	[super dealloc];
+}
+
+- (BOOL)rebuild {
+	ldns_zone_snapshot *snapshot;
+	ldns_zone_enum_filter *newFilter, *old;
+	ldns_rdf *suffixName;
+	ldns_status s;
+	
+	s = ldns_zone_snapshot_new_frm_file(&snapshot, [path fileSystemRepresentation]);
+	if (s != LDNS_STATUS_OK) {
+		NSLog(@"EnumNumberFilter: %@ %s", path, ldns_get_errorstr_by_id(s));
+		return NO;
+	}
+	suffixName = ldns_dname_new_frm_str([suffix UTF8String]);
+	newFilter = suffixName ? ldns_zone_enum_filter_new_frm_snapshot(snapshot, suffixName) : NULL;
+	if (suffixName) {
+		ldns_rdf_deep_free(suffixName);
+	}
+	ldns_zone_snapshot_free(snapshot);
+	if (!newFilter) {
+		return NO;
+	}
+	
+	//lookups check the filter under the lock, so the old one is unused once it is swapped out
+	@synchronized(self) {
+		old = filter;
+		filter = newFilter;
+		skipped = 0;
+		passed = 0;
+		falsePositives = 0;
+	}
+	ldns_zone_enum_filter_free(old);
+	return YES;
+}
+
+- (void)rebuildInBackground {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	[self rebuild];
+	[pool release];
+}
+
+- (BOOL)mayContain:(NSString *)number {
+	@synchronized(self) {
+		if (!filter) {
+			return YES;
+		}
+		if (!ldns_zone_enum_filter_may_contain(filter, [number UTF8String])) {
+			skipped++;
+			return NO;
+		}
+		passed++;
+	}
+	return YES;
+}
+
+- (void)countFalsePositive {
+	@synchronized(self) {
+		if (filter) {
+			falsePositives++;
+		}
+	}
+}
+
+- (NSUInteger)skipped {
+	@synchronized(self) {
+		return skipped;
+	}
+	return 0;
+}
+
+- (NSUInteger)passed {
+	@synchronized(self) {
+		return passed;
+	}
+	return 0;
+}
+
+- (NSUInteger)falsePositives {
+	@synchronized(self) {
+		return falsePositives;
+	}
+	return 0;
+}
+
+- (double)falsePositiveRate {
+	@synchronized(self) {
+		//the numbers that were skipped had no records either
+		if (falsePositives + skipped == 0) {
+			return 0.0;
+		}
+		return (double)falsePositives / (falsePositives + skipped);
+	}
+	return 0.0;
+}
+
+- (double)expectedFalsePositiveRate {
+	@synchronized(self) {
+		if (filter) {
+			return ldns_zone_enum_filter_fp_rate(filter);
+		}
+	}
+	return 0.0;
+}
+
+@end
+
+
+@interface EnumCacheEntry : NSObject {
+@public
+	ldns_rr_list *naptrs;
+	NSDate *date;
+	NSDate *expiryDate;
+}
+@end
+
+@implementation EnumCacheEntry
+
+- (void)dealloc {
+	ldns_rr_list_deep_free(naptrs);
+	[date release];
+	[expiryDate release];
+	[super dealloc];
+}
+
+@end
+
+
+@implementation EnumCacheSource
+
+- (id)initWithCapacity:(NSUInteger)aCapacity {
+	self = [super init];
+	capacity = aCapacity;
+	entries = [[NSMutableDictionary alloc] initWithCapacity:aCapacity];
+	return self;
+}
+
+- (void)dealloc {
+	[entries release];
+	[super dealloc];
+}
+
+- (NSString *)keyForDomain:(ldns_rdf *)domain {
+	char *str = ldns_rdf2str(domain);
+	if (!str) {
+		return nil;
+	}
+	NSString *key = [[NSString stringWithUTF8String:str] lowercaseString];
+	free(str);
+	return key;
+}
+
+- (ldns_rr_list *)naptrsForNumber:(NSString *)number domain:(ldns_rdf *)domain date:(NSDate **)date {
+	NSString *key = [self keyForDomain:domain];
+	if (!key) {
+		return NULL;
+	}
+	@synchronized(self) {
+		EnumCacheEntry *entry = [entries objectForKey:key];
+		if (!entry) {
+			return NULL;
+		}
+		if ([entry->expiryDate timeIntervalSinceNow] <= 0) {
+			[entries removeObjectForKey:key];
+			return NULL;
+		}
+		*date = [[entry->date retain] autorelease];
+		return ldns_rr_list_clone(entry->naptrs);
+	}
+	return NULL;
+}
+
+- (void)storeNaptrs:(ldns_rr_list *)naptrs forDomain:(ldns_rdf *)domain date:(NSDate *)date {
+	NSString *key = [self keyForDomain:domain];
+	NSUInteger i, count = ldns_rr_list_rr_count(naptrs);
+	uint32_t ttl;
+	
+	if (!key || count == 0) {
+		return;
+	}
+	//the set goes stale with its first record
+	ttl = ldns_rr_ttl(ldns_rr_list_rr(naptrs, 0));
+	for (i = 1; i < count; i++) {
+		if (ldns_rr_ttl(ldns_rr_list_rr(naptrs, i)) < ttl) {
+			ttl = ldns_rr_ttl(ldns_rr_list_rr(naptrs, i));
+		}
+	}
+	if (ttl == 0) {
+		return;
+	}
+	
+	EnumCacheEntry *entry = [[EnumCacheEntry alloc] init];
+	entry->naptrs = ldns_rr_list_clone(naptrs);
+	entry->date = [date retain];
+	entry->expiryDate = [[date addTimeInterval:ttl] retain];
+	if (!entry->naptrs) {
+		[entry release];
+		return;
+	}
+	
+	@synchronized(self) {
+		if ([entries count] >= capacity && ![entries objectForKey:key]) {
+			//make room, the expired ones first and else the one that
+			//expires first, the others are still good
+			NSMutableArray *expired = [NSMutableArray array];
+			NSString *soonestKey = nil;
+			NSDate *soonest = nil;
+			for (NSString *oldKey in entries) {
+				NSDate *expiry = ((EnumCacheEntry *)[entries objectForKey:oldKey])->expiryDate;
+				if ([expiry timeIntervalSinceNow] <= 0) {
+					[expired addObject:oldKey];
+				} else if (!soonest || [expiry compare:soonest] == NSOrderedAscending) {
+					soonest = expiry;
+					soonestKey = oldKey;
+				}
+			}
+			[entries removeObjectsForKeys:expired];
+			if ([entries count] >= capacity && soonestKey) {
+				[entries removeObjectForKey:soonestKey];
+			}
+		}
+		[entries setObject:entry forKey:key];
+	}
+	[entry release];
+}
+
+@end
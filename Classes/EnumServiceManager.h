@@ -9,6 +9,7 @@
 #import <Foundation/Foundation.h>
 #import "EnumService.h"
 #import "LocationService.h"
+#import "ldns.h"
 
 @interface EnumServiceManager : NSObject {
 }
@@ -82,63 +82,36 @@
 
 
 +(EnumService *)getEnumSericeForWeb:(NSString *)url{
-	EnumService *es = [[[EnumService alloc] init] autorelease];
+	//icons of the sites ldns recognizes, in the order of ldns_enum_site
+	static NSString * const siteIcons[] = {
+		nil,
+		@"linkedin.png",
+		@"facebook.png",
+		@"hyves.png",
+		@"twitter.png",
+		@"foursquare.png",
+		@"youtube.png",
+		@"skype.png",
+		@"myspace.png",
+		@"flickr.png",
+		@"openid-32.png"
+	};
 	
-	if ([url rangeOfString:@"linkedin.com"].location != NSNotFound) {
-		//linkedin site found
-		es.icon = [UIImage imageNamed:@"linkedin.png"];
-		es.title = @"LinkedIn";
-	}else if ([url rangeOfString:@"facebook.com"].location != NSNotFound) {
-		//facebook site found
-		es.icon = [UIImage imageNamed:@"facebook.png"];
-		es.title = @"Facebook";
-	}else if ([url rangeOfString:@"hyves.nl"].location != NSNotFound) {
-		//hyves site found
-		es.icon = [UIImage imageNamed:@"hyves.png"];
-		es.title = @"Hyves";
-	}else if ([url rangeOfString:@"twitter.com"].location != NSNotFound) {
-		//twitter site found
-		es.icon = [UIImage imageNamed:@"twitter.png"];
-		es.title = @"Twitter";
-	}else if ([url rangeOfString:@"foursquare.com"].location != NSNotFound) {
-		//foursquare site found
-		es.icon = [UIImage imageNamed:@"foursquare.png"];
-		es.title = @"Foursquare";
-	}else if ([url rangeOfString:@"youtube.com"].location != NSNotFound) {
-		//youtube site found
-		es.icon = [UIImage imageNamed:@"youtube.png"];
-		es.title = @"Youtube";
-	}else if ([url rangeOfString:@"skype.com"].location != NSNotFound) {
-		//skype site found
-		es.icon = [UIImage imageNamed:@"skype.png"];
-		es.title = @"Skype";
-	}else if ([url rangeOfString:@"myspace.com"].location != NSNotFound) {
-		//myspace site found
-		es.icon = [UIImage imageNamed:@"myspace.png"];
-		es.title = @"Myspace";
-	}else if ([url rangeOfString:@"flickr.com"].location != NSNotFound) {
-		//flickr site found
-		es.icon = [UIImage imageNamed:@"flickr.png"];
-		es.title = @"Flickr";
-	}else if ([url rangeOfString:@"myopenid.com"].location != NSNotFound) {
-		//myopenid site found
-		es.icon = [UIImage imageNamed:@"openid-32.png"];
-		es.title = @"myOpenId";
-	}
-
-	if (es.icon) {
-		//found a supported website
-		es.url = url;
-		[es setType:SERVICE_WEB];
-		
-		NSLog(@"found web service: %@", es.title);
-		
-		return es;
+	ldns_enum_site site = ldns_enum_site_frm_uri([url UTF8String]);
+	if (site == LDNS_ENUM_SITE_NONE || site >= sizeof(siteIcons) / sizeof(siteIcons[0])) {
+		return nil;
 	}
 	
+	//found a supported website
+	EnumService *es = [[[EnumService alloc] init] autorelease];
+	es.icon = [UIImage imageNamed:siteIcons[site]];
+	es.title = [NSString stringWithUTF8String:ldns_enum_site_name(site)];
+	es.url = url;
+	[es setType:SERVICE_WEB];
 	
+	NSLog(@"found web service: %@", es.title);
 	
-	return nil;
+	return es;
 
 }
 
@@ -39,6 +39,7 @@
 	NSString *labelDescription;			// descriptive label
 	NSString *uriContent;				// value of the NAPTR after regexp has been applied
 	NSDate *expiryDate;					// Expiry date of the record, based on time-to-live
+	ldns_enum_service_class serviceClass;	// kind of service of the first service type
 	
 }
 
@@ -58,6 +59,16 @@
  */
 + (id)recordWithRr:(ldns_rr *)rr date:(NSDate *)lookupDate;
 
+/**
+ * Class methods to initialize a NAPTR record from a ldns resource record
+ * that was reached from a number through non-terminal NAPTRs, so its
+ * owner is not the domain of the number.
+ * 
+ * @param aus  the number the regexp is applied to, with the + in front
+ * @return     the record
+ */
++ (id)recordWithRr:(ldns_rr *)rr date:(NSDate *)lookupDate aus:(NSString *)aus;
+
 /**
  * Initializer for a NAPTR record from a ldns resource record
  * Sets property isValid=NO on error or if the provided ldns rr is not a NAPTR.
@@ -67,6 +78,7 @@
  * @return     the record
  */
 - (id)initWithRr:(ldns_rr *)rr date:(NSDate *)lookupDate;
+- (id)initWithRr:(ldns_rr *)rr date:(NSDate *)lookupDate aus:(NSString *)aus;
 
 /**
  * Comparison selector for ordering NAPTR records. Use this to properly sort
@@ -82,6 +94,7 @@
 @property (readonly) BOOL isEncrypted;
 @property (readonly) BOOL isHidden;
 @property (readonly) BOOL isValid;
+@property (readonly) ldns_enum_service_class serviceClass;
 
 @property (readonly, nonatomic, retain) NSNumber *order; 
 @property (readonly, nonatomic, retain) NSNumber *preference; 
@@ -9,10 +9,7 @@
 #import "RecordNaptr.h"
 @interface RecordNaptr (PrivateMethods)
 
-- (void)parseServices:(NSString *)services;
-- (BOOL)tokenIsLih:(NSString *)token;
 - (NSString *)generateServiceDescription;
-- (NSString *)generateLabelDescription;
 
 - (NSString *)stringFromStringRdf:(const ldns_rdf *)rdf;
 - (NSString *)stringFromDnameRdf:(const ldns_rdf *)rdf;
@@ -34,6 +31,7 @@
 @synthesize isHidden;
 @synthesize isValid;
 @synthesize expiryDate;
+@synthesize serviceClass;
 
 + (id)recordWithRr:(ldns_rr *)rr {
 	NSDate *lookupDate = [[NSDate date] retain];
@@ -47,6 +45,11 @@
 	return self;
 }
 
++ (id)recordWithRr:(ldns_rr *)rr date:(NSDate *)lookupDate aus:(NSString *)aus {
+	self = [[[RecordNaptr alloc] initWithRr:rr date:lookupDate aus:aus] autorelease];
+	return self;
+}
+
 - (id)init {
 	// Never initialize it empty
 	self = [super init];
@@ -56,100 +59,63 @@
 }
 
 - (id)initWithRr:(ldns_rr *)rr date:(NSDate *)lookupDate {
+	return [self initWithRr:rr date:lookupDate aus:nil];
+}
+
+- (id)initWithRr:(ldns_rr *)rr date:(NSDate *)lookupDate aus:(NSString *)aus {
 	self = [super init];
 	isValid = NO;
 	
-	if (ldns_rr_get_type(rr) != LDNS_RR_TYPE_NAPTR)
+	// The fields are decoded by ldns, what is left here is making them objects.
+	// Without an aus the regexp is applied to the number of the owner name of the record
+	ldns_enum_naptr *naptr = NULL;
+	if (ldns_enum_naptr_new_frm_rr(&naptr, rr, [aus UTF8String]) != LDNS_STATUS_OK)
 		return self;
 	
-	NSTimeInterval ttl = (NSTimeInterval)ldns_rr_ttl(rr);
-	expiryDate = [lookupDate addTimeInterval:ttl];
+	NSTimeInterval ttl = (NSTimeInterval)ldns_enum_naptr_ttl(naptr);
+	expiryDate = [[lookupDate addTimeInterval:ttl] retain];
 	
 	serviceTypeArray = [NSMutableArray arrayWithCapacity:2];
 	labelArray = [NSMutableArray arrayWithCapacity:2];
 	lihArray = [NSMutableArray arrayWithCapacity:2];
 	
-	order = [[self numberFromIntRdf:ldns_rr_rdf(rr,0)] retain];
-	preference = [[self numberFromIntRdf:ldns_rr_rdf(rr,1)] retain];
-	flags = [[self stringFromStringRdf:ldns_rr_rdf(rr,2)] retain];
-	services = [[self stringFromStringRdf:ldns_rr_rdf(rr,3)] retain];
-	regexp = [[self stringFromStringRdf:ldns_rr_rdf(rr,4)] retain];
+	order = [[NSNumber numberWithInt:ldns_enum_naptr_order(naptr)] retain];
+	preference = [[NSNumber numberWithInt:ldns_enum_naptr_preference(naptr)] retain];
+	flags = [[NSString stringWithUTF8String:ldns_enum_naptr_flags(naptr)] retain];
+	services = [[NSString stringWithUTF8String:ldns_enum_naptr_services(naptr)] retain];
+	regexp = [[NSString stringWithUTF8String:ldns_enum_naptr_regexp(naptr)] retain];
+	replacement = [[NSString stringWithUTF8String:ldns_enum_naptr_replacement(naptr)] retain];
+	uriContent = [[NSString stringWithUTF8String:ldns_enum_naptr_uri(naptr)] retain];
 	
-	if ([services isEqualToString:@"x-crypto:data:8210"]) {
-		isPrivate = YES;
-		isEncrypted = YES;
-		
-		//TODO: Try to decrypt the NAPTR record
-		// if successful, set isEncrypted to NO;
-		
-	} else { // Not encrypted
-		isPrivate = NO;
-		isEncrypted = NO;
-	}
+	isTerminal = ldns_enum_naptr_terminal(naptr);
+	isEncrypted = ldns_enum_naptr_encrypted(naptr);
+	//TODO: Try to decrypt the NAPTR record
+	// if successful, set isEncrypted to NO;
+	isPrivate = isEncrypted;
+	serviceClass = ldns_enum_naptr_class(naptr);
 	
-	if ([flags isEqualToString:@"u"]) { // terminal naptr
-		isTerminal = YES;
-		replacement = @"";
-		[self parseServices:services];
-
-		if (isEncrypted) {
-			uriContent = @"";
-		} else {
-			// Clean Regexp (don't bother with regex, just assume it's a full overwrite)
-			NSArray *regexParts = [regexp componentsSeparatedByString:@"!"];
-			uriContent = [[NSString stringWithString:[regexParts objectAtIndex:2]] retain];
-		}
-		
-	} else if ([flags isEqualToString:@""]) { // Non-terminal naptr
-		isTerminal = NO;
-		replacement = [self stringFromDnameRdf:ldns_rr_rdf(rr,5)];
-		uriContent = [replacement retain];
-		
-	} else { // Not valid
-		return self;
+	size_t i;
+	for (i = 0; i < ldns_enum_naptr_type_count(naptr); i++) {
+		[serviceTypeArray addObject:[NSString stringWithUTF8String:ldns_enum_naptr_type(naptr, i)]];
+	}
+	for (i = 0; i < ldns_enum_naptr_lih_count(naptr); i++) {
+		[lihArray addObject:[NSString stringWithUTF8String:ldns_enum_naptr_lih(naptr, i)]];
+	}
+	for (i = 0; i < ldns_enum_naptr_label_count(naptr); i++) {
+		[labelArray addObject:[NSString stringWithUTF8String:ldns_enum_naptr_label(naptr, i)]];
 	}
 	
 	serviceDescription = [[self generateServiceDescription] retain];
-	labelDescription = [[self generateLabelDescription] retain];
+	char *label = ldns_enum_naptr_label_description(naptr);
+	labelDescription = [[NSString stringWithUTF8String:(label ? label : "")] retain];
+	if (label)
+		LDNS_FREE(label);
 	
+	ldns_enum_naptr_free(naptr);
 	isValid = YES;
 	return self;
 }
 
-- (void)parseServices:(NSString *)_services {
-	NSArray *sParts = [_services componentsSeparatedByString:@"+"];
-	NSString *aPart;
-	for (aPart in sParts) {
-		// Discard the E2U prefix
-		if ([aPart isEqualToString:@"E2U"])
-			continue;
-		if ([aPart hasPrefix:@"x-lbl:"]) {
-			[labelArray addObject:[aPart substringFromIndex:[@"x-lbl:" length]]];
-			continue;
-		}
-		if ([self tokenIsLih:aPart]) {
-			[lihArray addObject:aPart];
-			continue;
-		}
-		// service types are anything not of the above
-		[serviceTypeArray addObject:aPart];
-	}
-}
-
-- (BOOL)tokenIsLih:(NSString *)token {
-	
-	NSArray *locationIndicatorHints = [NSArray arrayWithObjects:
-									   @"x-mobile",
-									   @"x-work",
-									   @"x-main",
-									   @"x-home",
-									   @"x-transit",
-									   @"x-prs",
-									   nil
-									   ];
-	return ([locationIndicatorHints containsObject:token]);
-}
-
 - (NSString *)generateServiceDescription {
 	// Create the service description string, concatenating all service types and LIH
 	NSMutableString *theDesc = [[[NSMutableString alloc] initWithCapacity:30] autorelease];
@@ -206,27 +172,6 @@
 	return theDesc;
 }
 
-- (NSString *)generateLabelDescription {
-	// This one is easy, just concatenate all labels and replace dashes with spaces
-	NSMutableString *theDesc = [[[NSMutableString alloc] initWithCapacity:20] autorelease];
-
-	[theDesc setString:[labelArray componentsJoinedByString:@" "]];
-	[theDesc replaceOccurrencesOfString:@"-"
-							 withString:@" "
-								options:NSLiteralSearch
-								  range:NSMakeRange(0, [theDesc length])];
-	[theDesc replaceOccurrencesOfString:@"_"
-							 withString:@" "
-								options:NSLiteralSearch
-								  range:NSMakeRange(0, [theDesc length])];
-	// Label is a max of 20 chars
-	// TODO: verify if it is 20 chars or 20 bytes
-	if ([theDesc length] > 20) {
-		[theDesc deleteCharactersInRange:NSMakeRange(20, [theDesc length] - 20)];
-	}
-	return theDesc;
-}
-
 - (NSComparisonResult)comparator:(RecordNaptr *)aNaptr {
 	// First sort by order
 	switch ([order compare:aNaptr.order]) {
@@ -255,69 +200,20 @@
 # pragma mark ------------- Utility functions for parsing record data fields ------------
 
 - (NSString *)stringFromStringRdf:(const ldns_rdf *)rdf {
-	NSMutableString *res;
-	const uint8_t *data = ldns_rdf_data(rdf);
-	uint8_t length = data[0];
-	size_t i;
-	res = [NSMutableString stringWithCapacity:length];
-	for (i = 1; i <= length; ++i) {
-		char ch = (char) data[i];
-		if (isprint(ch)) {
-			if (ch == '"' || ch == '\\') {
-				[res appendString:@"\\"];
-			}
-			[res appendFormat:@"%c", ch];
-		} else {
-			[res appendFormat:@"\\%03u", (unsigned) ch];
-		}
-	}
+	char *str = ldns_enum_string_rdf2str(rdf);
+	if (!str)
+		return nil;
+	NSString *res = [NSString stringWithUTF8String:str];
+	LDNS_FREE(str);
 	return res;
 }
 
 - (NSString *)stringFromDnameRdf:(const ldns_rdf *)rdf {
-	NSMutableString *res;
-	uint8_t src_pos = 0;
-	uint8_t len;
-	uint8_t *data;
-	uint8_t i;
-	
-	data = (uint8_t*)ldns_rdf_data(rdf);
-	len = data[src_pos];
-	
-	if (ldns_rdf_size(rdf) > LDNS_MAX_DOMAINLEN) {
-		/* too large, return */
+	char *str = ldns_enum_dname_rdf2str(rdf);
+	if (!str)
 		return nil;
-	}
-	
-	res = [NSMutableString stringWithCapacity:len];
-	
-	/* special case: root label */
-	if (1 == ldns_rdf_size(rdf)) {
-		// keep the output empty
-	} else {
-		while ((len > 0) && src_pos < ldns_rdf_size(rdf)) {
-			src_pos++;
-			for(i = 0; i < len; i++) {
-				/* paranoia check for various 'strange' 
-				 characters in dnames
-				 */
-				if (data[src_pos] == '.' ||
-				    data[src_pos] == '(' || data[src_pos] == ')') {
-					[res appendFormat:@"\\%c", data[src_pos]];
-				} else if (!isprint((int) data[src_pos])) {
-					[res appendFormat:@"\\%03u", data[src_pos]];
-				} else {
-					[res appendFormat:@"%c", data[src_pos]];
-				}
-				src_pos++;
-			}
-			
-			len = data[src_pos];
-			// Don't append the last dot
-			if (len > 0)
-				[res appendString:@"."];
-		}
-	}	
+	NSString *res = [NSString stringWithUTF8String:str];
+	LDNS_FREE(str);
 	return res;
 }
 
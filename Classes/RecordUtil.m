@@ -17,7 +17,7 @@
 	NSMutableArray *list = [NSMutableArray arrayWithCapacity:10];
 	for (RecordNaptr *rec in naptrList) {
 		
-		if ([[rec serviceDescription] isEqualToString:@"web:http"]  ) {
+		if (rec.serviceClass == LDNS_ENUM_SERVICE_WEB) {
 			[list addObject:rec];
 		}
 	}
@@ -31,7 +31,7 @@
 
 	for (RecordNaptr *rec in naptrList) {
 		
-		if ([[rec serviceDescription] isEqualToString:@"key:http"]  ) {
+		if (rec.serviceClass == LDNS_ENUM_SERVICE_KEY) {
 			return rec.uriContent;
 		}
 	}
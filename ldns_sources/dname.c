@@ -148,40 +148,43 @@ ldns_dname_left_chop(const ldns_rdf *d)
 	return chop;
 }
 
-uint8_t         
+uint8_t
 ldns_dname_label_count(const ldns_rdf *r)
-{       
-        uint16_t src_pos;
-        uint16_t len;
-        uint8_t i;
-        size_t r_size;
+{
+	uint16_t src_pos;
+	uint16_t len;
+	uint8_t i;
+	size_t r_size;
 
 	if (!r) {
 		return 0;
 	}
+	if (ldns_rdf_get_type(r) != LDNS_RDF_TYPE_DNAME) {
+		return 0;
+	}
+	if (r->_label_count >= 0) {
+		return (uint8_t) r->_label_count;
+	}
 
-        i = 0; 
+	i = 0;
 	src_pos = 0;
-        r_size = ldns_rdf_size(r);
+	r_size = ldns_rdf_size(r);
+	len = ldns_rdf_data(r)[src_pos]; /* start of the label */
+
+	/* single root label */
+	if (1 != r_size) {
+		while ((len > 0) && src_pos < r_size) {
+			src_pos++;
+			src_pos += len;
+			len = ldns_rdf_data(r)[src_pos];
+			i++;
+		}
+	}
 
-        if (ldns_rdf_get_type(r) != LDNS_RDF_TYPE_DNAME) {
-                return 0;
-        } else {
-                len = ldns_rdf_data(r)[src_pos]; /* start of the label */
-
-                /* single root label */
-                if (1 == r_size) {
-                        return 0; 
-                } else {
-                        while ((len > 0) && src_pos < r_size) {
-                                src_pos++;
-                                src_pos += len;
-                                len = ldns_rdf_data(r)[src_pos];
-                                i++;
-                        }
-                }
-                return i;
-        }
+	/* the count is a cache, it does not change the name itself;
+	 * it is reset whenever the size, type or data is set */
+	((ldns_rdf *) r)->_label_count = i;
+	return i;
 }
 
 ldns_rdf *
@@ -211,20 +214,81 @@ ldns_dname_new_frm_data(uint16_t size, const void *data)
 	return ldns_rdf_new_frm_data(LDNS_RDF_TYPE_DNAME, size, data);
 }
 
+/*
+ * Case folding, eight octets at a time
+ *
+ * For every octet of a 64 bit word, the high bit of the masks below is
+ * set when the octet is an ASCII uppercase letter; adding 0x20 to those
+ * octets only lowercases the letters. Label length octets (at most 63)
+ * are never letters, so whole dnames can be folded at once.
+ */
+#define LDNS_OCTETS_ONES  0x0101010101010101ULL
+#define LDNS_OCTETS_HIGH  0x8080808080808080ULL
+#define LDNS_OCTET_TOLOWER(c) \
+	((c) >= 'A' && (c) <= 'Z' ? (c) + ('a' - 'A') : (c))
+
+static inline uint64_t
+ldns_octets_tolower64(uint64_t x)
+{
+	uint64_t heptets = x & ~LDNS_OCTETS_HIGH;
+	uint64_t above_z = heptets + LDNS_OCTETS_ONES * (0x7f - 'Z');
+	uint64_t from_a = heptets + LDNS_OCTETS_ONES * (0x80 - 'A');
+	uint64_t upper = ~x & (from_a ^ above_z) & LDNS_OCTETS_HIGH;
+
+	return x | (upper >> 2);
+}
+
 void
-ldns_dname2canonical(const ldns_rdf *rd)
+ldns_dname_octets_tolower(uint8_t *dst, const uint8_t *src, size_t len)
 {
-	uint8_t *rdd;
-	uint16_t i;
+	uint64_t word;
+	size_t i = 0;
 
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&word, src + i, 8);
+		word = ldns_octets_tolower64(word);
+		memcpy(dst + i, &word, 8);
+	}
+	for (; i < len; i++) {
+		dst[i] = (uint8_t) LDNS_OCTET_TOLOWER(src[i]);
+	}
+}
+
+int
+ldns_dname_octets_casecmp(const uint8_t *a, const uint8_t *b, size_t len)
+{
+	uint64_t wa, wb;
+	size_t i = 0;
+	int ca, cb;
+
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&wa, a + i, 8);
+		memcpy(&wb, b + i, 8);
+		if (wa != wb && ldns_octets_tolower64(wa)
+		                != ldns_octets_tolower64(wb)) {
+			/* the difference is somewhere in these eight */
+			break;
+		}
+	}
+	for (; i < len; i++) {
+		ca = LDNS_OCTET_TOLOWER(a[i]);
+		cb = LDNS_OCTET_TOLOWER(b[i]);
+		if (ca != cb) {
+			return ca < cb ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+void
+ldns_dname2canonical(const ldns_rdf *rd)
+{
 	if (ldns_rdf_get_type(rd) != LDNS_RDF_TYPE_DNAME) {
 		return;
 	}
 
-	rdd = (uint8_t*)ldns_rdf_data(rd);
-	for (i = 0; i < ldns_rdf_size(rd); i++, rdd++) {
-		*rdd = (uint8_t)LDNS_DNAME_NORMALIZE((int)*rdd);
-	}
+	ldns_dname_octets_tolower((uint8_t *) ldns_rdf_data(rd),
+	                          ldns_rdf_data(rd), ldns_rdf_size(rd));
 }
 
 bool
@@ -232,9 +296,9 @@ ldns_dname_is_subdomain(const ldns_rdf *sub, const ldns_rdf *parent)
 {
 	uint8_t sub_lab;
 	uint8_t par_lab;
-	int8_t i, j;
-	ldns_rdf *tmp_sub;
-	ldns_rdf *tmp_par;
+	uint8_t i;
+	size_t pos;
+	uint8_t *sub_data;
 
 	if (ldns_rdf_get_type(sub) != LDNS_RDF_TYPE_DNAME ||
 			ldns_rdf_get_type(parent) != LDNS_RDF_TYPE_DNAME ||
@@ -250,34 +314,72 @@ ldns_dname_is_subdomain(const ldns_rdf *sub, const ldns_rdf *parent)
 		return false;
 	}
 	
-	/* check all labels the from the parent labels, from right to left. 
-	 * When they /all/ match we have found a subdomain
+	/* skip the labels sub has in front of the parent. When what
+	 * remains is the parent, octet for octet, we have found a
+	 * subdomain
 	 */
-	j = sub_lab - 1; /* we count from zero, thank you */
-	for (i = par_lab -1; i >= 0; i--) {
-		tmp_sub = ldns_dname_label(sub, j);
-		tmp_par = ldns_dname_label(parent, i);
-
-		if (ldns_rdf_compare(tmp_sub, tmp_par) != 0) {
-			/* they are not equal */
-			ldns_rdf_deep_free(tmp_sub);
-			ldns_rdf_deep_free(tmp_par);
-			return false;
+	sub_data = ldns_rdf_data(sub);
+	pos = 0;
+	for (i = 0; i < sub_lab - par_lab; i++) {
+		pos += sub_data[pos] + 1;
+	}
+	return ldns_rdf_size(sub) - pos == ldns_rdf_size(parent) &&
+	       memcmp(sub_data + pos, ldns_rdf_data(parent),
+	              ldns_rdf_size(parent)) == 0;
+}
+
+/*
+ * Fills offsets with the position of every label in the dname, the
+ * root label excluded, and returns the number of labels found
+ */
+static uint8_t
+ldns_dname_label_offsets(const ldns_rdf *dname,
+                         uint16_t offsets[LDNS_MAX_DOMAINLEN / 2 + 1])
+{
+	const uint8_t *data = ldns_rdf_data(dname);
+	size_t size = ldns_rdf_size(dname);
+	size_t pos = 0;
+	uint8_t count = 0;
+
+	while (pos < size && data[pos] > 0 &&
+	       count < LDNS_MAX_DOMAINLEN / 2 + 1) {
+		offsets[count++] = (uint16_t) pos;
+		pos += data[pos] + 1;
+	}
+	return count;
+}
+
+/*
+ * Compares two labels (length octet first) in canonical order. Labels
+ * that are octet for octet equal, the common case, are handled by
+ * memcmp; only when that fails is case folded, a word at a time.
+ */
+static int
+ldns_dname_label_compare(const uint8_t *lp1, const uint8_t *lp2)
+{
+	uint8_t len = *lp1 < *lp2 ? *lp1 : *lp2;
+	int result;
+
+	if (memcmp(lp1 + 1, lp2 + 1, len) != 0) {
+		result = ldns_dname_octets_casecmp(lp1 + 1, lp2 + 1, len);
+		if (result != 0) {
+			return result;
 		}
-		ldns_rdf_deep_free(tmp_sub);
-		ldns_rdf_deep_free(tmp_par);
-		j--;
 	}
-	return true; 
+	if (*lp1 != *lp2) {
+		return *lp1 < *lp2 ? -1 : 1;
+	}
+	return 0;
 }
 
 int
 ldns_dname_compare(const ldns_rdf *dname1, const ldns_rdf *dname2)
 {
-	size_t lc1, lc2, lc1f, lc2f;
-	size_t i;
-	int result = 0;
-	uint8_t *lp1, *lp2;
+	uint16_t offsets1[LDNS_MAX_DOMAINLEN / 2 + 1];
+	uint16_t offsets2[LDNS_MAX_DOMAINLEN / 2 + 1];
+	uint8_t lc1, lc2;
+	uint8_t *data1, *data2;
+	int result;
 
 	/* see RFC4034 for this algorithm */
 	/* this algorithm assumes the names are normalized to case */
@@ -296,78 +398,32 @@ ldns_dname_compare(const ldns_rdf *dname1, const ldns_rdf *dname2)
 	assert(ldns_rdf_get_type(dname1) == LDNS_RDF_TYPE_DNAME);
 	assert(ldns_rdf_get_type(dname2) == LDNS_RDF_TYPE_DNAME);
 
-	
-	lc1 = ldns_dname_label_count(dname1);
-	lc2 = ldns_dname_label_count(dname2);
-	
-	if (lc1 == 0 && lc2 == 0) {
-		return 0;
-	}
-	if (lc1 == 0) {
-		return -1;
-	}
-	if (lc2 == 0) {
-		return 1;
-	}
-	lc1--;
-	lc2--;
+	/* find the labels once, instead of rescanning the names
+	 * for every label we compare */
+	lc1 = ldns_dname_label_offsets(dname1, offsets1);
+	lc2 = ldns_dname_label_offsets(dname2, offsets2);
+	data1 = ldns_rdf_data(dname1);
+	data2 = ldns_rdf_data(dname2);
+
 	/* we start at the last label */
-	while (true) {
-		/* find the label first */
-		lc1f = lc1;
-		lp1 = ldns_rdf_data(dname1);
-		while (lc1f > 0) {
-			lp1 += *lp1 + 1;
-			lc1f--;
-		}
-		
-		/* and find the other one */
-		lc2f = lc2;
-		lp2 = ldns_rdf_data(dname2);
-		while (lc2f > 0) {
-			lp2 += *lp2 + 1;
-			lc2f--;
-		}
-		
-		/* now check the label character for character. */
-		for (i = 1; i < (size_t)(*lp1 + 1); i++) {
-			if (i > *lp2) {
-				/* apparently label 1 is larger */
-				result = 1;
-				goto done;
-			}
-			if (LDNS_DNAME_NORMALIZE((int) *(lp1 + i)) <
-			    LDNS_DNAME_NORMALIZE((int) *(lp2 + i))) {
-			    result = -1;
-			    goto done;
-			} else if (LDNS_DNAME_NORMALIZE((int) *(lp1 + i)) >
-			    LDNS_DNAME_NORMALIZE((int) *(lp2 + i))) {
-			    result = 1;
-			    goto done;
-			}
-		}
-		if (*lp1 < *lp2) {
-			/* apparently label 2 is larger */
-			result = -1;
-			goto done;
-		}
-		if (lc1 == 0 && lc2 > 0) {
-			result = -1;
-			goto done;
-		} else if (lc1 > 0 && lc2 == 0) {
-			result = 1;
-			goto done;
-		} else if (lc1 == 0 && lc2 == 0) {
-			result = 0;
-			goto done;
-		}
+	while (lc1 > 0 && lc2 > 0) {
 		lc1--;
 		lc2--;
+		result = ldns_dname_label_compare(data1 + offsets1[lc1],
+		                                  data2 + offsets2[lc2]);
+		if (result != 0) {
+			return result;
+		}
 	}
-		
-	
-	done:
-	return result;
+
+	/* all labels they share are equal, the shorter name is first */
+	if (lc1 > 0) {
+		return 1;
+	}
+	if (lc2 > 0) {
+		return -1;
+	}
+	return 0;
 }
 
 /* nsec test: does prev <= middle < next 
@@ -441,6 +497,7 @@ ldns_dname_label(const ldns_rdf *rdf, uint8_t labelpos)
 			memset(tmpnew->_data, 0, len + 2);
 			memcpy(tmpnew->_data, ldns_rdf_data(rdf) + src_pos, len + 1);
 			tmpnew->_size = len + 2;
+			tmpnew->_label_count = 1;
 			return tmpnew;
 		}
 		src_pos++;
@@ -0,0 +1,1606 @@
+/*
+ * enum.c
+ *
+ * ENUM functions: number to domain, NAPTR decoding and
+ * service classification
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+#include "ldns/config.h"
+
+#include "ldns.h"
+
+#include <ctype.h>
+#include <regex.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* labels are cut off after this many characters to show */
+#define LDNS_ENUM_LABEL_MAX 20
+
+/* compiled NAPTR expressions that are kept, a regexp field is at most
+ * 255 bytes and refers to at most nine subexpressions */
+#define LDNS_ENUM_REGEX_SLOTS 256
+#define LDNS_ENUM_REGEX_WAYS 4
+#define LDNS_ENUM_REGEXP_MAX 255
+#define LDNS_ENUM_REGEXP_REFS 9
+#define LDNS_ENUM_HASH_INIT 2166136261U
+#define LDNS_ENUM_HASH_PRIME 16777619U
+
+/* no more records come out of a chase, a zone could make every step
+ * multiply them */
+#define LDNS_ENUM_CHASE_MAX 256
+
+/* the byte b in all eight bytes of a uint64_t */
+#define LDNS_ENUM_BYTES(b) ((uint64_t) (b) * 0x0101010101010101ULL)
+/* not 0 when one of the eight bytes of x is 0 */
+#define LDNS_ENUM_HAS_ZERO(x) \
+	(((x) - LDNS_ENUM_BYTES(0x01)) & ~(x) & LDNS_ENUM_BYTES(0x80))
+
+/* LDNS_ENUM_E164_SUFFIX in wire format */
+static const uint8_t ldns_enum_e164_suffix_wire[] = {
+	4, 'e', '1', '6', '4', 4, 'a', 'r', 'p', 'a', 0
+};
+
+/* the services tokens told apart, by a hash without collisions: FNV-1a
+ * of the token in lower case from LDNS_ENUM_TOKEN_SEED, its top bits
+ * are the slot. vcard is matched anywhere in a type */
+#define LDNS_ENUM_TOKEN_SEED 2166136352U
+#define LDNS_ENUM_TOKEN_BITS 4
+
+enum ldns_enum_token_kind {
+	LDNS_ENUM_TOKEN_TYPE,
+	LDNS_ENUM_TOKEN_E2U,
+	LDNS_ENUM_TOKEN_LIH
+};
+
+static const struct {
+	const char *token;
+	size_t len;
+	enum ldns_enum_token_kind kind;
+	ldns_enum_service_class service;
+} ldns_enum_tokens[1 << LDNS_ENUM_TOKEN_BITS] = {
+	{ "email:mailto", 12, LDNS_ENUM_TOKEN_TYPE, LDNS_ENUM_SERVICE_MAIL },
+	{ "x-main", 6, LDNS_ENUM_TOKEN_LIH, LDNS_ENUM_SERVICE_OTHER },
+	{ "loc:geo", 7, LDNS_ENUM_TOKEN_TYPE, LDNS_ENUM_SERVICE_LOC },
+	{ NULL, 0, LDNS_ENUM_TOKEN_TYPE, LDNS_ENUM_SERVICE_OTHER },
+	{ NULL, 0, LDNS_ENUM_TOKEN_TYPE, LDNS_ENUM_SERVICE_OTHER },
+	{ NULL, 0, LDNS_ENUM_TOKEN_TYPE, LDNS_ENUM_SERVICE_OTHER },
+	{ "x-prs", 5, LDNS_ENUM_TOKEN_LIH, LDNS_ENUM_SERVICE_OTHER },
+	{ "x-work", 6, LDNS_ENUM_TOKEN_LIH, LDNS_ENUM_SERVICE_OTHER },
+	{ "web:http", 8, LDNS_ENUM_TOKEN_TYPE, LDNS_ENUM_SERVICE_WEB },
+	{ "e2u", 3, LDNS_ENUM_TOKEN_E2U, LDNS_ENUM_SERVICE_OTHER },
+	{ "voice:tel", 9, LDNS_ENUM_TOKEN_TYPE, LDNS_ENUM_SERVICE_VOICE },
+	{ NULL, 0, LDNS_ENUM_TOKEN_TYPE, LDNS_ENUM_SERVICE_OTHER },
+	{ "x-home", 6, LDNS_ENUM_TOKEN_LIH, LDNS_ENUM_SERVICE_OTHER },
+	{ "key:http", 8, LDNS_ENUM_TOKEN_TYPE, LDNS_ENUM_SERVICE_KEY },
+	{ "x-mobile", 8, LDNS_ENUM_TOKEN_LIH, LDNS_ENUM_SERVICE_OTHER },
+	{ "x-transit", 9, LDNS_ENUM_TOKEN_LIH, LDNS_ENUM_SERVICE_OTHER }
+};
+
+/* the sites are found with an Aho-Corasick automaton of their hosts, on
+ * letters without case and the dot. Every state has a transition for
+ * every symbol, so the host of a uri is read in one pass. The symbols
+ * from LDNS_ENUM_SITE_END on end the host, LDNS_ENUM_SITE_USER the user
+ * part in front of it */
+#define LDNS_ENUM_SITE_SYMBOLS 32
+#define LDNS_ENUM_SITE_END 28
+#define LDNS_ENUM_SITE_USER 29
+#define LDNS_ENUM_SITE_STATES 128
+#define LDNS_ENUM_SITE_NO_MATCH 0xff
+
+/* the recognized web sites, by what their uris contain */
+static const struct {
+	ldns_enum_site site;
+	const char *host;
+	const char *name;
+} ldns_enum_sites[] = {
+	{ LDNS_ENUM_SITE_LINKEDIN, "linkedin.com", "LinkedIn" },
+	{ LDNS_ENUM_SITE_FACEBOOK, "facebook.com", "Facebook" },
+	{ LDNS_ENUM_SITE_HYVES, "hyves.nl", "Hyves" },
+	{ LDNS_ENUM_SITE_TWITTER, "twitter.com", "Twitter" },
+	{ LDNS_ENUM_SITE_FOURSQUARE, "foursquare.com", "Foursquare" },
+	{ LDNS_ENUM_SITE_YOUTUBE, "youtube.com", "Youtube" },
+	{ LDNS_ENUM_SITE_SKYPE, "skype.com", "Skype" },
+	{ LDNS_ENUM_SITE_MYSPACE, "myspace.com", "Myspace" },
+	{ LDNS_ENUM_SITE_FLICKR, "flickr.com", "Flickr" },
+	{ LDNS_ENUM_SITE_MYOPENID, "myopenid.com", "myOpenId" },
+	{ LDNS_ENUM_SITE_NONE, NULL, NULL }
+};
+
+static uint8_t ldns_enum_site_symbols[256];
+static uint8_t ldns_enum_site_next[LDNS_ENUM_SITE_STATES][LDNS_ENUM_SITE_SYMBOLS];
+/* the first site in ldns_enum_sites that ends in a state */
+static uint8_t ldns_enum_site_match[LDNS_ENUM_SITE_STATES];
+#ifdef HAVE_PTHREAD_H
+static pthread_once_t ldns_enum_site_once = PTHREAD_ONCE_INIT;
+#else
+static bool ldns_enum_site_built = false;
+#endif
+
+char *
+ldns_enum_number2str(const char *number, const char *suffix)
+{
+	size_t digits = 0;
+	size_t suffix_len;
+	const char *n;
+	char *str;
+	char *s;
+
+	if (!suffix) {
+		suffix = LDNS_ENUM_E164_SUFFIX;
+	}
+	for (n = number; *n; n++) {
+		if (isdigit((unsigned char) *n)) {
+			digits++;
+		}
+	}
+	if (digits == 0) {
+		return NULL;
+	}
+	suffix_len = strlen(suffix);
+	str = LDNS_XMALLOC(char, digits * 2 + suffix_len + 1);
+	if (!str) {
+		return NULL;
+	}
+	s = str;
+	while (n > number) {
+		n--;
+		if (isdigit((unsigned char) *n)) {
+			*s++ = *n;
+			*s++ = '.';
+		}
+	}
+	memcpy(s, suffix, suffix_len + 1);
+	return str;
+}
+
+/* true when all eight bytes of x are digits */
+static inline bool
+ldns_enum_all_digits(uint64_t x)
+{
+	return (x & LDNS_ENUM_BYTES(0xf0)) == LDNS_ENUM_BYTES(0x30) &&
+	       ((x + LDNS_ENUM_BYTES(0x06)) & LDNS_ENUM_BYTES(0xf0)) ==
+	       LDNS_ENUM_BYTES(0x30);
+}
+
+size_t
+ldns_enum_number2wire(uint8_t *wire, const char *number, size_t len,
+		const ldns_rdf *suffix)
+{
+	const uint8_t *suffix_data = ldns_enum_e164_suffix_wire;
+	size_t suffix_size = sizeof(ldns_enum_e164_suffix_wire);
+	const uint8_t *start = (const uint8_t *) number;
+	const uint8_t *n = start + len;
+	uint8_t *w = wire;
+	uint8_t *end;
+	uint64_t x;
+	size_t i;
+
+	if (suffix) {
+		suffix_data = ldns_rdf_data(suffix);
+		suffix_size = ldns_rdf_size(suffix);
+	}
+	if (suffix_size < 1 || suffix_size > LDNS_MAX_DOMAINLEN) {
+		return 0;
+	}
+	/* a digit takes two bytes, its length and itself */
+	end = wire + ((LDNS_MAX_DOMAINLEN - suffix_size) & ~(size_t) 1);
+	while (n > start) {
+		/* runs of eight digits, as numbers mostly are, go at once */
+		if (n - start >= 8 && end - w >= 16) {
+			memcpy(&x, n - 8, 8);
+			if (ldns_enum_all_digits(x)) {
+				for (i = 0; i < 8; i++) {
+					w[2 * i] = 1;
+					w[2 * i + 1] = n[-1 - (ptrdiff_t) i];
+				}
+				w += 16;
+				n -= 8;
+				continue;
+			}
+		}
+		n--;
+		if ((uint8_t) (*n - '0') <= 9) {
+			if (w == end) {
+				return 0;
+			}
+			w[0] = 1;
+			w[1] = *n;
+			w += 2;
+		}
+	}
+	if (w == wire) {
+		return 0;
+	}
+	/* a few bytes, copied by hand; memcpy() of an unknown size is slower */
+	for (i = 0; i < suffix_size; i++) {
+		w[i] = suffix_data[i];
+	}
+	return (size_t) (w - wire) + suffix_size;
+}
+
+ldns_rdf *
+ldns_enum_dname_new_frm_number(const char *number, const ldns_rdf *suffix)
+{
+	uint8_t wire[LDNS_MAX_DOMAINLEN];
+	size_t size;
+
+	size = ldns_enum_number2wire(wire, number, strlen(number), suffix);
+	if (size == 0) {
+		return NULL;
+	}
+	return ldns_rdf_new_frm_data(LDNS_RDF_TYPE_DNAME, size, wire);
+}
+
+size_t
+ldns_enum_dnames_new_frm_numbers(ldns_rdf **dnames,
+		const char * const *numbers, size_t count, const ldns_rdf *suffix)
+{
+	uint8_t wire[LDNS_MAX_DOMAINLEN];
+	size_t converted = 0;
+	size_t size;
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		dnames[i] = NULL;
+		size = ldns_enum_number2wire(wire, numbers[i], 
+				strlen(numbers[i]), suffix);
+		if (size > 0) {
+			dnames[i] = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_DNAME, 
+					size, wire);
+		}
+		if (dnames[i]) {
+			converted++;
+		}
+	}
+	return converted;
+}
+
+/* whether none of the eight bytes of x is to be escaped: all are
+ * printable and none is one of the specials a, b and c. The tests are
+ * exact for the word as a whole */
+static bool
+ldns_enum_plain(uint64_t x, uint8_t a, uint8_t b, uint8_t c)
+{
+	uint64_t special;
+
+	special = LDNS_ENUM_HAS_ZERO(x ^ LDNS_ENUM_BYTES(a)) |
+		LDNS_ENUM_HAS_ZERO(x ^ LDNS_ENUM_BYTES(b)) |
+		LDNS_ENUM_HAS_ZERO(x ^ LDNS_ENUM_BYTES(c));
+	/* a byte below 0x20, or one above 0x7e */
+	return ((((x - LDNS_ENUM_BYTES(0x20)) & ~x) | 
+		(x + LDNS_ENUM_BYTES(0x01)) | x | special) & 
+		LDNS_ENUM_BYTES(0x80)) == 0;
+}
+
+static char *
+ldns_enum_escape_bytes(char *s, const uint8_t *data, size_t len,
+		uint8_t a, uint8_t b, uint8_t c)
+{
+	size_t i;
+	uint8_t ch;
+
+	for (i = 0; i < len; i++) {
+		ch = data[i];
+		if (ch < 0x20 || ch > 0x7e) {
+			*s++ = '\\';
+			*s++ = (char) ('0' + ch / 100);
+			*s++ = (char) ('0' + ch / 10 % 10);
+			*s++ = (char) ('0' + ch % 10);
+		} else {
+			if (ch == a || ch == b || ch == c) {
+				*s++ = '\\';
+			}
+			*s++ = (char) ch;
+		}
+	}
+	return s;
+}
+
+/* writes data to s with a, b and c escaped with a \ and the unprintable
+ * bytes as \DDD, at most four characters a byte. Runs of eight bytes
+ * that need none of that are copied as they are */
+static char *
+ldns_enum_escape(char *s, const uint8_t *data, size_t len, 
+		uint8_t a, uint8_t b, uint8_t c)
+{
+	uint64_t x;
+	size_t i;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		memcpy(&x, data + i, 8);
+		if (ldns_enum_plain(x, a, b, c)) {
+			memcpy(s, &x, 8);
+			s += 8;
+		} else {
+			s = ldns_enum_escape_bytes(s, data + i, 8, a, b, c);
+		}
+	}
+	return ldns_enum_escape_bytes(s, data + i, len - i, a, b, c);
+}
+
+/* the text of a character string rdf at s, the end of it is returned,
+ * NULL when the rdf is too short */
+static char *
+ldns_enum_string_rdf2chars(char *s, const ldns_rdf *rdf)
+{
+	const uint8_t *data = ldns_rdf_data(rdf);
+
+	if (ldns_rdf_size(rdf) < 1 || data[0] >= ldns_rdf_size(rdf)) {
+		return NULL;
+	}
+	return ldns_enum_escape(s, data + 1, data[0], '"', '\\', '\\');
+}
+
+/* like ldns_enum_string_rdf2chars() for a dname */
+static char *
+ldns_enum_dname_rdf2chars(char *s, const ldns_rdf *rdf)
+{
+	const uint8_t *data = ldns_rdf_data(rdf);
+	size_t size = ldns_rdf_size(rdf);
+	size_t pos = 0;
+	char *start = s;
+	uint8_t len;
+
+	if (size < 1 || size > LDNS_MAX_DOMAINLEN) {
+		return NULL;
+	}
+	/* the root is the empty string, no dot is put after the last label */
+	len = data[pos];
+	while (len > 0) {
+		if (pos + 1 + len >= size) {
+			return NULL;
+		}
+		if (s != start) {
+			*s++ = '.';
+		}
+		s = ldns_enum_escape(s, data + pos + 1, len, '.', '(', ')');
+		pos += 1 + len;
+		len = data[pos];
+	}
+	return s;
+}
+
+char *
+ldns_enum_string_rdf2str(const ldns_rdf *rdf)
+{
+	char *str;
+	char *end;
+
+	if (ldns_rdf_size(rdf) < 1) {
+		return NULL;
+	}
+	/* every character takes at most four: \DDD */
+	str = LDNS_XMALLOC(char, (size_t) ldns_rdf_data(rdf)[0] * 4 + 1);
+	if (!str) {
+		return NULL;
+	}
+	end = ldns_enum_string_rdf2chars(str, rdf);
+	if (!end) {
+		LDNS_FREE(str);
+		return NULL;
+	}
+	*end = '\0';
+	return str;
+}
+
+char *
+ldns_enum_dname_rdf2str(const ldns_rdf *rdf)
+{
+	char *str;
+	char *end;
+
+	str = LDNS_XMALLOC(char, ldns_rdf_size(rdf) * 4 + 1);
+	if (!str) {
+		return NULL;
+	}
+	end = ldns_enum_dname_rdf2chars(str, rdf);
+	if (!end) {
+		LDNS_FREE(str);
+		return NULL;
+	}
+	*end = '\0';
+	return str;
+}
+
+ldns_status
+ldns_enum_string_rdf2buffer(ldns_buffer *output, const ldns_rdf *rdf)
+{
+	char *end;
+
+	if (!ldns_buffer_reserve(output, ldns_rdf_size(rdf) * 4)) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	end = ldns_enum_string_rdf2chars(
+			(char *) ldns_buffer_current(output), rdf);
+	if (!end) {
+		return LDNS_STATUS_ENUM_NAPTR_ERR;
+	}
+	ldns_buffer_skip(output, 
+			end - (char *) ldns_buffer_current(output));
+	return ldns_buffer_status(output);
+}
+
+ldns_status
+ldns_enum_dname_rdf2buffer(ldns_buffer *output, const ldns_rdf *rdf)
+{
+	char *end;
+
+	if (!ldns_buffer_reserve(output, ldns_rdf_size(rdf) * 4)) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	end = ldns_enum_dname_rdf2chars(
+			(char *) ldns_buffer_current(output), rdf);
+	if (!end) {
+		return LDNS_STATUS_ENUM_NAPTR_ERR;
+	}
+	ldns_buffer_skip(output, 
+			end - (char *) ldns_buffer_current(output));
+	return ldns_buffer_status(output);
+}
+
+/* a copy of str, to be freed with LDNS_FREE */
+static char *
+ldns_enum_strcpy(const char *str)
+{
+	size_t len = strlen(str);
+	char *copy = LDNS_XMALLOC(char, len + 1);
+
+	if (copy) {
+		memcpy(copy, str, len + 1);
+	}
+	return copy;
+}
+
+/* a compiled NAPTR expression, shared by the cache and its users */
+struct ldns_struct_enum_regex
+{
+	char *_ere;
+	bool _icase;
+	uint32_t _hash;
+	uint32_t _used;
+	regex_t _re;
+	size_t _refs;
+};
+typedef struct ldns_struct_enum_regex ldns_enum_regex;
+
+/* compiled expressions by their text, in sets of LDNS_ENUM_REGEX_WAYS.
+ * The entry of a set used longest ago is put out by a new one, it is
+ * freed when the last user is done with it */
+static ldns_enum_regex *ldns_enum_regex_cache[LDNS_ENUM_REGEX_SLOTS];
+static uint32_t ldns_enum_regex_clock;
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t ldns_enum_regex_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void
+ldns_enum_regex_free(ldns_enum_regex *regex)
+{
+	regfree(&regex->_re);
+	LDNS_FREE(regex->_ere);
+	LDNS_FREE(regex);
+}
+
+/* done with a regex ldns_enum_regex_get() gave */
+static void
+ldns_enum_regex_release(ldns_enum_regex *regex)
+{
+	bool unused;
+
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ldns_enum_regex_lock);
+#endif
+	unused = --regex->_refs == 0;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&ldns_enum_regex_lock);
+#endif
+	if (unused) {
+		ldns_enum_regex_free(regex);
+	}
+}
+
+/* the compiled form of ere, from the cache or compiled now and put in
+ * it. NULL when ere is no valid extended regular expression */
+static ldns_enum_regex *
+ldns_enum_regex_get(const char *ere, bool icase)
+{
+	ldns_enum_regex **set;
+	ldns_enum_regex *regex;
+	ldns_enum_regex *old;
+	uint32_t h;
+	size_t oldest;
+	size_t i;
+	const char *e;
+
+	h = LDNS_ENUM_HASH_INIT;
+	for (e = ere; *e; e++) {
+		h = (h ^ (uint8_t) *e) * LDNS_ENUM_HASH_PRIME;
+	}
+	h = (h ^ (uint32_t) icase) * LDNS_ENUM_HASH_PRIME;
+	set = &ldns_enum_regex_cache[(h % (LDNS_ENUM_REGEX_SLOTS /
+			LDNS_ENUM_REGEX_WAYS)) * LDNS_ENUM_REGEX_WAYS];
+
+	regex = NULL;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ldns_enum_regex_lock);
+#endif
+	for (i = 0; i < LDNS_ENUM_REGEX_WAYS; i++) {
+		if (set[i] && set[i]->_hash == h && set[i]->_icase == icase &&
+		    strcmp(set[i]->_ere, ere) == 0) {
+			regex = set[i];
+			regex->_used = ++ldns_enum_regex_clock;
+			regex->_refs++;
+			break;
+		}
+	}
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&ldns_enum_regex_lock);
+#endif
+	if (regex) {
+		return regex;
+	}
+
+	regex = LDNS_MALLOC(ldns_enum_regex);
+	if (!regex) {
+		return NULL;
+	}
+	regex->_ere = ldns_enum_strcpy(ere);
+	if (!regex->_ere) {
+		LDNS_FREE(regex);
+		return NULL;
+	}
+	if (regcomp(&regex->_re, ere, 
+			REG_EXTENDED | (icase ? REG_ICASE : 0)) != 0) {
+		LDNS_FREE(regex->_ere);
+		LDNS_FREE(regex);
+		return NULL;
+	}
+	regex->_icase = icase;
+	regex->_hash = h;
+	/* one for the cache, one for the caller */
+	regex->_refs = 2;
+
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ldns_enum_regex_lock);
+#endif
+	oldest = 0;
+	for (i = 0; i < LDNS_ENUM_REGEX_WAYS; i++) {
+		if (!set[i]) {
+			oldest = i;
+			break;
+		}
+		if (set[i]->_used < set[oldest]->_used) {
+			oldest = i;
+		}
+	}
+	old = set[oldest];
+	set[oldest] = regex;
+	regex->_used = ++ldns_enum_regex_clock;
+	if (old && --old->_refs > 0) {
+		old = NULL;
+	}
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&ldns_enum_regex_lock);
+#endif
+	if (old) {
+		ldns_enum_regex_free(old);
+	}
+	return regex;
+}
+
+/* the end of the part of a substitution expression that starts at
+ * start, the position of the next delim that is not escaped */
+static size_t
+ldns_enum_regexp_part_end(const uint8_t *regexp, size_t len, size_t start,
+		uint8_t delim)
+{
+	size_t i;
+
+	for (i = start; i < len && regexp[i] != delim; i++) {
+		if (regexp[i] == '\\' && i + 1 < len) {
+			i++;
+		}
+	}
+	return i;
+}
+
+/* writes repl with the backreferences filled in to out, when it is not
+ * NULL, and returns the length of that */
+static size_t
+ldns_enum_regexp_subst(char *out, const uint8_t *repl, size_t len,
+		const char *aus, const regmatch_t *match)
+{
+	size_t size = 0;
+	size_t i;
+	size_t n;
+	int ref;
+
+	for (i = 0; i < len; i++) {
+		if (repl[i] == '\\' && i + 1 < len) {
+			i++;
+			if (repl[i] >= '1' && repl[i] <= '9') {
+				ref = repl[i] - '0';
+				if (match[ref].rm_so < 0) {
+					continue;
+				}
+				n = (size_t) (match[ref].rm_eo - match[ref].rm_so);
+				if (out) {
+					memcpy(out + size, aus + match[ref].rm_so, n);
+				}
+				size += n;
+				continue;
+			}
+			/* \\ and \delim, or any other escaped character */
+		}
+		if (out) {
+			out[size] = (char) repl[i];
+		}
+		size++;
+	}
+	return size;
+}
+
+ldns_status
+ldns_enum_regexp_apply(char **result, const uint8_t *regexp, size_t len,
+		const char *aus)
+{
+	char ere[LDNS_ENUM_REGEXP_MAX + 1];
+	regmatch_t match[LDNS_ENUM_REGEXP_REFS + 1];
+	ldns_enum_regex *regex;
+	const uint8_t *repl;
+	size_t repl_len;
+	size_t aus_len;
+	size_t ere_len = 0;
+	size_t end;
+	size_t size;
+	size_t i;
+	uint8_t delim;
+	bool icase = false;
+	char *r;
+	int rc;
+
+	if (len < 3 || len > LDNS_ENUM_REGEXP_MAX || memchr(regexp, 0, len)) {
+		return LDNS_STATUS_ENUM_REGEXP_ERR;
+	}
+	/* the delimiter can be anything but a digit, \ or the flag i */
+	delim = regexp[0];
+	if (isdigit((int) delim) || delim == '\\' || delim == 'i') {
+		return LDNS_STATUS_ENUM_REGEXP_ERR;
+	}
+
+	end = ldns_enum_regexp_part_end(regexp, len, 1, delim);
+	if (end >= len) {
+		return LDNS_STATUS_ENUM_REGEXP_ERR;
+	}
+	/* the delimiter is unescaped, other escapes are for regcomp(). The
+	 * pairs are walked like ldns_enum_regexp_part_end() does, so the \ of
+	 * \\ does not escape what follows */
+	for (i = 1; i < end; i++) {
+		if (regexp[i] == '\\' && i + 1 < end) {
+			if (regexp[i + 1] != delim) {
+				ere[ere_len++] = '\\';
+			}
+			i++;
+		}
+		ere[ere_len++] = (char) regexp[i];
+	}
+	ere[ere_len] = '\0';
+
+	repl = regexp + end + 1;
+	end = ldns_enum_regexp_part_end(regexp, len, end + 1, delim);
+	if (end >= len) {
+		return LDNS_STATUS_ENUM_REGEXP_ERR;
+	}
+	repl_len = (size_t) (regexp + end - repl);
+	for (i = end + 1; i < len; i++) {
+		if (regexp[i] != 'i') {
+			return LDNS_STATUS_ENUM_REGEXP_ERR;
+		}
+		icase = true;
+	}
+
+	regex = ldns_enum_regex_get(ere, icase);
+	if (!regex) {
+		return LDNS_STATUS_ENUM_REGEXP_ERR;
+	}
+	rc = regexec(&regex->_re, aus, LDNS_ENUM_REGEXP_REFS + 1, match, 0);
+	ldns_enum_regex_release(regex);
+	if (rc == REG_NOMATCH) {
+		return LDNS_STATUS_ENUM_REGEXP_NO_MATCH;
+	} else if (rc != 0) {
+		return LDNS_STATUS_ENUM_REGEXP_ERR;
+	}
+	/* the match is replaced, what is around it is kept, like sed does */
+	aus_len = strlen(aus);
+	size = (size_t) match[0].rm_so +
+		ldns_enum_regexp_subst(NULL, repl, repl_len, aus, match) +
+		(aus_len - (size_t) match[0].rm_eo);
+	r = LDNS_XMALLOC(char, size + 1);
+	if (!r) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	memcpy(r, aus, (size_t) match[0].rm_so);
+	size = (size_t) match[0].rm_so;
+	size += ldns_enum_regexp_subst(r + size, repl, repl_len, aus, match);
+	memcpy(r + size, aus + match[0].rm_eo, aus_len - (size_t) match[0].rm_eo);
+	size += aus_len - (size_t) match[0].rm_eo;
+	r[size] = '\0';
+	*result = r;
+	return LDNS_STATUS_OK;
+}
+
+char *
+ldns_enum_aus_frm_dname(const ldns_rdf *name)
+{
+	const uint8_t *data = ldns_rdf_data(name);
+	size_t size = ldns_rdf_size(name);
+	size_t digits = 0;
+	size_t i;
+	char *aus;
+
+	/* the leading labels of one digit, the last digit first */
+	while (digits * 2 + 2 < size && data[digits * 2] == 1 &&
+	       isdigit((int) data[digits * 2 + 1])) {
+		digits++;
+	}
+	if (digits == 0) {
+		return NULL;
+	}
+	aus = LDNS_XMALLOC(char, digits + 2);
+	if (!aus) {
+		return NULL;
+	}
+	aus[0] = '+';
+	for (i = 0; i < digits; i++) {
+		aus[i + 1] = (char) data[(digits - 1 - i) * 2 + 1];
+	}
+	aus[digits + 1] = '\0';
+	return aus;
+}
+
+/*
+ * splits the services of a terminal NAPTR in types, labels and hints,
+ * the E2U token is left out
+ */
+static uint8_t
+ldns_enum_lower(uint8_t c)
+{
+	return (uint8_t) (c | ((uint8_t) (c - 'A') < 26 ? 0x20 : 0));
+}
+
+/* what a services token is, without case; the class of a type */
+static enum ldns_enum_token_kind
+ldns_enum_token_classify(const uint8_t *token, size_t len, 
+		ldns_enum_service_class *service)
+{
+	uint32_t h;
+	size_t slot;
+	size_t i;
+
+	h = LDNS_ENUM_TOKEN_SEED;
+	for (i = 0; i < len; i++) {
+		h = (h ^ ldns_enum_lower(token[i])) * LDNS_ENUM_HASH_PRIME;
+	}
+	slot = h >> (32 - LDNS_ENUM_TOKEN_BITS);
+	if (ldns_enum_tokens[slot].len == len) {
+		for (i = 0; i < len; i++) {
+			if (ldns_enum_lower(token[i]) != 
+			    (uint8_t) ldns_enum_tokens[slot].token[i]) {
+				break;
+			}
+		}
+		if (i == len) {
+			*service = ldns_enum_tokens[slot].service;
+			return ldns_enum_tokens[slot].kind;
+		}
+	}
+	*service = LDNS_ENUM_SERVICE_OTHER;
+	for (i = 0; i + 6 <= len; i++) {
+		if (ldns_enum_lower(token[i]) == 'v' && 
+		    ldns_enum_lower(token[i + 1]) == 'c' &&
+		    ldns_enum_lower(token[i + 2]) == 'a' &&
+		    ldns_enum_lower(token[i + 3]) == 'r' &&
+		    ldns_enum_lower(token[i + 4]) == 'd' &&
+		    token[i + 5] == ':') {
+			*service = LDNS_ENUM_SERVICE_VCARD;
+			break;
+		}
+	}
+	return LDNS_ENUM_TOKEN_TYPE;
+}
+
+static ldns_status
+ldns_enum_naptr_parse_services(ldns_enum_naptr *naptr)
+{
+	size_t count = 1;
+	size_t len;
+	char *token;
+	char *next;
+	enum ldns_enum_token_kind kind;
+	ldns_enum_service_class service;
+
+	naptr->_tokens = ldns_enum_strcpy(naptr->_services);
+	if (!naptr->_tokens) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	for (token = naptr->_tokens; *token; token++) {
+		if (*token == '+') {
+			count++;
+		}
+	}
+	naptr->_types = LDNS_XMALLOC(char *, count);
+	naptr->_labels = LDNS_XMALLOC(char *, count);
+	naptr->_lihs = LDNS_XMALLOC(char *, count);
+	if (!naptr->_types || !naptr->_labels || !naptr->_lihs) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	for (token = naptr->_tokens; token; token = next) {
+		next = strchr(token, '+');
+		if (next) {
+			*next++ = '\0';
+		}
+		len = next ? (size_t) (next - token - 1) : strlen(token);
+		if (len >= 6 && strncmp(token, "x-lbl:", 6) == 0) {
+			naptr->_labels[naptr->_label_count++] = token + 6;
+			continue;
+		}
+		kind = ldns_enum_token_classify((const uint8_t *) token, len, 
+				&service);
+		if (kind == LDNS_ENUM_TOKEN_LIH) {
+			naptr->_lihs[naptr->_lih_count++] = token;
+		} else if (kind == LDNS_ENUM_TOKEN_TYPE) {
+			if (naptr->_type_count == 0) {
+				naptr->_class = service;
+			}
+			naptr->_types[naptr->_type_count++] = token;
+		}
+	}
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_enum_naptr_new_frm_rr(ldns_enum_naptr **naptr, const ldns_rr *rr,
+		const char *aus)
+{
+	ldns_enum_naptr *n;
+	const ldns_rdf *regexp;
+	char *owner_aus;
+	char *end;
+	ldns_status status = LDNS_STATUS_MEM_ERR;
+
+	if (ldns_rr_get_type(rr) != LDNS_RR_TYPE_NAPTR ||
+	    ldns_rr_rd_count(rr) != 6 ||
+	    ldns_rdf_size(ldns_rr_rdf(rr, 0)) != 2 ||
+	    ldns_rdf_size(ldns_rr_rdf(rr, 1)) != 2) {
+		return LDNS_STATUS_ENUM_NAPTR_ERR;
+	}
+	n = LDNS_MALLOC(ldns_enum_naptr);
+	if (!n) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	memset(n, 0, sizeof(ldns_enum_naptr));
+	n->_order = ldns_rdf2native_int16(ldns_rr_rdf(rr, 0));
+	n->_preference = ldns_rdf2native_int16(ldns_rr_rdf(rr, 1));
+	n->_ttl = ldns_rr_ttl(rr);
+	/* the three character strings go into one allocation, one after
+	 * the other, the size is that of all three escaped */
+	n->_flags = LDNS_XMALLOC(char, (ldns_rdf_size(ldns_rr_rdf(rr, 2)) + 
+			ldns_rdf_size(ldns_rr_rdf(rr, 3)) + 
+			ldns_rdf_size(ldns_rr_rdf(rr, 4))) * 4);
+	if (!n->_flags) {
+		goto error;
+	}
+	end = ldns_enum_string_rdf2chars(n->_flags, ldns_rr_rdf(rr, 2));
+	if (end) {
+		*end++ = '\0';
+		n->_services = end;
+		end = ldns_enum_string_rdf2chars(end, ldns_rr_rdf(rr, 3));
+	}
+	if (end) {
+		*end++ = '\0';
+		n->_regexp = end;
+		end = ldns_enum_string_rdf2chars(end, ldns_rr_rdf(rr, 4));
+	}
+	if (!end) {
+		status = LDNS_STATUS_ENUM_NAPTR_ERR;
+		goto error;
+	}
+	*end = '\0';
+	n->_encrypted = strcmp(n->_services, LDNS_ENUM_ENCRYPTED_SERVICES) == 0;
+
+	if (strcmp(n->_flags, "u") == 0) {
+		n->_terminal = true;
+		n->_replacement = ldns_enum_strcpy("");
+		if (n->_encrypted) {
+			n->_uri = ldns_enum_strcpy("");
+		} else {
+			regexp = ldns_rr_rdf(rr, 4);
+			owner_aus = aus ? NULL : 
+				ldns_enum_aus_frm_dname(ldns_rr_owner(rr));
+			status = ldns_enum_regexp_apply(&n->_uri, 
+					ldns_rdf_data(regexp) + 1, 
+					ldns_rdf_data(regexp)[0],
+					aus ? aus : (owner_aus ? owner_aus : ""));
+			LDNS_FREE(owner_aus);
+			if (status != LDNS_STATUS_OK) {
+				goto error;
+			}
+			status = LDNS_STATUS_MEM_ERR;
+		}
+		if (!n->_replacement || !n->_uri) {
+			goto error;
+		}
+		status = ldns_enum_naptr_parse_services(n);
+		if (status != LDNS_STATUS_OK) {
+			goto error;
+		}
+	} else if (n->_flags[0] == '\0') {
+		n->_terminal = false;
+		n->_replacement = ldns_enum_dname_rdf2str(ldns_rr_rdf(rr, 5));
+		if (!n->_replacement) {
+			status = LDNS_STATUS_ENUM_NAPTR_ERR;
+			goto error;
+		}
+		n->_uri = ldns_enum_strcpy(n->_replacement);
+		if (!n->_uri) {
+			goto error;
+		}
+	} else {
+		status = LDNS_STATUS_ENUM_NAPTR_ERR;
+		goto error;
+	}
+	*naptr = n;
+	return LDNS_STATUS_OK;
+
+error:
+	ldns_enum_naptr_free(n);
+	return status;
+}
+
+void
+ldns_enum_naptr_free(ldns_enum_naptr *naptr)
+{
+	if (!naptr) {
+		return;
+	}
+	LDNS_FREE(naptr->_flags);
+	LDNS_FREE(naptr->_replacement);
+	LDNS_FREE(naptr->_uri);
+	LDNS_FREE(naptr->_tokens);
+	LDNS_FREE(naptr->_types);
+	LDNS_FREE(naptr->_labels);
+	LDNS_FREE(naptr->_lihs);
+	LDNS_FREE(naptr);
+}
+
+uint16_t
+ldns_enum_naptr_order(const ldns_enum_naptr *naptr)
+{
+	return naptr->_order;
+}
+
+uint16_t
+ldns_enum_naptr_preference(const ldns_enum_naptr *naptr)
+{
+	return naptr->_preference;
+}
+
+uint32_t
+ldns_enum_naptr_ttl(const ldns_enum_naptr *naptr)
+{
+	return naptr->_ttl;
+}
+
+const char *
+ldns_enum_naptr_flags(const ldns_enum_naptr *naptr)
+{
+	return naptr->_flags;
+}
+
+const char *
+ldns_enum_naptr_services(const ldns_enum_naptr *naptr)
+{
+	return naptr->_services;
+}
+
+const char *
+ldns_enum_naptr_regexp(const ldns_enum_naptr *naptr)
+{
+	return naptr->_regexp;
+}
+
+const char *
+ldns_enum_naptr_replacement(const ldns_enum_naptr *naptr)
+{
+	return naptr->_replacement;
+}
+
+const char *
+ldns_enum_naptr_uri(const ldns_enum_naptr *naptr)
+{
+	return naptr->_uri;
+}
+
+bool
+ldns_enum_naptr_terminal(const ldns_enum_naptr *naptr)
+{
+	return naptr->_terminal;
+}
+
+bool
+ldns_enum_naptr_encrypted(const ldns_enum_naptr *naptr)
+{
+	return naptr->_encrypted;
+}
+
+ldns_enum_service_class
+ldns_enum_naptr_class(const ldns_enum_naptr *naptr)
+{
+	return naptr->_class;
+}
+
+size_t
+ldns_enum_naptr_type_count(const ldns_enum_naptr *naptr)
+{
+	return naptr->_type_count;
+}
+
+const char *
+ldns_enum_naptr_type(const ldns_enum_naptr *naptr, size_t i)
+{
+	return i < naptr->_type_count ? naptr->_types[i] : NULL;
+}
+
+size_t
+ldns_enum_naptr_label_count(const ldns_enum_naptr *naptr)
+{
+	return naptr->_label_count;
+}
+
+const char *
+ldns_enum_naptr_label(const ldns_enum_naptr *naptr, size_t i)
+{
+	return i < naptr->_label_count ? naptr->_labels[i] : NULL;
+}
+
+size_t
+ldns_enum_naptr_lih_count(const ldns_enum_naptr *naptr)
+{
+	return naptr->_lih_count;
+}
+
+const char *
+ldns_enum_naptr_lih(const ldns_enum_naptr *naptr, size_t i)
+{
+	return i < naptr->_lih_count ? naptr->_lihs[i] : NULL;
+}
+
+char *
+ldns_enum_naptr_label_description(const ldns_enum_naptr *naptr)
+{
+	char *desc;
+	size_t len = 0;
+	size_t i;
+	const char *l;
+
+	desc = LDNS_XMALLOC(char, LDNS_ENUM_LABEL_MAX + 1);
+	if (!desc) {
+		return NULL;
+	}
+	for (i = 0; i < naptr->_label_count && len < LDNS_ENUM_LABEL_MAX; i++) {
+		if (i > 0) {
+			desc[len++] = ' ';
+		}
+		for (l = naptr->_labels[i]; *l && len < LDNS_ENUM_LABEL_MAX; l++) {
+			desc[len++] = (*l == '-' || *l == '_') ? ' ' : *l;
+		}
+	}
+	desc[len] = '\0';
+	return desc;
+}
+
+int
+ldns_enum_naptr_compare(const ldns_enum_naptr *a, const ldns_enum_naptr *b)
+{
+	if (a->_order != b->_order) {
+		return a->_order < b->_order ? -1 : 1;
+	}
+	if (a->_preference != b->_preference) {
+		return a->_preference < b->_preference ? -1 : 1;
+	}
+	return 0;
+}
+
+/* the records of a name a chase went to */
+struct ldns_struct_enum_chase_node
+{
+	ldns_rdf *_name;
+	ldns_rr_list *_naptrs;
+};
+typedef struct ldns_struct_enum_chase_node ldns_enum_chase_node;
+
+/* the replacement of a NAPTR without flags, or NULL */
+static const ldns_rdf *
+ldns_enum_rr_chase_name(const ldns_rr *rr)
+{
+	const ldns_rdf *flags;
+	const ldns_rdf *replacement;
+
+	if (ldns_rr_get_type(rr) != LDNS_RR_TYPE_NAPTR ||
+	    ldns_rr_rd_count(rr) != 6) {
+		return NULL;
+	}
+	flags = ldns_rr_rdf(rr, 2);
+	replacement = ldns_rr_rdf(rr, 5);
+	if (ldns_rdf_size(flags) != 1 || 
+	    ldns_rdf_get_type(replacement) != LDNS_RDF_TYPE_DNAME ||
+	    ldns_rdf_size(replacement) <= 1) {
+		return NULL;
+	}
+	return replacement;
+}
+
+static uint32_t
+ldns_enum_rr_rank(const ldns_rr *rr)
+{
+	uint16_t order = 0xffff;
+	uint16_t preference = 0xffff;
+
+	if (ldns_rr_rd_count(rr) >= 2 &&
+	    ldns_rdf_size(ldns_rr_rdf(rr, 0)) == 2 &&
+	    ldns_rdf_size(ldns_rr_rdf(rr, 1)) == 2) {
+		order = ldns_rdf2native_int16(ldns_rr_rdf(rr, 0));
+		preference = ldns_rdf2native_int16(ldns_rr_rdf(rr, 1));
+	}
+	return ((uint32_t) order << 16) | preference;
+}
+
+static ldns_enum_chase_node *
+ldns_enum_chase_find(ldns_enum_chase_node *nodes, size_t count, 
+		const ldns_rdf *name)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		if (ldns_dname_compare(nodes[i]._name, name) == 0) {
+			return &nodes[i];
+		}
+	}
+	return NULL;
+}
+
+/* gets the records of the names the lists from first on point to and
+ * that are not there yet, adds them at the end */
+static ldns_status
+ldns_enum_chase_step(ldns_enum_chase_node **nodes, size_t *count, 
+		size_t *capacity, size_t first, const ldns_resolver *r,
+		ldns_enum_lookup_func lookup, ldns_enum_store_func store, 
+		void *arg)
+{
+	ldns_enum_chase_node *grown;
+	ldns_rdf **names;
+	ldns_rr_type *types;
+	ldns_pkt **answers;
+	const ldns_rdf *name;
+	ldns_rr_list *list;
+	size_t old_count;
+	size_t name_count;
+	size_t i, j, k;
+
+	old_count = *count;
+	for (i = first; i < old_count; i++) {
+		list = (*nodes)[i]._naptrs;
+		for (j = 0; j < ldns_rr_list_rr_count(list); j++) {
+			name = ldns_enum_rr_chase_name(ldns_rr_list_rr(list, j));
+			if (!name || ldns_enum_chase_find(*nodes, *count, name)) {
+				continue;
+			}
+			if (*count == *capacity) {
+				grown = LDNS_XREALLOC(*nodes, ldns_enum_chase_node,
+						*capacity * 2);
+				if (!grown) {
+					return LDNS_STATUS_MEM_ERR;
+				}
+				*nodes = grown;
+				*capacity *= 2;
+			}
+			(*nodes)[*count]._name = ldns_rdf_clone(name);
+			if (!(*nodes)[*count]._name) {
+				return LDNS_STATUS_MEM_ERR;
+			}
+			(*nodes)[*count]._naptrs = lookup ? 
+				lookup(name, arg) : NULL;
+			(*count)++;
+		}
+	}
+	if (!r) {
+		return LDNS_STATUS_OK;
+	}
+
+	/* the names lookup had nothing for go out at once */
+	name_count = 0;
+	for (i = old_count; i < *count; i++) {
+		if (!(*nodes)[i]._naptrs) {
+			name_count++;
+		}
+	}
+	if (name_count == 0) {
+		return LDNS_STATUS_OK;
+	}
+	names = LDNS_XMALLOC(ldns_rdf *, name_count);
+	types = LDNS_XMALLOC(ldns_rr_type, name_count);
+	answers = LDNS_XMALLOC(ldns_pkt *, name_count);
+	if (!names || !types || !answers) {
+		LDNS_FREE(names);
+		LDNS_FREE(types);
+		LDNS_FREE(answers);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	k = 0;
+	for (i = old_count; i < *count; i++) {
+		if (!(*nodes)[i]._naptrs) {
+			names[k] = (*nodes)[i]._name;
+			types[k] = LDNS_RR_TYPE_NAPTR;
+			k++;
+		}
+	}
+	if (ldns_resolver_query_parallel(answers, r, names, types, name_count,
+			LDNS_RR_CLASS_IN, LDNS_RD, NULL, NULL) != LDNS_STATUS_OK) {
+		for (k = 0; k < name_count; k++) {
+			answers[k] = NULL;
+		}
+	}
+	k = 0;
+	for (i = old_count; i < *count; i++) {
+		if ((*nodes)[i]._naptrs) {
+			continue;
+		}
+		if (answers[k]) {
+			list = ldns_pkt_rr_list_by_type(answers[k], 
+					LDNS_RR_TYPE_NAPTR, LDNS_SECTION_ANSWER);
+			if (list && store) {
+				store((*nodes)[i]._name, list, arg);
+			}
+			(*nodes)[i]._naptrs = list;
+			ldns_pkt_free(answers[k]);
+		}
+		k++;
+	}
+	LDNS_FREE(names);
+	LDNS_FREE(types);
+	LDNS_FREE(answers);
+	return LDNS_STATUS_OK;
+}
+
+/* adds the records of a list to result in the order to use them in, each
+ * non-terminal one replaced by the records of the name it points to */
+static ldns_status
+ldns_enum_chase_expand(ldns_rr_list *result, const ldns_rr_list *naptrs,
+		ldns_enum_chase_node *nodes, size_t count,
+		const ldns_rdf **path, size_t depth, size_t max_depth)
+{
+	ldns_rr **sorted;
+	ldns_rr *rr;
+	ldns_rr *clone;
+	const ldns_rdf *name;
+	ldns_enum_chase_node *node;
+	ldns_status status;
+	size_t rr_count;
+	size_t i, j;
+
+	rr_count = ldns_rr_list_rr_count(naptrs);
+	if (rr_count == 0) {
+		return LDNS_STATUS_OK;
+	}
+	sorted = LDNS_XMALLOC(ldns_rr *, rr_count);
+	if (!sorted) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	/* by insertion, records of the same rank stay in the order they came */
+	for (i = 0; i < rr_count; i++) {
+		rr = ldns_rr_list_rr(naptrs, i);
+		for (j = i; j > 0 && 
+		    ldns_enum_rr_rank(sorted[j - 1]) > ldns_enum_rr_rank(rr); 
+		    j--) {
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = rr;
+	}
+
+	status = LDNS_STATUS_OK;
+	for (i = 0; i < rr_count && status == LDNS_STATUS_OK; i++) {
+		if (ldns_rr_list_rr_count(result) >= LDNS_ENUM_CHASE_MAX) {
+			break;
+		}
+		name = ldns_enum_rr_chase_name(sorted[i]);
+		node = NULL;
+		if (name && depth < max_depth) {
+			for (j = 0; j <= depth; j++) {
+				if (ldns_dname_compare(path[j], name) == 0) {
+					break;
+				}
+			}
+			if (j > depth) {
+				node = ldns_enum_chase_find(nodes, count, name);
+			}
+		}
+		if (node && ldns_rr_list_rr_count(node->_naptrs) > 0) {
+			path[depth + 1] = name;
+			status = ldns_enum_chase_expand(result, node->_naptrs, 
+					nodes, count, path, depth + 1, max_depth);
+			continue;
+		}
+		clone = ldns_rr_clone(sorted[i]);
+		if (!clone || !ldns_rr_list_push_rr(result, clone)) {
+			if (clone) {
+				ldns_rr_free(clone);
+			}
+			status = LDNS_STATUS_MEM_ERR;
+		}
+	}
+	LDNS_FREE(sorted);
+	return status;
+}
+
+ldns_status
+ldns_enum_naptr_chase(ldns_rr_list **result, const ldns_resolver *r,
+		const ldns_rr_list *naptrs, size_t depth, 
+		ldns_enum_lookup_func lookup, ldns_enum_store_func store, 
+		void *arg)
+{
+	ldns_enum_chase_node *nodes;
+	const ldns_rdf **path;
+	ldns_rr_list *list;
+	size_t count;
+	size_t capacity;
+	size_t first;
+	size_t last;
+	size_t d;
+	size_t i;
+	ldns_status status;
+
+	list = ldns_rr_list_new();
+	capacity = 8;
+	nodes = LDNS_XMALLOC(ldns_enum_chase_node, capacity);
+	path = LDNS_XMALLOC(const ldns_rdf *, depth + 1);
+	if (!list || !nodes || !path) {
+		if (list) {
+			ldns_rr_list_free(list);
+		}
+		LDNS_FREE(nodes);
+		LDNS_FREE(path);
+		return LDNS_STATUS_MEM_ERR;
+	}
+
+	/* the records of the number are the first step, not asked for */
+	nodes[0]._name = ldns_rr_list_rr_count(naptrs) > 0 ? 
+		ldns_rr_owner(ldns_rr_list_rr(naptrs, 0)) : NULL;
+	nodes[0]._naptrs = (ldns_rr_list *) naptrs;
+	count = 1;
+	status = LDNS_STATUS_OK;
+	if (nodes[0]._name) {
+		first = 0;
+		for (d = 0; d < depth && status == LDNS_STATUS_OK; d++) {
+			last = count;
+			status = ldns_enum_chase_step(&nodes, &count, &capacity, 
+					first, r, lookup, store, arg);
+			if (count == last) {
+				break;
+			}
+			first = last;
+		}
+	}
+	if (status == LDNS_STATUS_OK) {
+		path[0] = nodes[0]._name;
+		status = ldns_enum_chase_expand(list, naptrs, nodes, count, 
+				path, 0, nodes[0]._name ? depth : 0);
+	}
+
+	for (i = 1; i < count; i++) {
+		ldns_rdf_deep_free(nodes[i]._name);
+		if (nodes[i]._naptrs) {
+			ldns_rr_list_deep_free(nodes[i]._naptrs);
+		}
+	}
+	LDNS_FREE(nodes);
+	LDNS_FREE(path);
+	if (status != LDNS_STATUS_OK) {
+		ldns_rr_list_deep_free(list);
+		return status;
+	}
+	*result = list;
+	return LDNS_STATUS_OK;
+}
+
+bool
+ldns_enum_token_is_lih(const char *token)
+{
+	ldns_enum_service_class service;
+
+	return ldns_enum_token_classify((const uint8_t *) token, 
+			strlen(token), &service) == LDNS_ENUM_TOKEN_LIH;
+}
+
+ldns_enum_service_class
+ldns_enum_service_classify(const char *type)
+{
+	ldns_enum_service_class service;
+
+	if (ldns_enum_token_classify((const uint8_t *) type, strlen(type), 
+			&service) != LDNS_ENUM_TOKEN_TYPE) {
+		return LDNS_ENUM_SERVICE_OTHER;
+	}
+	return service;
+}
+
+ldns_enum_service_class
+ldns_enum_services_classify(const uint8_t *services, size_t len)
+{
+	ldns_enum_service_class service;
+	size_t start;
+	size_t end;
+
+	for (start = 0; start < len; start = end + 1) {
+		for (end = start; end < len && services[end] != '+'; end++) {
+			/* to the end of the token */
+		}
+		if (end - start >= 6 && 
+		    memcmp(services + start, "x-lbl:", 6) == 0) {
+			continue;
+		}
+		if (ldns_enum_token_classify(services + start, end - start, 
+				&service) == LDNS_ENUM_TOKEN_TYPE) {
+			return service;
+		}
+	}
+	return LDNS_ENUM_SERVICE_OTHER;
+}
+
+static void
+ldns_enum_site_build(void)
+{
+	uint8_t queue[LDNS_ENUM_SITE_STATES];
+	uint8_t fail[LDNS_ENUM_SITE_STATES];
+	size_t head, tail;
+	size_t states;
+	size_t i, c;
+	uint8_t state, next;
+	const char *h;
+
+	/* letters without case are 1 to 26, the dot 27, all else 0 */
+	memset(ldns_enum_site_symbols, 0, sizeof(ldns_enum_site_symbols));
+	for (c = 0; c < 26; c++) {
+		ldns_enum_site_symbols['a' + c] = (uint8_t) (c + 1);
+		ldns_enum_site_symbols['A' + c] = (uint8_t) (c + 1);
+	}
+	ldns_enum_site_symbols['.'] = 27;
+	ldns_enum_site_symbols['/'] = LDNS_ENUM_SITE_END;
+	ldns_enum_site_symbols['?'] = LDNS_ENUM_SITE_END;
+	ldns_enum_site_symbols['#'] = LDNS_ENUM_SITE_END;
+	ldns_enum_site_symbols[':'] = LDNS_ENUM_SITE_END;
+	ldns_enum_site_symbols['@'] = LDNS_ENUM_SITE_USER;
+
+	/* the trie of the hosts, 0 is the root and no state goes to it */
+	memset(ldns_enum_site_next, 0, sizeof(ldns_enum_site_next));
+	memset(ldns_enum_site_match, LDNS_ENUM_SITE_NO_MATCH, 
+			sizeof(ldns_enum_site_match));
+	states = 1;
+	for (i = 0; ldns_enum_sites[i].host; i++) {
+		state = 0;
+		for (h = ldns_enum_sites[i].host; *h; h++) {
+			c = ldns_enum_site_symbols[(uint8_t) *h];
+			if (!ldns_enum_site_next[state][c]) {
+				ldns_enum_site_next[state][c] = (uint8_t) states++;
+			}
+			state = ldns_enum_site_next[state][c];
+		}
+		if (ldns_enum_site_match[state] == LDNS_ENUM_SITE_NO_MATCH) {
+			ldns_enum_site_match[state] = (uint8_t) i;
+		}
+	}
+
+	/* breadth first, the missing transitions are those of the longest
+	 * suffix that is in the trie */
+	head = tail = 0;
+	for (c = 0; c < LDNS_ENUM_SITE_SYMBOLS; c++) {
+		next = ldns_enum_site_next[0][c];
+		if (next) {
+			fail[next] = 0;
+			queue[tail++] = next;
+		}
+	}
+	while (head < tail) {
+		state = queue[head++];
+		if (ldns_enum_site_match[fail[state]] < 
+		    ldns_enum_site_match[state]) {
+			ldns_enum_site_match[state] = 
+				ldns_enum_site_match[fail[state]];
+		}
+		for (c = 0; c < LDNS_ENUM_SITE_SYMBOLS; c++) {
+			next = ldns_enum_site_next[state][c];
+			if (next) {
+				fail[next] = ldns_enum_site_next[fail[state]][c];
+				queue[tail++] = next;
+			} else {
+				ldns_enum_site_next[state][c] = 
+					ldns_enum_site_next[fail[state]][c];
+			}
+		}
+	}
+}
+
+ldns_enum_site
+ldns_enum_site_frm_data(const uint8_t *uri, size_t len)
+{
+	uint8_t state;
+	uint8_t first;
+	uint8_t symbol;
+	size_t start;
+	size_t i;
+
+#ifdef HAVE_PTHREAD_H
+	pthread_once(&ldns_enum_site_once, ldns_enum_site_build);
+#else
+	if (!ldns_enum_site_built) {
+		ldns_enum_site_build();
+		ldns_enum_site_built = true;
+	}
+#endif
+	/* the host is after the scheme, or at the start without one */
+	start = 0;
+	for (i = 0; i < len && uri[i] != '/' && uri[i] != '?' && 
+	    uri[i] != '#'; i++) {
+		if (uri[i] == ':' && i + 2 < len && 
+		    uri[i + 1] == '/' && uri[i + 2] == '/') {
+			start = i + 3;
+			break;
+		}
+	}
+
+	/* the site that comes first in the table wins, like it did when
+	 * the hosts were looked for one by one */
+	state = 0;
+	first = LDNS_ENUM_SITE_NO_MATCH;
+	for (i = start; i < len; i++) {
+		symbol = ldns_enum_site_symbols[uri[i]];
+		if (symbol >= LDNS_ENUM_SITE_END) {
+			if (symbol != LDNS_ENUM_SITE_USER) {
+				break;
+			}
+			state = 0;
+			first = LDNS_ENUM_SITE_NO_MATCH;
+			continue;
+		}
+		state = ldns_enum_site_next[state][symbol];
+		if (ldns_enum_site_match[state] < first) {
+			first = ldns_enum_site_match[state];
+		}
+	}
+	if (first == LDNS_ENUM_SITE_NO_MATCH) {
+		return LDNS_ENUM_SITE_NONE;
+	}
+	return ldns_enum_sites[first].site;
+}
+
+ldns_enum_site
+ldns_enum_site_frm_uri(const char *uri)
+{
+	return ldns_enum_site_frm_data((const uint8_t *) uri, strlen(uri));
+}
+
+const char *
+ldns_enum_site_name(ldns_enum_site site)
+{
+	size_t i;
+
+	for (i = 0; ldns_enum_sites[i].host; i++) {
+		if (ldns_enum_sites[i].site == site) {
+			return ldns_enum_sites[i].name;
+		}
+	}
+	return NULL;
+}
@@ -84,6 +84,14 @@ ldns_lookup_table ldns_error_str[] = {
 	{ LDNS_STATUS_DNSSEC_NSEC_RR_NOT_COVERED, "RR not covered by the given NSEC RRs" },
 	{ LDNS_STATUS_DNSSEC_NSEC_WILDCARD_NOT_COVERED, "wildcard not covered by the given NSEC RRs" },
 	{ LDNS_STATUS_DNSSEC_NSEC3_ORIGINAL_NOT_FOUND, "original of NSEC3 hashed name could not be found" },
+	{ LDNS_STATUS_SNAPSHOT_FORMAT_ERR, "Zone snapshot is damaged or not a zone snapshot" },
+	{ LDNS_STATUS_SNAPSHOT_VERSION_ERR, "Zone snapshot was written in an unknown format version" },
+	{ LDNS_STATUS_SNAPSHOT_CHECKSUM_ERR, "Zone snapshot checksum mismatch" },
+	{ LDNS_STATUS_XFR_RCODE_ERR, "Zone transfer was answered with an error code" },
+	{ LDNS_STATUS_XFR_FORMAT_ERR, "Zone transfer does not follow the soa of the zone" },
+	{ LDNS_STATUS_ENUM_NAPTR_ERR, "Not a valid ENUM NAPTR record" },
+	{ LDNS_STATUS_ENUM_REGEXP_ERR, "Not a valid NAPTR regexp" },
+	{ LDNS_STATUS_ENUM_REGEXP_NO_MATCH, "NAPTR regexp does not match the number" },
 	{ 0, NULL }
 };
 
@@ -19,23 +19,114 @@
 #include <openssl/ssl.h>
 #include <openssl/sha.h>
 #endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* the hosts file is stat()ed for changes at most this often, in seconds */
+#define LDNS_HOSTS_CHECK_INTERVAL 1
+
+/* the hosts file as it was last read, indexed by name. The index refers
+ * to the rrs in the list */
+static ldns_rr_list *ldns_hosts_rrs = NULL;
+static ldns_zone_index *ldns_hosts_index = NULL;
+static bool ldns_hosts_read = false;
+static time_t ldns_hosts_mtime = 0;
+static off_t ldns_hosts_size = 0;
+static time_t ldns_hosts_checked = 0;
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t ldns_hosts_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* reads the hosts file again when it changed since the last time. Call
+ * it with ldns_hosts_lock held */
+static void
+ldns_hosts_refresh(void)
+{
+	struct stat st;
+	time_t now;
+	ldns_zone hosts;
+	ldns_rr_list *rrs;
+	ldns_zone_index *index;
+
+	now = time(NULL);
+	if (ldns_hosts_read && now >= ldns_hosts_checked &&
+	    now - ldns_hosts_checked < LDNS_HOSTS_CHECK_INTERVAL) {
+		return;
+	}
+	ldns_hosts_checked = now;
+	if (stat(LDNS_RESOLV_HOSTS, &st) != 0) {
+		/* no file is like an empty one */
+		st.st_mtime = 0;
+		st.st_size = 0;
+	}
+	if (ldns_hosts_read && st.st_mtime == ldns_hosts_mtime &&
+	    st.st_size == ldns_hosts_size) {
+		return;
+	}
+
+	rrs = ldns_get_rr_list_hosts_frm_file(NULL);
+	index = NULL;
+	if (rrs) {
+		ldns_zone_set_soa(&hosts, NULL);
+		ldns_zone_set_rrs(&hosts, rrs);
+		index = ldns_zone_index_new(&hosts);
+		if (!index) {
+			/* keep what we had, and try again next time */
+			ldns_rr_list_deep_free(rrs);
+			return;
+		}
+	}
+	ldns_zone_index_free(ldns_hosts_index);
+	ldns_rr_list_deep_free(ldns_hosts_rrs);
+	ldns_hosts_rrs = rrs;
+	ldns_hosts_index = index;
+	ldns_hosts_mtime = st.st_mtime;
+	ldns_hosts_size = st.st_size;
+	ldns_hosts_read = true;
+}
+
+/* the addresses the hosts file has for name, a copy of them because the
+ * file may be read again any time */
+static ldns_rr_list *
+ldns_hosts_rr_list_by_name(const ldns_rdf *name)
+{
+	ldns_rr_list *rrs;
+	ldns_rr_list *result;
+
+	result = NULL;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ldns_hosts_lock);
+#endif
+	ldns_hosts_refresh();
+	if (ldns_hosts_index) {
+		rrs = ldns_zone_index_name_rrs(ldns_hosts_index, name);
+		if (rrs) {
+			result = ldns_rr_list_clone(rrs);
+			ldns_rr_list_free(rrs);
+		}
+	}
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&ldns_hosts_lock);
+#endif
+	return result;
+}
 
 ldns_rr_list *
 ldns_get_rr_list_addr_by_name(ldns_resolver *res, ldns_rdf *name, ldns_rr_class c, 
 		uint16_t flags)
 {
-	ldns_pkt *pkt;
+	ldns_rdf *names[2];
+	ldns_rr_type types[2];
+	ldns_pkt *answers[2];
 	ldns_rr_list *aaaa;
 	ldns_rr_list *a;
-	ldns_rr_list *result = NULL;
-	ldns_rr_list *hostsfilenames;
-	size_t i;
+	ldns_rr_list *result;
 	uint8_t ip6;
 
-	a = NULL; 
-	aaaa = NULL; 
-	result = NULL;
-
 	if (!res) {
 		return NULL;
 	}
@@ -43,64 +134,49 @@ ldns_get_rr_list_addr_by_name(ldns_resolver *res, ldns_rdf *name, ldns_rr_class
 		return NULL;
 	}
 
+	result = ldns_hosts_rr_list_by_name(name);
+	if (result) {
+		return result;
+	}
+
 	ip6 = ldns_resolver_ip6(res); /* we use INET_ANY here, save
 					 what was there */
 
 	ldns_resolver_set_ip6(res, LDNS_RESOLV_INETANY);
-	
-	hostsfilenames = ldns_get_rr_list_hosts_frm_file(NULL);
-	for (i = 0; i < ldns_rr_list_rr_count(hostsfilenames); i++) {
-		if (ldns_rdf_compare(name, 
-					ldns_rr_owner(ldns_rr_list_rr(hostsfilenames, 
-							i))) == 0) {
-			if (!result) {
-				result = ldns_rr_list_new();
-			}
-			ldns_rr_list_push_rr(result, 
-					ldns_rr_clone(ldns_rr_list_rr(hostsfilenames, i)));
-		}
-	}
-	ldns_rr_list_deep_free(hostsfilenames);
 
-	if (result) {
-		return result;
+	/* both at once, add the RD flags, because we want an answer */
+	names[0] = name;
+	names[1] = name;
+	types[0] = LDNS_RR_TYPE_AAAA;
+	types[1] = LDNS_RR_TYPE_A;
+	if (ldns_resolver_query_parallel(answers, res, names, types, 2, c, 
+				flags | LDNS_RD, NULL, NULL) != LDNS_STATUS_OK) {
+		answers[0] = NULL;
+		answers[1] = NULL;
 	}
-
-	/* add the RD flags, because we want an answer */
-	pkt = ldns_resolver_query(res, name, LDNS_RR_TYPE_AAAA, c, flags | LDNS_RD);
-	if (pkt) {
-		/* extract the data we need */
-		aaaa = ldns_pkt_rr_list_by_type(pkt, LDNS_RR_TYPE_AAAA, 
-			LDNS_SECTION_ANSWER);
-		ldns_pkt_free(pkt);
-	} 
-
-	pkt = ldns_resolver_query(res, name, LDNS_RR_TYPE_A, c, flags | LDNS_RD);
-	if (pkt) {
-		/* extract the data we need */
-		a = ldns_pkt_rr_list_by_type(pkt, LDNS_RR_TYPE_A, LDNS_SECTION_ANSWER);
-		ldns_pkt_free(pkt);
-	} 
 	ldns_resolver_set_ip6(res, ip6);
 
+	/* extract the data we need */
+	aaaa = NULL;
+	a = NULL;
+	if (answers[0]) {
+		aaaa = ldns_pkt_rr_list_by_type(answers[0], LDNS_RR_TYPE_AAAA, 
+				LDNS_SECTION_ANSWER);
+		ldns_pkt_free(answers[0]);
+	}
+	if (answers[1]) {
+		a = ldns_pkt_rr_list_by_type(answers[1], LDNS_RR_TYPE_A, 
+				LDNS_SECTION_ANSWER);
+		ldns_pkt_free(answers[1]);
+	}
+
 	if (aaaa && a) {
 		result = ldns_rr_list_cat_clone(aaaa, a);
 		ldns_rr_list_deep_free(aaaa);
 		ldns_rr_list_deep_free(a);
 		return result;
 	}
-	
-	if (aaaa) {
-		result = ldns_rr_list_clone(aaaa);
-	}
-	
-	if (a) {
-		result = ldns_rr_list_clone(a);
-	}
-
-	ldns_rr_list_deep_free(aaaa);
-	ldns_rr_list_deep_free(a);
-	return result;
+	return aaaa ? aaaa : a;
 }
 
 ldns_rr_list *
@@ -16,12 +16,49 @@
 
 #include "ldns.h"
 
-/* TODO Jelte
-  add a pointer to a 'possiblecompression' structure
-  to all the needed functions?
-  something like an array of name, pointer values?
-  every dname part could be added to it
-*/
+/*
+ * Name compression (RFC 1035, section 4.1.4)
+ *
+ * While a packet is written, every name suffix that is put on the wire
+ * is remembered in a small open addressing hash table, keyed on a hash
+ * of the suffix. A later name that ends in a suffix found in the table
+ * only writes its leading labels followed by a pointer to the earlier
+ * copy. Suffixes are matched octet for octet, so decompression gives
+ * back exactly the names that were put in.
+ *
+ * Only packet encoding uses the table; the canonical and DNSSEC wire
+ * forms are always written uncompressed.
+ */
+#define LDNS_COMPRESS_INITIAL_SIZE 64
+#define LDNS_COMPRESS_MAX_OFFSET   0x3fff
+
+struct ldns_struct_compress_entry
+{
+	/** The suffix, pointing into the owner or rdata of a packet rr */
+	const uint8_t *_name;
+	/** Length of the suffix including the root label, 0 if unused */
+	uint16_t _len;
+	/** Offset of the suffix from the start of the packet */
+	uint16_t _offset;
+	uint32_t _hash;
+};
+typedef struct ldns_struct_compress_entry ldns_compress_entry;
+
+struct ldns_struct_compress_table
+{
+	ldns_compress_entry *_entries;
+	size_t _capacity;
+	/** Initial entries, so small packets need no allocation */
+	ldns_compress_entry _initial[LDNS_COMPRESS_INITIAL_SIZE];
+	size_t _count;
+	/** Position in the buffer where the packet starts */
+	size_t _base;
+	/** The last name written, rrs in a set usually share their owner */
+	const uint8_t *_last_name;
+	size_t _last_len;
+	uint16_t _last_offset;
+};
+typedef struct ldns_struct_compress_table ldns_compress_table;
 
 ldns_status
 ldns_dname2buffer_wire(ldns_buffer *buffer, const ldns_rdf *name)
@@ -44,16 +81,12 @@ ldns_rdf2buffer_wire(ldns_buffer *buffer, const ldns_rdf *rdf)
 ldns_status
 ldns_rdf2buffer_wire_canonical(ldns_buffer *buffer, const ldns_rdf *rdf)
 {
-	size_t i;
-	uint8_t *rdf_data;
-
 	if (ldns_rdf_get_type(rdf) == LDNS_RDF_TYPE_DNAME) {
 		if (ldns_buffer_reserve(buffer, ldns_rdf_size(rdf))) {
-			rdf_data = ldns_rdf_data(rdf);
-			for (i = 0; i < ldns_rdf_size(rdf); i++) {
-				ldns_buffer_write_u8(buffer,
-								 LDNS_DNAME_NORMALIZE(rdf_data[i]));
-			}
+			ldns_dname_octets_tolower(ldns_buffer_current(buffer),
+			                          ldns_rdf_data(rdf),
+			                          ldns_rdf_size(rdf));
+			ldns_buffer_skip(buffer, (ssize_t) ldns_rdf_size(rdf));
 		}
 	} else {
 		/* direct copy for all other types */
@@ -87,7 +120,7 @@ ldns_rr2buffer_wire_canonical(ldns_buffer *buffer,
 						int section)
 {
 	uint16_t i;
-	uint16_t rdl_pos = 0;
+	size_t rdl_pos = 0;
 	bool pre_rfc3597 = false;
 	switch (ldns_rr_get_type(rr)) {
 	case LDNS_RR_TYPE_NS:
@@ -158,7 +191,7 @@ ldns_status
 ldns_rr2buffer_wire(ldns_buffer *buffer, const ldns_rr *rr, int section)
 {
 	uint16_t i;
-	uint16_t rdl_pos = 0;
+	size_t rdl_pos = 0;
 	
 	if (ldns_rr_owner(rr)) {
 		(void) ldns_dname2buffer_wire(buffer, ldns_rr_owner(rr));
@@ -264,46 +297,335 @@ ldns_hdr2buffer_wire(ldns_buffer *buffer, const ldns_pkt *packet)
 	return ldns_buffer_status(buffer);
 }
 
+static void
+ldns_compress_table_init(ldns_compress_table *table, size_t base)
+{
+	table->_entries = table->_initial;
+	table->_capacity = LDNS_COMPRESS_INITIAL_SIZE;
+	table->_count = 0;
+	table->_base = base;
+	table->_last_name = NULL;
+	memset(table->_initial, 0, sizeof(table->_initial));
+}
+
+static void
+ldns_compress_table_free(ldns_compress_table *table)
+{
+	if (table->_entries != table->_initial) {
+		LDNS_FREE(table->_entries);
+	}
+	table->_entries = NULL;
+	table->_capacity = 0;
+}
+
+static const ldns_compress_entry *
+ldns_compress_table_find(const ldns_compress_table *table,
+                         const uint8_t *name, uint16_t len, uint32_t hash)
+{
+	size_t mask = table->_capacity - 1;
+	size_t i;
+
+	for (i = hash & mask; table->_entries[i]._len != 0; i = (i + 1) & mask) {
+		if (table->_entries[i]._hash == hash &&
+		    table->_entries[i]._len == len &&
+		    memcmp(table->_entries[i]._name, name, len) == 0) {
+			return &table->_entries[i];
+		}
+	}
+	return NULL;
+}
+
+static void
+ldns_compress_table_insert(ldns_compress_table *table,
+                           const uint8_t *name, uint16_t len, uint32_t hash,
+                           uint16_t offset)
+{
+	ldns_compress_entry *old_entries;
+	size_t old_capacity;
+	size_t mask;
+	size_t i, j;
+
+	/* keep the load factor under one half */
+	if ((table->_count + 1) * 2 > table->_capacity) {
+		old_entries = table->_entries;
+		old_capacity = table->_capacity;
+		table->_entries = LDNS_XMALLOC(ldns_compress_entry,
+		                               old_capacity * 2);
+		if (!table->_entries) {
+			/* no room to remember this one, just do not
+			 * compress against it */
+			table->_entries = old_entries;
+			return;
+		}
+		memset(table->_entries, 0,
+		       old_capacity * 2 * sizeof(ldns_compress_entry));
+		table->_capacity = old_capacity * 2;
+		mask = table->_capacity - 1;
+		for (j = 0; j < old_capacity; j++) {
+			if (old_entries[j]._len == 0) {
+				continue;
+			}
+			for (i = old_entries[j]._hash & mask;
+			     table->_entries[i]._len != 0;
+			     i = (i + 1) & mask) {
+				;
+			}
+			table->_entries[i] = old_entries[j];
+		}
+		if (old_entries != table->_initial) {
+			LDNS_FREE(old_entries);
+		}
+	}
+
+	mask = table->_capacity - 1;
+	for (i = hash & mask; table->_entries[i]._len != 0; i = (i + 1) & mask) {
+		;
+	}
+	table->_entries[i]._name = name;
+	table->_entries[i]._len = len;
+	table->_entries[i]._offset = offset;
+	table->_entries[i]._hash = hash;
+	table->_count++;
+}
+
+/*
+ * Writes the name, replacing the longest suffix that was written before
+ * by a compression pointer, and remembers the new suffixes
+ */
+static ldns_status
+ldns_dname2buffer_wire_compress(ldns_buffer *buffer, const ldns_rdf *name,
+                                ldns_compress_table *table)
+{
+	const uint8_t *data = ldns_rdf_data(name);
+	size_t size = ldns_rdf_size(name);
+	uint8_t label_pos[LDNS_MAX_DOMAINLEN / 2 + 1];
+	uint32_t hashes[LDNS_MAX_DOMAINLEN / 2 + 1];
+	const ldns_compress_entry *match = NULL;
+	const ldns_compress_entry *found;
+	uint16_t match_offset = 0;
+	size_t prefix;
+	uint8_t labels = 0;
+	uint8_t i, j;
+	size_t pos = 0;
+	size_t offset, first_offset;
+	uint32_t hash;
+
+	if (!table->_entries || ldns_rdf_get_type(name) != LDNS_RDF_TYPE_DNAME ||
+	    size > LDNS_MAX_DOMAINLEN) {
+		return ldns_dname2buffer_wire(buffer, name);
+	}
+
+	if (table->_last_name && table->_last_len == size && size > 1 &&
+	    memcmp(table->_last_name, data, size) == 0) {
+		if (ldns_buffer_reserve(buffer, 2)) {
+			ldns_buffer_write_u16(buffer, 0xc000 | table->_last_offset);
+		}
+		return ldns_buffer_status(buffer);
+	}
+
+	/* find the label boundaries */
+	while (pos < size && data[pos] != 0) {
+		if (data[pos] > LDNS_MAX_LABELLEN) {
+			return ldns_dname2buffer_wire(buffer, name);
+		}
+		label_pos[labels++] = (uint8_t) pos;
+		pos += data[pos] + 1;
+	}
+	if (pos != size - 1) {
+		/* not a sequence of labels ending in the root label */
+		return ldns_dname2buffer_wire(buffer, name);
+	}
+
+	/* hash every suffix, from the root label to the left */
+	hash = 5381;
+	for (i = labels; i > 0; i--) {
+		for (j = 0; j <= data[label_pos[i - 1]]; j++) {
+			hash = ((hash << 5) + hash) ^ data[label_pos[i - 1] + j];
+		}
+		hashes[i - 1] = hash;
+	}
+
+	/* the longest suffix that was already written wins. A name is
+	 * remembered with its suffixes, so the search goes from the root
+	 * label to the left and stops at the first suffix that is new.
+	 * Near the largest offset a pointer can hold that may miss a
+	 * longer match, which only costs space */
+	for (i = labels; i > 0; i--) {
+		found = ldns_compress_table_find(table, data + label_pos[i - 1],
+		                                 (uint16_t) (size - label_pos[i - 1]),
+		                                 hashes[i - 1]);
+		if (!found) {
+			break;
+		}
+		/* the entry can move when the table grows below */
+		match = found;
+		match_offset = found->_offset;
+	}
+
+	/* the labels before the match are written in one go */
+	prefix = i < labels ? label_pos[i] : size;
+	if (!ldns_buffer_reserve(buffer, prefix + 2)) {
+		return ldns_buffer_status(buffer);
+	}
+	first_offset = ldns_buffer_position(buffer) - table->_base;
+	for (j = 0; j < i; j++) {
+		offset = first_offset + label_pos[j];
+		if (offset <= LDNS_COMPRESS_MAX_OFFSET) {
+			ldns_compress_table_insert(table, data + label_pos[j],
+			                           (uint16_t) (size - label_pos[j]),
+			                           hashes[j], (uint16_t) offset);
+		}
+	}
+	if (match) {
+		ldns_buffer_write(buffer, data, prefix);
+		ldns_buffer_write_u16(buffer, 0xc000 | match_offset);
+	} else {
+		ldns_buffer_write(buffer, data, size);
+	}
+
+	if (i == 0 && match) {
+		table->_last_name = data;
+		table->_last_len = size;
+		table->_last_offset = match_offset;
+	} else if (i > 0 && first_offset <= LDNS_COMPRESS_MAX_OFFSET) {
+		table->_last_name = data;
+		table->_last_len = size;
+		table->_last_offset = (uint16_t) first_offset;
+	}
+	return ldns_buffer_status(buffer);
+}
+
+/*
+ * Only the rdata names of the types from RFC 1035 may be compressed
+ * (RFC 3597, section 4)
+ */
+static bool
+ldns_rr_rdata_compressible(ldns_rr_type type)
+{
+	switch (type) {
+	case LDNS_RR_TYPE_NS:
+	case LDNS_RR_TYPE_MD:
+	case LDNS_RR_TYPE_MF:
+	case LDNS_RR_TYPE_CNAME:
+	case LDNS_RR_TYPE_SOA:
+	case LDNS_RR_TYPE_MB:
+	case LDNS_RR_TYPE_MG:
+	case LDNS_RR_TYPE_MR:
+	case LDNS_RR_TYPE_PTR:
+	case LDNS_RR_TYPE_MINFO:
+	case LDNS_RR_TYPE_MX:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static ldns_status
+ldns_rr2buffer_wire_compress(ldns_buffer *buffer, const ldns_rr *rr,
+                             int section, ldns_compress_table *table)
+{
+	uint16_t i;
+	size_t rdl_pos = 0;
+	bool compress_rdata;
+	
+	if (ldns_rr_owner(rr)) {
+		(void) ldns_dname2buffer_wire_compress(buffer, ldns_rr_owner(rr),
+		                                       table);
+	}
+	
+	if (ldns_buffer_reserve(buffer, 4)) {
+		(void) ldns_buffer_write_u16(buffer, ldns_rr_get_type(rr));
+		(void) ldns_buffer_write_u16(buffer, ldns_rr_get_class(rr));
+	}
+
+	if (section != LDNS_SECTION_QUESTION) {
+		if (ldns_buffer_reserve(buffer, 6)) {
+			ldns_buffer_write_u32(buffer, ldns_rr_ttl(rr));
+			/* remember pos for later */
+			rdl_pos = ldns_buffer_position(buffer);
+			ldns_buffer_write_u16(buffer, 0);
+		}	
+
+		compress_rdata = ldns_rr_rdata_compressible(ldns_rr_get_type(rr));
+		for (i = 0; i < ldns_rr_rd_count(rr); i++) {
+			if (compress_rdata && ldns_rdf_get_type(ldns_rr_rdf(rr, i))
+			                      == LDNS_RDF_TYPE_DNAME) {
+				(void) ldns_dname2buffer_wire_compress(buffer,
+				                       ldns_rr_rdf(rr, i), table);
+			} else {
+				(void) ldns_rdf2buffer_wire(buffer, ldns_rr_rdf(rr, i));
+			}
+		}
+		
+		if (rdl_pos != 0) {
+			ldns_buffer_write_u16_at(buffer, rdl_pos,
+			                         ldns_buffer_position(buffer)
+		        	                   - rdl_pos - 2);
+		}
+	}
+	return ldns_buffer_status(buffer);
+}
+
 ldns_status
 ldns_pkt2buffer_wire(ldns_buffer *buffer, const ldns_pkt *packet)
+{
+	return ldns_pkt2buffer_wire_compress(buffer, packet, true);
+}
+
+ldns_status
+ldns_pkt2buffer_wire_compress(ldns_buffer *buffer, const ldns_pkt *packet,
+                              bool compress)
 {
 	ldns_rr_list *rr_list;
 	uint16_t i;
+	ldns_compress_table table;
 	
 	/* edns tmp vars */
 	ldns_rr *edns_rr;
 	uint8_t edata[4];
 	
+	if (compress) {
+		ldns_compress_table_init(&table, ldns_buffer_position(buffer));
+	} else {
+		table._entries = NULL;
+		table._capacity = 0;
+	}
+
 	(void) ldns_hdr2buffer_wire(buffer, packet);
 
 	rr_list = ldns_pkt_question(packet);
 	if (rr_list) {
 		for (i = 0; i < ldns_rr_list_rr_count(rr_list); i++) {
-			(void) ldns_rr2buffer_wire(buffer, 
-			             ldns_rr_list_rr(rr_list, i), LDNS_SECTION_QUESTION);
+			(void) ldns_rr2buffer_wire_compress(buffer, 
+			             ldns_rr_list_rr(rr_list, i), LDNS_SECTION_QUESTION,
+			             &table);
 		}
 	}
 	rr_list = ldns_pkt_answer(packet);
 	if (rr_list) {
 		for (i = 0; i < ldns_rr_list_rr_count(rr_list); i++) {
-			(void) ldns_rr2buffer_wire(buffer, 
-			             ldns_rr_list_rr(rr_list, i), LDNS_SECTION_ANSWER);
+			(void) ldns_rr2buffer_wire_compress(buffer, 
+			             ldns_rr_list_rr(rr_list, i), LDNS_SECTION_ANSWER,
+			             &table);
 		}
 	}
 	rr_list = ldns_pkt_authority(packet);
 	if (rr_list) {
 		for (i = 0; i < ldns_rr_list_rr_count(rr_list); i++) {
-			(void) ldns_rr2buffer_wire(buffer, 
-			             ldns_rr_list_rr(rr_list, i), LDNS_SECTION_AUTHORITY);
+			(void) ldns_rr2buffer_wire_compress(buffer, 
+			             ldns_rr_list_rr(rr_list, i), LDNS_SECTION_AUTHORITY,
+			             &table);
 		}
 	}
 	rr_list = ldns_pkt_additional(packet);
 	if (rr_list) {
 		for (i = 0; i < ldns_rr_list_rr_count(rr_list); i++) {
-			(void) ldns_rr2buffer_wire(buffer, 
-			             ldns_rr_list_rr(rr_list, i), LDNS_SECTION_ADDITIONAL);
+			(void) ldns_rr2buffer_wire_compress(buffer, 
+			             ldns_rr_list_rr(rr_list, i), LDNS_SECTION_ADDITIONAL,
+			             &table);
 		}
 	}
+	ldns_compress_table_free(&table);
 	
 	/* add EDNS to additional if it is needed */
 	if (ldns_pkt_edns(packet)) {
@@ -320,7 +642,8 @@ ldns_pkt2buffer_wire(ldns_buffer *buffer, const ldns_pkt *packet)
 		ldns_rr_free(edns_rr);
 	}
 	
-	/* add TSIG to additional if it is there */
+	/* add TSIG to additional if it is there, the TSIG rr itself
+	 * is never compressed */
 	if (ldns_pkt_tsig(packet)) {
 		(void) ldns_rr2buffer_wire(buffer,
 		                           ldns_pkt_tsig(packet), LDNS_SECTION_ADDITIONAL);
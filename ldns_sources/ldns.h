@@ -119,6 +119,7 @@ Or you can just use the menu above to browse through the API docs.
 #include "ldns/zone.h"
 #include "ldns/dnssec_zone.h"
 #include "ldns/rbtree.h"
+#include "ldns/enum.h"
 
 #define LDNS_IP4ADDRLEN      (32/8)
 #define LDNS_IP6ADDRLEN      (128/8)
@@ -113,6 +113,26 @@ ldns_rdf *ldns_dname_new_frm_data(uint16_t size, const void *data);
  */
 void ldns_dname2canonical(const ldns_rdf *rdf);
 
+/**
+ * Copies len octets of dname data from src to dst, lowercasing the
+ * ASCII letters. Label length octets are never letters, so whole
+ * dnames can be passed. Works a machine word at a time; dst may be src.
+ * \param[out] dst where to put the lowercased octets
+ * \param[in] src the octets to lowercase
+ * \param[in] len the number of octets
+ * \return void
+ */
+void ldns_dname_octets_tolower(uint8_t *dst, const uint8_t *src, size_t len);
+
+/**
+ * Compares len octets of dname data as if both were lowercased
+ * \param[in] a the first octets
+ * \param[in] b the second octets
+ * \param[in] len the number of octets to compare
+ * \return -1 if a sorts before b, 1 if it sorts after b, 0 when equal
+ */
+int ldns_dname_octets_casecmp(const uint8_t *a, const uint8_t *b, size_t len);
+
 /**
  * test wether the name sub falls under parent (i.e. is a subdomain
  * of parent.
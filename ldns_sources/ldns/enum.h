@@ -0,0 +1,471 @@
+/*
+ * enum.h
+ *
+ * ENUM (E.164 number to URI mapping) definitions
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+
+/**
+ * \file
+ *
+ * Functions for ENUM, RFC 6116: turning a phone number into its domain,
+ * decoding the NAPTR records found there and telling what kind of
+ * service they point to. None of these need anything but ldns, so the
+ * same code runs in the app and on a server.
+ */
+
+#ifndef LDNS_ENUM_H
+#define LDNS_ENUM_H
+
+#include "common.h"
+#include "rdata.h"
+#include "rr.h"
+#include "error.h"
+#include "resolver.h"
+
+/** the suffix used when none is given */
+#define LDNS_ENUM_E164_SUFFIX "e164.arpa"
+
+/** the services field of a NAPTR that is encrypted */
+#define LDNS_ENUM_ENCRYPTED_SERVICES "x-crypto:data:8210"
+
+/**
+ * The kinds of service a NAPTR can point to that are told apart
+ */
+enum ldns_enum_service_class_enum
+{
+	LDNS_ENUM_SERVICE_OTHER = 0,
+	LDNS_ENUM_SERVICE_WEB,
+	LDNS_ENUM_SERVICE_KEY,
+	LDNS_ENUM_SERVICE_LOC,
+	LDNS_ENUM_SERVICE_MAIL,
+	LDNS_ENUM_SERVICE_VOICE,
+	LDNS_ENUM_SERVICE_VCARD
+};
+typedef enum ldns_enum_service_class_enum ldns_enum_service_class;
+
+/**
+ * The web sites a web:http uri is recognized as
+ */
+enum ldns_enum_site_enum
+{
+	LDNS_ENUM_SITE_NONE = 0,
+	LDNS_ENUM_SITE_LINKEDIN,
+	LDNS_ENUM_SITE_FACEBOOK,
+	LDNS_ENUM_SITE_HYVES,
+	LDNS_ENUM_SITE_TWITTER,
+	LDNS_ENUM_SITE_FOURSQUARE,
+	LDNS_ENUM_SITE_YOUTUBE,
+	LDNS_ENUM_SITE_SKYPE,
+	LDNS_ENUM_SITE_MYSPACE,
+	LDNS_ENUM_SITE_FLICKR,
+	LDNS_ENUM_SITE_MYOPENID
+};
+typedef enum ldns_enum_site_enum ldns_enum_site;
+
+/**
+ * A decoded ENUM NAPTR record
+ *
+ * The strings are in presentation format, the services are split up in
+ * the enumservice types, the x-lbl labels and the location indicator
+ * hints (x-mobile, x-work, ...). Only terminal records have services.
+ */
+struct ldns_struct_enum_naptr
+{
+	uint16_t _order;
+	uint16_t _preference;
+	uint32_t _ttl;
+	/** flags, services and regexp are in one allocation, that of _flags */
+	char *_flags;
+	char *_services;
+	char *_regexp;
+	char *_replacement;
+	/** the uri of a terminal record, the replacement of another one */
+	char *_uri;
+	bool _terminal;
+	bool _encrypted;
+	ldns_enum_service_class _class;
+	/** the services with the separators overwritten, the tokens point into it */
+	char *_tokens;
+	char **_types;
+	size_t _type_count;
+	char **_labels;
+	size_t _label_count;
+	char **_lihs;
+	size_t _lih_count;
+};
+typedef struct ldns_struct_enum_naptr ldns_enum_naptr;
+
+/**
+ * Converts a phone number to its ENUM domain name, the digits in
+ * reverse order, each a label, followed by the suffix. Anything in the
+ * number that is not a digit, like the leading +, is skipped.
+ * \param[in] number the number, e.g. +31123456789
+ * \param[in] suffix the suffix, NULL for LDNS_ENUM_E164_SUFFIX
+ * \return the name, e.g. 9.8.7.6.5.4.3.2.1.1.3.e164.arpa, to be freed by
+ * the caller, or NULL when the number has no digits
+ */
+char *ldns_enum_number2str(const char *number, const char *suffix);
+
+/**
+ * Writes the ENUM domain name of a phone number in wire format: a label
+ * of one byte for every digit, last digit first, and then the suffix as
+ * it is. Anything in the number that is not a digit is skipped.
+ * \param[out] wire room for LDNS_MAX_DOMAINLEN bytes
+ * \param[in] number the number, need not be zero terminated
+ * \param[in] len the length of number
+ * \param[in] suffix the suffix dname, NULL for LDNS_ENUM_E164_SUFFIX
+ * \return the size of the name, 0 when the number has no digits or the
+ * name would be too long
+ */
+size_t ldns_enum_number2wire(uint8_t *wire, const char *number, size_t len, const ldns_rdf *suffix);
+
+/**
+ * Converts a phone number to its ENUM domain name as a dname rdf, like
+ * ldns_enum_number2wire()
+ * \param[in] number the number
+ * \param[in] suffix the suffix dname, NULL for LDNS_ENUM_E164_SUFFIX
+ * \return the dname or NULL when the number has no digits or the name
+ * would be too long
+ */
+ldns_rdf *ldns_enum_dname_new_frm_number(const char *number, const ldns_rdf *suffix);
+
+/**
+ * Converts many phone numbers to their ENUM domain names at once, like
+ * ldns_enum_number2wire(). Convert the suffix to a dname once and pass
+ * it to every call, the names are not parsed as text.
+ * \param[out] dnames room for count dnames, set to the names in the
+ * order of the numbers, NULL for the numbers that have no name
+ * \param[in] numbers the numbers
+ * \param[in] count the number of numbers
+ * \param[in] suffix the suffix dname, NULL for LDNS_ENUM_E164_SUFFIX
+ * \return the number of names made
+ */
+size_t ldns_enum_dnames_new_frm_numbers(ldns_rdf **dnames, const char * const *numbers, size_t count, const ldns_rdf *suffix);
+
+/**
+ * Returns a character string rdf as text, without the quotes around
+ * it. " and \ are escaped with a \, unprintable characters as \DDD.
+ * \param[in] rdf the rdf, of type LDNS_RDF_TYPE_STR
+ * \return the text, to be freed by the caller
+ */
+char *ldns_enum_string_rdf2str(const ldns_rdf *rdf);
+
+/**
+ * Returns a dname rdf as text, without the closing dot and with . ( and
+ * ) in labels escaped with a \, unprintable characters as \DDD. The root
+ * is the empty string.
+ * \param[in] rdf the rdf, of type LDNS_RDF_TYPE_DNAME
+ * \return the text, to be freed by the caller, or NULL if the rdf is no
+ * valid dname
+ */
+char *ldns_enum_dname_rdf2str(const ldns_rdf *rdf);
+
+/**
+ * Like ldns_enum_string_rdf2str(), appending the text to a buffer. The
+ * room for all of it is made at once and runs of characters that need
+ * no escaping are copied eight at a time.
+ * \param[in] output the buffer to append to, it is not 0 terminated
+ * \param[in] rdf the rdf, of type LDNS_RDF_TYPE_STR
+ * \return LDNS_STATUS_OK, LDNS_STATUS_MEM_ERR, or
+ * LDNS_STATUS_ENUM_NAPTR_ERR when the rdf is too short
+ */
+ldns_status ldns_enum_string_rdf2buffer(ldns_buffer *output, const ldns_rdf *rdf);
+
+/**
+ * Like ldns_enum_dname_rdf2str(), appending the text to a buffer, see
+ * ldns_enum_string_rdf2buffer()
+ * \param[in] output the buffer to append to, it is not 0 terminated
+ * \param[in] rdf the rdf, of type LDNS_RDF_TYPE_DNAME
+ * \return LDNS_STATUS_OK, LDNS_STATUS_MEM_ERR, or
+ * LDNS_STATUS_ENUM_NAPTR_ERR when the rdf is no valid dname
+ */
+ldns_status ldns_enum_dname_rdf2buffer(ldns_buffer *output, const ldns_rdf *rdf);
+
+/**
+ * Applies the regexp field of a NAPTR, a substitution expression as in
+ * RFC 3402: a delimiter, an extended regular expression, the delimiter,
+ * the replacement, the delimiter and the flags. \1 to \9 in the
+ * replacement are what the subexpressions matched, the flag i makes case
+ * not matter. The delimiter is escaped with a \ where it is meant
+ * itself. The first match in aus is replaced and what is around it is
+ * kept, like sed does. The compiled expressions are cached, so the
+ * expression of a zone is compiled once for all its numbers.
+ * \param[out] result the string aus becomes, to be freed by the caller
+ * \param[in] regexp the field as it is in the record, not escaped
+ * \param[in] len the length of regexp
+ * \param[in] aus the string to apply it to, for ENUM the number with the
+ * + in front
+ * \return LDNS_STATUS_ENUM_REGEXP_ERR when regexp is no valid expression,
+ * LDNS_STATUS_ENUM_REGEXP_NO_MATCH when it does not match aus
+ */
+ldns_status ldns_enum_regexp_apply(char **result, const uint8_t *regexp, size_t len, const char *aus);
+
+/**
+ * Returns the number an ENUM domain name is for, from the labels of one
+ * digit it starts with
+ * \param[in] name the name, e.g. 3.2.1.e164.arpa.
+ * \return the number with a + in front, e.g. +123, to be freed by the
+ * caller, or NULL when the name does not start with a digit label
+ */
+char *ldns_enum_aus_frm_dname(const ldns_rdf *name);
+
+/** the non-terminal NAPTRs ldns_enum_naptr_chase() follows one after another */
+#define LDNS_ENUM_CHASE_DEPTH 5
+
+/**
+ * Looks for the NAPTR records of a name before the network is asked
+ * \param[in] name the name
+ * \param[in] arg what was given to ldns_enum_naptr_chase()
+ * \return a new list, freed by ldns_enum_naptr_chase(), or NULL
+ */
+typedef ldns_rr_list *(*ldns_enum_lookup_func)(const ldns_rdf *name, void *arg);
+
+/**
+ * Offered the NAPTR records the network answered for a name, to keep
+ * \param[in] name the name
+ * \param[in] naptrs the records, they stay with the caller
+ * \param[in] arg what was given to ldns_enum_naptr_chase()
+ */
+typedef void (*ldns_enum_store_func)(const ldns_rdf *name, const ldns_rr_list *naptrs, void *arg);
+
+/**
+ * Decodes a NAPTR record. Records with the flag "u" are terminal and
+ * their uri is what the regexp makes of the number, see
+ * ldns_enum_regexp_apply(). Other records must have no flags and point
+ * to their replacement.
+ * \param[out] naptr the decoded record
+ * \param[in] rr the rr to decode
+ * \param[in] aus the number the record was looked up for, with the + in
+ * front. When NULL it is taken from the owner name of rr
+ * \return LDNS_STATUS_ENUM_NAPTR_ERR when rr is not a NAPTR or its fields
+ * are not those of an ENUM record, the error of ldns_enum_regexp_apply()
+ * when its regexp does not apply to the number
+ */
+ldns_status ldns_enum_naptr_new_frm_rr(ldns_enum_naptr **naptr, const ldns_rr *rr, const char *aus);
+
+/**
+ * Follows the non-terminal NAPTRs of a number to the records their
+ * replacements have, and those of the non-terminal ones among them, up
+ * to depth deep. The names of one step are asked for at the same time
+ * with ldns_resolver_query_parallel(), after lookup had no answer for
+ * them. Every record takes the place of the one that pointed to it, so
+ * the result is in the order the records are to be used in: on order
+ * and preference, and within a replaced record on those of its own
+ * records. A non-terminal record is kept as it is when its replacement
+ * has no records, is a name it was reached through or is too deep.
+ * \param[out] result the records, to be freed by the caller
+ * \param[in] r the resolver to ask, NULL to use lookup only
+ * \param[in] naptrs the records of the number
+ * \param[in] depth how many non-terminal records may follow each other
+ * \param[in] lookup when not NULL asked for a name before the network
+ * \param[in] store when not NULL given the records the network answered
+ * \param[in] arg passed on to lookup and store
+ * \return LDNS_STATUS_OK or LDNS_STATUS_MEM_ERR
+ */
+ldns_status ldns_enum_naptr_chase(ldns_rr_list **result, const ldns_resolver *r, const ldns_rr_list *naptrs, size_t depth, ldns_enum_lookup_func lookup, ldns_enum_store_func store, void *arg);
+
+/**
+ * Frees a decoded NAPTR record
+ * \param[in] naptr the record
+ */
+void ldns_enum_naptr_free(ldns_enum_naptr *naptr);
+
+/**
+ * Returns the order of a NAPTR
+ * \param[in] naptr the record
+ * \return the order
+ */
+uint16_t ldns_enum_naptr_order(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns the preference of a NAPTR
+ * \param[in] naptr the record
+ * \return the preference
+ */
+uint16_t ldns_enum_naptr_preference(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns the ttl of a NAPTR
+ * \param[in] naptr the record
+ * \return the ttl
+ */
+uint32_t ldns_enum_naptr_ttl(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns the flags field of a NAPTR
+ * \param[in] naptr the record
+ * \return the flags
+ */
+const char *ldns_enum_naptr_flags(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns the services field of a NAPTR
+ * \param[in] naptr the record
+ * \return the services
+ */
+const char *ldns_enum_naptr_services(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns the regexp field of a NAPTR
+ * \param[in] naptr the record
+ * \return the regexp
+ */
+const char *ldns_enum_naptr_regexp(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns the replacement of a NAPTR, the empty string for a terminal one
+ * \param[in] naptr the record
+ * \return the replacement
+ */
+const char *ldns_enum_naptr_replacement(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns what a NAPTR points to: the uri of a terminal record, the
+ * empty string if that is encrypted, or the replacement of another one
+ * \param[in] naptr the record
+ * \return the uri
+ */
+const char *ldns_enum_naptr_uri(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns whether a NAPTR is terminal
+ * \param[in] naptr the record
+ * \return true for a record with the "u" flag
+ */
+bool ldns_enum_naptr_terminal(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns whether a NAPTR is encrypted
+ * \param[in] naptr the record
+ * \return true when its services are LDNS_ENUM_ENCRYPTED_SERVICES
+ */
+bool ldns_enum_naptr_encrypted(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns the kind of service of a NAPTR, that of its first enumservice
+ * type
+ * \param[in] naptr the record
+ * \return the class
+ */
+ldns_enum_service_class ldns_enum_naptr_class(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns the number of enumservice types of a NAPTR, e.g. web:http
+ * \param[in] naptr the record
+ * \return the number of types
+ */
+size_t ldns_enum_naptr_type_count(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns an enumservice type of a NAPTR
+ * \param[in] naptr the record
+ * \param[in] i the index of the type
+ * \return the type or NULL if there are not that many
+ */
+const char *ldns_enum_naptr_type(const ldns_enum_naptr *naptr, size_t i);
+
+/**
+ * Returns the number of x-lbl labels of a NAPTR
+ * \param[in] naptr the record
+ * \return the number of labels
+ */
+size_t ldns_enum_naptr_label_count(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns an x-lbl label of a NAPTR, without the x-lbl: in front
+ * \param[in] naptr the record
+ * \param[in] i the index of the label
+ * \return the label or NULL if there are not that many
+ */
+const char *ldns_enum_naptr_label(const ldns_enum_naptr *naptr, size_t i);
+
+/**
+ * Returns the number of location indicator hints of a NAPTR
+ * \param[in] naptr the record
+ * \return the number of hints
+ */
+size_t ldns_enum_naptr_lih_count(const ldns_enum_naptr *naptr);
+
+/**
+ * Returns a location indicator hint of a NAPTR, e.g. x-mobile
+ * \param[in] naptr the record
+ * \param[in] i the index of the hint
+ * \return the hint or NULL if there are not that many
+ */
+const char *ldns_enum_naptr_lih(const ldns_enum_naptr *naptr, size_t i);
+
+/**
+ * Returns the labels of a NAPTR as one text to show: joined with spaces,
+ * - and _ made spaces and cut off after 20 characters
+ * \param[in] naptr the record
+ * \return the text, to be freed by the caller
+ */
+char *ldns_enum_naptr_label_description(const ldns_enum_naptr *naptr);
+
+/**
+ * Compares two NAPTRs on order and then preference, the order in which
+ * they are to be used
+ * \param[in] a the first record
+ * \param[in] b the second record
+ * \return -1, 0 or 1 when a comes before, with or after b
+ */
+int ldns_enum_naptr_compare(const ldns_enum_naptr *a, const ldns_enum_naptr *b);
+
+/**
+ * Tells whether a services token is a location indicator hint, ignoring
+ * case
+ * \param[in] token the token, e.g. x-mobile
+ * \return true if it is
+ */
+bool ldns_enum_token_is_lih(const char *token);
+
+/**
+ * Returns the kind of service an enumservice type is, ignoring case
+ * \param[in] type the type, e.g. web:http
+ * \return the class, LDNS_ENUM_SERVICE_OTHER when it is not one told apart
+ */
+ldns_enum_service_class ldns_enum_service_classify(const char *type);
+
+/**
+ * Returns the kind of service of the first enumservice type in a
+ * services field, as it is in the record. The tokens are told apart with
+ * one hash each, no strings are made.
+ * \param[in] services the field without its length byte, e.g.
+ * E2U+x-mobile+voice:tel
+ * \param[in] len the length of services
+ * \return the class, LDNS_ENUM_SERVICE_OTHER when there is no type told
+ * apart
+ */
+ldns_enum_service_class ldns_enum_services_classify(const uint8_t *services, size_t len);
+
+/**
+ * Returns the web site a uri is on, of those that are recognized, by
+ * its host
+ * \param[in] uri the uri
+ * \return the site or LDNS_ENUM_SITE_NONE
+ */
+ldns_enum_site ldns_enum_site_frm_uri(const char *uri);
+
+/**
+ * Like ldns_enum_site_frm_uri(), for a uri that is not a string. The
+ * hosts of all sites are looked for in the host of the uri in one pass,
+ * ignoring case; when several are in it the site that comes first in the
+ * table counts.
+ * \param[in] uri the uri
+ * \param[in] len the length of uri
+ * \return the site or LDNS_ENUM_SITE_NONE
+ */
+ldns_enum_site ldns_enum_site_frm_data(const uint8_t *uri, size_t len);
+
+/**
+ * Returns the name of a web site to show
+ * \param[in] site the site
+ * \return the name, e.g. LinkedIn, or NULL for LDNS_ENUM_SITE_NONE
+ */
+const char *ldns_enum_site_name(ldns_enum_site site);
+
+#endif /* LDNS_ENUM_H */
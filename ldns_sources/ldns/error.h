@@ -90,7 +90,15 @@ enum ldns_enum_status {
 	LDNS_STATUS_DNSSEC_EXISTENCE_DENIED,
 	LDNS_STATUS_DNSSEC_NSEC_RR_NOT_COVERED,
 	LDNS_STATUS_DNSSEC_NSEC_WILDCARD_NOT_COVERED,
-	LDNS_STATUS_DNSSEC_NSEC3_ORIGINAL_NOT_FOUND
+	LDNS_STATUS_DNSSEC_NSEC3_ORIGINAL_NOT_FOUND,
+	LDNS_STATUS_SNAPSHOT_FORMAT_ERR,
+	LDNS_STATUS_SNAPSHOT_VERSION_ERR,
+	LDNS_STATUS_SNAPSHOT_CHECKSUM_ERR,
+	LDNS_STATUS_XFR_RCODE_ERR,
+	LDNS_STATUS_XFR_FORMAT_ERR,
+	LDNS_STATUS_ENUM_NAPTR_ERR,
+	LDNS_STATUS_ENUM_REGEXP_ERR,
+	LDNS_STATUS_ENUM_REGEXP_NO_MATCH
 };
 typedef enum ldns_enum_status ldns_status;
 
@@ -24,7 +24,8 @@
 
 /**
  * Ask the resolver about name
- * and return all address records
+ * and return all address records, the AAAA records first. The AAAA and
+ * A queries are sent at the same time
  * \param[in] r the resolver to use
  * \param[in] name the name to look for
  * \param[in] c the class to use
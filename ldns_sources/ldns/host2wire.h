@@ -103,13 +103,26 @@ ldns_status ldns_rrsig2buffer_wire(ldns_buffer *output, const ldns_rr *sigrr);
 ldns_status ldns_rr_rdata2buffer_wire(ldns_buffer *output, const ldns_rr *rr);
 
 /**
- * Copies the packet data to the buffer in wire format
+ * Copies the packet data to the buffer in wire format.
+ * Owner names, and the rdata names of the RFC 1035 types, are compressed
  * \param[out] *output buffer to append the result to
  * \param[in] *pkt packet to convert
  * \return ldns_status
  */
 ldns_status ldns_pkt2buffer_wire(ldns_buffer *output, const ldns_pkt *pkt);
 
+/**
+ * Copies the packet data to the buffer in wire format, optionally
+ * without name compression
+ * \param[out] *output buffer to append the result to
+ * \param[in] *pkt packet to convert
+ * \param[in] compress when false all names are written out in full
+ * \return ldns_status
+ */
+ldns_status ldns_pkt2buffer_wire_compress(ldns_buffer *output,
+								  const ldns_pkt *pkt,
+								  bool compress);
+
 /**
  * Copies the rr_list data to the buffer in wire format
  * \param[out] *output buffer to append the result to
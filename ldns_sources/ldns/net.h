@@ -96,6 +96,26 @@ ldns_status ldns_send(ldns_pkt **pkt, ldns_resolver *r, const ldns_pkt *query_pk
  */
 ldns_status ldns_send_buffer(ldns_pkt **pkt, ldns_resolver *r, ldns_buffer *qb, ldns_rdf *tsig_mac);
 
+/**
+ * Sends several queries at once and hands out the answers as they come
+ * in. The nameservers of the resolver are tried in turn like with
+ * ldns_send(), every round with the queries that are still unanswered.
+ * Over tcp, or when the queries are signed with TSIG, they are sent one
+ * after the other with ldns_send().
+ *
+ * \param[out] answers room for count packets, set to the answers in the
+ * order of the queries, NULL where none came
+ * \param[in] r the resolver to use
+ * \param[in] queries the queries to send, each with its own id
+ * \param[in] count the number of queries
+ * \param[in] func when not NULL called with the index of every answer
+ * as soon as it is in answers. When it returns false the other answers
+ * are not waited for
+ * \param[in] arg passed on to func
+ * \return LDNS_STATUS_OK when at least one answer came
+ */
+ldns_status ldns_send_parallel(ldns_pkt **answers, ldns_resolver *r, ldns_pkt * const *queries, size_t count, bool (*func)(size_t, void *), void *arg);
+
 /**
  * Create a tcp socket to the specified address
  * \param[in] to ip and family
@@ -184,4 +204,33 @@ ldns_rdf * ldns_sockaddr_storage2rdf(struct sockaddr_storage *sock, uint16_t *po
  */
 ldns_status ldns_axfr_start(ldns_resolver *resolver, ldns_rdf *domain, ldns_rr_class c);
 
+/**
+ * Prepares the resolver for an ixfr query, for the changes since the
+ * version of the zone with soa. The query is sent over tcp and the
+ * answers can be read from the socket of the resolver, ldns_zone_ixfr()
+ * does that
+ * \param[in] resolver the resolver to use
+ * \param[in] domain the domain to ixfr
+ * \param[in] c the class to use
+ * \param[in] soa the soa of the version of the zone that is there
+ * \return ldns_status the status of the transfer
+ */
+ldns_status ldns_ixfr_start(ldns_resolver *resolver, ldns_rdf *domain, ldns_rr_class c, const ldns_rr *soa);
+
+/**
+ * Does an axfr and hands the rrs of the zone to func as they are read,
+ * the soa first and once. Every message is read into the same buffer
+ * and its rrs are taken from that, so the transfer itself needs memory
+ * for one message only, however large the zone.
+ * \param[in] resolver the resolver to use
+ * \param[in] domain the domain to axfr
+ * \param[in] c the class to use
+ * \param[in] func called with every rr, which is then its to free. When
+ * it does not return LDNS_STATUS_OK the transfer is stopped
+ * \param[in] arg passed on to func
+ * \return LDNS_STATUS_OK when the whole zone was read, else the error of
+ * the transfer or the one func returned
+ */
+ldns_status ldns_axfr_stream(ldns_resolver *resolver, ldns_rdf *domain, ldns_rr_class c, ldns_status (*func)(ldns_rr *, void *), void *arg);
+
 #endif  /* LDNS_NET_H */
@@ -65,6 +65,22 @@ ssize_t ldns_fget_token(FILE *f, char *token, const char *delim, size_t limit);
  */
 ssize_t ldns_fget_token_l(FILE *f, char *token, const char *delim, size_t limit, int *line_nr);
 
+/** 
+ * returns a token/char from the buffer b, exactly the way
+ * ldns_fget_token_l() reads it from a stream: the same handling of ( and ),
+ * comments and line numbers, and no special meaning for \\ (unlike
+ * ldns_bget_token()). Runs of ordinary characters are copied in one go
+ * and comments are skipped with memchr(), so this is a lot faster than
+ * reading the same data through stdio.
+ * \param[in] *b the buffer to read from, its position is advanced
+ * \param[out] *token the token is put here
+ * \param[in] *delim chars at which the parsing should stop
+ * \param[in] *limit how much to read. If 0 use builtin maximum
+ * \param[in] line_nr pointer to an integer containing the current line number (for debugging purposes)
+ * \return 0 on error of end of b otherwise return the length of what is read
+ */
+ssize_t ldns_mget_token_l(ldns_buffer *b, char *token, const char *delim, size_t limit, int *line_nr);
+
 /**
  * returns a token/char from the buffer b.
  * This function deals with ( and ) in the buffer,
@@ -156,4 +172,15 @@ void ldns_fskipcs(FILE *fp, const char *s);
  */
 void ldns_fskipcs_l(FILE *fp, const char *s, int *line_nr);
 
+/**
+ * skips all of the characters in the given string in the buffer, moving
+ * the position to the first character that is not in *s. Counts the
+ * newlines like ldns_fskipcs_l() does.
+ * \param[in] *buffer buffer to use
+ * \param[in] *s characters to skip
+ * \param[in] line_nr pointer to an integer containing the current line number (for debugging purposes)
+ * \return void
+ */
+void ldns_mskipcs_l(ldns_buffer *buffer, const char *s, int *line_nr);
+
 #endif /* LDNS_PARSE_H */
@@ -130,6 +130,8 @@ struct ldns_struct_rdf
 	size_t _size;
 	/** The type of the data */
 	ldns_rdf_type _type;
+	/** Number of labels in a dname, -1 when not yet counted */
+	int16_t _label_count;
 	/** Pointer to the data (raw octets) */
 	void  *_data;
 };
@@ -49,6 +49,22 @@
 #define LDNS_RESOLV_RTT_INF             0       /* infinity */
 #define LDNS_RESOLV_RTT_MIN             1       /* reachable */
 
+/**
+ * A negative answer remembered by ldns_resolver_search(): the name had
+ * no records of the type, or did not exist
+ */
+struct ldns_struct_resolver_negative
+{
+	/** the lowercased wire format name */
+	uint8_t _name[LDNS_MAX_DOMAINLEN];
+	size_t _name_size;
+	ldns_rr_type _type;
+	ldns_rr_class _class;
+	uint8_t _rcode;
+	time_t _expires;
+};
+typedef struct ldns_struct_resolver_negative ldns_resolver_negative;
+
 /**
  * DNS stub resolver structure
  */
@@ -101,6 +117,8 @@ struct ldns_struct_resolver
 	bool _defnames;
 	/**  If true apply the search list */
 	bool _dnsrch;
+	/**  If true the names of the search list are all asked for at once */
+	bool _search_parallel;
 	/**  Timeout for socket connections */
 	struct timeval _timeout;
 	/**  Only try the first nameserver, and return with an error directly if it fails */
@@ -132,6 +150,10 @@ struct ldns_struct_resolver
 	char *_tsig_keydata;
 	/** TSIG signing algorithm */
 	char *_tsig_algorithm;
+	/** The negative answers of searches with these nameservers, made
+	 * by the first search that gets one and dropped when the
+	 * nameservers change */
+	ldns_resolver_negative *_negative;
 };
 typedef struct ldns_struct_resolver ldns_resolver;
 
@@ -198,6 +220,12 @@ bool ldns_resolver_usevc(const ldns_resolver *r);
  * \return true: yes, fail, false: no, try the others
  */
 bool ldns_resolver_fail(const ldns_resolver *r);
+/**
+ * Does the resolver ask for all the names of the search list at once
+ * \param[in] r the resolver
+ * \return true: at once, false: one after the other
+ */
+bool ldns_resolver_search_parallel(const ldns_resolver *r);
 /**
  * Does the resolver do DNSSEC
  * \param[in] r the resolver
@@ -459,6 +487,14 @@ void ldns_resolver_set_ip6(ldns_resolver *r, uint8_t i);
  */
 void ldns_resolver_set_fail(ldns_resolver *r, bool b);
 
+/**
+ * Whether ldns_resolver_search() asks for all the names of the search
+ * list at once, instead of one after the other
+ * \param[in] r the resolver
+ * \param[in] b true: at once, false: one after the other
+ */
+void ldns_resolver_set_search_parallel(ldns_resolver *r, bool b);
+
 /**
  * Whether or not to ignore the TC bit
  * \param[in] r the resolver
@@ -547,7 +583,13 @@ ldns_status ldns_resolver_push_nameserver_rr_list(ldns_resolver *r, ldns_rr_list
 /**
  * Send the query for using the resolver and take the search list into account
  * The search algorithm is as follows:
- * If the name is absolute, try it as-is, otherwise apply the search list
+ * If the name has more than one label, try it as-is, otherwise apply the
+ * search list and then try the name itself. The first of those names
+ * that has the records wins, else the first answer is returned. Names the nameservers of the resolver recently answered with NXDOMAIN or
+ * no data are not asked for again until that answer expires; when all
+ * of them are, an answer with the rcode of the first is made up. With
+ * ldns_resolver_set_search_parallel() all the names are asked for at
+ * once
  * \param[in] *r operate using this resolver
  * \param[in] *rdf query for this name
  * \param[in] t query for this type (may be 0, defaults to A)
@@ -602,6 +644,27 @@ ldns_status ldns_resolver_send_pkt(ldns_pkt **answer, const ldns_resolver *r, co
 ldns_pkt* ldns_resolver_query(const ldns_resolver *r, const ldns_rdf *name, ldns_rr_type type, ldns_rr_class class, uint16_t flags);
 
 
+/**
+ * Send queries for several names or types at the same time, see
+ * ldns_send_parallel(). Each name is asked for as ldns_resolver_query()
+ * would
+ * \param[out] answers room for count packets, set to the answers in the
+ * order of the queries, NULL where none came
+ * \param[in] *r operate using this resolver
+ * \param[in] names query for these names
+ * \param[in] types query each name for this type (0 is A)
+ * \param[in] count the number of names and types
+ * \param[in] class query for this class (may be 0, default to IN)
+ * \param[in] flags the query flags
+ * \param[in] func when not NULL called with the index of every answer
+ * as soon as it arrives. When it returns false the rest is not waited
+ * for
+ * \param[in] arg passed on to func
+ * \return LDNS_STATUS_OK when at least one answer came
+ */
+ldns_status ldns_resolver_query_parallel(ldns_pkt **answers, const ldns_resolver *r, ldns_rdf * const *names, const ldns_rr_type *types, size_t count, ldns_rr_class class, uint16_t flags, bool (*func)(size_t, void *), void *arg);
+
+
 /** 
  * Create a new resolver structure 
  * \return ldns_resolver* pointer to new strcture
@@ -292,6 +292,35 @@ struct ldns_struct_rr_list
 };
 typedef struct ldns_struct_rr_list ldns_rr_list;
 
+/**
+ * Scratch space for reading resource records from text.
+ *
+ * ldns_rr_new_frm_str() and friends need a couple of buffers for every
+ * rr they read, among them one of LDNS_MAX_PACKETLEN for the rdata. The
+ * parser holds on to them, so code that reads many rrs, like a zone
+ * loader, can reuse them instead of allocating them for every record.
+ * A parser can be used by one thread at a time.
+ */
+struct ldns_struct_rr_parser
+{
+	char *_owner;
+	char *_ttl;
+	char *_clas;
+	char *_type;
+	/** the rdata part of the rr text */
+	char *_rdata;
+	/** the current rdata field */
+	char *_rd;
+	char *_b64;
+	/** the line read from a zone file */
+	char *_line;
+	/** reads the rr text, without a copy of it */
+	ldns_buffer _rr_buf;
+	/** reads _rdata */
+	ldns_buffer _rd_buf;
+};
+typedef struct ldns_struct_rr_parser ldns_rr_parser;
+
 /**
  * Contains all information about resource record types.
  *
@@ -352,6 +381,48 @@ void ldns_rr_free(ldns_rr *rr);
  */
 ldns_status ldns_rr_new_frm_str(ldns_rr **n, const char *str, uint32_t default_ttl, ldns_rdf *origin, ldns_rdf **prev);
 
+/**
+ * creates a new parser, with the scratch space for reading rrs
+ * \return the new parser, or NULL on memory errors
+ */
+ldns_rr_parser *ldns_rr_parser_new(void);
+
+/**
+ * frees a parser
+ * \param[in] parser the parser to free
+ */
+void ldns_rr_parser_free(ldns_rr_parser *parser);
+
+/**
+ * creates an rr from a string, like ldns_rr_new_frm_str(), but uses the
+ * buffers of parser. The rdata of NAPTR, NS, A, AAAA, SOA and RRSIG
+ * records in plain text is split up without the generic tokenizer; the
+ * result is the same.
+ * \param[in] parser the parser to use
+ * \param[out] n the rr
+ * \param[in] str the string to convert
+ * \param[in] default_ttl pointer to a default ttl for the rr. If 0 DEF_TTL will be used
+ * \param[in] origin when the owner is relative add this
+ * \param[in] prev the previous ownername
+ * \return a status msg describing an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_rr_parser_frm_str(ldns_rr_parser *parser, ldns_rr **n, const char *str, uint32_t default_ttl, ldns_rdf *origin, ldns_rdf **prev);
+
+/**
+ * reads only the owner, ttl, class and type of an rr string, the way
+ * ldns_rr_parser_frm_str() would, without building the rr. The rdata is
+ * not looked at, so an rr that is reported fine here can still fail to
+ * parse in full.
+ * \param[in] parser the parser to use
+ * \param[in] str the string to read
+ * \param[in] default_ttl the ttl to use when there is none. If 0 DEF_TTL will be used
+ * \param[out] owner the owner as written, valid until the next use of parser
+ * \param[out] ttl the ttl the rr gets
+ * \param[out] type the type of the rr
+ * \return a status msg describing an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_rr_parser_frm_str_head(ldns_rr_parser *parser, const char *str, uint32_t default_ttl, const char **owner, uint32_t *ttl, ldns_rr_type *type);
+
 /**
  * creates a new rr from a file containing a string.
  * \param[out] rr the new rr
@@ -385,6 +456,60 @@ ldns_status ldns_rr_new_frm_fp(ldns_rr **rr, FILE *fp, uint32_t *default_ttl, ld
  */
 ldns_status ldns_rr_new_frm_fp_l(ldns_rr **rr, FILE *fp, uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev, int *line_nr);
 
+/**
+ * creates a new rr from zone data in a buffer, like ldns_rr_new_frm_fp_l()
+ * does from a file. The buffer's position is moved past what was read.
+ * \param[out] rr the new rr
+ * \param[in] b the buffer to read from
+ * \param[in] default_ttl a default ttl for the rr. If NULL DEF_TTL will be used
+ *            the pointer will be updated if the data contains a $TTL directive
+ * \param[in] origin when the owner is relative add this
+ * 	      the pointer will be updated if the data contains a $ORIGIN directive
+ *	      The caller must ldns_rdf_deep_free it.
+ * \param[in] prev when the owner is whitespaces use this as the * ownername
+ *            the pointer will be updated after the call
+ *	      The caller must ldns_rdf_deep_free it.
+ * \param[in] line_nr pointer to an integer containing the current line number (for debugging purposes)
+ * \return a ldns_status with an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_rr_new_frm_buffer_l(ldns_rr **rr, ldns_buffer *b, uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev, int *line_nr);
+
+/**
+ * ldns_rr_new_frm_fp_l(), with the buffers of parser
+ * \param[in] parser the parser to use
+ * \param[out] rr the new rr
+ * \param[in] fp the file pointer to use
+ * \param[in] default_ttl a default ttl for the rr. If NULL DEF_TTL will be used
+ *            the pointer will be updated if the file contains a $TTL directive
+ * \param[in] origin when the owner is relative add this
+ * 	      the pointer will be updated if the file contains a $ORIGIN directive
+ *	      The caller must ldns_rdf_deep_free it.
+ * \param[in] prev when the owner is whitespaces use this as the * ownername
+ *            the pointer will be updated after the call
+ *	      The caller must ldns_rdf_deep_free it.
+ * \param[in] line_nr pointer to an integer containing the current line number (for debugging purposes)
+ * \return a ldns_status with an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_rr_parser_frm_fp_l(ldns_rr_parser *parser, ldns_rr **rr, FILE *fp, uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev, int *line_nr);
+
+/**
+ * ldns_rr_new_frm_buffer_l(), with the buffers of parser
+ * \param[in] parser the parser to use
+ * \param[out] rr the new rr
+ * \param[in] b the buffer to read from
+ * \param[in] default_ttl a default ttl for the rr. If NULL DEF_TTL will be used
+ *            the pointer will be updated if the data contains a $TTL directive
+ * \param[in] origin when the owner is relative add this
+ * 	      the pointer will be updated if the data contains a $ORIGIN directive
+ *	      The caller must ldns_rdf_deep_free it.
+ * \param[in] prev when the owner is whitespaces use this as the * ownername
+ *            the pointer will be updated after the call
+ *	      The caller must ldns_rdf_deep_free it.
+ * \param[in] line_nr pointer to an integer containing the current line number (for debugging purposes)
+ * \return a ldns_status with an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_rr_parser_frm_buffer_l(ldns_rr_parser *parser, ldns_rr **rr, ldns_buffer *b, uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev, int *line_nr);
+
 /**
  * sets the owner in the rr structure.
  * \param[in] *rr rr to operate on
@@ -668,6 +793,8 @@ ldns_rr_list* ldns_rr_list_clone(const ldns_rr_list *rrlist);
 
 /**
  * sorts an rr_list (canonical wire format). the sorting is done inband.
+ * rrs that compare equal keep their order. Large lists are sorted on
+ * several threads when pthreads are available.
  * \param[in] unsorted the rr_list to be sorted
  * \return void
  */
@@ -27,6 +27,7 @@
 #include "rdata.h"
 #include "rr.h"
 #include "error.h"
+#include "resolver.h"
 
 /** 
  * DNS Zone
@@ -111,9 +112,9 @@ bool ldns_zone_push_rr(ldns_zone *z, ldns_rr *rr);
  * records. The resulting list does are pointer references
  * to the zone's data.
  *
- * Due to the current zone implementation (as a list of rr's), this
- * function is extremely slow. Another (probably better) way to do this
- * is to use an ldns_dnssec_zone structure and the mark_glue function 
+ * This builds an ldns_zone_index for the zone on every call, to look
+ * for glue more than once build the index once and use
+ * ldns_zone_index_glue_rr_list()
  *
  * \param[in] z the zone to look for glue
  * \return the rr_list with the glue
@@ -145,6 +146,63 @@ ldns_status ldns_zone_new_frm_fp(ldns_zone **z, FILE *fp, ldns_rdf *origin, uint
  */
 ldns_status ldns_zone_new_frm_fp_l(ldns_zone **z, FILE *fp, ldns_rdf *origin, uint32_t ttl, ldns_rr_class c, int *line_nr);
 
+/**
+ * Create a new zone from zone data in a buffer, keep track of the line
+ * numbering. The result is the same as ldns_zone_new_frm_fp_l() on a file
+ * with that content. Large zone data is cut up at line boundaries and
+ * the parts are parsed on all cpus, errors and line numbers are still
+ * those of the first bad line.
+ * \param[out] z the new zone
+ * \param[in] *b the buffer to read from, its position is advanced
+ * \param[in] *origin the zones' origin
+ * \param[in] ttl default ttl to use
+ * \param[in] c default class to use (IN)
+ * \param[out] line_nr used for error msg, to get to the line number
+ *
+ * \return ldns_status mesg with an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_zone_new_frm_buffer_l(ldns_zone **z, ldns_buffer *b, ldns_rdf *origin, uint32_t ttl, ldns_rr_class c, int *line_nr);
+
+/**
+ * Create a new zone from the named file. Regular files are mapped in
+ * memory and tokenised from there, which is a lot faster on large zones
+ * than reading them through stdio; anything else is read as a stream.
+ * \param[out] z the new zone
+ * \param[in] *filename the zone file to read
+ * \param[in] *origin the zones' origin
+ * \param[in] ttl default ttl to use
+ * \param[in] c default class to use (IN)
+ *
+ * \return ldns_status mesg with an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_zone_new_frm_file(ldns_zone **z, const char *filename, ldns_rdf *origin, uint32_t ttl, ldns_rr_class c);
+
+/**
+ * Create a new zone from the named file, keep track of the line numbering.
+ * See ldns_zone_new_frm_file().
+ * \param[out] z the new zone
+ * \param[in] *filename the zone file to read
+ * \param[in] *origin the zones' origin
+ * \param[in] ttl default ttl to use
+ * \param[in] c default class to use (IN)
+ * \param[out] line_nr used for error msg, to get to the line number
+ *
+ * \return ldns_status mesg with an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_zone_new_frm_file_l(ldns_zone **z, const char *filename, ldns_rdf *origin, uint32_t ttl, ldns_rr_class c, int *line_nr);
+
+/**
+ * Create a new zone with an axfr from the first nameserver of the
+ * resolver. The rrs go into the zone as they are read, see
+ * ldns_axfr_stream()
+ * \param[out] z the new zone
+ * \param[in] resolver the resolver to use
+ * \param[in] origin the zone to transfer
+ * \param[in] c the class of the zone
+ * \return ldns_status mesg with an error or LDNS_STATUS_OK
+ */
+ldns_status ldns_zone_new_frm_axfr(ldns_zone **z, ldns_resolver *resolver, ldns_rdf *origin, ldns_rr_class c);
+
 /**
  * Frees the allocated memory for the zone, and the rr_list structure in it
  * \param[in] zone the zone to free
@@ -164,4 +222,431 @@ void ldns_zone_deep_free(ldns_zone *zone);
  */
 void ldns_zone_sort(ldns_zone *zone);
 
+/**
+ * Brings a zone up to date with an ixfr from the first nameserver of the
+ * resolver. When the nameserver has no incremental transfer for the
+ * zone it sends all of it, or, when it does not do ixfr at all, an axfr
+ * is done instead. The rrs the new version has in common with zone are
+ * shared, not copied, so zone must be freed with ldns_zone_free() and
+ * removed with ldns_rr_list_deep_free() once the new version is in use.
+ * \param[in] resolver the resolver to use
+ * \param[in] zone the zone to update, it must have a soa
+ * \param[out] newzone the new version of the zone, NULL when zone is up
+ * to date
+ * \param[out] removed the rrs of zone that are not in newzone, its soa
+ * included
+ * \return LDNS_STATUS_OK or an error, in which case zone is left alone
+ */
+ldns_status ldns_zone_ixfr(ldns_resolver *resolver, const ldns_zone *zone, ldns_zone **newzone, ldns_rr_list **removed);
+
+/**
+ * The rrs of one type at a name in an ldns_zone_index
+ */
+struct ldns_struct_zone_rrset
+{
+	ldns_rr_type	 _type;
+	/** references to the rrs in the zone, in zone order */
+	ldns_rr_list	*_rrs;
+};
+typedef struct ldns_struct_zone_rrset ldns_zone_rrset;
+
+/**
+ * A name in an ldns_zone_index with its rrsets
+ */
+struct ldns_struct_zone_name
+{
+	/** where the lowercased wire name is in the keys of the index */
+	size_t		 _key;
+	uint16_t	 _key_size;
+	uint32_t	 _hash;
+	uint16_t	 _rrset_count;
+	ldns_zone_rrset	*_rrsets;
+};
+typedef struct ldns_struct_zone_name ldns_zone_name;
+
+/**
+ * Index over the rrs of an ldns_zone
+ *
+ * The owner names of the zone are hashed case insensitively, every name
+ * has its rrs grouped by type. The rrs themselves stay in the zone, the
+ * index only refers to them, so it must not outlive the zone or changes
+ * to it.
+ */
+struct ldns_struct_zone_index
+{
+	/** lowercased wire format owner names, one after the other */
+	uint8_t		*_keys;
+	size_t		 _keys_size;
+	size_t		 _keys_capacity;
+	ldns_zone_name	*_names;
+	size_t		 _name_count;
+	size_t		 _name_capacity;
+	/** open addressing, name number + 1 or 0 when empty */
+	size_t		*_slots;
+	size_t		 _slot_mask;
+	/** the lowercased owner of the soa, or NULL */
+	ldns_rdf	*_apex;
+};
+typedef struct ldns_struct_zone_index ldns_zone_index;
+
+/**
+ * Builds an index over the rrs of a zone, soa included, in one pass.
+ * \param[in] zone the zone to index
+ * \return the index or NULL when out of memory
+ */
+ldns_zone_index *ldns_zone_index_new(const ldns_zone *zone);
+
+/**
+ * Frees the index, the rrs in the zone are left alone
+ * \param[in] index the index to free
+ */
+void ldns_zone_index_free(ldns_zone_index *index);
+
+/**
+ * Returns the number of distinct owner names in the index
+ * \param[in] index the index
+ * \return the number of names
+ */
+size_t ldns_zone_index_name_count(const ldns_zone_index *index);
+
+/**
+ * Looks up the rrs of one type at a name
+ * \param[in] index the index to search
+ * \param[in] name the owner name, in any case
+ * \param[in] type the type
+ * \return the rrset, or NULL when there is none. The list belongs to
+ * the index and must not be changed or freed
+ */
+ldns_rr_list *ldns_zone_index_rrset(const ldns_zone_index *index, const ldns_rdf *name, ldns_rr_type type);
+
+/**
+ * Looks up all the rrs at a name, the rrsets after each other in the
+ * order in which their types first appear in the zone
+ * \param[in] index the index to search
+ * \param[in] name the owner name, in any case
+ * \return a new list of references to the rrs, free it with 
+ * ldns_rr_list_free(). NULL when the name is not in the zone
+ */
+ldns_rr_list *ldns_zone_index_name_rrs(const ldns_zone_index *index, const ldns_rdf *name);
+
+/**
+ * Finds the delegation that name falls under: the NS rrset of the
+ * topmost name at or above name that has NS rrs and is not the apex
+ * \param[in] index the index to search
+ * \param[in] name the name to look for
+ * \return the NS rrset of the zone cut, or NULL when name is not
+ * delegated. The list belongs to the index
+ */
+ldns_rr_list *ldns_zone_index_zone_cut(const ldns_zone_index *index, const ldns_rdf *name);
+
+/**
+ * Tells whether an rr is glue: an A or AAAA record below a zone cut. These
+ * are the rrs ldns_zone_glue_rr_list() returns
+ * \param[in] index the index of the zone the rr is in
+ * \param[in] rr the rr to check
+ * \return true if it is glue
+ */
+bool ldns_zone_index_is_glue(const ldns_zone_index *index, const ldns_rr *rr);
+
+/** the format version ldns_zone_snapshot_write() writes */
+#define LDNS_ZONE_SNAPSHOT_VERSION 1
+
+/**
+ * Compiled, read only form of a zone
+ *
+ * A snapshot file holds the rrs of a zone in canonical order in wire
+ * format, with a prebuilt name index like that of ldns_zone_index. It is
+ * used where it lies, normally a read only mapping of the file: opening
+ * one checks it but parses nothing, rrs are only made when asked for.
+ * A mapped file must never be changed in place, a reader touching a page
+ * that was cut off gets SIGBUS. Replace it with a new file that is
+ * renamed over it, as ldns_zone_snapshot_write_file() does.
+ *
+ * The layout, all numbers in network order:
+ *  - header: "LDNSSNAP", version, flags, soa rr number (or 0xffffffff),
+ *    rr, rrset, name and slot counts, size of the keys and of the rr
+ *    data, and a crc32 of the rest of the file
+ *  - names: key offset, key size, rrset count, hash, first rrset
+ *  - rrsets: type, class, first rr, rr count
+ *  - rr offsets into the rr data, one more than there are rrs
+ *  - hash slots: name number + 1, or 0 when empty
+ *  - keys: the lowercased wire format names
+ *  - rr data: the rrs in wire format, uncompressed
+ */
+struct ldns_struct_zone_snapshot
+{
+	const uint8_t	*_data;
+	size_t		 _size;
+	/** how _data was come by, to give it back */
+	bool		 _mapped;
+	bool		 _alloced;
+	uint32_t	 _soa;
+	uint32_t	 _rr_count;
+	uint32_t	 _rrset_count;
+	uint32_t	 _name_count;
+	uint32_t	 _slot_count;
+	const uint8_t	*_names;
+	const uint8_t	*_rrsets;
+	const uint8_t	*_rr_offsets;
+	const uint8_t	*_slots;
+	const uint8_t	*_keys;
+	uint32_t	 _keys_size;
+	const uint8_t	*_rr_data;
+	uint32_t	 _rr_data_size;
+};
+typedef struct ldns_struct_zone_snapshot ldns_zone_snapshot;
+
+/**
+ * Compiles a zone into a snapshot. The rrs, soa included, go in
+ * canonical order, the way ldns_zone_sort() puts them.
+ * \param[in] fp the file to write to
+ * \param[in] zone the zone to write
+ * \return LDNS_STATUS_OK or an error
+ */
+ldns_status ldns_zone_snapshot_write(FILE *fp, const ldns_zone *zone);
+
+/**
+ * Compiles a zone into a snapshot file, like ldns_zone_snapshot_write().
+ * The snapshot is written to a temporary file that is then renamed to
+ * filename, so those that have the old file open keep reading it
+ * unchanged.
+ * \param[in] filename the file to replace
+ * \param[in] zone the zone to write
+ * \return LDNS_STATUS_OK or an error, filename is untouched then
+ */
+ldns_status ldns_zone_snapshot_write_file(const char *filename, const ldns_zone *zone);
+
+/**
+ * Opens a snapshot file. The file is mapped if it can be, else read.
+ * A mapped file has to be replaced by renaming another over it, never
+ * rewritten, see ldns_zone_snapshot_write_file()
+ * \param[out] snapshot the opened snapshot
+ * \param[in] filename the snapshot file
+ * \return LDNS_STATUS_OK, or an error when the file can not be read or
+ * is not a good snapshot
+ */
+ldns_status ldns_zone_snapshot_new_frm_file(ldns_zone_snapshot **snapshot, const char *filename);
+
+/**
+ * Uses snapshot data that is already in memory, it is not copied and
+ * must stay as long as the snapshot is used
+ * \param[out] snapshot the snapshot
+ * \param[in] data the snapshot data
+ * \param[in] size the size of data
+ * \return LDNS_STATUS_OK, or an error when data is not a good snapshot
+ */
+ldns_status ldns_zone_snapshot_new_frm_data(ldns_zone_snapshot **snapshot, const uint8_t *data, size_t size);
+
+/**
+ * Closes a snapshot. Rrs that were taken from it are not affected
+ * \param[in] snapshot the snapshot to close
+ */
+void ldns_zone_snapshot_free(ldns_zone_snapshot *snapshot);
+
+/**
+ * Returns the number of rrs in a snapshot, soa included
+ * \param[in] snapshot the snapshot
+ * \return the number of rrs
+ */
+size_t ldns_zone_snapshot_rr_count(const ldns_zone_snapshot *snapshot);
+
+/**
+ * Returns the soa of the zone a snapshot was written from
+ * \param[in] snapshot the snapshot
+ * \return a new rr, free it with ldns_rr_free(). NULL when the zone had
+ * no soa
+ */
+ldns_rr *ldns_zone_snapshot_soa(const ldns_zone_snapshot *snapshot);
+
+/**
+ * Looks up the rrs of one type at a name, like ldns_zone_index_rrset()
+ * \param[in] snapshot the snapshot to search
+ * \param[in] name the owner name, in any case
+ * \param[in] type the type
+ * \return a new list with the rrs, free it with ldns_rr_list_deep_free().
+ * NULL when there are none
+ */
+ldns_rr_list *ldns_zone_snapshot_rrset(const ldns_zone_snapshot *snapshot, const ldns_rdf *name, ldns_rr_type type);
+
+/**
+ * Looks up all the rrs at a name, like ldns_zone_index_name_rrs()
+ * \param[in] snapshot the snapshot to search
+ * \param[in] name the owner name, in any case
+ * \return a new list with the rrs, free it with ldns_rr_list_deep_free().
+ * NULL when the name is not in the zone
+ */
+ldns_rr_list *ldns_zone_snapshot_name_rrs(const ldns_zone_snapshot *snapshot, const ldns_rdf *name);
+
+/**
+ * Finds the delegation name falls under, like ldns_zone_index_zone_cut()
+ * \param[in] snapshot the snapshot to search
+ * \param[in] name the name to look for
+ * \return a new list with the NS rrs of the zone cut, free it with 
+ * ldns_rr_list_deep_free(). NULL when name is not delegated
+ */
+ldns_rr_list *ldns_zone_snapshot_zone_cut(const ldns_zone_snapshot *snapshot, const ldns_rdf *name);
+
+/**
+ * Makes a zone out of all the rrs in a snapshot. Printed, it is the
+ * same text as the zone the snapshot was written from, once that zone
+ * is sorted.
+ * \param[out] z the new zone
+ * \param[in] snapshot the snapshot to read
+ * \return LDNS_STATUS_OK or an error
+ */
+ldns_status ldns_zone_new_frm_snapshot(ldns_zone **z, const ldns_zone_snapshot *snapshot);
+
+
+/**
+ * A digit in an ldns_zone_enum_index. The children of a node are kept
+ * next to each other, so a node only needs to know which digits it has
+ * children for and where the first one is
+ */
+struct ldns_struct_zone_enum_node
+{
+	/** the node of the lowest child digit, the others follow it */
+	uint32_t	 _children;
+	/** the first naptr of the number that ends here */
+	uint32_t	 _rrs;
+	/** bit n is set when there is a child for digit n */
+	uint16_t	 _digits;
+	uint16_t	 _rr_count;
+};
+typedef struct ldns_struct_zone_enum_node ldns_zone_enum_node;
+
+/**
+ * Index over the NAPTR rrs of an ENUM zone by number
+ *
+ * The owner names of ENUM records are the digits of a number in reverse,
+ * one label each, under a suffix like e164.arpa. The index is a trie of
+ * the digits in number order, looking up a number takes one step per
+ * digit and no names are made for it. Like ldns_zone_index it only
+ * refers to the rrs in the zone.
+ */
+struct ldns_struct_zone_enum_index
+{
+	/** the lowercased suffix the numbers are under */
+	ldns_rdf		*_suffix;
+	/** the nodes, the root first */
+	ldns_zone_enum_node	*_nodes;
+	size_t			 _node_count;
+	/** the naptrs, those of a number after each other in zone order */
+	ldns_rr			**_rrs;
+	size_t			 _rr_count;
+	size_t			 _number_count;
+};
+typedef struct ldns_struct_zone_enum_index ldns_zone_enum_index;
+
+/**
+ * Builds an index over the NAPTR rrs of a zone that are at a number under
+ * suffix. Other rrs, and NAPTRs at names that are not all single digit
+ * labels, are left out.
+ * \param[in] zone the zone to index
+ * \param[in] suffix the ENUM suffix, like e164.arpa., or NULL for the
+ * apex of the zone
+ * \return the index or NULL when out of memory
+ */
+ldns_zone_enum_index *ldns_zone_enum_index_new(const ldns_zone *zone, const ldns_rdf *suffix);
+
+/**
+ * Frees the index, the rrs in the zone are left alone
+ * \param[in] index the index to free
+ */
+void ldns_zone_enum_index_free(ldns_zone_enum_index *index);
+
+/**
+ * Returns the number of numbers with NAPTRs in the index
+ * \param[in] index the index
+ * \return the number of numbers
+ */
+size_t ldns_zone_enum_index_number_count(const ldns_zone_enum_index *index);
+
+/**
+ * Looks up the NAPTR rrs of a number
+ * \param[in] index the index to search
+ * \param[in] number the digits of the number, in normal order and with
+ * or without a leading '+', relative to the suffix of the index
+ * \return a new list of references to the rrs in zone order, free it with
+ * ldns_rr_list_free(). NULL when the number has none or has no digits
+ */
+ldns_rr_list *ldns_zone_enum_index_naptrs(const ldns_zone_enum_index *index, const char *number);
+
+/**
+ * Looks up the NAPTR rrs at an ENUM name, like 4.3.2.1.e164.arpa.
+ * \param[in] index the index to search
+ * \param[in] name the name, in any case
+ * \return a new list of references to the rrs in zone order, free it with
+ * ldns_rr_list_free(). NULL when the name has none
+ */
+ldns_rr_list *ldns_zone_enum_index_naptrs_frm_dname(const ldns_zone_enum_index *index, const ldns_rdf *name);
+
+
+/**
+ * Blocked bloom filter of the numbers in ENUM data
+ *
+ * Tells for sure that a number has no NAPTR rrs, so a lookup for it can
+ * be skipped, or that it may have some. All the bits for a number are in
+ * one 512 bit block, which takes one cache line to check. It is built
+ * once and only read after, so one filter can be shared by threads and
+ * replaced by a new one as a whole.
+ */
+struct ldns_struct_zone_enum_filter
+{
+	/** 8 words of 64 bits a block */
+	uint64_t	*_blocks;
+	size_t		 _block_count;
+	size_t		 _number_count;
+	/** the chance that a number that is not there gets through */
+	double		 _fp_rate;
+};
+typedef struct ldns_struct_zone_enum_filter ldns_zone_enum_filter;
+
+/**
+ * Builds a filter of the numbers under suffix that have NAPTR rrs in a
+ * list, like that of a zone or a zone transfer
+ * \param[in] rrs the rrs
+ * \param[in] suffix the ENUM suffix, like e164.arpa.
+ * \return the filter or NULL when out of memory
+ */
+ldns_zone_enum_filter *ldns_zone_enum_filter_new(const ldns_rr_list *rrs, const ldns_rdf *suffix);
+
+/**
+ * Builds a filter of the numbers under suffix that have NAPTR rrs in a
+ * snapshot. Only the names and rrset types are read, no rrs are made.
+ * \param[in] snapshot the snapshot
+ * \param[in] suffix the ENUM suffix, like e164.arpa.
+ * \return the filter or NULL when out of memory
+ */
+ldns_zone_enum_filter *ldns_zone_enum_filter_new_frm_snapshot(const ldns_zone_snapshot *snapshot, const ldns_rdf *suffix);
+
+/**
+ * Frees a filter
+ * \param[in] filter the filter to free
+ */
+void ldns_zone_enum_filter_free(ldns_zone_enum_filter *filter);
+
+/**
+ * Checks whether a number may have NAPTR rrs
+ * \param[in] filter the filter
+ * \param[in] number the digits of the number, in normal order and with
+ * or without a leading '+', relative to the suffix of the filter
+ * \return false when the number has none for sure
+ */
+bool ldns_zone_enum_filter_may_contain(const ldns_zone_enum_filter *filter, const char *number);
+
+/**
+ * Returns the number of numbers put in the filter
+ * \param[in] filter the filter
+ * \return the number of numbers
+ */
+size_t ldns_zone_enum_filter_number_count(const ldns_zone_enum_filter *filter);
+
+/**
+ * Returns the expected false positive rate of the filter, worked out
+ * from how full its blocks are
+ * \param[in] filter the filter
+ * \return the fraction of absent numbers that get through
+ */
+double ldns_zone_enum_filter_fp_rate(const ldns_zone_enum_filter *filter);
+
 #endif /* LDNS_ZONE_H */
@@ -28,6 +28,7 @@
 #include <arpa/inet.h>
 #endif
 #include <sys/time.h>
+#include <sys/select.h>
 #include <errno.h>
 
 ldns_status
@@ -218,6 +219,336 @@ ldns_send_buffer(ldns_pkt **result, ldns_resolver *r, ldns_buffer *qb, ldns_rdf
 	return status;
 }
 
+/* the milliseconds from start to end */
+static uint32_t
+ldns_ms_between(const struct timeval *start, const struct timeval *end)
+{
+	return (uint32_t) ((end->tv_sec - start->tv_sec) * 1000 +
+			(end->tv_usec - start->tv_usec) / 1000);
+}
+
+/* whether a packet came from the address it was sent to */
+static bool
+ldns_sockaddr_storage_same(const struct sockaddr_storage *from,
+		const struct sockaddr_storage *to)
+{
+	const struct sockaddr_in *from4, *to4;
+	const struct sockaddr_in6 *from6, *to6;
+
+	if (from->ss_family != to->ss_family) {
+		return false;
+	}
+	if (from->ss_family == AF_INET) {
+		from4 = (const struct sockaddr_in *) from;
+		to4 = (const struct sockaddr_in *) to;
+		return from4->sin_port == to4->sin_port &&
+			memcmp(&from4->sin_addr, &to4->sin_addr,
+					sizeof(from4->sin_addr)) == 0;
+	}
+	if (from->ss_family == AF_INET6) {
+		from6 = (const struct sockaddr_in6 *) from;
+		to6 = (const struct sockaddr_in6 *) to;
+		return from6->sin6_port == to6->sin6_port &&
+			memcmp(&from6->sin6_addr, &to6->sin6_addr,
+					sizeof(from6->sin6_addr)) == 0;
+	}
+	return false;
+}
+
+/* whether answer is the reply to query: it has the same id and asks the
+ * same question */
+static bool
+ldns_pkt_answers_query(const ldns_pkt *answer, const ldns_pkt *query)
+{
+	ldns_rr *question, *asked;
+
+	if (ldns_pkt_id(answer) != ldns_pkt_id(query) || !ldns_pkt_qr(answer)) {
+		return false;
+	}
+	if (ldns_rr_list_rr_count(ldns_pkt_question(query)) == 0) {
+		return true;
+	}
+	if (ldns_rr_list_rr_count(ldns_pkt_question(answer)) !=
+	    ldns_rr_list_rr_count(ldns_pkt_question(query))) {
+		return false;
+	}
+	question = ldns_rr_list_rr(ldns_pkt_question(answer), 0);
+	asked = ldns_rr_list_rr(ldns_pkt_question(query), 0);
+	return ldns_rr_get_type(question) == ldns_rr_get_type(asked) &&
+		ldns_rr_get_class(question) == ldns_rr_get_class(asked) &&
+		ldns_dname_compare(ldns_rr_owner(question),
+				ldns_rr_owner(asked)) == 0;
+}
+
+/* waits until the queries that went to ns are answered or the timeout of
+ * the resolver passes. Returns the number of answers, or count + 1 when
+ * func wants no more */
+static size_t
+ldns_send_parallel_wait(ldns_pkt **answers, ldns_resolver *r,
+		ldns_pkt * const *queries, size_t count, int *sockets,
+		const struct timeval *start, ldns_rdf *ns,
+		const struct sockaddr_storage *to,
+		bool (*func)(size_t, void *), void *arg)
+{
+	struct timeval now, left, timeout;
+	struct sockaddr_storage from;
+	socklen_t from_len;
+	fd_set readable;
+	int max_fd, ready;
+	uint8_t *wire;
+	size_t wire_size;
+	ldns_pkt *answer;
+	size_t i, answered;
+
+	answered = 0;
+	timeout = ldns_resolver_timeout(r);
+	for (;;) {
+		FD_ZERO(&readable);
+		max_fd = -1;
+		for (i = 0; i < count; i++) {
+			if (sockets[i] != 0) {
+				FD_SET(sockets[i], &readable);
+				if (sockets[i] > max_fd) {
+					max_fd = sockets[i];
+				}
+			}
+		}
+		if (max_fd == -1) {
+			return answered;
+		}
+		gettimeofday(&now, NULL);
+		left.tv_sec = start->tv_sec + timeout.tv_sec - now.tv_sec;
+		left.tv_usec = start->tv_usec + timeout.tv_usec - now.tv_usec;
+		while (left.tv_usec < 0) {
+			left.tv_usec += 1000000;
+			left.tv_sec--;
+		}
+		while (left.tv_usec >= 1000000) {
+			left.tv_usec -= 1000000;
+			left.tv_sec++;
+		}
+		if (left.tv_sec < 0) {
+			return answered;
+		}
+		ready = select(max_fd + 1, &readable, NULL, NULL, &left);
+		if (ready == -1 && errno == EINTR) {
+			continue;
+		}
+		if (ready <= 0) {
+			return answered;
+		}
+
+		for (i = 0; i < count; i++) {
+			if (sockets[i] == 0 || !FD_ISSET(sockets[i], &readable)) {
+				continue;
+			}
+			wire = ldns_udp_read_wire(sockets[i], &wire_size,
+					&from, &from_len);
+			if (!wire) {
+				continue;
+			}
+			answer = NULL;
+			if (!ldns_sockaddr_storage_same(&from, to) ||
+			    ldns_wire2pkt(&answer, wire, wire_size) !=
+			    LDNS_STATUS_OK ||
+			    !ldns_pkt_answers_query(answer, queries[i])) {
+				/* not for us, or a spoofed one with a lucky
+				 * id, the real answer may follow */
+				if (answer) {
+					ldns_pkt_free(answer);
+				}
+				LDNS_FREE(wire);
+				continue;
+			}
+			LDNS_FREE(wire);
+			close(sockets[i]);
+			sockets[i] = 0;
+
+			gettimeofday(&now, NULL);
+			ldns_pkt_set_querytime(answer,
+					ldns_ms_between(start, &now));
+			ldns_pkt_set_answerfrom(answer, ns);
+			ldns_pkt_set_timestamp(answer, *start);
+			ldns_pkt_set_size(answer, wire_size);
+			answers[i] = answer;
+			answered++;
+			if (func && !func(i, arg)) {
+				return count + 1;
+			}
+		}
+	}
+}
+
+/* ldns_send_parallel() the slow way */
+static ldns_status
+ldns_send_one_by_one(ldns_pkt **answers, ldns_resolver *r,
+		ldns_pkt * const *queries, size_t count,
+		bool (*func)(size_t, void *), void *arg)
+{
+	ldns_status status;
+	size_t i;
+
+	status = LDNS_STATUS_NETWORK_ERR;
+	for (i = 0; i < count; i++) {
+		if (ldns_send(&answers[i], r, queries[i]) != LDNS_STATUS_OK) {
+			if (answers[i]) {
+				ldns_pkt_free(answers[i]);
+				answers[i] = NULL;
+			}
+		} else if (answers[i]) {
+			status = LDNS_STATUS_OK;
+			if (func && !func(i, arg)) {
+				break;
+			}
+		}
+	}
+	return status;
+}
+
+ldns_status
+ldns_send_parallel(ldns_pkt **answers, ldns_resolver *r,
+		ldns_pkt * const *queries, size_t count,
+		bool (*func)(size_t, void *), void *arg)
+{
+	ldns_buffer **qbs;
+	int *sockets;
+	struct sockaddr_storage *ns;
+	size_t ns_len;
+	struct timeval start;
+	ldns_rdf **ns_array;
+	size_t *rtt;
+	size_t i, pending, answered;
+	uint8_t n, retries;
+	bool all_servers_rtt_inf, done;
+	ldns_status status;
+
+	assert(r != NULL);
+
+	for (i = 0; i < count; i++) {
+		answers[i] = NULL;
+	}
+	/* no gain over tcp, with a connection per query, and tsig answers
+	 * are checked one by one in ldns_send() */
+	for (i = 0; i < count; i++) {
+		if (ldns_resolver_usevc(r) || ldns_pkt_tsig(queries[i])) {
+			return ldns_send_one_by_one(answers, r, queries, count,
+					func, arg);
+		}
+	}
+
+	qbs = LDNS_XMALLOC(ldns_buffer *, count);
+	sockets = LDNS_XMALLOC(int, count);
+	if (!qbs || !sockets) {
+		LDNS_FREE(qbs);
+		LDNS_FREE(sockets);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	status = LDNS_STATUS_OK;
+	for (i = 0; i < count; i++) {
+		sockets[i] = 0;
+		qbs[i] = ldns_buffer_new(LDNS_MIN_BUFLEN);
+		if (!qbs[i]) {
+			status = LDNS_STATUS_MEM_ERR;
+		} else if (ldns_pkt2buffer_wire(qbs[i], queries[i]) !=
+			   LDNS_STATUS_OK) {
+			status = LDNS_STATUS_ERR;
+		}
+	}
+
+	if (ldns_resolver_random(r)) {
+		ldns_resolver_nameservers_randomize(r);
+	}
+	rtt = ldns_resolver_rtt(r);
+	ns_array = ldns_resolver_nameservers(r);
+	all_servers_rtt_inf = true;
+	pending = count;
+	done = false;
+
+	/* like ldns_send_buffer(), but every round sends all the queries
+	 * that are still unanswered */
+	for (n = 0; status == LDNS_STATUS_OK && !done && pending > 0 &&
+			n < ldns_resolver_nameserver_count(r); n++) {
+		if (rtt[n] == LDNS_RESOLV_RTT_INF) {
+			continue;
+		}
+		all_servers_rtt_inf = false;
+		ns = ldns_rdf2native_sockaddr_storage(ns_array[n],
+				ldns_resolver_port(r), &ns_len);
+		if (!ns) {
+			continue;
+		}
+		if ((ns->ss_family == AF_INET &&
+		     ldns_resolver_ip6(r) == LDNS_RESOLV_INET6) ||
+		    (ns->ss_family == AF_INET6 &&
+		     ldns_resolver_ip6(r) == LDNS_RESOLV_INET)) {
+			LDNS_FREE(ns);
+			continue;
+		}
+
+		answered = 0;
+		for (retries = ldns_resolver_retry(r);
+				retries > 0 && !done && pending > 0; retries--) {
+			gettimeofday(&start, NULL);
+			for (i = 0; i < count; i++) {
+				if (answers[i]) {
+					continue;
+				}
+				if (sockets[i] != 0) {
+					close(sockets[i]);
+				}
+				sockets[i] = ldns_udp_bgsend(qbs[i], ns,
+						(socklen_t) ns_len,
+						ldns_resolver_timeout(r));
+			}
+			i = ldns_send_parallel_wait(answers, r, queries, count,
+					sockets, &start, ns_array[n], ns, func, arg);
+			if (i > count) {
+				done = true;
+			} else {
+				answered += i;
+				pending -= i;
+			}
+		}
+		LDNS_FREE(ns);
+
+		if (!done && answered == 0) {
+			ldns_resolver_set_nameserver_rtt(r, n,
+					LDNS_RESOLV_RTT_INF);
+			if (ldns_resolver_fail(r)) {
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (sockets[i] != 0) {
+			close(sockets[i]);
+		}
+		if (qbs[i]) {
+			ldns_buffer_free(qbs[i]);
+		}
+	}
+	LDNS_FREE(sockets);
+	LDNS_FREE(qbs);
+
+	if (status != LDNS_STATUS_OK) {
+		for (i = 0; i < count; i++) {
+			if (answers[i]) {
+				ldns_pkt_free(answers[i]);
+				answers[i] = NULL;
+			}
+		}
+		return status;
+	}
+	if (all_servers_rtt_inf) {
+		return LDNS_STATUS_RES_NO_NS;
+	}
+	if (done || pending < count) {
+		return LDNS_STATUS_OK;
+	}
+	return LDNS_STATUS_NETWORK_ERR;
+}
+
 ldns_status
 ldns_udp_send(uint8_t **result, ldns_buffer *qbin, const struct sockaddr_storage *to, 
 		socklen_t tolen, struct timeval timeout, size_t *answer_size)
@@ -366,6 +697,7 @@ ldns_udp_read_wire(int sockfd, size_t *size, struct sockaddr_storage *from,
 		return NULL;
 	}
 
+	flen = (socklen_t) sizeof(struct sockaddr_storage);
 	wire_size = recvfrom(sockfd, wire, LDNS_MAX_PACKETLEN, 0, 
 			(struct sockaddr*) from, &flen);
 
@@ -548,26 +880,17 @@ ldns_sockaddr_storage2rdf(struct sockaddr_storage *sock, uint16_t *port)
         return addr;
 }
 
-/* code from resolver.c */
-ldns_status
-ldns_axfr_start(ldns_resolver *resolver, ldns_rdf *domain, ldns_rr_class class) 
+/* connects to the first nameserver of the resolver and sends query over
+ * it, the query is freed */
+static ldns_status
+ldns_xfr_start(ldns_resolver *resolver, ldns_pkt *query)
 {
-        ldns_pkt *query;
         ldns_buffer *query_wire;
 
         struct sockaddr_storage *ns;
         size_t ns_len = 0;
         ldns_status status;
 
-        if (!resolver || ldns_resolver_nameserver_count(resolver) < 1) {
-                return LDNS_STATUS_ERR;
-        }
-
-        query = ldns_pkt_query_new(ldns_rdf_clone(domain), LDNS_RR_TYPE_AXFR, class, 0);
-
-        if (!query) {
-                return LDNS_STATUS_ADDRESS_ERR;
-        }
         /* For AXFR, we have to make the connection ourselves */
         ns = ldns_rdf2native_sockaddr_storage(resolver->_nameservers[0],
                         ldns_resolver_port(resolver), &ns_len);
@@ -587,6 +910,8 @@ ldns_axfr_start(ldns_resolver *resolver, ldns_rdf *domain, ldns_rr_class class)
 		                            ldns_resolver_tsig_keydata(resolver),
 		                            300, ldns_resolver_tsig_algorithm(resolver), NULL);
 		if (status != LDNS_STATUS_OK) {
+			ldns_pkt_free(query);
+			LDNS_FREE(ns);
 			return LDNS_STATUS_CRYPTO_TSIG_ERR;
 		}
 	}
@@ -598,6 +923,7 @@ ldns_axfr_start(ldns_resolver *resolver, ldns_rdf *domain, ldns_rr_class class)
         status = ldns_pkt2buffer_wire(query_wire, query);
         if (status != LDNS_STATUS_OK) {
                 ldns_pkt_free(query);
+                ldns_buffer_free(query_wire);
                 LDNS_FREE(ns);
                 return status;
         }
@@ -620,3 +946,170 @@ ldns_axfr_start(ldns_resolver *resolver, ldns_rdf *domain, ldns_rr_class class)
         resolver->_axfr_soa_count = 0;
         return LDNS_STATUS_OK;
 }
+
+/* code from resolver.c */
+ldns_status
+ldns_axfr_start(ldns_resolver *resolver, ldns_rdf *domain, ldns_rr_class class) 
+{
+        ldns_pkt *query;
+
+        if (!resolver || ldns_resolver_nameserver_count(resolver) < 1) {
+                return LDNS_STATUS_ERR;
+        }
+
+        query = ldns_pkt_query_new(ldns_rdf_clone(domain), LDNS_RR_TYPE_AXFR, class, 0);
+
+        if (!query) {
+                return LDNS_STATUS_ADDRESS_ERR;
+        }
+        return ldns_xfr_start(resolver, query);
+}
+
+ldns_status
+ldns_ixfr_start(ldns_resolver *resolver, ldns_rdf *domain, ldns_rr_class class,
+		const ldns_rr *soa)
+{
+        ldns_pkt *query;
+        ldns_rr *soa_copy;
+
+        if (!resolver || ldns_resolver_nameserver_count(resolver) < 1 || 
+	    !soa) {
+                return LDNS_STATUS_ERR;
+        }
+
+        query = ldns_pkt_query_new(ldns_rdf_clone(domain), LDNS_RR_TYPE_IXFR, class, 0);
+        if (!query) {
+                return LDNS_STATUS_ADDRESS_ERR;
+        }
+	/* the version we have goes in the authority section */
+        soa_copy = ldns_rr_clone(soa);
+        if (!soa_copy || 
+	    !ldns_pkt_push_rr(query, LDNS_SECTION_AUTHORITY, soa_copy)) {
+                ldns_rr_free(soa_copy);
+                ldns_pkt_free(query);
+                return LDNS_STATUS_MEM_ERR;
+        }
+        return ldns_xfr_start(resolver, query);
+}
+
+/* receives exactly size bytes */
+static bool
+ldns_tcp_recv_all(int sockfd, uint8_t *data, size_t size)
+{
+	ssize_t bytes;
+
+	while (size > 0) {
+		bytes = recv(sockfd, data, size, 0);
+		if (bytes <= 0) {
+			return false;
+		}
+		data += bytes;
+		size -= (size_t) bytes;
+	}
+	return true;
+}
+
+/* reads the next tcp message into buffer, the same buffer is used for
+ * every message so nothing is allocated once it has grown */
+static ldns_status
+ldns_tcp_read_buffer(int sockfd, ldns_buffer *buffer)
+{
+	uint8_t size_wire[2];
+	size_t size;
+
+	if (!ldns_tcp_recv_all(sockfd, size_wire, 2)) {
+		return LDNS_STATUS_NETWORK_ERR;
+	}
+	size = ldns_read_uint16(size_wire);
+	ldns_buffer_clear(buffer);
+	if (!ldns_buffer_reserve(buffer, size)) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	if (!ldns_tcp_recv_all(sockfd, ldns_buffer_begin(buffer), size)) {
+		return LDNS_STATUS_NETWORK_ERR;
+	}
+	ldns_buffer_set_limit(buffer, size);
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_axfr_stream(ldns_resolver *resolver, ldns_rdf *domain,
+		ldns_rr_class class, ldns_status (*func)(ldns_rr *, void *),
+		void *arg)
+{
+	ldns_buffer *message;
+	ldns_rr *rr;
+	uint8_t *wire;
+	size_t size, pos;
+	uint16_t i, count;
+	int soa_count;
+	ldns_status status;
+
+	if (!func) {
+		return LDNS_STATUS_NULL;
+	}
+	status = ldns_axfr_start(resolver, domain, class);
+	if (status != LDNS_STATUS_OK) {
+		return status;
+	}
+	message = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	if (!message) {
+		status = LDNS_STATUS_MEM_ERR;
+	}
+
+	soa_count = 0;
+	while (status == LDNS_STATUS_OK && soa_count < 2) {
+		status = ldns_tcp_read_buffer(resolver->_socket, message);
+		if (status != LDNS_STATUS_OK) {
+			break;
+		}
+		wire = ldns_buffer_begin(message);
+		size = ldns_buffer_limit(message);
+		if (size < LDNS_HEADER_SIZE) {
+			status = LDNS_STATUS_WIRE_INCOMPLETE_HEADER;
+			break;
+		}
+		if (LDNS_RCODE_WIRE(wire) != LDNS_RCODE_NOERROR) {
+			status = LDNS_STATUS_XFR_RCODE_ERR;
+			break;
+		}
+
+		/* the rrs are read straight from the message, there is no
+		 * packet in between */
+		pos = LDNS_HEADER_SIZE;
+		count = LDNS_QDCOUNT(wire);
+		for (i = 0; status == LDNS_STATUS_OK && i < count; i++) {
+			status = ldns_wire2rr(&rr, wire, size, &pos,
+					LDNS_SECTION_QUESTION);
+			if (status == LDNS_STATUS_OK) {
+				ldns_rr_free(rr);
+			}
+		}
+		count = LDNS_ANCOUNT(wire);
+		for (i = 0; status == LDNS_STATUS_OK && i < count; i++) {
+			status = ldns_wire2rr(&rr, wire, size, &pos,
+					LDNS_SECTION_ANSWER);
+			if (status != LDNS_STATUS_OK) {
+				break;
+			}
+			if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA) {
+				soa_count++;
+			} else if (soa_count == 0) {
+				/* a transfer starts with the soa */
+				status = LDNS_STATUS_XFR_FORMAT_ERR;
+			}
+			if (soa_count == 2 || status != LDNS_STATUS_OK) {
+				ldns_rr_free(rr);
+				break;
+			}
+			status = func(rr, arg);
+		}
+	}
+
+	if (message) {
+		ldns_buffer_free(message);
+	}
+	close(resolver->_socket);
+	resolver->_socket = 0;
+	return status;
+}
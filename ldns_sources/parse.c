@@ -155,6 +155,195 @@ tokenread:
 	return (ssize_t)i;
 }
 
+/* octets that always need a look from the tokeniser in ldns_mget_token_l,
+ * whatever the delimiters are */
+#define LDNS_MTOKEN_SPECIAL	"()\";\n"
+
+/* marks the octets a run of plain characters stops at: the specials, the
+ * delimiters and NUL */
+static void
+ldns_mtoken_stops(uint8_t *stop, const char *del)
+{
+	const char *d;
+
+	memset(stop, 0, 256);
+	stop[0] = 1;
+	for (d = LDNS_MTOKEN_SPECIAL; *d; d++) {
+		stop[(uint8_t) *d] = 1;
+	}
+	for (d = del; *d; d++) {
+		stop[(uint8_t) *d] = 1;
+	}
+}
+
+/* returns the number of leading octets in s that are not stops. The runs
+ * in zone data are short (a quote every few characters), a table lookup
+ * per octet beats comparing whole words against every stop */
+static size_t
+ldns_mtoken_span(const uint8_t *s, size_t len, const uint8_t *stop)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (stop[s[i]]) {
+			return i;
+		}
+	}
+	return len;
+}
+
+ssize_t
+ldns_mget_token_l(ldns_buffer *b, char *token, const char *delim, size_t limit, int *line_nr)
+{	
+	int c;
+	int p; /* 0 -> no parenthese seen, >0 nr of ( seen */
+	int com, quoted;
+	char *t;
+	size_t i, span;
+	const char *d;
+	const char *del;
+	const uint8_t *data;
+	const uint8_t *nl;
+	size_t pos, end;
+	uint8_t stop[256];
+
+	/* standard delimeters */
+	if (!delim) {
+		/* from isspace(3) */
+		del = LDNS_PARSE_NORMAL;
+	} else {
+		del = delim;
+	}
+	ldns_mtoken_stops(stop, del);
+
+	p = 0;
+	i = 0;
+	com = 0;
+	quoted = 0;
+	t = token;
+	if (del[0] == '"') {
+		quoted = 1;
+	}
+	data = ldns_buffer_begin(b);
+	pos = ldns_buffer_position(b);
+	end = ldns_buffer_limit(b);
+	while (pos < end) {
+		/* runs of plain octets go to the token in one copy, the
+		 * rest is the same state machine as ldns_fget_token_l */
+		if (com == 0 && p >= 0) {
+			span = ldns_mtoken_span(data + pos, end - pos, stop);
+			if (limit > 0 && span >= limit - i) {
+				memcpy(t, data + pos, limit - i);
+				t += limit - i;
+				ldns_buffer_set_position(b, pos + (limit - i));
+				*t = '\0';
+				return -1;
+			}
+			memcpy(t, data + pos, span);
+			t += span;
+			i += span;
+			pos += span;
+			if (pos == end) {
+				break;
+			}
+		}
+		c = (int) data[pos++];
+
+		if (c == '(') {
+			/* this only counts for non-comments */
+			if (com == 0) {
+				p++;
+			}
+			continue;
+		}
+
+		if (c == ')') {
+			/* this only counts for non-comments */
+			if (com == 0) {
+				p--;
+			}
+			continue;
+		}
+
+		if (p < 0) {
+			/* more ) then ( - close off the string */
+			ldns_buffer_set_position(b, pos);
+			*t = '\0';
+			return 0;
+		}
+
+		/* do something with comments ; */
+		if (c == ';' && quoted == 0) {
+			com = 1;
+		}
+		if (c == '\"' && com == 0) {
+			quoted = 1 - quoted;
+		}
+
+		if (c == '\n' && com != 0) {
+			/* comments */
+			com = 0;
+			*t = ' ';
+			if (line_nr) {
+				*line_nr = *line_nr + 1;
+			}
+			if (p == 0 && i > 0) {
+				goto tokenread;
+			} else {
+				continue;
+			}
+		}
+
+		if (com == 1) {
+			/* skip the rest of the comment in one go */
+			*t = ' ';
+			nl = memchr(data + pos, '\n', end - pos);
+			pos = nl ? (size_t) (nl - data) : end;
+			continue;
+		}
+
+		if (c == '\n' && p != 0 && t > token) {
+			/* in parentheses */
+			if (line_nr) {
+				*line_nr = *line_nr + 1;
+			}
+			continue;
+		}
+
+		/* check if we hit the delim */
+		for (d = del; *d; d++) {
+			if (c == *d && i > 0) {
+				if (c == '\n' && line_nr) {
+					*line_nr = *line_nr + 1;
+				}
+				goto tokenread;
+			}
+		}
+		if (c != '\0' && c != '\n') {
+			*t++ = c;
+			i++;
+		}
+		if (limit > 0 && i >= limit) {
+			ldns_buffer_set_position(b, pos);
+			*t = '\0';
+			return -1;
+		}
+	}
+	ldns_buffer_set_position(b, pos);
+	*t = '\0';
+	return (ssize_t)i;
+
+tokenread:
+	ldns_buffer_set_position(b, pos);
+	ldns_mskipcs_l(b, del, line_nr);
+	*t = '\0';
+	if (p != 0) {
+		return -1;
+	}
+
+	return (ssize_t)i;
+}
+
 ssize_t
 ldns_fget_keyword_data(FILE *f, const char *keyword, const char *k_del, char *data,
                const char *d_del, size_t data_limit)
@@ -376,6 +565,32 @@ ldns_fskipcs_l(FILE *fp, const char *s, int *line_nr)
 	}
 }
 
+void
+ldns_mskipcs_l(ldns_buffer *buffer, const char *s, int *line_nr)
+{
+	bool found;
+	uint8_t c;
+	const char *d;
+
+	while (ldns_buffer_position(buffer) < ldns_buffer_limit(buffer)) {
+		c = ldns_buffer_read_u8_at(buffer, ldns_buffer_position(buffer));
+		/* counted before the check, like ldns_fskipcs_l does */
+		if (line_nr && c == '\n') {
+			*line_nr = *line_nr + 1;
+		}
+		found = false;
+		for (d = s; *d; d++) {
+			if (*d == (char) c) {
+				found = true;
+			}
+		}
+		if (!found) {
+			return;
+		}
+		ldns_buffer_skip(buffer, 1);
+	}
+}
+
 ssize_t
 ldns_bget_keyword_data(ldns_buffer *b, const char *keyword, const char *k_del, char
 *data, const char *d_del, size_t data_limit)
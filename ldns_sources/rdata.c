@@ -47,6 +47,7 @@ ldns_rdf_set_size(ldns_rdf *rd, size_t size)
 {
 	assert(rd != NULL);
 	rd->_size = size;
+	rd->_label_count = -1;
 }
 
 void
@@ -54,6 +55,7 @@ ldns_rdf_set_type(ldns_rdf *rd, ldns_rdf_type type)
 {
 	assert(rd != NULL);
 	rd->_type = type;
+	rd->_label_count = -1;
 }
 
 void
@@ -62,6 +64,7 @@ ldns_rdf_set_data(ldns_rdf *rd, void *data)
 	/* only copy the pointer */
 	assert(rd != NULL);
 	rd->_data = data;
+	rd->_label_count = -1;
 }
 
 /* for types that allow it, return
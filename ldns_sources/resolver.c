@@ -14,6 +14,36 @@
 
 #include "ldns.h"
 #include <strings.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* negative answers remembered for searches, and for how long at most, in
+ * seconds */
+#define LDNS_RESOLV_NEGATIVE_SLOTS   256
+#define LDNS_RESOLV_NEGATIVE_MAX_TTL 900
+
+/* the negative answers of searches are kept by every resolver for its
+ * own nameservers, in a table of LDNS_RESOLV_NEGATIVE_SLOTS where an
+ * entry is overwritten by any later one with the same slot. The lock
+ * guards the tables of all resolvers, a resolver may be searched with
+ * from several threads */
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t ldns_negative_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* drops the negative answers, they were of other nameservers */
+static void
+ldns_resolver_forget_negatives(ldns_resolver *r)
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ldns_negative_lock);
+#endif
+	LDNS_FREE(r->_negative);
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&ldns_negative_lock);
+#endif
+}
 
 /* Access function for reading 
  * and setting the different Resolver 
@@ -68,6 +98,12 @@ ldns_resolver_dnsrch(const ldns_resolver *r)
 	return r->_dnsrch;
 }
 
+bool
+ldns_resolver_search_parallel(const ldns_resolver *r)
+{
+	return r->_search_parallel;
+}
+
 bool
 ldns_resolver_fail(const ldns_resolver *r)
 {
@@ -254,6 +290,7 @@ ldns_resolver_pop_nameserver(ldns_resolver *r)
 	ldns_resolver_set_rtt(r, rtt);
 	/* decr the count */
 	ldns_resolver_dec_nameserver_count(r);
+	ldns_resolver_forget_negatives(r);
 	return pop;
 }
 
@@ -288,6 +325,7 @@ ldns_resolver_push_nameserver(ldns_resolver *r, ldns_rdf *n)
 	rtt[ns_count] = LDNS_RESOLV_RTT_MIN;
 	ldns_resolver_incr_nameserver_count(r);
 	ldns_resolver_set_rtt(r, rtt);
+	ldns_resolver_forget_negatives(r);
 	return LDNS_STATUS_OK;
 }
 
@@ -405,6 +443,12 @@ ldns_resolver_set_fail(ldns_resolver *r, bool f)
 	r->_fail =f;
 }
 
+void
+ldns_resolver_set_search_parallel(ldns_resolver *r, bool b)
+{
+	r->_search_parallel = b;
+}
+
 void
 ldns_resolver_set_searchlist_count(ldns_resolver *r, size_t c)
 {
@@ -576,6 +620,7 @@ ldns_resolver_new(void)
 	ldns_resolver_set_retry(r, 3);
 	ldns_resolver_set_retrans(r, 2);
 	ldns_resolver_set_fail(r, false);
+	ldns_resolver_set_search_parallel(r, false);
 	ldns_resolver_set_edns_udp_size(r, 0);
 	ldns_resolver_set_dnssec(r, false);
 	ldns_resolver_set_dnssec_cd(r, false);
@@ -600,6 +645,7 @@ ldns_resolver_new(void)
 	r->_tsig_keyname = NULL;
 	r->_tsig_keydata = NULL;
 	r->_tsig_algorithm = NULL;
+	r->_negative = NULL;
 	return r;
 }
 
@@ -851,39 +897,325 @@ ldns_resolver_deep_free(ldns_resolver *res)
 		if (res->_dnssec_anchors) {
 			ldns_rr_list_deep_free(res->_dnssec_anchors);
 		}
+		LDNS_FREE(res->_negative);
 		LDNS_FREE(res);
 	}
 }
 
+/* the slot of name, type and class, name lowercased into key. NULL when
+ * name is too long or r has no table */
+static ldns_resolver_negative *
+ldns_negative_slot(const ldns_resolver *r, const ldns_rdf *name,
+		ldns_rr_type type, ldns_rr_class class, uint8_t *key)
+{
+	uint32_t h;
+	size_t i;
+
+	if (!r->_negative || ldns_rdf_size(name) > LDNS_MAX_DOMAINLEN) {
+		return NULL;
+	}
+	ldns_dname_octets_tolower(key, ldns_rdf_data(name), ldns_rdf_size(name));
+	h = 2166136261U;
+	for (i = 0; i < ldns_rdf_size(name); i++) {
+		h = (h ^ key[i]) * 16777619U;
+	}
+	h = (h ^ type) * 16777619U;
+	h = (h ^ class) * 16777619U;
+	return &r->_negative[h % LDNS_RESOLV_NEGATIVE_SLOTS];
+}
+
+/* whether name is known not to have records of type, the rcode it was
+ * answered with goes in rcode */
+static bool
+ldns_negative_cached(const ldns_resolver *r, const ldns_rdf *name,
+		ldns_rr_type type, ldns_rr_class class, uint8_t *rcode)
+{
+	uint8_t key[LDNS_MAX_DOMAINLEN];
+	ldns_resolver_negative *entry;
+	bool cached;
+
+	cached = false;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ldns_negative_lock);
+#endif
+	entry = ldns_negative_slot(r, name, type, class, key);
+	if (entry && entry->_expires > time(NULL) && entry->_type == type &&
+	    entry->_class == class && 
+	    entry->_name_size == ldns_rdf_size(name) &&
+	    memcmp(entry->_name, key, entry->_name_size) == 0) {
+		*rcode = entry->_rcode;
+		cached = true;
+	}
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&ldns_negative_lock);
+#endif
+	return cached;
+}
+
+/* whether answer has the records that were asked for */
+static bool
+ldns_search_positive(const ldns_pkt *answer)
+{
+	return ldns_pkt_get_rcode(answer) == LDNS_RCODE_NOERROR &&
+		ldns_pkt_ancount(answer) > 0;
+}
+
+/* remembers answer when it says name has no records of type, for as
+ * long as the soa in it allows (RFC 2308) */
+static void
+ldns_negative_store(ldns_resolver *r, const ldns_pkt *answer,
+		const ldns_rdf *name, ldns_rr_type type, ldns_rr_class class)
+{
+	uint8_t key[LDNS_MAX_DOMAINLEN];
+	ldns_resolver_negative *entry;
+	ldns_rr_list *authority;
+	ldns_rr *soa;
+	uint32_t ttl;
+	size_t i;
+
+	if (ldns_search_positive(answer) ||
+	    (ldns_pkt_get_rcode(answer) != LDNS_RCODE_NOERROR &&
+	     ldns_pkt_get_rcode(answer) != LDNS_RCODE_NXDOMAIN)) {
+		return;
+	}
+	soa = NULL;
+	authority = ldns_pkt_authority(answer);
+	for (i = 0; i < ldns_rr_list_rr_count(authority); i++) {
+		if (ldns_rr_get_type(ldns_rr_list_rr(authority, i)) ==
+		    LDNS_RR_TYPE_SOA) {
+			soa = ldns_rr_list_rr(authority, i);
+			break;
+		}
+	}
+	if (!soa || ldns_rr_rd_count(soa) < 7) {
+		/* no telling how long it holds */
+		return;
+	}
+	ttl = ldns_rr_ttl(soa);
+	if (ldns_rdf2native_int32(ldns_rr_rdf(soa, 6)) < ttl) {
+		ttl = ldns_rdf2native_int32(ldns_rr_rdf(soa, 6));
+	}
+	if (ttl > LDNS_RESOLV_NEGATIVE_MAX_TTL) {
+		ttl = LDNS_RESOLV_NEGATIVE_MAX_TTL;
+	}
+	if (ttl == 0) {
+		return;
+	}
+
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ldns_negative_lock);
+#endif
+	if (!r->_negative) {
+		r->_negative = LDNS_XMALLOC(ldns_resolver_negative,
+				LDNS_RESOLV_NEGATIVE_SLOTS);
+		if (r->_negative) {
+			memset(r->_negative, 0, sizeof(ldns_resolver_negative) *
+					LDNS_RESOLV_NEGATIVE_SLOTS);
+		}
+	}
+	entry = ldns_negative_slot(r, name, type, class, key);
+	if (entry) {
+		memcpy(entry->_name, key, ldns_rdf_size(name));
+		entry->_name_size = ldns_rdf_size(name);
+		entry->_type = type;
+		entry->_class = class;
+		entry->_rcode = ldns_pkt_get_rcode(answer);
+		entry->_expires = time(NULL) + (time_t) ttl;
+	}
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&ldns_negative_lock);
+#endif
+}
+
+/* the state of a parallel search */
+struct ldns_struct_search
+{
+	ldns_pkt **_answers;
+	size_t _count;
+};
+typedef struct ldns_struct_search ldns_search;
+
+/* the search is over when a name has the records and all the names
+ * before it are known not to */
+static bool
+ldns_search_answered(size_t i, void *arg)
+{
+	ldns_search *search = (ldns_search *) arg;
+	size_t j;
+
+	(void) i;
+
+	for (j = 0; j < search->_count; j++) {
+		if (!search->_answers[j]) {
+			/* a better one may still come */
+			return true;
+		}
+		if (ldns_search_positive(search->_answers[j])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* picks the answer for the names of a search from answers, the others
+ * are freed */
+static ldns_pkt *
+ldns_search_pick(ldns_pkt **answers, size_t count)
+{
+	ldns_pkt *p;
+	size_t i;
+
+	p = NULL;
+	for (i = 0; i < count; i++) {
+		if (answers[i] && ldns_search_positive(answers[i])) {
+			p = answers[i];
+			break;
+		}
+	}
+	for (i = 0; !p && i < count; i++) {
+		p = answers[i];
+	}
+	for (i = 0; i < count; i++) {
+		if (answers[i] && answers[i] != p) {
+			ldns_pkt_free(answers[i]);
+		}
+	}
+	return p;
+}
+
+/* the answer of a name that is known to be a miss, as the nameserver
+ * gave it minus the soa. Takes name */
+static ldns_pkt *
+ldns_search_missed(ldns_rdf *name, ldns_rr_type type, ldns_rr_class class,
+		uint16_t flags, uint8_t rcode)
+{
+	ldns_pkt *p;
+
+	p = ldns_pkt_query_new(name, type, class, flags);
+	if (!p) {
+		ldns_rdf_deep_free(name);
+		return NULL;
+	}
+	ldns_pkt_set_random_id(p);
+	ldns_pkt_set_qr(p, true);
+	ldns_pkt_set_ra(p, true);
+	ldns_pkt_set_rcode(p, rcode);
+	return p;
+}
+
 ldns_pkt *
 ldns_resolver_search(const ldns_resolver *r,const  ldns_rdf *name, ldns_rr_type type, 
                 ldns_rr_class class, uint16_t flags)
 {
 
-	char *str_dname;
-	ldns_rdf *new_name;
+	ldns_rdf **names;
+	ldns_rr_type *types;
+	ldns_pkt **answers;
+	ldns_search search;
 	ldns_rdf **search_list;
-	size_t i;
+	ldns_rdf *missed;
+	uint8_t rcode, missed_rcode;
+	size_t i, count;
 	ldns_pkt *p;
 
-	str_dname = ldns_rdf2str(name);
-
-	if (ldns_dname_str_absolute(str_dname)) {
+	/* a dname always ends in the root label, so like resolv.conf's
+	 * ndots:1 a name of a single label is taken as the relative one */
+	if (ldns_dname_label_count(name) != 1 ||
+	    ldns_resolver_searchlist_count(r) == 0) {
 		/* query as-is */
 		return ldns_resolver_query(r, name, type, class, flags);
+	}
+	if (0 == type) {
+		type = LDNS_RR_TYPE_A;
+	}
+	if (0 == class) {
+		class = LDNS_RR_CLASS_IN;
+	}
+
+	search_list = ldns_resolver_searchlist(r);
+	count = ldns_resolver_searchlist_count(r);
+	names = LDNS_XMALLOC(ldns_rdf *, count + 1);
+	types = LDNS_XMALLOC(ldns_rr_type, count + 1);
+	answers = LDNS_XMALLOC(ldns_pkt *, count + 1);
+	if (!names || !types || !answers) {
+		LDNS_FREE(names);
+		LDNS_FREE(types);
+		LDNS_FREE(answers);
+		return NULL;
+	}
+	/* the names that are not known to be misses, in the order of the
+	 * list */
+	count = 0;
+	missed = NULL;
+	missed_rcode = LDNS_RCODE_NXDOMAIN;
+	for (i = 0; i <= ldns_resolver_searchlist_count(r); i++) {
+		if (i < ldns_resolver_searchlist_count(r)) {
+			names[count] = ldns_dname_cat_clone(name, search_list[i]);
+		} else {
+			/* the name itself comes last */
+			names[count] = ldns_rdf_clone(name);
+		}
+		if (!names[count]) {
+			continue;
+		}
+		if (ldns_negative_cached(r, names[count], type, class, &rcode)) {
+			if (!missed) {
+				missed = names[count];
+				missed_rcode = rcode;
+			} else {
+				ldns_rdf_deep_free(names[count]);
+			}
+			continue;
+		}
+		types[count] = type;
+		answers[count] = NULL;
+		count++;
+	}
+
+	p = NULL;
+	if (count > 0 && ldns_resolver_search_parallel(r)) {
+		search._answers = answers;
+		search._count = count;
+		if (ldns_resolver_query_parallel(answers, r, names, types, count,
+				class, flags, ldns_search_answered, &search) !=
+		    LDNS_STATUS_OK) {
+			for (i = 0; i < count; i++) {
+				answers[i] = NULL;
+			}
+		}
 	} else {
-		search_list = ldns_resolver_searchlist(r);
-		for (i = 0; i < ldns_resolver_searchlist_count(r); i++) {
-			new_name = ldns_dname_cat_clone(name, search_list[i]);
-
-			p = ldns_resolver_query(r, new_name, type, class, flags);
-			ldns_rdf_free(new_name);
-			if (p) {
-				return p;
+		for (i = 0; i < count; i++) {
+			answers[i] = ldns_resolver_query(r, names[i], type, class, 
+					flags);
+			if (answers[i] && ldns_search_positive(answers[i])) {
+				break;
 			}
 		}
 	}
-	return NULL;
+	for (i = 0; i < count; i++) {
+		if (answers[i]) {
+			ldns_negative_store((ldns_resolver *) r, answers[i],
+					names[i], type, class);
+		}
+	}
+	p = ldns_search_pick(answers, count);
+	if (!p && count == 0 && missed) {
+		/* every name is a known miss, answer as the first of them
+		 * was answered */
+		p = ldns_search_missed(missed, type, class, flags, missed_rcode);
+		missed = NULL;
+	}
+	if (missed) {
+		ldns_rdf_deep_free(missed);
+	}
+
+	for (i = 0; i < count; i++) {
+		ldns_rdf_deep_free(names[i]);
+	}
+	LDNS_FREE(names);
+	LDNS_FREE(types);
+	LDNS_FREE(answers);
+	return p;
 }
 
 ldns_pkt *
@@ -1000,6 +1332,46 @@ ldns_resolver_prepare_query_pkt(ldns_pkt **query_pkt, ldns_resolver *r,
 }
 
 
+/* the last touches to a query before it is sent, the id can not change
+ * after this */
+static ldns_status
+ldns_resolver_finish_query_pkt(ldns_pkt *query_pkt, ldns_resolver *r,
+		ldns_rr_type type)
+{
+#ifdef HAVE_SSL
+	ldns_status status;
+#else
+	(void) r;
+#endif
+
+	/* if tsig values are set, tsign it */
+	/* TODO: make last 3 arguments optional too? maybe make complete
+	         rr instead of seperate values in resolver (and packet)
+	  Jelte
+	  should this go in pkt_prepare?
+	*/
+#ifdef HAVE_SSL
+	if (ldns_resolver_tsig_keyname(r) && ldns_resolver_tsig_keydata(r)) {
+		status = ldns_pkt_tsig_sign(query_pkt,
+		                            ldns_resolver_tsig_keyname(r),
+		                            ldns_resolver_tsig_keydata(r),
+		                            300, ldns_resolver_tsig_algorithm(r), NULL);
+		if (status != LDNS_STATUS_OK) {
+			return LDNS_STATUS_CRYPTO_TSIG_ERR;
+		}
+	}
+#endif /* HAVE_SSL */
+	/* TODO: XXXXXXXXXX Hack to ensure naptrs are gotten through EDNS0 */
+	if (type == LDNS_RR_TYPE_NAPTR) {
+		ldns_pkt_set_edns_udp_size(query_pkt, 4096);
+//		ldns_pkt_set_edns_extended_rcode(query_pkt, 0);
+		ldns_pkt_set_edns_version(query_pkt, 0);
+//		ldns_pkt_set_edns_z(query_pkt, 0);
+//		ldns_pkt_set_edns_data(query_pkt, NULL);
+	}
+	return LDNS_STATUS_OK;
+}
+
 ldns_status
 ldns_resolver_send(ldns_pkt **answer, ldns_resolver *r, const ldns_rdf *name, 
 		ldns_rr_type type, ldns_rr_class class, uint16_t flags)
@@ -1038,31 +1410,10 @@ ldns_resolver_send(ldns_pkt **answer, ldns_resolver *r, const ldns_rdf *name,
 	if (status != LDNS_STATUS_OK) {
 		return status;
 	}
-
-	/* if tsig values are set, tsign it */
-	/* TODO: make last 3 arguments optional too? maybe make complete
-	         rr instead of seperate values in resolver (and packet)
-	  Jelte
-	  should this go in pkt_prepare?
-	*/
-#ifdef HAVE_SSL
-	if (ldns_resolver_tsig_keyname(r) && ldns_resolver_tsig_keydata(r)) {
-		status = ldns_pkt_tsig_sign(query_pkt,
-		                            ldns_resolver_tsig_keyname(r),
-		                            ldns_resolver_tsig_keydata(r),
-		                            300, ldns_resolver_tsig_algorithm(r), NULL);
-		if (status != LDNS_STATUS_OK) {
-			return LDNS_STATUS_CRYPTO_TSIG_ERR;
-		}
-	}
-#endif /* HAVE_SSL */
-	/* TODO: XXXXXXXXXX Hack to ensure naptrs are gotten through EDNS0 */
-	if (type == LDNS_RR_TYPE_NAPTR) {
-		ldns_pkt_set_edns_udp_size(query_pkt, 4096);
-//		ldns_pkt_set_edns_extended_rcode(query_pkt, 0);
-		ldns_pkt_set_edns_version(query_pkt, 0);
-//		ldns_pkt_set_edns_z(query_pkt, 0);
-//		ldns_pkt_set_edns_data(query_pkt, NULL);
+	status = ldns_resolver_finish_query_pkt(query_pkt, r, type);
+	if (status != LDNS_STATUS_OK) {
+		ldns_pkt_free(query_pkt);
+		return status;
 	}
 	
 	status = ldns_resolver_send_pkt(&answer_pkt, r, query_pkt);
@@ -1075,6 +1426,88 @@ ldns_resolver_send(ldns_pkt **answer, ldns_resolver *r, const ldns_rdf *name,
 	return status;
 }
 
+ldns_status
+ldns_resolver_query_parallel(ldns_pkt **answers, const ldns_resolver *r,
+		ldns_rdf * const *names, const ldns_rr_type *types, size_t count,
+		ldns_rr_class class, uint16_t flags,
+		bool (*func)(size_t, void *), void *arg)
+{
+	ldns_pkt **queries;
+	ldns_rdf *name;
+	ldns_rr_type type;
+	ldns_status status;
+	size_t i, j;
+	bool unique;
+
+	if (0 == ldns_resolver_nameserver_count(r)) {
+		return LDNS_STATUS_RES_NO_NS;
+	}
+	if (0 == class) {
+		class = LDNS_RR_CLASS_IN;
+	}
+	queries = LDNS_XMALLOC(ldns_pkt *, count);
+	if (!queries) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+
+	status = LDNS_STATUS_OK;
+	for (i = 0; i < count; i++) {
+		queries[i] = NULL;
+		answers[i] = NULL;
+	}
+	for (i = 0; status == LDNS_STATUS_OK && i < count; i++) {
+		if (ldns_rdf_get_type(names[i]) != LDNS_RDF_TYPE_DNAME) {
+			status = LDNS_STATUS_RES_QUERY;
+			break;
+		}
+		/* what ldns_resolver_query() would ask */
+		if (ldns_resolver_defnames(r) && ldns_resolver_domain(r)) {
+			name = ldns_dname_cat_clone(names[i], 
+					ldns_resolver_domain(r));
+		} else {
+			name = ldns_rdf_clone(names[i]);
+		}
+		if (!name) {
+			status = LDNS_STATUS_MEM_ERR;
+			break;
+		}
+		type = types[i] ? types[i] : LDNS_RR_TYPE_A;
+		status = ldns_resolver_prepare_query_pkt(&queries[i], 
+				(ldns_resolver *)r, name, type, class, flags);
+		ldns_rdf_deep_free(name);
+		if (status != LDNS_STATUS_OK) {
+			queries[i] = NULL;
+			break;
+		}
+		/* the answers are told apart by their ids */
+		do {
+			unique = true;
+			for (j = 0; j < i; j++) {
+				if (ldns_pkt_id(queries[j]) == 
+				    ldns_pkt_id(queries[i])) {
+					ldns_pkt_set_random_id(queries[i]);
+					unique = false;
+					break;
+				}
+			}
+		} while (!unique);
+		status = ldns_resolver_finish_query_pkt(queries[i], 
+				(ldns_resolver *)r, type);
+	}
+
+	if (status == LDNS_STATUS_OK) {
+		status = ldns_send_parallel(answers, (ldns_resolver *)r, queries,
+				count, func, arg);
+	}
+	for (i = 0; i < count; i++) {
+		if (queries[i]) {
+			ldns_pkt_free(queries[i]);
+		}
+	}
+	LDNS_FREE(queries);
+	return status;
+}
+
 ldns_rr *
 ldns_axfr_next(ldns_resolver *resolver)
 {
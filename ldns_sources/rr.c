@@ -16,9 +16,15 @@
 
 #include <errno.h>
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 #define LDNS_SYNTAX_DATALEN 16
 #define LDNS_TTL_DATALEN    21
 #define LDNS_RRLIST_INIT    8
+/* most rdata fields ldns_rr_parser_frm_str() splits up in one go */
+#define LDNS_RR_PARSER_FAST_FIELDS 16
 
 ldns_rr *
 ldns_rr_new(void)
@@ -80,6 +86,324 @@ ldns_rr_free(ldns_rr *rr)
 	}
 }
 
+ldns_rr_parser *
+ldns_rr_parser_new(void)
+{
+	ldns_rr_parser *parser;
+
+	parser = LDNS_MALLOC(ldns_rr_parser);
+	if (!parser) {
+		return NULL;
+	}
+	parser->_owner = LDNS_XMALLOC(char, LDNS_MAX_DOMAINLEN + 1);
+	parser->_ttl = LDNS_XMALLOC(char, LDNS_TTL_DATALEN);
+	parser->_clas = LDNS_XMALLOC(char, LDNS_SYNTAX_DATALEN);
+	/* the type can also come from the ttl or class token */
+	parser->_type = LDNS_XMALLOC(char, LDNS_TTL_DATALEN);
+	parser->_rdata = LDNS_XMALLOC(char, LDNS_MAX_PACKETLEN + 1);
+	parser->_rd = LDNS_XMALLOC(char, LDNS_MAX_RDFLEN);
+	parser->_b64 = LDNS_XMALLOC(char, LDNS_MAX_RDFLEN);
+	parser->_line = LDNS_XMALLOC(char, LDNS_MAX_LINELEN + 1);
+	if (!parser->_owner || !parser->_ttl || !parser->_clas || 
+	    !parser->_type || !parser->_rdata || !parser->_rd || 
+	    !parser->_b64 || !parser->_line) {
+		ldns_rr_parser_free(parser);
+		return NULL;
+	}
+	return parser;
+}
+
+void
+ldns_rr_parser_free(ldns_rr_parser *parser)
+{
+	if (parser) {
+		LDNS_FREE(parser->_owner);
+		LDNS_FREE(parser->_ttl);
+		LDNS_FREE(parser->_clas);
+		LDNS_FREE(parser->_type);
+		LDNS_FREE(parser->_rdata);
+		LDNS_FREE(parser->_rd);
+		LDNS_FREE(parser->_b64);
+		LDNS_FREE(parser->_line);
+		LDNS_FREE(parser);
+	}
+}
+
+/* lets b read the len octets at data, without copying them. The buffer
+ * is only read from and never freed */
+static void
+ldns_rr_parser_buffer_set(ldns_buffer *b, const char *data, size_t len)
+{
+	b->_data = (uint8_t *) data;
+	b->_position = 0;
+	b->_limit = b->_capacity = len;
+	b->_fixed = 1;
+	b->_status = LDNS_STATUS_OK;
+}
+
+/* makes the rdf for a dname field of rr. An @ is the origin,
+ * relative names get the origin appended */
+static ldns_status
+ldns_rr_parser_dname(ldns_rdf **r, const char *rd, size_t rd_strlen, 
+		ldns_rdf *origin, const ldns_rr *rr)
+{
+	*r = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_DNAME, rd);
+
+	/* check if the origin should be used or concatenated */
+	if (rd_strlen == 1 && rd[0] == '@') {
+		ldns_rdf_deep_free(*r);
+		if (origin) {
+			*r = ldns_rdf_clone(origin);
+		} else {
+			/* if this is the SOA, use its own owner name */
+			if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA) {
+				*r = ldns_rdf_clone(ldns_rr_owner(rr));
+			} else {
+				*r = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_DNAME, ".");
+			}
+		}
+	} else if (*r && rd_strlen > 1 && !ldns_dname_str_absolute(rd) && origin) {
+		if (ldns_dname_cat(*r, origin) != LDNS_STATUS_OK) {
+			return LDNS_STATUS_ERR;
+		}
+	}
+	return LDNS_STATUS_OK;
+}
+
+/* the types whose rdata ldns_rr_parser_rdata_split() may split */
+static const ldns_rr_type ldns_rr_parser_fast_types[] = {
+	LDNS_RR_TYPE_NAPTR,
+	LDNS_RR_TYPE_NS,
+	LDNS_RR_TYPE_A,
+	LDNS_RR_TYPE_AAAA,
+	LDNS_RR_TYPE_SOA,
+	LDNS_RR_TYPE_RRSIG,
+	0
+};
+
+/*
+ * splits the rdata of the types above into its fields, the way the
+ * generic loop in ldns_rr_parser_frm_str() does with ldns_bget_token(),
+ * but without reading it a character at a time. Only plain text is
+ * taken: no parentheses, comments, escapes or newlines, and strings
+ * must be quoted. Returns the number of fields in start and len, or -1
+ * when the rdata should go through the generic loop.
+ */
+static int
+ldns_rr_parser_rdata_split(const char *rdata, const ldns_rr_descriptor *desc, 
+		const char **start, size_t *len)
+{
+	const char *s;
+	const char *e;
+	size_t i, r_max;
+	int n;
+
+	for (i = 0; ldns_rr_parser_fast_types[i] != 0; i++) {
+		if (ldns_rr_parser_fast_types[i] == desc->_type) {
+			break;
+		}
+	}
+	if (ldns_rr_parser_fast_types[i] == 0) {
+		return -1;
+	}
+	if (rdata[strcspn(rdata, "();\\\n")] != '\0') {
+		return -1;
+	}
+	r_max = ldns_rr_descriptor_maximum(desc);
+	if (r_max > LDNS_RR_PARSER_FAST_FIELDS) {
+		return -1;
+	}
+
+	s = rdata;
+	n = 0;
+	for (i = 0; i < r_max && *s != '\0'; i++) {
+		switch (ldns_rr_descriptor_field_type(desc, i)) {
+		case LDNS_RDF_TYPE_STR:
+			while (*s == ' ') {
+				s++;
+			}
+			if (*s != '"') {
+				/* unquoted, runs until a tab */
+				return -1;
+			}
+			s++;
+			e = strchr(s, '"');
+			/* quotes after the closing one are skipped too */
+			if (!e || e[1] == '"') {
+				return -1;
+			}
+			start[n] = s;
+			len[n] = (size_t) (e - s);
+			s = e + 1;
+			/* and so is the character after them */
+			if (*s != '\0') {
+				s++;
+			}
+			break;
+		case LDNS_RDF_TYPE_B64:
+			/* the rest of the rdata, a tab would be cut out */
+			start[n] = s;
+			len[n] = strlen(s);
+			if (strchr(s, '\t')) {
+				return -1;
+			}
+			s += len[n];
+			break;
+		case LDNS_RDF_TYPE_LOC:
+		case LDNS_RDF_TYPE_WKS:
+		case LDNS_RDF_TYPE_NSEC:
+			return -1;
+		default:
+			start[n] = s;
+			len[n] = strcspn(s, " \t");
+			s += len[n];
+			s += strspn(s, " \t");
+			break;
+		}
+		if (len[n] >= LDNS_MAX_RDFLEN - 1) {
+			return -1;
+		}
+		n++;
+	}
+	return n;
+}
+
+/* 
+ * reads a token of the rr text like ldns_bget_token(b, token, "\t\n ",
+ * limit) does. When plain is set, the text has no parentheses, comments,
+ * escapes or newlines and the token is found in one go.
+ */
+static ssize_t
+ldns_rr_parser_token(ldns_buffer *b, bool plain, char *token, size_t limit)
+{
+	const char *s;
+	size_t len;
+
+	if (!plain) {
+		return ldns_bget_token(b, token, "\t\n ", limit);
+	}
+	/* the text is nul terminated just past the end of b */
+	s = (const char *) ldns_buffer_current(b);
+	len = strcspn(s, "\t ");
+	if (len >= limit - 1 || (len == 0 && s[len] == '\0')) {
+		token[0] = '\0';
+		return -1;
+	}
+	memcpy(token, s, len);
+	token[len] = '\0';
+	ldns_buffer_skip(b, (ssize_t) len);
+	ldns_bskipcs(b, "\t\n ");
+	return (ssize_t) len;
+}
+
+/* splits the owner, ttl, class and type off the start of str, what is
+ * left of it is waiting in the rr buffer of the parser */
+static ldns_status
+ldns_rr_parser_head(ldns_rr_parser *parser, const char *str, 
+		uint32_t default_ttl, bool *plain, uint32_t *ttl_val, 
+		ldns_rr_class *clas_val, char **type)
+{
+	ldns_buffer *rr_buf;
+	char *owner;
+	char *ttl;
+	char *clas;
+	size_t len;
+
+	owner = parser->_owner;
+	ttl = parser->_ttl;
+	clas = parser->_clas;
+	rr_buf = &parser->_rr_buf;
+	*ttl_val = 0;
+	*clas_val = 0;
+	*type = NULL;
+
+	ldns_rr_parser_buffer_set(rr_buf, str, strlen(str));
+	*plain = str[strcspn(str, "();\\\n")] == '\0';
+	
+	/* split the rr in its parts -1 signals trouble */
+	if (ldns_rr_parser_token(rr_buf, *plain, owner, LDNS_MAX_DOMAINLEN) == -1) {
+		return LDNS_STATUS_SYNTAX_ERR;
+	}
+	
+	if (ldns_rr_parser_token(rr_buf, *plain, ttl, LDNS_TTL_DATALEN) == -1) {
+		return LDNS_STATUS_SYNTAX_TTL_ERR;
+	}
+	*ttl_val = (uint32_t) strtol(ttl, NULL, 10);
+
+	if (strlen(ttl) > 0 && !isdigit(ttl[0])) {
+		/* ah, it's not there or something */
+		if (default_ttl == 0) {
+			*ttl_val = LDNS_DEFAULT_TTL;
+		} else {
+			*ttl_val = default_ttl;
+		}
+		/* we not ASSUMING the TTL is missing and that
+		 * the rest of the RR is still there. That is
+		 * CLASS TYPE RDATA 
+		 * so ttl value we read is actually the class
+		 */
+		*clas_val = ldns_get_rr_class_by_name(ttl);
+		/* class can be left out too, assume IN, current
+		 * token must be type
+		 */
+		if (*clas_val == 0) {
+			*clas_val = LDNS_RR_CLASS_IN;
+			len = strlen(ttl) + 1;
+			if (len > LDNS_TTL_DATALEN) {
+				return LDNS_STATUS_SYNTAX_TYPE_ERR;
+			}
+			*type = parser->_type;
+			memcpy(*type, ttl, len);
+		}
+	} else {
+		if (ldns_rr_parser_token(rr_buf, *plain, clas, LDNS_SYNTAX_DATALEN) == -1) {
+			return LDNS_STATUS_SYNTAX_CLASS_ERR;
+		}
+		*clas_val = ldns_get_rr_class_by_name(clas);
+		/* class can be left out too, assume IN, current
+		 * token must be type
+		 */
+		if (*clas_val == 0) {
+			*clas_val = LDNS_RR_CLASS_IN;
+			len = strlen(clas) + 1;
+			if (len > LDNS_TTL_DATALEN) {
+				return LDNS_STATUS_SYNTAX_TYPE_ERR;
+			}
+			*type = parser->_type;
+			memcpy(*type, clas, len);
+		}
+	}
+	/* the rest should still be waiting for us */
+
+	if (!*type) {
+		*type = parser->_type;
+		if (ldns_rr_parser_token(rr_buf, *plain, *type, LDNS_SYNTAX_DATALEN) == -1) {
+			return LDNS_STATUS_SYNTAX_TYPE_ERR;
+		}
+	}
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_rr_parser_frm_str_head(ldns_rr_parser *parser, const char *str, 
+		uint32_t default_ttl, const char **owner, uint32_t *ttl, 
+		ldns_rr_type *type)
+{
+	bool plain;
+	ldns_rr_class clas_val;
+	char *type_str;
+	ldns_status s;
+
+	s = ldns_rr_parser_head(parser, str, default_ttl, &plain, ttl, 
+			&clas_val, &type_str);
+	if (s != LDNS_STATUS_OK) {
+		return s;
+	}
+	*owner = parser->_owner;
+	*type = ldns_get_rr_type_by_name(type_str);
+	return LDNS_STATUS_OK;
+}
+
 /* 
  * extra spaces are allowed
  * allow ttl to be optional
@@ -94,8 +418,8 @@ ldns_rr_free(ldns_rr *rr)
  * miek.nl. IN MX 10 elektron.atoom.net
  */
 ldns_status
-ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns_rdf *origin, 
-		ldns_rdf **prev)
+ldns_rr_parser_frm_str(ldns_rr_parser *parser, ldns_rr **newrr, const char *str, 
+		uint32_t default_ttl, ldns_rdf *origin, ldns_rdf **prev)
 {
 	ldns_rr *new;
 	const ldns_rr_descriptor *desc;
@@ -104,10 +428,8 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 	ldns_buffer *rd_buf;
 	uint32_t ttl_val;
 	char  *owner; 
-	char  *ttl; 
 	ldns_rr_class clas_val;
-	char  *clas;
-	char  *type = NULL;
+	char  *type;
 	char  *rdata;
 	char  *rd;
 	char  *b64;
@@ -115,6 +437,7 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 	const char *delimiters;
 	ssize_t c;
 	ldns_rdf *owner_dname;
+	ldns_status s;
 	
 	/* used for types with unknown number of rdatas */
 	bool done;
@@ -122,7 +445,6 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 		
 	ldns_rdf *r = NULL;
 	uint16_t r_cnt;
-	uint16_t r_min;
 	uint16_t r_max;
 
 	uint16_t hex_data_size;
@@ -131,130 +453,47 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 	uint8_t *hex_data;
 	size_t hex_pos;
 
-	new = ldns_rr_new();
+	bool plain;
+	const char *field_start[LDNS_RR_PARSER_FAST_FIELDS];
+	size_t field_len[LDNS_RR_PARSER_FAST_FIELDS];
+	int field_count;
+	int f;
 
-	owner = LDNS_XMALLOC(char, LDNS_MAX_DOMAINLEN + 1);
-	ttl = LDNS_XMALLOC(char, 21);
-	clas = LDNS_XMALLOC(char, 11);
-	rdata = LDNS_XMALLOC(char, LDNS_MAX_PACKETLEN + 1);
-	rr_buf = LDNS_MALLOC(ldns_buffer);
-	rd_buf = LDNS_MALLOC(ldns_buffer);
-	rd = LDNS_XMALLOC(char, LDNS_MAX_RDFLEN);
-	b64 = LDNS_XMALLOC(char, LDNS_MAX_RDFLEN);
-	if (!new || !owner || !ttl || !clas || !rdata || !rr_buf || !rd_buf || !rd | !b64) {
-		return LDNS_STATUS_MEM_ERR;
+	s = ldns_rr_parser_head(parser, str, default_ttl, &plain, &ttl_val, 
+			&clas_val, &type);
+	if (s != LDNS_STATUS_OK) {
+		return s;
 	}
-	r_cnt = 0;
-	ttl_val = 0;
-	clas_val = 0;
 
-	ldns_buffer_new_frm_data(rr_buf, (char*)str, strlen(str));
-	
-	/* split the rr in its parts -1 signals trouble */
-	if (ldns_bget_token(rr_buf, owner, "\t\n ", LDNS_MAX_DOMAINLEN) == -1) {
-		LDNS_FREE(owner); 
-		LDNS_FREE(ttl); 
-		LDNS_FREE(clas); 
-		LDNS_FREE(rdata);
-		LDNS_FREE(rd);
-		LDNS_FREE(rd_buf);
-		LDNS_FREE(b64);
-		ldns_buffer_free(rr_buf);
-		ldns_rr_free(new);
-		return LDNS_STATUS_SYNTAX_ERR;
-	}
-	
-	if (ldns_bget_token(rr_buf, ttl, "\t\n ", LDNS_TTL_DATALEN) == -1) {
-		LDNS_FREE(owner); 
-		LDNS_FREE(ttl); 
-		LDNS_FREE(clas); 
-		LDNS_FREE(rdata);
-		LDNS_FREE(rd);
-		LDNS_FREE(rd_buf);
-		LDNS_FREE(b64);
-		ldns_buffer_free(rr_buf);
-		ldns_rr_free(new);
-		return LDNS_STATUS_SYNTAX_TTL_ERR;
-	}
-	ttl_val = (uint32_t) strtol(ttl, NULL, 10);
-
-	if (strlen(ttl) > 0 && !isdigit(ttl[0])) {
-		/* ah, it's not there or something */
-		if (default_ttl == 0) {
-			ttl_val = LDNS_DEFAULT_TTL;
-		} else {
-			ttl_val = default_ttl;
-		}
-		/* we not ASSUMING the TTL is missing and that
-		 * the rest of the RR is still there. That is
-		 * CLASS TYPE RDATA 
-		 * so ttl value we read is actually the class
-		 */
-		clas_val = ldns_get_rr_class_by_name(ttl);
-		/* class can be left out too, assume IN, current
-		 * token must be type
-		 */
-		if (clas_val == 0) {
-			clas_val = LDNS_RR_CLASS_IN;
-			type = LDNS_XMALLOC(char, strlen(ttl) + 1);
-			strncpy(type, ttl, strlen(ttl) + 1);
-		}
-	} else {
-		if (ldns_bget_token(rr_buf, clas, "\t\n ", LDNS_SYNTAX_DATALEN) == -1) {
-			LDNS_FREE(owner); 
-			LDNS_FREE(ttl); 
-			LDNS_FREE(clas); 
-			LDNS_FREE(rdata);
-			LDNS_FREE(rd);
-			LDNS_FREE(rd_buf);
-			ldns_buffer_free(rr_buf);
-			ldns_rr_free(new);
-			return LDNS_STATUS_SYNTAX_CLASS_ERR;
-		}
-		clas_val = ldns_get_rr_class_by_name(clas);
-		/* class can be left out too, assume IN, current
-		 * token must be type
-		 */
-		if (clas_val == 0) {
-			clas_val = LDNS_RR_CLASS_IN;
-			type = LDNS_XMALLOC(char, strlen(clas) + 1);
-			strncpy(type, clas, strlen(clas) + 1);
-		}
+	new = ldns_rr_new();
+	if (!new) {
+		return LDNS_STATUS_MEM_ERR;
 	}
-	/* the rest should still be waiting for us */
 
-	if (!type) {
-		type = LDNS_XMALLOC(char, LDNS_SYNTAX_DATALEN);
-		if (ldns_bget_token(rr_buf, type, "\t\n ", LDNS_SYNTAX_DATALEN) == -1) {
-			LDNS_FREE(owner); 
-			LDNS_FREE(ttl); 
-			LDNS_FREE(clas); 
-			LDNS_FREE(rdata);
-			LDNS_FREE(rd);
-			LDNS_FREE(rd_buf);
-			ldns_buffer_free(rr_buf);
-			ldns_rr_free(new);
-			return LDNS_STATUS_SYNTAX_TYPE_ERR;
-		}
-	}
+	owner = parser->_owner;
+	rdata = parser->_rdata;
+	rd = parser->_rd;
+	b64 = parser->_b64;
+	rr_buf = &parser->_rr_buf;
+	rd_buf = &parser->_rd_buf;
+	r_cnt = 0;
 	
-	if (ldns_bget_token(rr_buf, rdata, "\0", LDNS_MAX_PACKETLEN) == -1) {
+	if (plain) {
+		/* the rest of the text, cut off where ldns_bget_token
+		 * would */
+		rd_strlen = ldns_buffer_remaining(rr_buf);
+		if (rd_strlen > LDNS_MAX_PACKETLEN - 1) {
+			rd_strlen = LDNS_MAX_PACKETLEN - 1;
+		}
+		memcpy(rdata, ldns_buffer_current(rr_buf), rd_strlen);
+		rdata[rd_strlen] = '\0';
+	} else if (ldns_bget_token(rr_buf, rdata, "\0", LDNS_MAX_PACKETLEN) == -1) {
 		/* apparently we are done, and it's only a question RR
-		 * so do not free and error here
-		LDNS_FREE(owner); 
-		LDNS_FREE(ttl); 
-		LDNS_FREE(clas); 
-		LDNS_FREE(type);
-		LDNS_FREE(rdata);
-		LDNS_FREE(rd);
-		LDNS_FREE(rd_buf);
-		ldns_buffer_free(rr_buf);
-		ldns_rr_free(new);
-		return NULL;
-		*/
+		 * so do not error here
+		 */
 	}
 
-	ldns_buffer_new_frm_data(rd_buf, rdata, strlen(rdata));
+	ldns_rr_parser_buffer_set(rd_buf, rdata, strlen(rdata));
 
 	if (strlen(owner) <= 1 && strncmp(owner, "@", 1) == 0) {
 		if (origin) {
@@ -279,30 +518,14 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 		} else {
 			owner_dname = ldns_dname_new_frm_str(owner);
 			if (!owner_dname) {
-					LDNS_FREE(owner); 
-					LDNS_FREE(ttl); 
-					LDNS_FREE(clas); 
-					LDNS_FREE(type);
-					LDNS_FREE(rdata);
-					LDNS_FREE(rd);
-					LDNS_FREE(rd_buf);
-					ldns_buffer_free(rr_buf);
-					ldns_rr_free(new);
-					return LDNS_STATUS_SYNTAX_ERR;
+				ldns_rr_free(new);
+				return LDNS_STATUS_SYNTAX_ERR;
 			}
 			
 			ldns_rr_set_owner(new, owner_dname);
 			if (!ldns_dname_str_absolute(owner) && origin) {
 				if(ldns_dname_cat(ldns_rr_owner(new), 
 							origin) != LDNS_STATUS_OK) {
-					LDNS_FREE(owner); 
-					LDNS_FREE(ttl); 
-					LDNS_FREE(clas); 
-					LDNS_FREE(type);
-					LDNS_FREE(rdata);
-					LDNS_FREE(rd);
-					LDNS_FREE(rd_buf);
-					ldns_buffer_free(rr_buf);
 					ldns_rr_free(new);
 					return LDNS_STATUS_SYNTAX_ERR;
 				} 
@@ -313,26 +536,50 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 			}
 		}
 	}
-	LDNS_FREE(owner);
 
 	ldns_rr_set_ttl(new, ttl_val);
-	LDNS_FREE(ttl);
-
 	ldns_rr_set_class(new, clas_val);
-	LDNS_FREE(clas);
 
 	rr_type = ldns_get_rr_type_by_name(type);
-	LDNS_FREE(type);
 
 	desc = ldns_rr_descript((uint16_t)rr_type);
 	ldns_rr_set_type(new, rr_type);
 	if (desc) {
 		/* only the rdata remains */
 		r_max = ldns_rr_descriptor_maximum(desc);
-		r_min = ldns_rr_descriptor_minimum(desc);
+		field_count = ldns_rr_parser_rdata_split(rdata, desc, 
+				field_start, field_len);
 	} else {
-		r_min = 1;
 		r_max = 1;
+		field_count = -1;
+	}
+
+	if (field_count >= 0) {
+		/* the common types in plain text are already split, make
+		 * the rdfs the same way the loop below would */
+		for (f = 0; f < field_count; f++) {
+			memcpy(rd, field_start[f], field_len[f]);
+			rd[field_len[f]] = '\0';
+			if (ldns_rr_descriptor_field_type(desc, f) == 
+					LDNS_RDF_TYPE_DNAME) {
+				if (ldns_rr_parser_dname(&r, rd, field_len[f], 
+						origin, new) != LDNS_STATUS_OK) {
+					ldns_rdf_deep_free(r);
+					ldns_rr_free(new);
+					return LDNS_STATUS_ERR;
+				}
+			} else {
+				r = ldns_rdf_new_frm_str(
+					ldns_rr_descriptor_field_type(desc, f), rd);
+			}
+			if (!r) {
+				ldns_rr_free(new);
+				return LDNS_STATUS_SYNTAX_RDATA_ERR;
+			}
+			ldns_rr_push_rdf(new, r);
+		}
+		/* nothing left for the generic loop */
+		r_max = 0;
 	}
 
 	/* depending on the rr_type we need to extract
@@ -392,8 +639,7 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 						c = ldns_bget_token(rd_buf, rd, delimiters, LDNS_MAX_RDFLEN);
 						if (c == -1) {
 							/* something goes very wrong here */
-							ldns_buffer_free(rd_buf);
-							LDNS_FREE(rd);
+							ldns_rr_free(new);
 							return LDNS_STATUS_SYNTAX_RDATA_ERR;
 						}
 						hex_data_size = (uint16_t) atoi(rd);
@@ -401,8 +647,7 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 						hex_data_str = LDNS_XMALLOC(char, 2 * hex_data_size + 1);
 						if (!hex_data_str) {
 							/* malloc error */
-							ldns_buffer_free(rd_buf);
-							LDNS_FREE(rd);
+							ldns_rr_free(new);
 							return LDNS_STATUS_SYNTAX_RDATA_ERR;
 						}
 						cur_hex_data_size = 0;
@@ -450,27 +695,11 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 									rd);
 							break;
 						case LDNS_RDF_TYPE_DNAME:
-							r = ldns_rdf_new_frm_str(
-									ldns_rr_descriptor_field_type(desc, r_cnt),
-									rd);
-
-							/* check if the origin should be used or concatenated */
-							if (rd_strlen == 1 && ldns_rdf_data(r)[1] == '@') {
+							if (ldns_rr_parser_dname(&r, rd, rd_strlen, 
+									origin, new) != LDNS_STATUS_OK) {
 								ldns_rdf_deep_free(r);
-								if (origin) {
-									r = ldns_rdf_clone(origin);
-								} else {
-								     /* if this is the SOA, use its own owner name */
-									if (rr_type == LDNS_RR_TYPE_SOA) {
-										r = ldns_rdf_clone(ldns_rr_owner(new));
-									} else {
-										r = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_DNAME, ".");
-									}
-								}
-							} else if (rd_strlen > 1 && !ldns_dname_str_absolute(rd) && origin) {
-								if (ldns_dname_cat(r, origin) != LDNS_STATUS_OK) {
-									return LDNS_STATUS_ERR;
-								}
+								ldns_rr_free(new);
+								return LDNS_STATUS_ERR;
 							}
 							break;
 						default:
@@ -482,11 +711,6 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 						if (r) {
 							ldns_rr_push_rdf(new, r);
 						} else {
-							LDNS_FREE(rd);
-							LDNS_FREE(b64);
-							ldns_buffer_free(rd_buf);
-							ldns_buffer_free(rr_buf);
-							LDNS_FREE(rdata);
 							ldns_rr_free(new);
 							return LDNS_STATUS_SYNTAX_RDATA_ERR;
 						}
@@ -504,11 +728,6 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 				}
 			}
 	}
-	LDNS_FREE(rd);
-	LDNS_FREE(b64);
-	ldns_buffer_free(rd_buf);
-	ldns_buffer_free(rr_buf);
-	LDNS_FREE(rdata);
 
 	if (newrr) {
 		*newrr = new;
@@ -516,23 +735,39 @@ ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns
 	return LDNS_STATUS_OK;
 }
 
+ldns_status
+ldns_rr_new_frm_str(ldns_rr **newrr, const char *str, uint32_t default_ttl, ldns_rdf *origin, 
+		ldns_rdf **prev)
+{
+	ldns_rr_parser *parser;
+	ldns_status s;
+
+	parser = ldns_rr_parser_new();
+	if (!parser) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	s = ldns_rr_parser_frm_str(parser, newrr, str, default_ttl, origin, prev);
+	ldns_rr_parser_free(parser);
+	return s;
+}
+
 ldns_status
 ldns_rr_new_frm_fp(ldns_rr **newrr, FILE *fp, uint32_t *ttl, ldns_rdf **origin, ldns_rdf **prev)
 {
 	return ldns_rr_new_frm_fp_l(newrr, fp, ttl, origin, prev, NULL);
 }
 
-ldns_status
-ldns_rr_new_frm_fp_l(ldns_rr **newrr, FILE *fp, uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev, int *line_nr)
+/* handles one line from a zone: a $ORIGIN or $TTL directive or an rr */
+static ldns_status
+ldns_rr_parser_frm_line(ldns_rr_parser *parser, ldns_rr **newrr, const char *line, 
+		uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev)
 {
-        char *line;
 	const char *endptr;  /* unused */
 	ldns_rr *rr;
-	char *keyword;
+	const char *keyword;
 	uint32_t ttl;
 	ldns_rdf *tmp;
 	ldns_status s;
-	ssize_t size;
 
 	s = LDNS_STATUS_ERR;
 	if (default_ttl) {
@@ -541,29 +776,6 @@ ldns_rr_new_frm_fp_l(ldns_rr **newrr, FILE *fp, uint32_t *default_ttl, ldns_rdf
 		ttl = 0;
 	}
 
-        line = LDNS_XMALLOC(char, LDNS_MAX_LINELEN + 1);
-        if (!line) {
-                return LDNS_STATUS_MEM_ERR;
-        }
-
-        /* read an entire line in from the file */
-        if ((size = ldns_fget_token_l(fp, line, LDNS_PARSE_SKIP_SPACE, LDNS_MAX_LINELEN, line_nr)) == -1) {
-		LDNS_FREE(line);
-		/* if last line was empty, we are now at feof, which is not
-		 * always a parse error (happens when for instance last line
-		 * was a comment)
-		 */
-                return LDNS_STATUS_SYNTAX_ERR;
-        }
-
-	/* we can have the situation, where we've read ok, but still got
-	 * no bytes to play with, in this case size is 0 
-	 */
-	if (size == 0) {
-		LDNS_FREE(line);
-		return LDNS_STATUS_SYNTAX_EMPTY;
-	}
-	
 	if ((keyword = strstr(line, "$ORIGIN "))) {
 		if (*origin) {
 			ldns_rdf_deep_free(*origin);
@@ -572,7 +784,6 @@ ldns_rr_new_frm_fp_l(ldns_rr **newrr, FILE *fp, uint32_t *default_ttl, ldns_rdf
 		tmp = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_DNAME, keyword + 8);
 		if (!tmp) {
 			/* could not parse what next to $ORIGIN */
-			LDNS_FREE(line);
 			return LDNS_STATUS_SYNTAX_DNAME_ERR;
 		}
 		*origin = tmp;
@@ -584,19 +795,93 @@ ldns_rr_new_frm_fp_l(ldns_rr **newrr, FILE *fp, uint32_t *default_ttl, ldns_rdf
 		s = LDNS_STATUS_SYNTAX_TTL;
 	} else {
 		if (origin && *origin) {
-			s = ldns_rr_new_frm_str(&rr, (const char*) line, ttl, *origin, prev);
+			s = ldns_rr_parser_frm_str(parser, &rr, line, ttl, *origin, prev);
 		} else {
-			s = ldns_rr_new_frm_str(&rr, (const char*) line, ttl, NULL, prev);
+			s = ldns_rr_parser_frm_str(parser, &rr, line, ttl, NULL, prev);
 		}
 	
 	}
-	LDNS_FREE(line);
 	if (newrr && s == LDNS_STATUS_OK) {
 		*newrr = rr;
 	}
 	return s;
 }
 
+ldns_status
+ldns_rr_parser_frm_fp_l(ldns_rr_parser *parser, ldns_rr **newrr, FILE *fp, uint32_t *default_ttl, 
+		ldns_rdf **origin, ldns_rdf **prev, int *line_nr)
+{
+	ssize_t size;
+
+        /* read an entire line in from the file */
+        if ((size = ldns_fget_token_l(fp, parser->_line, LDNS_PARSE_SKIP_SPACE, LDNS_MAX_LINELEN, line_nr)) == -1) {
+		/* if last line was empty, we are now at feof, which is not
+		 * always a parse error (happens when for instance last line
+		 * was a comment)
+		 */
+                return LDNS_STATUS_SYNTAX_ERR;
+        }
+
+	/* we can have the situation, where we've read ok, but still got
+	 * no bytes to play with, in this case size is 0 
+	 */
+	if (size == 0) {
+		return LDNS_STATUS_SYNTAX_EMPTY;
+	}
+
+	return ldns_rr_parser_frm_line(parser, newrr, parser->_line, default_ttl, 
+			origin, prev);
+}
+
+ldns_status
+ldns_rr_parser_frm_buffer_l(ldns_rr_parser *parser, ldns_rr **newrr, ldns_buffer *b, 
+		uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev, int *line_nr)
+{
+	ssize_t size;
+
+	/* same as the file version, a line at the time */
+	if ((size = ldns_mget_token_l(b, parser->_line, LDNS_PARSE_SKIP_SPACE, LDNS_MAX_LINELEN, line_nr)) == -1) {
+		return LDNS_STATUS_SYNTAX_ERR;
+	}
+	if (size == 0) {
+		return LDNS_STATUS_SYNTAX_EMPTY;
+	}
+	return ldns_rr_parser_frm_line(parser, newrr, parser->_line, default_ttl, 
+			origin, prev);
+}
+
+ldns_status
+ldns_rr_new_frm_fp_l(ldns_rr **newrr, FILE *fp, uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev, int *line_nr)
+{
+	ldns_rr_parser *parser;
+	ldns_status s;
+
+	parser = ldns_rr_parser_new();
+	if (!parser) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	s = ldns_rr_parser_frm_fp_l(parser, newrr, fp, default_ttl, origin, prev, 
+			line_nr);
+	ldns_rr_parser_free(parser);
+	return s;
+}
+
+ldns_status
+ldns_rr_new_frm_buffer_l(ldns_rr **newrr, ldns_buffer *b, uint32_t *default_ttl, ldns_rdf **origin, ldns_rdf **prev, int *line_nr)
+{
+	ldns_rr_parser *parser;
+	ldns_status s;
+
+	parser = ldns_rr_parser_new();
+	if (!parser) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	s = ldns_rr_parser_frm_buffer_l(parser, newrr, b, default_ttl, origin, prev, 
+			line_nr);
+	ldns_rr_parser_free(parser);
+	return s;
+}
+
 void
 ldns_rr_set_owner(ldns_rr *rr, ldns_rdf *owner)
 {
@@ -1301,36 +1586,424 @@ qsort_schwartz_rr_compare(const void *a, const void *b)
 	return result;
 }
 
-void
-ldns_rr_list_sort(ldns_rr_list *unsorted)
+/*
+ * The rr types whose rdata dnames are lowercased in the canonical
+ * form, see chapter 7 of RFC3597
+ */
+static bool
+ldns_rr_type_canonical_lowercase(ldns_rr_type type)
 {
-	struct ldns_schwartzian_compare_struct **sortables;
-	size_t item_count;
+	switch(type) {
+        	case LDNS_RR_TYPE_NS:
+        	case LDNS_RR_TYPE_MD:
+        	case LDNS_RR_TYPE_MF:
+        	case LDNS_RR_TYPE_CNAME:
+        	case LDNS_RR_TYPE_SOA:
+        	case LDNS_RR_TYPE_MB:
+        	case LDNS_RR_TYPE_MG:
+        	case LDNS_RR_TYPE_MR:
+        	case LDNS_RR_TYPE_PTR:
+        	case LDNS_RR_TYPE_HINFO:
+        	case LDNS_RR_TYPE_MINFO:
+        	case LDNS_RR_TYPE_MX:
+        	case LDNS_RR_TYPE_RP:
+        	case LDNS_RR_TYPE_AFSDB:
+        	case LDNS_RR_TYPE_RT:
+        	case LDNS_RR_TYPE_SIG:
+        	case LDNS_RR_TYPE_PX:
+        	case LDNS_RR_TYPE_NXT:
+        	case LDNS_RR_TYPE_NAPTR:
+        	case LDNS_RR_TYPE_KX:
+        	case LDNS_RR_TYPE_SRV:
+        	case LDNS_RR_TYPE_DNAME:
+        	case LDNS_RR_TYPE_A6:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*
+ * Canonical sort keys
+ *
+ * ldns_rr_list_sort orders rrs by owner name (ldns_dname_compare), by
+ * class and by type (both descending), and then by the canonical wire
+ * format of the rdata, shorter rdata first when one is a prefix of the
+ * other. All of that is flattened into one key per rr, in a single
+ * buffer, so that plain byte order of the keys is the sort order:
+ *
+ * - the owner labels, lowercased, from the root down. Every octet c is
+ *   stored as c + 1 (0xfe and 0xff as 0xff 0x01 and 0xff 0x02) and every
+ *   label ends with a 0, so a label sorts before any longer label it is
+ *   a prefix of. A final 0 sorts a name before its subdomains.
+ * - 0xffff - class and 0xffff - type, in network order
+ * - the canonical rdata; it is last, so it is not escaped
+ *
+ * Equal keys keep their original order.
+ */
+struct ldns_struct_rr_sort_key
+{
+	/** Offset of the key in the key buffer */
+	size_t _offset;
+	size_t _len;
+	/** Position of the rr in the list before sorting */
+	size_t _index;
+};
+typedef struct ldns_struct_rr_sort_key ldns_rr_sort_key;
+
+#define LDNS_RR_SORT_INSERTION     16
+#define LDNS_RR_SORT_PARALLEL_MIN  65536
+#define LDNS_RR_SORT_MAX_THREADS   8
+
+static size_t
+ldns_rr_sort_key_size(const ldns_rr *rr)
+{
+	size_t size = 4;
 	size_t i;
-	
-	if (unsorted) {
-		item_count = ldns_rr_list_rr_count(unsorted);
-		
-		sortables = LDNS_XMALLOC(struct ldns_schwartzian_compare_struct *,
-					 item_count);
-		for (i = 0; i < item_count; i++) {
-			sortables[i] = LDNS_XMALLOC(struct ldns_schwartzian_compare_struct, 1);
-			sortables[i]->original_object = ldns_rr_list_rr(unsorted, i);
-			sortables[i]->transformed_object = NULL;
+
+	if (ldns_rr_owner(rr)) {
+		size += 2 * ldns_rdf_size(ldns_rr_owner(rr)) + 1;
+	}
+	for (i = 0; i < ldns_rr_rd_count(rr); i++) {
+		size += ldns_rdf_size(ldns_rr_rdf(rr, i));
+	}
+	return size;
+}
+
+static size_t
+ldns_rr_sort_key_write(uint8_t *key, const ldns_rr *rr)
+{
+	uint16_t offsets[LDNS_MAX_DOMAINLEN / 2 + 1];
+	const uint8_t *data;
+	size_t size;
+	size_t pos = 0;
+	size_t len = 0;
+	uint8_t labels = 0;
+	size_t label_len;
+	uint8_t c;
+	size_t i;
+	bool lowercase_rdata;
+
+	if (ldns_rr_owner(rr)) {
+		data = ldns_rdf_data(ldns_rr_owner(rr));
+		size = ldns_rdf_size(ldns_rr_owner(rr));
+		while (pos < size && data[pos] > 0 &&
+		       labels < LDNS_MAX_DOMAINLEN / 2 + 1) {
+			offsets[labels++] = (uint16_t) pos;
+			pos += data[pos] + 1;
 		}
-		qsort(sortables,
-		      item_count,
-		      sizeof(struct ldns_schwartzian_compare_struct *),
-		      qsort_schwartz_rr_compare);
-		for (i = 0; i < item_count; i++) {
-			unsorted->_rrs[i] = sortables[i]->original_object;
-			if (sortables[i]->transformed_object) {
-				ldns_buffer_free(sortables[i]->transformed_object);
+		while (labels > 0) {
+			labels--;
+			pos = offsets[labels];
+			label_len = data[pos];
+			if (pos + 1 + label_len > size) {
+				label_len = size - pos - 1;
+			}
+			ldns_dname_octets_tolower(key + len, data + pos + 1,
+			                          label_len);
+			for (i = 0; i < label_len && key[len + i] < 0xfe; i++) {
+				key[len + i]++;
 			}
-			LDNS_FREE(sortables[i]);
+			len += i;
+			/* 0xfe and 0xff take two octets, do the rest of
+			 * this label one octet at a time */
+			for (; i < label_len; i++) {
+				ldns_dname_octets_tolower(&c, data + pos + 1 + i, 1);
+				if (c < 0xfe) {
+					key[len++] = c + 1;
+				} else {
+					key[len++] = 0xff;
+					key[len++] = c - 0xfd;
+				}
+			}
+			key[len++] = 0;
 		}
-		LDNS_FREE(sortables);
 	}
+	key[len++] = 0;
+
+	ldns_write_uint16(key + len, 0xffff - ldns_rr_get_class(rr));
+	ldns_write_uint16(key + len + 2, 0xffff - ldns_rr_get_type(rr));
+	len += 4;
+
+	lowercase_rdata = ldns_rr_type_canonical_lowercase(ldns_rr_get_type(rr));
+	for (i = 0; i < ldns_rr_rd_count(rr); i++) {
+		data = ldns_rdf_data(ldns_rr_rdf(rr, i));
+		size = ldns_rdf_size(ldns_rr_rdf(rr, i));
+		if (lowercase_rdata && ldns_rdf_get_type(ldns_rr_rdf(rr, i))
+		                       == LDNS_RDF_TYPE_DNAME) {
+			ldns_dname_octets_tolower(key + len, data, size);
+		} else {
+			memcpy(key + len, data, size);
+		}
+		len += size;
+	}
+	return len;
+}
+
+/* compares two keys that are known to be equal up to depth */
+static int
+ldns_rr_sort_key_compare(const uint8_t *keys, const ldns_rr_sort_key *a,
+                         const ldns_rr_sort_key *b, size_t depth)
+{
+	size_t min_len = a->_len < b->_len ? a->_len : b->_len;
+	int result = 0;
+
+	if (depth < min_len) {
+		result = memcmp(keys + a->_offset + depth,
+		                keys + b->_offset + depth, min_len - depth);
+	}
+	if (result != 0) {
+		return result;
+	}
+	if (a->_len != b->_len) {
+		return a->_len < b->_len ? -1 : 1;
+	}
+	if (a->_index != b->_index) {
+		return a->_index < b->_index ? -1 : 1;
+	}
+	return 0;
+}
+
+static int
+ldns_rr_sort_key_index_compare(const void *a, const void *b)
+{
+	size_t ia = ((const ldns_rr_sort_key *) a)->_index;
+	size_t ib = ((const ldns_rr_sort_key *) b)->_index;
+
+	return ia < ib ? -1 : (ia > ib ? 1 : 0);
+}
+
+/* the octet of the key at depth, -1 past its end */
+static int
+ldns_rr_sort_key_at(const uint8_t *keys, const ldns_rr_sort_key *k,
+                    size_t depth)
+{
+	return depth < k->_len ? keys[k->_offset + depth] : -1;
+}
+
+/*
+ * Multikey quicksort (Bentley and Sedgewick): partition on the octet at
+ * depth and only look one octet deeper within the equal part
+ */
+static void
+ldns_rr_sort_keys(const uint8_t *keys, ldns_rr_sort_key *k, size_t n,
+                  size_t depth)
+{
+	ldns_rr_sort_key tmp;
+	size_t lt, gt, i, j;
+	int pivot, c;
+
+	while (n > LDNS_RR_SORT_INSERTION) {
+		pivot = ldns_rr_sort_key_at(keys, &k[n / 2], depth);
+		lt = 0;
+		i = 0;
+		gt = n;
+		while (i < gt) {
+			c = ldns_rr_sort_key_at(keys, &k[i], depth);
+			if (c < pivot) {
+				tmp = k[lt]; k[lt] = k[i]; k[i] = tmp;
+				lt++;
+				i++;
+			} else if (c > pivot) {
+				gt--;
+				tmp = k[gt]; k[gt] = k[i]; k[i] = tmp;
+			} else {
+				i++;
+			}
+		}
+		ldns_rr_sort_keys(keys, k, lt, depth);
+		ldns_rr_sort_keys(keys, k + gt, n - gt, depth);
+		k += lt;
+		n = gt - lt;
+		if (pivot == -1) {
+			/* these keys are all equal, keep their original order */
+			qsort(k, n, sizeof(ldns_rr_sort_key),
+			      ldns_rr_sort_key_index_compare);
+			return;
+		}
+		depth++;
+	}
+
+	for (i = 1; i < n; i++) {
+		tmp = k[i];
+		for (j = i; j > 0 &&
+		     ldns_rr_sort_key_compare(keys, &k[j - 1], &tmp, depth) > 0;
+		     j--) {
+			k[j] = k[j - 1];
+		}
+		k[j] = tmp;
+	}
+}
+
+#ifdef HAVE_PTHREAD_H
+struct ldns_struct_rr_sort_job
+{
+	const uint8_t *_keys;
+	ldns_rr_sort_key *_sort_keys;
+	size_t _count;
+};
+typedef struct ldns_struct_rr_sort_job ldns_rr_sort_job;
+
+static void *
+ldns_rr_sort_job_run(void *arg)
+{
+	ldns_rr_sort_job *job = (ldns_rr_sort_job *) arg;
+
+	ldns_rr_sort_keys(job->_keys, job->_sort_keys, job->_count, 0);
+	return NULL;
+}
+
+/*
+ * Sorts equal parts of the keys on their own thread, and merges the
+ * sorted parts. Returns false, with the keys untouched, if this cannot
+ * be done in parallel
+ */
+static bool
+ldns_rr_sort_keys_parallel(const uint8_t *keys, ldns_rr_sort_key *k,
+                           size_t n)
+{
+	pthread_t threads[LDNS_RR_SORT_MAX_THREADS];
+	bool started[LDNS_RR_SORT_MAX_THREADS];
+	ldns_rr_sort_job jobs[LDNS_RR_SORT_MAX_THREADS];
+	size_t bounds[LDNS_RR_SORT_MAX_THREADS + 1];
+	ldns_rr_sort_key *from, *to, *swap;
+	size_t parts, runs;
+	size_t i, r, a, a_end, b, b_end, pos;
+	long cpus;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 2) {
+		return false;
+	}
+	parts = cpus > LDNS_RR_SORT_MAX_THREADS ?
+	        LDNS_RR_SORT_MAX_THREADS : (size_t) cpus;
+	to = LDNS_XMALLOC(ldns_rr_sort_key, n);
+	if (!to) {
+		return false;
+	}
+
+	for (i = 0; i <= parts; i++) {
+		bounds[i] = n / parts * i;
+	}
+	bounds[parts] = n;
+	for (i = 0; i < parts; i++) {
+		jobs[i]._keys = keys;
+		jobs[i]._sort_keys = k + bounds[i];
+		jobs[i]._count = bounds[i + 1] - bounds[i];
+		started[i] = i > 0 && pthread_create(&threads[i], NULL,
+		                        ldns_rr_sort_job_run, &jobs[i]) == 0;
+	}
+	for (i = 0; i < parts; i++) {
+		if (!started[i]) {
+			(void) ldns_rr_sort_job_run(&jobs[i]);
+		}
+	}
+	for (i = 0; i < parts; i++) {
+		if (started[i]) {
+			(void) pthread_join(threads[i], NULL);
+		}
+	}
+
+	/* merge neighbouring runs until one is left */
+	from = k;
+	for (runs = parts; runs > 1; runs = (runs + 1) / 2) {
+		for (r = 0; r < runs; r += 2) {
+			a = bounds[r];
+			a_end = bounds[r + 1];
+			b = a_end;
+			b_end = r + 1 < runs ? bounds[r + 2] : a_end;
+			pos = a;
+			while (a < a_end && b < b_end) {
+				if (ldns_rr_sort_key_compare(keys, &from[a],
+				                             &from[b], 0) <= 0) {
+					to[pos++] = from[a++];
+				} else {
+					to[pos++] = from[b++];
+				}
+			}
+			while (a < a_end) {
+				to[pos++] = from[a++];
+			}
+			while (b < b_end) {
+				to[pos++] = from[b++];
+			}
+			bounds[r / 2] = bounds[r];
+		}
+		bounds[(runs + 1) / 2] = n;
+		swap = from;
+		from = to;
+		to = swap;
+	}
+	if (from != k) {
+		memcpy(k, from, n * sizeof(ldns_rr_sort_key));
+		to = from;
+	}
+	LDNS_FREE(to);
+	return true;
+}
+#endif /* HAVE_PTHREAD_H */
+
+void
+ldns_rr_list_sort(ldns_rr_list *unsorted)
+{
+	ldns_rr_sort_key *sort_keys;
+	uint8_t *keys;
+	ldns_rr **rrs;
+	size_t item_count;
+	size_t key_size;
+	size_t i;
+	bool sorted = false;
+
+	if (!unsorted) {
+		return;
+	}
+	item_count = ldns_rr_list_rr_count(unsorted);
+	if (item_count < 2) {
+		return;
+	}
+
+	key_size = 0;
+	for (i = 0; i < item_count; i++) {
+		key_size += ldns_rr_sort_key_size(ldns_rr_list_rr(unsorted, i));
+	}
+	keys = LDNS_XMALLOC(uint8_t, key_size);
+	sort_keys = LDNS_XMALLOC(ldns_rr_sort_key, item_count);
+	rrs = LDNS_XMALLOC(ldns_rr *, item_count);
+	if (!keys || !sort_keys || !rrs) {
+		LDNS_FREE(keys);
+		LDNS_FREE(sort_keys);
+		LDNS_FREE(rrs);
+		/* no room for the keys, compare the rrs directly */
+		qsort(unsorted->_rrs, item_count, sizeof(ldns_rr *),
+		      qsort_rr_compare);
+		return;
+	}
+
+	/* build all keys in one go, in one buffer */
+	key_size = 0;
+	for (i = 0; i < item_count; i++) {
+		rrs[i] = ldns_rr_list_rr(unsorted, i);
+		sort_keys[i]._offset = key_size;
+		sort_keys[i]._len = ldns_rr_sort_key_write(keys + key_size, rrs[i]);
+		sort_keys[i]._index = i;
+		key_size += sort_keys[i]._len;
+	}
+
+#ifdef HAVE_PTHREAD_H
+	if (item_count >= LDNS_RR_SORT_PARALLEL_MIN) {
+		sorted = ldns_rr_sort_keys_parallel(keys, sort_keys, item_count);
+	}
+#endif
+	if (!sorted) {
+		ldns_rr_sort_keys(keys, sort_keys, item_count, 0);
+	}
+
+	for (i = 0; i < item_count; i++) {
+		unsorted->_rrs[i] = rrs[sort_keys[i]._index];
+	}
+	LDNS_FREE(keys);
+	LDNS_FREE(sort_keys);
+	LDNS_FREE(rrs);
 }
 
 int
@@ -1551,37 +2224,10 @@ ldns_rr2canonical(ldns_rr *rr)
 	 * lowercase the rdata dnames if the rr type is one
 	 * of the list in chapter 7 of RFC3597
 	 */
-	switch(ldns_rr_get_type(rr)) {
-        	case LDNS_RR_TYPE_NS:
-        	case LDNS_RR_TYPE_MD:
-        	case LDNS_RR_TYPE_MF:
-        	case LDNS_RR_TYPE_CNAME:
-        	case LDNS_RR_TYPE_SOA:
-        	case LDNS_RR_TYPE_MB:
-        	case LDNS_RR_TYPE_MG:
-        	case LDNS_RR_TYPE_MR:
-        	case LDNS_RR_TYPE_PTR:
-        	case LDNS_RR_TYPE_HINFO:
-        	case LDNS_RR_TYPE_MINFO:
-        	case LDNS_RR_TYPE_MX:
-        	case LDNS_RR_TYPE_RP:
-        	case LDNS_RR_TYPE_AFSDB:
-        	case LDNS_RR_TYPE_RT:
-        	case LDNS_RR_TYPE_SIG:
-        	case LDNS_RR_TYPE_PX:
-        	case LDNS_RR_TYPE_NXT:
-        	case LDNS_RR_TYPE_NAPTR:
-        	case LDNS_RR_TYPE_KX:
-        	case LDNS_RR_TYPE_SRV:
-        	case LDNS_RR_TYPE_DNAME:
-        	case LDNS_RR_TYPE_A6:
-			for (i = 0; i < ldns_rr_rd_count(rr); i++) {
-				ldns_dname2canonical(ldns_rr_rdf(rr, i));
-			}
-			return;
-		default:
-			/* do nothing */
-			return;
+	if (ldns_rr_type_canonical_lowercase(ldns_rr_get_type(rr))) {
+		for (i = 0; i < ldns_rr_rd_count(rr); i++) {
+			ldns_dname2canonical(ldns_rr_rdf(rr, i));
+		}
 	}
 }
 
@@ -0,0 +1,189 @@
+/*
+ * dname_bench.c
+ *
+ * measures how fast dnames are counted, compared and checked for being
+ * subdomains, and how fast rr lists are put in canonical order
+ *
+ * usage: dname_bench [rounds], each rounds runs every case once
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+#include "ldns/config.h"
+
+#include "ldns.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_NAMES 1000000
+#define BENCH_RRS   200000
+
+static ldns_rdf *bench_names[BENCH_NAMES];
+static ldns_rr *bench_rrs[BENCH_RRS];
+
+static double
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench_report(const char *what, size_t count, double start)
+{
+	printf("%-44s %7.2f M/s\n", what, count / (bench_now() - start) / 1e6);
+}
+
+/* ENUM names of numbers that share their first digits, in mixed case */
+static void
+bench_make_names(void)
+{
+	char str[64];
+	size_t i;
+
+	for (i = 0; i < BENCH_NAMES; i++) {
+		snprintf(str, sizeof(str), "%u.%u.%u.%u.6.1.3.%s.arpa.",
+				(unsigned int) (i % 10),
+				(unsigned int) (i / 10 % 10),
+				(unsigned int) (i / 100 % 10),
+				(unsigned int) (i / 1000 % 10),
+				(i & 1) ? "E164" : "e164");
+		bench_names[i] = ldns_dname_new_frm_str(str);
+		if (!bench_names[i]) {
+			fprintf(stderr, "can not make %s\n", str);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static void
+bench_dnames(void)
+{
+	ldns_rdf *parent = ldns_dname_new_frm_str("6.1.3.e164.arpa.");
+	ldns_rdf *other = ldns_dname_new_frm_str("7.1.3.e164.arpa.");
+	size_t total = 0;
+	size_t i;
+	double start;
+
+	start = bench_now();
+	for (i = 0; i < BENCH_NAMES; i++) {
+		total += ldns_dname_label_count(bench_names[i]);
+	}
+	bench_report("label counts", BENCH_NAMES, start);
+
+	start = bench_now();
+	for (i = 0; i < BENCH_NAMES; i++) {
+		total += ldns_dname_is_subdomain(bench_names[i],
+				(i & 1) ? parent : other);
+	}
+	bench_report("subdomain checks", BENCH_NAMES, start);
+
+	/* neighbours differ in their first label and in case */
+	start = bench_now();
+	for (i = 1; i < BENCH_NAMES; i++) {
+		total += ldns_dname_compare(bench_names[i - 1],
+				bench_names[i]) < 0;
+	}
+	bench_report("canonical compares", BENCH_NAMES - 1, start);
+
+	if (total == 0) {
+		printf("nothing counted\n");
+	}
+	ldns_rdf_deep_free(parent);
+	ldns_rdf_deep_free(other);
+}
+
+static int
+bench_qsort_compare(const void *a, const void *b)
+{
+	return ldns_rr_compare(*(ldns_rr * const *) a, *(ldns_rr * const *) b);
+}
+
+/* the NAPTRs of numbers in a zone, in the order they were provisioned */
+static void
+bench_make_rrs(void)
+{
+	char str[256];
+	size_t i;
+	unsigned int n;
+
+	for (i = 0; i < BENCH_RRS; i++) {
+		n = (unsigned int) (i * 7919 % BENCH_RRS);
+		snprintf(str, sizeof(str), "%u.%u.%u.%u.%u.%u.1.3.e164.arpa. "
+				"3600 IN NAPTR %u 10 \"u\" \"E2U+sip\" "
+				"\"!^.*$!sip:%u@example.nl!\" .",
+				n % 10, n / 10 % 10, n / 100 % 10,
+				n / 1000 % 10, n / 10000 % 10, n / 100000 % 10,
+				(unsigned int) (i % 3) * 10, n);
+		bench_rrs[i] = NULL;
+		if (ldns_rr_new_frm_str(&bench_rrs[i], str, 0, NULL, NULL)
+				!= LDNS_STATUS_OK) {
+			fprintf(stderr, "can not parse %s\n", str);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static void
+bench_sort(void)
+{
+	ldns_rr_list *list = ldns_rr_list_new();
+	ldns_rr **copy = LDNS_XMALLOC(ldns_rr *, BENCH_RRS);
+	size_t i;
+	double start;
+
+	if (!list || !copy) {
+		fprintf(stderr, "out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < BENCH_RRS; i++) {
+		(void) ldns_rr_list_push_rr(list, bench_rrs[i]);
+	}
+	start = bench_now();
+	ldns_rr_list_sort(list);
+	bench_report("rrs sorted with canonical keys", BENCH_RRS, start);
+
+	/* what it cost when every comparison built the wire forms */
+	memcpy(copy, bench_rrs, BENCH_RRS * sizeof(ldns_rr *));
+	start = bench_now();
+	qsort(copy, BENCH_RRS, sizeof(ldns_rr *), bench_qsort_compare);
+	bench_report("rrs sorted with ldns_rr_compare", BENCH_RRS, start);
+
+	for (i = 0; i < BENCH_RRS; i++) {
+		if (ldns_rr_compare(copy[i], ldns_rr_list_rr(list, i)) != 0) {
+			printf("the orders differ at %u\n", (unsigned int) i);
+			break;
+		}
+	}
+	LDNS_FREE(copy);
+	ldns_rr_list_free(list);
+}
+
+int
+main(int argc, char **argv)
+{
+	int rounds = 1;
+	int round;
+	size_t i;
+
+	if (argc > 1) {
+		rounds = atoi(argv[1]);
+	}
+	bench_make_names();
+	bench_make_rrs();
+	for (round = 0; round < rounds; round++) {
+		bench_dnames();
+		bench_sort();
+	}
+	for (i = 0; i < BENCH_NAMES; i++) {
+		ldns_rdf_deep_free(bench_names[i]);
+	}
+	for (i = 0; i < BENCH_RRS; i++) {
+		ldns_rr_free(bench_rrs[i]);
+	}
+	return EXIT_SUCCESS;
+}
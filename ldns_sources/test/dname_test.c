@@ -0,0 +1,217 @@
+/*
+ * dname_test.c
+ *
+ * checks the label counts of dnames when they change, and that rr lists
+ * are sorted in the order of ldns_rr_compare()
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+#include "ldns/config.h"
+
+#include "ldns.h"
+
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond) ldns_test_check((cond), #cond, __FILE__, __LINE__)
+
+static void
+ldns_test_check(bool ok, const char *what, const char *file, int line)
+{
+	if (!ok) {
+		fprintf(stderr, "%s:%d: failed: %s\n", file, line, what);
+		failures++;
+	}
+}
+
+static ldns_rr *
+ldns_test_rr(const char *str)
+{
+	ldns_rr *rr;
+
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s: can not parse %s\n", __FILE__, str);
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+static void
+test_label_count(void)
+{
+	ldns_rdf *name = ldns_dname_new_frm_str("www.example.nl.");
+	ldns_rdf *other = ldns_dname_new_frm_str("1.2.3.4.5.e164.arpa.");
+	ldns_rdf *root = ldns_dname_new_frm_str(".");
+	ldns_rdf *suffix = ldns_dname_new_frm_str("example.");
+	uint8_t *data, *old;
+
+	CHECK(ldns_dname_label_count(name) == 3);
+	/* counted once, the same after */
+	CHECK(ldns_dname_label_count(name) == 3);
+	CHECK(ldns_dname_label_count(other) == 7);
+	CHECK(ldns_dname_label_count(root) == 0);
+
+	/* new data is counted again */
+	data = LDNS_XMALLOC(uint8_t, ldns_rdf_size(other));
+	memcpy(data, ldns_rdf_data(other), ldns_rdf_size(other));
+	old = ldns_rdf_data(name);
+	ldns_rdf_set_data(name, data);
+	LDNS_FREE(old);
+	ldns_rdf_set_size(name, ldns_rdf_size(other));
+	CHECK(ldns_dname_label_count(name) == 7);
+	CHECK(ldns_dname_compare(name, other) == 0);
+
+	/* a shorter size on the same data, the root of "1." */
+	data[2] = 0;
+	ldns_rdf_set_size(name, 3);
+	CHECK(ldns_dname_label_count(name) == 1);
+
+	/* writers of names change the count too */
+	CHECK(ldns_dname_cat(name, suffix) == LDNS_STATUS_OK);
+	CHECK(ldns_dname_label_count(name) == 2);
+	CHECK(ldns_dname_cat(root, suffix) == LDNS_STATUS_OK);
+	CHECK(ldns_dname_label_count(root) == 1);
+
+	/* a name that is no longer one has no labels */
+	ldns_rdf_set_type(other, LDNS_RDF_TYPE_STR);
+	CHECK(ldns_dname_label_count(other) == 0);
+	ldns_rdf_set_type(other, LDNS_RDF_TYPE_DNAME);
+	CHECK(ldns_dname_label_count(other) == 7);
+
+	CHECK(ldns_dname_is_subdomain(name, suffix));
+	CHECK(!ldns_dname_is_subdomain(other, suffix));
+
+	ldns_rdf_deep_free(name);
+	ldns_rdf_deep_free(other);
+	ldns_rdf_deep_free(root);
+	ldns_rdf_deep_free(suffix);
+}
+
+static int
+ldns_test_compare(const void *a, const void *b)
+{
+	return ldns_rr_compare(*(ldns_rr * const *) a, *(ldns_rr * const *) b);
+}
+
+/* sorts rrs and checks the order against qsort with ldns_rr_compare */
+static void
+ldns_test_sort(ldns_rr **rrs, size_t count, int line)
+{
+	ldns_rr_list *list = ldns_rr_list_new();
+	ldns_rr **expected = LDNS_XMALLOC(ldns_rr *, count);
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		(void) ldns_rr_list_push_rr(list, rrs[i]);
+	}
+	memcpy(expected, rrs, count * sizeof(ldns_rr *));
+	qsort(expected, count, sizeof(ldns_rr *), ldns_test_compare);
+	ldns_rr_list_sort(list);
+
+	CHECK(ldns_rr_list_rr_count(list) == count);
+	for (i = 0; i < count; i++) {
+		if (ldns_rr_compare(ldns_rr_list_rr(list, i), expected[i])
+				!= 0) {
+			fprintf(stderr, "%s:%d: rr %u is out of order\n",
+					__FILE__, line, (unsigned int) i);
+			failures++;
+			break;
+		}
+	}
+	LDNS_FREE(expected);
+	ldns_rr_list_free(list);
+}
+
+static void
+test_sort(void)
+{
+	const char *strs[] = {
+		"b.example. 3600 IN A 192.0.2.2",
+		"B.example. 3600 IN A 192.0.2.1",
+		"example. 3600 IN SOA ns.example. h.example. 1 2 3 4 5",
+		"example. 3600 IN NS ns.example.",
+		"example. 3600 CH TXT \"chaos\"",
+		"a.b.example. 3600 IN A 192.0.2.3",
+		"a\\.b.example. 3600 IN A 192.0.2.4",
+		"\\000.example. 3600 IN A 192.0.2.5",
+		"\\255.example. 3600 IN A 192.0.2.6",
+		"z.example. 3600 IN TXT \"b\"",
+		"z.example. 3600 IN TXT \"a\"",
+		"z.example. 3600 IN TXT \"ab\"",
+		"Z.EXAMPLE. 3600 IN CNAME A.example.",
+		"z.example. 3600 IN AAAA 2001:db8::1",
+		"9.8.7.6.5.4.3.2.1.1.3.e164.arpa. 60 IN NAPTR "
+			"100 10 \"u\" \"E2U+sip\" \"!^.*$!sip:a@example.nl!\" .",
+		"9.8.7.6.5.4.3.2.1.1.3.e164.arpa. 60 IN NAPTR "
+			"10 10 \"u\" \"E2U+sip\" \"!^.*$!sip:b@example.nl!\" .",
+		"8.8.7.6.5.4.3.2.1.1.3.e164.arpa. 60 IN NAPTR "
+			"10 10 \"u\" \"E2U+sip\" \"!^.*$!sip:c@example.nl!\" .",
+		"1.3.e164.arpa. 60 IN NS ns.Example.",
+		"1.3.e164.arpa. 60 IN NS NS.example."
+	};
+	size_t count = sizeof(strs) / sizeof(strs[0]);
+	ldns_rr *rrs[sizeof(strs) / sizeof(strs[0])];
+	ldns_rr *first, *second;
+	ldns_rr_list *list;
+	ldns_rr **many;
+	char str[256];
+	size_t i, many_count;
+	unsigned int n;
+
+	for (i = 0; i < count; i++) {
+		rrs[i] = ldns_test_rr(strs[i]);
+	}
+	ldns_test_sort(rrs, count, __LINE__);
+	for (i = 0; i < count; i++) {
+		ldns_rr_free(rrs[i]);
+	}
+
+	/* rrs that compare equal keep their order */
+	first = ldns_test_rr("www.example. 60 IN A 192.0.2.1");
+	second = ldns_test_rr("WWW.example. 120 IN A 192.0.2.1");
+	CHECK(ldns_rr_compare(first, second) == 0);
+	list = ldns_rr_list_new();
+	(void) ldns_rr_list_push_rr(list, ldns_test_rr("z.example. A 192.0.2.9"));
+	(void) ldns_rr_list_push_rr(list, first);
+	(void) ldns_rr_list_push_rr(list, second);
+	(void) ldns_rr_list_push_rr(list, ldns_test_rr("a.example. A 192.0.2.9"));
+	ldns_rr_list_sort(list);
+	CHECK(ldns_rr_list_rr(list, 1) == first);
+	CHECK(ldns_rr_list_rr(list, 2) == second);
+	ldns_rr_list_deep_free(list);
+
+	/* enough to be sorted in parts on more than one cpu */
+	many_count = 70000;
+	many = LDNS_XMALLOC(ldns_rr *, many_count);
+	for (i = 0; i < many_count; i++) {
+		n = (unsigned int) (i * 7919 % many_count);
+		snprintf(str, sizeof(str), "%u.%u.%u.%u.%u.1.3.%s.arpa. 3600 "
+				"IN NAPTR %u 10 \"u\" \"E2U+sip\" "
+				"\"!^.*$!sip:%u@example.nl!\" .",
+				n % 10, n / 10 % 10, n / 100 % 10,
+				n / 1000 % 10, n / 10000 % 10,
+				(n & 1) ? "E164" : "e164", n % 3 * 10, n / 3);
+		many[i] = ldns_test_rr(str);
+	}
+	ldns_test_sort(many, many_count, __LINE__);
+	for (i = 0; i < many_count; i++) {
+		ldns_rr_free(many[i]);
+	}
+	LDNS_FREE(many);
+}
+
+int
+main(void)
+{
+	test_label_count();
+	test_sort();
+	if (failures > 0) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all checks passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,238 @@
+/*
+ * enum_bench.c
+ *
+ * measures how fast the ENUM functions of enum.c turn numbers into
+ * names, apply NAPTR regexps and decode NAPTR records
+ *
+ * usage: enum_bench [rounds], each rounds runs every case once
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+#include "ldns/config.h"
+
+#include "ldns.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <regex.h>
+
+#define BENCH_NUMBERS 1000000
+#define BENCH_REGEXPS 50
+
+static char bench_digits[BENCH_NUMBERS][16];
+static const char *bench_numbers[BENCH_NUMBERS];
+static ldns_rdf *bench_dnames[BENCH_NUMBERS];
+
+static double
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench_report(const char *what, size_t count, double start)
+{
+	printf("%-44s %7.2f M/s\n", what, count / (bench_now() - start) / 1e6);
+}
+
+/* numbers into names, as wire data, as rdfs and by way of the text */
+static void
+bench_number2wire(void)
+{
+	ldns_rdf *suffix;
+	uint8_t wire[LDNS_MAX_DOMAINLEN];
+	size_t total = 0;
+	size_t i;
+	double start;
+	char *str;
+
+	suffix = ldns_dname_new_frm_str("e164.nl");
+
+	start = bench_now();
+	for (i = 0; i < BENCH_NUMBERS; i++) {
+		total += ldns_enum_number2wire(wire, bench_numbers[i],
+				strlen(bench_numbers[i]), suffix);
+	}
+	bench_report("names into a buffer", BENCH_NUMBERS, start);
+	if (total == 0) {
+		printf("no names made\n");
+	}
+
+	start = bench_now();
+	ldns_enum_dnames_new_frm_numbers(bench_dnames, bench_numbers,
+			BENCH_NUMBERS, suffix);
+	bench_report("names as rdfs", BENCH_NUMBERS, start);
+	for (i = 0; i < BENCH_NUMBERS; i++) {
+		ldns_rdf_deep_free(bench_dnames[i]);
+	}
+
+	start = bench_now();
+	for (i = 0; i < BENCH_NUMBERS; i++) {
+		str = ldns_enum_number2str(bench_numbers[i], "e164.nl");
+		bench_dnames[i] = ldns_dname_new_frm_str(str);
+		LDNS_FREE(str);
+	}
+	bench_report("names by way of the text", BENCH_NUMBERS, start);
+	for (i = 0; i < BENCH_NUMBERS; i++) {
+		ldns_rdf_deep_free(bench_dnames[i]);
+	}
+
+	ldns_rdf_deep_free(suffix);
+}
+
+/* one provider regexp over many numbers, and a mix of regexps */
+static void
+bench_regexp_apply(void)
+{
+	const char *regexp = "!^\\+31(6[0-9]{8})$!sip:0\\1@voip.example.nl!";
+	char mixed[BENCH_REGEXPS][64];
+	size_t len = strlen(regexp);
+	size_t count = BENCH_NUMBERS / 2;
+	size_t i;
+	double start;
+	char *result;
+	regex_t re;
+	regmatch_t match[10];
+
+	start = bench_now();
+	for (i = 0; i < count; i++) {
+		if (ldns_enum_regexp_apply(&result, (const uint8_t *) regexp,
+				len, bench_numbers[i]) == LDNS_STATUS_OK) {
+			LDNS_FREE(result);
+		}
+	}
+	bench_report("one regexp, compiled once", count, start);
+
+	/* what applying it cost before the compiled regexps were kept */
+	count = BENCH_NUMBERS / 20;
+	start = bench_now();
+	for (i = 0; i < count; i++) {
+		if (regcomp(&re, "^\\+31(6[0-9]{8})$", REG_EXTENDED) == 0) {
+			(void) regexec(&re, bench_numbers[i], 10, match, 0);
+			regfree(&re);
+		}
+	}
+	bench_report("one regexp, compiled every time (no subst)",
+			count, start);
+
+	for (i = 0; i < BENCH_REGEXPS; i++) {
+		snprintf(mixed[i], sizeof(mixed[i]),
+				"!^\\+316%d(.*)$!sip:\\1@p%d.example!",
+				(int) (i % 10 * 10 + i / 10), (int) i);
+	}
+	count = BENCH_NUMBERS / 10;
+	start = bench_now();
+	for (i = 0; i < count; i++) {
+		regexp = mixed[i % BENCH_REGEXPS];
+		if (ldns_enum_regexp_apply(&result, (const uint8_t *) regexp,
+				strlen(regexp), bench_numbers[i]) == LDNS_STATUS_OK) {
+			LDNS_FREE(result);
+		}
+	}
+	bench_report("50 regexps mixed", count, start);
+}
+
+/* the character strings of typical NAPTR records, and the records */
+static void
+bench_naptr(void)
+{
+	const char *fields[4] = {
+		"u",
+		"E2U+web:http+x-lbl:homepage",
+		"!^.*$!http://www.example.com/people/somebody/profile!",
+		"!^.*$!mailto:somebody@example.com!"
+	};
+	const char *records[4] = {
+		"3.2.1.e164.arpa. 60 IN NAPTR 100 10 \"u\" "
+		"\"E2U+web:http+x-lbl:homepage\" "
+		"\"!^.*$!http://www.example.com/people/somebody/profile!\" .",
+		"3.2.1.e164.arpa. 60 IN NAPTR 100 20 \"u\" "
+		"\"E2U+email:mailto+x-work\" "
+		"\"!^.*$!mailto:somebody@example.com!\" .",
+		"3.2.1.e164.arpa. 60 IN NAPTR 100 30 \"u\" "
+		"\"E2U+voice:tel+x-mobile\" \"!^.*$!tel:+31612345678!\" .",
+		"3.2.1.e164.arpa. 60 IN NAPTR 200 10 \"\" \"\" \"\" "
+		"next.example.com."
+	};
+	ldns_rdf *rdfs[4];
+	ldns_rr *rrs[4];
+	ldns_buffer *buf;
+	ldns_enum_naptr *naptr;
+	uint8_t data[256];
+	size_t count = 4 * BENCH_NUMBERS;
+	size_t i;
+	double start;
+	char *str;
+
+	for (i = 0; i < 4; i++) {
+		data[0] = (uint8_t) strlen(fields[i]);
+		memcpy(data + 1, fields[i], data[0]);
+		rdfs[i] = ldns_rdf_new_frm_data(LDNS_RDF_TYPE_STR,
+				(size_t) data[0] + 1, data);
+		rrs[i] = NULL;
+		if (ldns_rr_new_frm_str(&rrs[i], records[i], 0, NULL, NULL)
+				!= LDNS_STATUS_OK) {
+			fprintf(stderr, "can not parse %s\n", records[i]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	buf = ldns_buffer_new(LDNS_MIN_BUFLEN);
+
+	start = bench_now();
+	for (i = 0; i < count; i++) {
+		str = ldns_enum_string_rdf2str(rdfs[i & 3]);
+		LDNS_FREE(str);
+	}
+	bench_report("fields as new strings", count, start);
+
+	start = bench_now();
+	for (i = 0; i < count; i++) {
+		ldns_buffer_clear(buf);
+		(void) ldns_enum_string_rdf2buffer(buf, rdfs[i & 3]);
+	}
+	bench_report("fields into a buffer", count, start);
+
+	count = 2 * BENCH_NUMBERS;
+	start = bench_now();
+	for (i = 0; i < count; i++) {
+		if (ldns_enum_naptr_new_frm_rr(&naptr, rrs[i & 3], "+123")
+				== LDNS_STATUS_OK) {
+			ldns_enum_naptr_free(naptr);
+		}
+	}
+	bench_report("whole records", count, start);
+
+	ldns_buffer_free(buf);
+	for (i = 0; i < 4; i++) {
+		ldns_rdf_deep_free(rdfs[i]);
+		ldns_rr_free(rrs[i]);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	int rounds = 1;
+	int round;
+	size_t i;
+
+	if (argc > 1) {
+		rounds = atoi(argv[1]);
+	}
+	for (i = 0; i < BENCH_NUMBERS; i++) {
+		snprintf(bench_digits[i], sizeof(bench_digits[i]), "+316%08u",
+				(unsigned int) (i * 7919 % 100000000));
+		bench_numbers[i] = bench_digits[i];
+	}
+	for (round = 0; round < rounds; round++) {
+		bench_number2wire();
+		bench_regexp_apply();
+		bench_naptr();
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,555 @@
+/*
+ * enum_test.c
+ *
+ * checks the ENUM functions of enum.c against fixed vectors
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+#include "ldns/config.h"
+
+#include "ldns.h"
+
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond) ldns_test_check((cond), #cond, __FILE__, __LINE__)
+
+static void
+ldns_test_check(bool ok, const char *what, const char *file, int line)
+{
+	if (!ok) {
+		fprintf(stderr, "%s:%d: failed: %s\n", file, line, what);
+		failures++;
+	}
+}
+
+/* compares a string that may be NULL with the expected one */
+static bool
+ldns_test_streq(const char *got, const char *expected)
+{
+	if (!got || !expected) {
+		return got == expected;
+	}
+	return strcmp(got, expected) == 0;
+}
+
+/* checks what a function returning a new string gave, and frees it */
+static void
+ldns_test_str(char *got, const char *expected, const char *what, int line)
+{
+	if (!ldns_test_streq(got, expected)) {
+		fprintf(stderr, "%s:%d: %s gave \"%s\", not \"%s\"\n",
+				__FILE__, line, what, got ? got : "(null)",
+				expected ? expected : "(null)");
+		failures++;
+	}
+	LDNS_FREE(got);
+}
+
+#define CHECK_STR(call, expected) ldns_test_str((call), (expected), #call, __LINE__)
+
+static ldns_rr *
+ldns_test_rr(const char *str)
+{
+	ldns_rr *rr;
+
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s: can not parse %s\n", __FILE__, str);
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+static void
+test_number2str(void)
+{
+	ldns_rdf *suffix;
+	ldns_rdf *name;
+	ldns_rdf *dnames[4];
+	const char *numbers[4] = { "+31123456789", "+", "0031", "" };
+	uint8_t wire[LDNS_MAX_DOMAINLEN];
+	char digits[200];
+	const uint8_t expected[] = {
+		1, '3', 1, '2', 1, '1',
+		4, 'e', '1', '6', '4', 4, 'a', 'r', 'p', 'a', 0
+	};
+
+	CHECK_STR(ldns_enum_number2str("+31123456789", NULL),
+			"9.8.7.6.5.4.3.2.1.1.3.e164.arpa");
+	CHECK_STR(ldns_enum_number2str("+1 (555) 010-0", NULL),
+			"0.0.1.0.5.5.5.1.e164.arpa");
+	CHECK_STR(ldns_enum_number2str("+4420", "e164.example"),
+			"0.2.4.4.e164.example");
+	CHECK_STR(ldns_enum_number2str("0031", NULL), "1.3.0.0.e164.arpa");
+	CHECK_STR(ldns_enum_number2str("+", NULL), NULL);
+	CHECK_STR(ldns_enum_number2str("", NULL), NULL);
+
+	/* the digits, last first, each a label, then the suffix as is */
+	CHECK(ldns_enum_number2wire(wire, "+1-23", 5, NULL) == sizeof(expected));
+	CHECK(memcmp(wire, expected, sizeof(expected)) == 0);
+	suffix = ldns_dname_new_frm_str("e164.arpa.");
+	CHECK(ldns_enum_number2wire(wire, "+1-23", 5, suffix) == sizeof(expected));
+	CHECK(memcmp(wire, expected, sizeof(expected)) == 0);
+	/* only len bytes of the number count */
+	CHECK(ldns_enum_number2wire(wire, "+1-23", 2, suffix) == 13);
+	CHECK(ldns_enum_number2wire(wire, "+-", 2, suffix) == 0);
+	/* 123 digits and e164.arpa. make 257 bytes, too long for a name */
+	memset(digits, '7', sizeof(digits));
+	CHECK(ldns_enum_number2wire(wire, digits, 122, suffix) == 255);
+	CHECK(ldns_enum_number2wire(wire, digits, 123, suffix) == 0);
+
+	/* the same name as the text made into a dname */
+	name = ldns_enum_dname_new_frm_number("+31123456789", suffix);
+	CHECK(name != NULL);
+	if (name) {
+		CHECK_STR(ldns_rdf2str(name), "9.8.7.6.5.4.3.2.1.1.3.e164.arpa.");
+		ldns_rdf_deep_free(name);
+	}
+	CHECK(ldns_enum_dname_new_frm_number("+", suffix) == NULL);
+
+	CHECK(ldns_enum_dnames_new_frm_numbers(dnames, numbers, 4, suffix) == 2);
+	CHECK(dnames[0] && dnames[2] && !dnames[1] && !dnames[3]);
+	if (dnames[2]) {
+		CHECK_STR(ldns_rdf2str(dnames[2]), "1.3.0.0.e164.arpa.");
+	}
+	ldns_rdf_deep_free(dnames[0]);
+	ldns_rdf_deep_free(dnames[2]);
+
+	/* and back */
+	name = ldns_dname_new_frm_str("8.7.6.5.4.3.2.1.6.1.3.e164.arpa.");
+	CHECK_STR(ldns_enum_aus_frm_dname(name), "+31612345678");
+	ldns_rdf_deep_free(name);
+	name = ldns_dname_new_frm_str("www.example.com.");
+	CHECK_STR(ldns_enum_aus_frm_dname(name), NULL);
+	ldns_rdf_deep_free(name);
+	ldns_rdf_deep_free(suffix);
+}
+
+/* the text of an rdf made from data, in a new string and in a buffer */
+static void
+ldns_test_rdf_text(ldns_rdf_type type, const uint8_t *data, size_t size,
+		const char *expected, int line)
+{
+	ldns_rdf *rdf;
+	ldns_buffer *buffer;
+	ldns_status s;
+	char *text;
+
+	rdf = ldns_rdf_new_frm_data(type, size, data);
+	buffer = ldns_buffer_new(4);
+	if (!rdf || !buffer) {
+		fprintf(stderr, "%s:%d: out of memory\n", __FILE__, line);
+		exit(EXIT_FAILURE);
+	}
+	if (type == LDNS_RDF_TYPE_STR) {
+		text = ldns_enum_string_rdf2str(rdf);
+		s = ldns_enum_string_rdf2buffer(buffer, rdf);
+	} else {
+		text = ldns_enum_dname_rdf2str(rdf);
+		s = ldns_enum_dname_rdf2buffer(buffer, rdf);
+	}
+	ldns_test_str(text, expected, "rdf2str", line);
+	if (expected) {
+		if (s != LDNS_STATUS_OK ||
+		    ldns_buffer_position(buffer) != strlen(expected) ||
+		    memcmp(ldns_buffer_begin(buffer), expected,
+			    strlen(expected)) != 0) {
+			fprintf(stderr, "%s:%d: rdf2buffer differs\n", __FILE__,
+					line);
+			failures++;
+		}
+	} else if (s != LDNS_STATUS_ENUM_NAPTR_ERR) {
+		fprintf(stderr, "%s:%d: rdf2buffer took a bad rdf\n", __FILE__,
+				line);
+		failures++;
+	}
+	ldns_buffer_free(buffer);
+	ldns_rdf_deep_free(rdf);
+}
+
+#define CHECK_RDF_TEXT(type, data, expected) \
+	ldns_test_rdf_text((type), (data), sizeof(data), (expected), __LINE__)
+
+static void
+test_naptr_text(void)
+{
+	const uint8_t plain[] = { 3, 'a', 'b', 'c' };
+	const uint8_t escaped[] = { 9, 'a', '"', 'b', '\\', 'c', 7, 0xff, ' ', '~' };
+	const uint8_t empty[] = { 0 };
+	const uint8_t short_string[] = { 5, 'a', 'b' };
+	const uint8_t name[] = { 3, 'a', '.', 'b', 3, '(', 'x', ')', 2, 1, 'Z', 0 };
+	const uint8_t root[] = { 0 };
+	const uint8_t short_name[] = { 3, 'a', 'b' };
+
+	CHECK_RDF_TEXT(LDNS_RDF_TYPE_STR, plain, "abc");
+	CHECK_RDF_TEXT(LDNS_RDF_TYPE_STR, escaped, "a\\\"b\\\\c\\007\\255 ~");
+	CHECK_RDF_TEXT(LDNS_RDF_TYPE_STR, empty, "");
+	CHECK_RDF_TEXT(LDNS_RDF_TYPE_STR, short_string, NULL);
+	CHECK_RDF_TEXT(LDNS_RDF_TYPE_DNAME, name, "a\\.b.\\(x\\).\\001Z");
+	CHECK_RDF_TEXT(LDNS_RDF_TYPE_DNAME, root, "");
+	CHECK_RDF_TEXT(LDNS_RDF_TYPE_DNAME, short_name, NULL);
+}
+
+static void
+test_naptr_decode(void)
+{
+	ldns_enum_naptr *naptr;
+	ldns_rr *rr;
+
+	rr = ldns_test_rr("3.2.1.e164.arpa. 60 IN NAPTR 100 10 \"u\" "
+			"\"E2U+web:http+x-lbl:homepage+x-work\" "
+			"\"!^.*$!http://www.example.com/p!\" .");
+	CHECK(ldns_enum_naptr_new_frm_rr(&naptr, rr, NULL) == LDNS_STATUS_OK);
+	CHECK(ldns_enum_naptr_order(naptr) == 100);
+	CHECK(ldns_enum_naptr_preference(naptr) == 10);
+	CHECK(ldns_enum_naptr_ttl(naptr) == 60);
+	CHECK(ldns_test_streq(ldns_enum_naptr_flags(naptr), "u"));
+	CHECK(ldns_test_streq(ldns_enum_naptr_services(naptr),
+			"E2U+web:http+x-lbl:homepage+x-work"));
+	CHECK(ldns_test_streq(ldns_enum_naptr_regexp(naptr),
+			"!^.*$!http://www.example.com/p!"));
+	CHECK(ldns_test_streq(ldns_enum_naptr_replacement(naptr), ""));
+	CHECK(ldns_test_streq(ldns_enum_naptr_uri(naptr),
+			"http://www.example.com/p"));
+	CHECK(ldns_enum_naptr_terminal(naptr));
+	CHECK(!ldns_enum_naptr_encrypted(naptr));
+	CHECK(ldns_enum_naptr_class(naptr) == LDNS_ENUM_SERVICE_WEB);
+	CHECK(ldns_enum_naptr_type_count(naptr) == 1);
+	CHECK(ldns_test_streq(ldns_enum_naptr_type(naptr, 0), "web:http"));
+	CHECK(ldns_enum_naptr_type(naptr, 1) == NULL);
+	CHECK(ldns_enum_naptr_label_count(naptr) == 1);
+	CHECK(ldns_test_streq(ldns_enum_naptr_label(naptr, 0), "homepage"));
+	CHECK(ldns_enum_naptr_lih_count(naptr) == 1);
+	CHECK(ldns_test_streq(ldns_enum_naptr_lih(naptr, 0), "x-work"));
+	CHECK_STR(ldns_enum_naptr_label_description(naptr), "homepage");
+	ldns_enum_naptr_free(naptr);
+	ldns_rr_free(rr);
+
+	/* the number is what the regexp is applied to. The zone text
+	 * parser takes parentheses for line continuation, so the regexp is
+	 * put in afterwards */
+	rr = ldns_test_rr("3.2.1.e164.arpa. 60 IN NAPTR 10 20 \"u\" "
+			"\"E2U+voice:tel\" \"\" .");
+	ldns_rdf_deep_free(ldns_rr_set_rdf(rr, ldns_rdf_new_frm_str(
+			LDNS_RDF_TYPE_STR, "!^\\\\+(.*)$!tel:00\\\\1!"), 4));
+	CHECK(ldns_enum_naptr_new_frm_rr(&naptr, rr, NULL) == LDNS_STATUS_OK);
+	CHECK(ldns_test_streq(ldns_enum_naptr_uri(naptr), "tel:00123"));
+	CHECK(ldns_enum_naptr_class(naptr) == LDNS_ENUM_SERVICE_VOICE);
+	ldns_enum_naptr_free(naptr);
+	CHECK(ldns_enum_naptr_new_frm_rr(&naptr, rr, "+3161") == LDNS_STATUS_OK);
+	CHECK(ldns_test_streq(ldns_enum_naptr_uri(naptr), "tel:003161"));
+	ldns_enum_naptr_free(naptr);
+	ldns_rr_free(rr);
+
+	/* the fields are escaped, the uri is taken from the raw bytes */
+	rr = ldns_test_rr("3.2.1.e164.arpa. 60 IN NAPTR 1 1 \"u\" "
+			"\"E2U+web:http+x-lbl:a\\\"b\" \"!^.*$!http://q\\\"!\" .");
+	CHECK(ldns_enum_naptr_new_frm_rr(&naptr, rr, NULL) == LDNS_STATUS_OK);
+	CHECK(ldns_test_streq(ldns_enum_naptr_services(naptr),
+			"E2U+web:http+x-lbl:a\\\"b"));
+	CHECK(ldns_test_streq(ldns_enum_naptr_regexp(naptr),
+			"!^.*$!http://q\\\"!"));
+	CHECK(ldns_test_streq(ldns_enum_naptr_uri(naptr), "http://q\""));
+	ldns_enum_naptr_free(naptr);
+	ldns_rr_free(rr);
+
+	rr = ldns_test_rr("3.2.1.e164.arpa. 60 IN NAPTR 200 10 \"\" \"\" \"\" "
+			"next.example.com.");
+	CHECK(ldns_enum_naptr_new_frm_rr(&naptr, rr, NULL) == LDNS_STATUS_OK);
+	CHECK(!ldns_enum_naptr_terminal(naptr));
+	CHECK(ldns_test_streq(ldns_enum_naptr_replacement(naptr),
+			"next.example.com"));
+	CHECK(ldns_test_streq(ldns_enum_naptr_uri(naptr), "next.example.com"));
+	CHECK(ldns_enum_naptr_type_count(naptr) == 0);
+	ldns_enum_naptr_free(naptr);
+	ldns_rr_free(rr);
+
+	rr = ldns_test_rr("3.2.1.e164.arpa. 60 IN NAPTR 1 1 \"u\" "
+			"\"x-crypto:data:8210\" \"!^.*$!data:x!\" .");
+	CHECK(ldns_enum_naptr_new_frm_rr(&naptr, rr, NULL) == LDNS_STATUS_OK);
+	CHECK(ldns_enum_naptr_encrypted(naptr));
+	CHECK(ldns_test_streq(ldns_enum_naptr_uri(naptr), ""));
+	ldns_enum_naptr_free(naptr);
+	ldns_rr_free(rr);
+
+	rr = ldns_test_rr("3.2.1.e164.arpa. 60 IN NAPTR 1 1 \"u\" \"E2U+sip\" "
+			"\"!^.*$!\" .");
+	CHECK(ldns_enum_naptr_new_frm_rr(&naptr, rr, NULL) ==
+			LDNS_STATUS_ENUM_REGEXP_ERR);
+	ldns_rr_free(rr);
+
+	rr = ldns_test_rr("3.2.1.e164.arpa. 60 IN A 192.0.2.1");
+	CHECK(ldns_enum_naptr_new_frm_rr(&naptr, rr, NULL) ==
+			LDNS_STATUS_ENUM_NAPTR_ERR);
+	ldns_rr_free(rr);
+}
+
+static void
+test_classify(void)
+{
+	const char *services;
+
+	CHECK(ldns_enum_service_classify("web:http") == LDNS_ENUM_SERVICE_WEB);
+	CHECK(ldns_enum_service_classify("WEB:HTTP") == LDNS_ENUM_SERVICE_WEB);
+	CHECK(ldns_enum_service_classify("email:mailto") ==
+			LDNS_ENUM_SERVICE_MAIL);
+	CHECK(ldns_enum_service_classify("voice:tel") == LDNS_ENUM_SERVICE_VOICE);
+	CHECK(ldns_enum_service_classify("key:http") == LDNS_ENUM_SERVICE_KEY);
+	CHECK(ldns_enum_service_classify("loc:geo") == LDNS_ENUM_SERVICE_LOC);
+	CHECK(ldns_enum_service_classify("vcard:http") ==
+			LDNS_ENUM_SERVICE_VCARD);
+	CHECK(ldns_enum_service_classify("sip") == LDNS_ENUM_SERVICE_OTHER);
+	CHECK(ldns_enum_service_classify("web:https") == LDNS_ENUM_SERVICE_OTHER);
+	CHECK(ldns_enum_service_classify("") == LDNS_ENUM_SERVICE_OTHER);
+	/* a location hint is no type */
+	CHECK(ldns_enum_service_classify("x-mobile") == LDNS_ENUM_SERVICE_OTHER);
+	CHECK(ldns_enum_token_is_lih("x-mobile"));
+	CHECK(!ldns_enum_token_is_lih("voice:tel"));
+
+	/* the first type counts, labels and hints are passed over */
+	services = "E2U+x-lbl:foo+x-mobile+web:http+email:mailto";
+	CHECK(ldns_enum_services_classify((const uint8_t *) services,
+			strlen(services)) == LDNS_ENUM_SERVICE_WEB);
+	services = "E2U+email:mailto+x-work";
+	CHECK(ldns_enum_services_classify((const uint8_t *) services,
+			strlen(services)) == LDNS_ENUM_SERVICE_MAIL);
+	services = "E2U+sip";
+	CHECK(ldns_enum_services_classify((const uint8_t *) services,
+			strlen(services)) == LDNS_ENUM_SERVICE_OTHER);
+	CHECK(ldns_enum_services_classify((const uint8_t *) "", 0) ==
+			LDNS_ENUM_SERVICE_OTHER);
+
+	CHECK(ldns_enum_site_frm_uri("http://www.linkedin.com/in/x") ==
+			LDNS_ENUM_SITE_LINKEDIN);
+	CHECK(ldns_enum_site_frm_uri("http://WWW.LINKEDIN.COM/") ==
+			LDNS_ENUM_SITE_LINKEDIN);
+	CHECK(ldns_enum_site_frm_uri("https://facebook.com/x") ==
+			LDNS_ENUM_SITE_FACEBOOK);
+	CHECK(ldns_enum_site_frm_uri("http://www.hyves.nl") ==
+			LDNS_ENUM_SITE_HYVES);
+	CHECK(ldns_enum_site_frm_uri("http://user@twitter.com/") ==
+			LDNS_ENUM_SITE_TWITTER);
+	CHECK(ldns_enum_site_frm_uri("http://foursquare.com/u") ==
+			LDNS_ENUM_SITE_FOURSQUARE);
+	CHECK(ldns_enum_site_frm_uri("http://www.youtube.com/user/x") ==
+			LDNS_ENUM_SITE_YOUTUBE);
+	CHECK(ldns_enum_site_frm_uri("http://myspace.com/x") ==
+			LDNS_ENUM_SITE_MYSPACE);
+	CHECK(ldns_enum_site_frm_uri("http://www.flickr.com/photos/x") ==
+			LDNS_ENUM_SITE_FLICKR);
+	CHECK(ldns_enum_site_frm_uri("http://x.myopenid.com/") ==
+			LDNS_ENUM_SITE_MYOPENID);
+	/* only the host is looked at */
+	CHECK(ldns_enum_site_frm_uri("http://twitter.com@example.com/") ==
+			LDNS_ENUM_SITE_NONE);
+	CHECK(ldns_enum_site_frm_uri("http://example.com/facebook.com") ==
+			LDNS_ENUM_SITE_NONE);
+	CHECK(ldns_enum_site_frm_uri("") == LDNS_ENUM_SITE_NONE);
+	CHECK(ldns_enum_site_frm_data((const uint8_t *) "http://hyves.nl/",
+			11) == LDNS_ENUM_SITE_NONE);
+	CHECK(ldns_enum_site_frm_data((const uint8_t *) "http://hyves.nl/",
+			15) == LDNS_ENUM_SITE_HYVES);
+	CHECK(ldns_test_streq(ldns_enum_site_name(LDNS_ENUM_SITE_LINKEDIN),
+			"LinkedIn"));
+	CHECK(ldns_enum_site_name(LDNS_ENUM_SITE_NONE) == NULL);
+}
+
+/* the result of ldns_enum_regexp_apply(), or the error */
+static char *
+ldns_test_regexp(const char *regexp, const char *aus)
+{
+	ldns_status s;
+	char *result;
+	char *error;
+
+	s = ldns_enum_regexp_apply(&result, (const uint8_t *) regexp,
+			strlen(regexp), aus);
+	if (s == LDNS_STATUS_OK) {
+		return result;
+	}
+	error = LDNS_XMALLOC(char, 32);
+	if (error) {
+		snprintf(error, 32, "%s", s == LDNS_STATUS_ENUM_REGEXP_NO_MATCH ?
+				"no match" : s == LDNS_STATUS_ENUM_REGEXP_ERR ?
+				"error" : "other");
+	}
+	return error;
+}
+
+#define CHECK_REGEXP(regexp, aus, expected) \
+	ldns_test_str(ldns_test_regexp((regexp), (aus)), (expected), \
+			"regexp " regexp, __LINE__)
+
+static void
+test_regexp_apply(void)
+{
+	CHECK_REGEXP("!^.*$!sip:info@example.com!", "+31612345678",
+			"sip:info@example.com");
+	CHECK_REGEXP("!^\\+31(.*)$!tel:0\\1!", "+31612345678", "tel:0612345678");
+	CHECK_REGEXP("/^\\+(..)(.*)$/sip:\\2@cc\\1.example/", "+31612345678",
+			"sip:612345678@cc31.example");
+	/* what is around the match stays */
+	CHECK_REGEXP("#^\\+31#0#", "+31612345678", "0612345678");
+	CHECK_REGEXP("!^(.)(.)(.)(.)(.)(.)(.)(.)(.)(.)$!\\9\\8\\7\\6\\5\\4\\3\\2\\1\\\\!",
+			"+123456789", "87654321+\\");
+	/* an escaped delimiter is the delimiter itself, other escapes stay */
+	CHECK_REGEXP("!^(.*)$!mailto:\\1\\!here!", "+31", "mailto:+31!here");
+	/* and | unescaped is alternation in the ERE */
+	CHECK_REGEXP("|a\\|b|X|", "xa|by", "xX|by");
+	CHECK_REGEXP("!a\\\\!x!", "a\\", "x");
+	CHECK_REGEXP("!a\\\\!x!", "a!", "no match");
+	CHECK_REGEXP("!a\\!!x!", "a!", "x");
+	CHECK_REGEXP("!ABC!x!i", "+31abc", "+31x");
+	CHECK_REGEXP("!ABC!x!", "+31abc", "no match");
+	CHECK_REGEXP("!^\\+44!x!", "+31612345678", "no match");
+	CHECK_REGEXP("!ABC!x!j", "+31abc", "error");
+	CHECK_REGEXP("1abc1x1", "+31abc", "error");
+	CHECK_REGEXP("!abc!x", "+31abc", "error");
+	CHECK_REGEXP("!(!x!", "+31abc", "error");
+	CHECK_REGEXP("!!", "+31", "error");
+}
+
+/* the records of the names the chase test looks up */
+static const char *ldns_test_chase_zone[] = {
+	"1.2.3.e164.arpa. 60 IN NAPTR 10 10 \"\" \"\" \"\" a.example.",
+	"1.2.3.e164.arpa. 60 IN NAPTR 5 10 \"u\" \"E2U+sip\" \"!^.*$!sip:top@x!\" .",
+	"1.2.3.e164.arpa. 60 IN NAPTR 20 10 \"\" \"\" \"\" loop.example.",
+	"1.2.3.e164.arpa. 60 IN NAPTR 30 10 \"\" \"\" \"\" missing.example.",
+	"a.example. 60 IN NAPTR 2 10 \"u\" \"E2U+web:http\" \"!^.*$!http://a2!\" .",
+	"a.example. 60 IN NAPTR 1 10 \"u\" \"E2U+web:http\" \"!^.*$!http://a1!\" .",
+	"a.example. 60 IN NAPTR 3 10 \"\" \"\" \"\" b.example.",
+	"b.example. 60 IN NAPTR 1 1 \"u\" \"E2U+email:mailto\" \"!^.*$!mailto:b!\" .",
+	"loop.example. 60 IN NAPTR 1 1 \"\" \"\" \"\" 1.2.3.e164.arpa.",
+	"loop.example. 60 IN NAPTR 2 1 \"\" \"\" \"\" loop.example.",
+	NULL
+};
+
+static ldns_rr_list *
+ldns_test_chase_lookup(const ldns_rdf *name, void *arg)
+{
+	ldns_rr_list *naptrs;
+	ldns_rr *rr;
+	size_t i;
+
+	(*(size_t *) arg)++;
+	naptrs = ldns_rr_list_new();
+	for (i = 0; ldns_test_chase_zone[i]; i++) {
+		rr = ldns_test_rr(ldns_test_chase_zone[i]);
+		if (ldns_dname_compare(ldns_rr_owner(rr), name) == 0) {
+			ldns_rr_list_push_rr(naptrs, rr);
+		} else {
+			ldns_rr_free(rr);
+		}
+	}
+	if (ldns_rr_list_rr_count(naptrs) == 0) {
+		ldns_rr_list_free(naptrs);
+		return NULL;
+	}
+	return naptrs;
+}
+
+/* chases the records of 1.2.3.e164.arpa. depth deep, the result has to
+ * be the rrs of the zone at the indexes in expected */
+static void
+ldns_test_chase(size_t depth, const int *expected, size_t count,
+		size_t lookups, int line)
+{
+	ldns_rr_list *naptrs;
+	ldns_rr_list *result;
+	ldns_rdf *name;
+	ldns_rr *rr;
+	size_t looked;
+	size_t i;
+
+	looked = 0;
+	name = ldns_dname_new_frm_str("1.2.3.e164.arpa.");
+	naptrs = ldns_test_chase_lookup(name, &looked);
+	looked = 0;
+	if (ldns_enum_naptr_chase(&result, NULL, naptrs, depth,
+			ldns_test_chase_lookup, NULL, &looked) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s:%d: chase failed\n", __FILE__, line);
+		failures++;
+		result = NULL;
+	}
+	if (result && ldns_rr_list_rr_count(result) != count) {
+		fprintf(stderr, "%s:%d: chase gave %u records, not %u\n",
+				__FILE__, line,
+				(unsigned) ldns_rr_list_rr_count(result),
+				(unsigned) count);
+		failures++;
+	} else if (result) {
+		for (i = 0; i < count; i++) {
+			rr = ldns_test_rr(ldns_test_chase_zone[expected[i]]);
+			if (ldns_rr_compare(rr, ldns_rr_list_rr(result, i)) != 0) {
+				fprintf(stderr, "%s:%d: chase record %u is not %s\n",
+						__FILE__, line, (unsigned) i,
+						ldns_test_chase_zone[expected[i]]);
+				failures++;
+			}
+			ldns_rr_free(rr);
+		}
+	}
+	if (looked != lookups) {
+		fprintf(stderr, "%s:%d: chase looked up %u names, not %u\n",
+				__FILE__, line, (unsigned) looked,
+				(unsigned) lookups);
+		failures++;
+	}
+	ldns_rr_list_deep_free(result);
+	ldns_rr_list_deep_free(naptrs);
+	ldns_rdf_deep_free(name);
+}
+
+#define CHECK_CHASE(depth, expected, lookups) \
+	ldns_test_chase((depth), (expected), \
+			sizeof(expected) / sizeof(expected[0]), (lookups), \
+			__LINE__)
+
+static void
+test_chase(void)
+{
+	/* no following, just the order */
+	const int depth0[] = { 1, 0, 2, 3 };
+	/* a.example. takes the place of its pointer, loop.example. points
+	 * back to the number and to itself so it stays, missing.example.
+	 * has nothing */
+	const int depth1[] = { 1, 5, 4, 6, 8, 9, 3 };
+	const int depth2[] = { 1, 5, 4, 7, 8, 9, 3 };
+	ldns_rr_list *empty;
+	ldns_rr_list *result;
+	size_t looked;
+
+	CHECK_CHASE(0, depth0, 0);
+	CHECK_CHASE(1, depth1, 3);
+	CHECK_CHASE(2, depth2, 4);
+	CHECK_CHASE(3, depth2, 4);
+
+	looked = 0;
+	empty = ldns_rr_list_new();
+	CHECK(ldns_enum_naptr_chase(&result, NULL, empty, LDNS_ENUM_CHASE_DEPTH,
+			ldns_test_chase_lookup, NULL, &looked) == LDNS_STATUS_OK);
+	CHECK(ldns_rr_list_rr_count(result) == 0);
+	CHECK(looked == 0);
+	ldns_rr_list_deep_free(result);
+	ldns_rr_list_free(empty);
+}
+
+int
+main(void)
+{
+	test_number2str();
+	test_naptr_text();
+	test_naptr_decode();
+	test_classify();
+	test_regexp_apply();
+	test_chase();
+	if (failures > 0) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all checks passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,376 @@
+/*
+ * resolver_test.c
+ *
+ * checks which names a search asks a nameserver on the loopback address
+ * for, and that the negative answers it got are not asked for again
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+#include "ldns/config.h"
+
+#include "ldns.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+static int failures = 0;
+
+#define CHECK(cond) ldns_test_check((cond), #cond, __FILE__, __LINE__)
+
+static void
+ldns_test_check(bool ok, const char *what, const char *file, int line)
+{
+	if (!ok) {
+		fprintf(stderr, "%s:%d: failed: %s\n", file, line, what);
+		failures++;
+	}
+}
+
+static ldns_rr *
+ldns_test_rr(const char *str)
+{
+	ldns_rr *rr;
+
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s: can not parse %s\n", __FILE__, str);
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+/*
+ * The nameserver: under good.test. every name has an address, under
+ * nodata.test. names exist without one, and no other names exist. Under
+ * zero.test. the soa of the answer allows no caching.
+ */
+struct ldns_test_server
+{
+	int sock;
+	pthread_mutex_t lock;
+	size_t queries;
+	bool stop;
+};
+typedef struct ldns_test_server ldns_test_server;
+
+static ldns_pkt *
+ldns_test_answer(const ldns_pkt *query)
+{
+	ldns_rr *question = ldns_rr_list_rr(ldns_pkt_question(query), 0);
+	ldns_pkt *answer = ldns_pkt_new();
+	char *name;
+	char str[300];
+	size_t size;
+
+	ldns_pkt_set_id(answer, ldns_pkt_id(query));
+	ldns_pkt_set_qr(answer, true);
+	ldns_pkt_set_aa(answer, true);
+	ldns_pkt_set_rd(answer, ldns_pkt_rd(query));
+	(void) ldns_pkt_push_rr(answer, LDNS_SECTION_QUESTION,
+			ldns_rr_clone(question));
+	name = ldns_rdf2str(ldns_rr_owner(question));
+	size = strlen(name);
+
+	if (size > 10 && strcmp(name + size - 10, "good.test.") == 0) {
+		snprintf(str, sizeof(str), "%s 3600 IN A 192.0.2.1", name);
+		(void) ldns_pkt_push_rr(answer, LDNS_SECTION_ANSWER,
+				ldns_test_rr(str));
+	} else if (size > 12 && strcmp(name + size - 12, "nodata.test.") == 0) {
+		(void) ldns_pkt_push_rr(answer, LDNS_SECTION_AUTHORITY,
+				ldns_test_rr("nodata.test. 3600 IN SOA "
+					"ns.test. h.test. 1 1 1 1 300"));
+	} else if (size > 10 && strcmp(name + size - 10, "zero.test.") == 0) {
+		ldns_pkt_set_rcode(answer, LDNS_RCODE_NXDOMAIN);
+		(void) ldns_pkt_push_rr(answer, LDNS_SECTION_AUTHORITY,
+				ldns_test_rr("zero.test. 3600 IN SOA "
+					"ns.test. h.test. 1 1 1 1 0"));
+	} else {
+		ldns_pkt_set_rcode(answer, LDNS_RCODE_NXDOMAIN);
+		(void) ldns_pkt_push_rr(answer, LDNS_SECTION_AUTHORITY,
+				ldns_test_rr(". 3600 IN SOA "
+					"ns.test. h.test. 1 1 1 1 300"));
+	}
+	LDNS_FREE(name);
+	return answer;
+}
+
+static void *
+ldns_test_server_run(void *arg)
+{
+	ldns_test_server *server = (ldns_test_server *) arg;
+	uint8_t wire[LDNS_MAX_PACKETLEN];
+	struct sockaddr_storage from;
+	socklen_t from_len;
+	ldns_pkt *query, *answer;
+	uint8_t *answer_wire;
+	size_t answer_size;
+	ssize_t size;
+	bool stop;
+
+	do {
+		from_len = sizeof(from);
+		size = recvfrom(server->sock, wire, sizeof(wire), 0,
+				(struct sockaddr *) &from, &from_len);
+		if (size > 0 && ldns_wire2pkt(&query, wire, (size_t) size)
+				== LDNS_STATUS_OK) {
+			pthread_mutex_lock(&server->lock);
+			server->queries++;
+			pthread_mutex_unlock(&server->lock);
+			answer = ldns_test_answer(query);
+			if (ldns_pkt2wire(&answer_wire, answer, &answer_size)
+					== LDNS_STATUS_OK) {
+				(void) sendto(server->sock, answer_wire,
+						answer_size, 0,
+						(struct sockaddr *) &from,
+						from_len);
+				LDNS_FREE(answer_wire);
+			}
+			ldns_pkt_free(answer);
+			ldns_pkt_free(query);
+		}
+		pthread_mutex_lock(&server->lock);
+		stop = server->stop;
+		pthread_mutex_unlock(&server->lock);
+	} while (!stop);
+	return NULL;
+}
+
+/* the queries the server got since the last call */
+static size_t
+ldns_test_queries(ldns_test_server *server)
+{
+	size_t queries;
+
+	pthread_mutex_lock(&server->lock);
+	queries = server->queries;
+	server->queries = 0;
+	pthread_mutex_unlock(&server->lock);
+	return queries;
+}
+
+/* the queries the server got, once it got at least count of them or
+ * half a second went by. A parallel search can be over before all its
+ * queries are in */
+static size_t
+ldns_test_queries_wait(ldns_test_server *server, size_t count)
+{
+	size_t queries;
+	int i;
+
+	for (i = 0; i < 50; i++) {
+		pthread_mutex_lock(&server->lock);
+		queries = server->queries;
+		pthread_mutex_unlock(&server->lock);
+		if (queries >= count) {
+			break;
+		}
+		usleep(10000);
+	}
+	return ldns_test_queries(server);
+}
+
+static ldns_resolver *
+ldns_test_resolver(uint16_t port, const char **domains)
+{
+	ldns_resolver *res = ldns_resolver_new();
+	ldns_rdf *rdf;
+	size_t i;
+
+	rdf = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_A, "127.0.0.1");
+	(void) ldns_resolver_push_nameserver(res, rdf);
+	ldns_rdf_deep_free(rdf);
+	ldns_resolver_set_port(res, port);
+	for (i = 0; domains[i]; i++) {
+		rdf = ldns_dname_new_frm_str(domains[i]);
+		ldns_resolver_push_searchlist(res, rdf);
+		ldns_rdf_deep_free(rdf);
+	}
+	return res;
+}
+
+/* searches for name, checks the rcode and the name that was answered */
+static void
+ldns_test_search(ldns_resolver *res, const char *name, ldns_pkt_rcode rcode,
+		const char *answered, int line)
+{
+	ldns_rdf *rdf = ldns_dname_new_frm_str(name);
+	ldns_pkt *answer;
+	char *qname;
+
+	answer = ldns_resolver_search(res, rdf, LDNS_RR_TYPE_A,
+			LDNS_RR_CLASS_IN, LDNS_RD);
+	if (!answer) {
+		fprintf(stderr, "%s:%d: no answer for %s\n", __FILE__, line,
+				name);
+		failures++;
+		ldns_rdf_deep_free(rdf);
+		return;
+	}
+	qname = ldns_rdf2str(ldns_rr_owner(ldns_rr_list_rr(
+			ldns_pkt_question(answer), 0)));
+	if (ldns_pkt_get_rcode(answer) != rcode ||
+	    !qname || strcmp(qname, answered) != 0) {
+		fprintf(stderr, "%s:%d: %s was answered for %s with rcode %d\n",
+				__FILE__, line, name, qname ? qname : "(null)",
+				(int) ldns_pkt_get_rcode(answer));
+		failures++;
+	}
+	LDNS_FREE(qname);
+	ldns_pkt_free(answer);
+	ldns_rdf_deep_free(rdf);
+}
+
+static void
+test_negative(ldns_test_server *server, uint16_t port)
+{
+	const char *domains[] = { "nx.test.", "nodata.test.", "good.test.", NULL };
+	const char *misses[] = { "nx.test.", "nodata.test.", NULL };
+	const char *nodata[] = { "nodata.test.", "nx.test.", NULL };
+	const char *uncached[] = { "zero.test.", NULL };
+	ldns_resolver *res;
+	ldns_rdf *ns;
+
+	/* the misses before the name that has the records are asked for
+	 * once */
+	res = ldns_test_resolver(port, domains);
+	ldns_test_search(res, "www", LDNS_RCODE_NOERROR, "www.good.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 3);
+	ldns_test_search(res, "www", LDNS_RCODE_NOERROR, "www.good.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 1);
+
+	/* they are forgotten when the nameservers change */
+	ns = ldns_resolver_pop_nameserver(res);
+	(void) ldns_resolver_push_nameserver(res, ns);
+	ldns_rdf_deep_free(ns);
+	ldns_test_search(res, "www", LDNS_RCODE_NOERROR, "www.good.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 3);
+
+	/* another resolver has negative answers of its own */
+	ldns_resolver_deep_free(res);
+	res = ldns_test_resolver(port, domains);
+	ldns_test_search(res, "www", LDNS_RCODE_NOERROR, "www.good.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 3);
+	ldns_resolver_deep_free(res);
+
+	/* all misses, the name itself too: the first name is answered
+	 * as the nameserver did without asking it again */
+	res = ldns_test_resolver(port, misses);
+	ldns_test_search(res, "www", LDNS_RCODE_NXDOMAIN, "www.nx.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 3);
+	ldns_test_search(res, "www", LDNS_RCODE_NXDOMAIN, "www.nx.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 0);
+	/* another name is asked for */
+	ldns_test_search(res, "mail", LDNS_RCODE_NXDOMAIN, "mail.nx.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 3);
+	ldns_resolver_deep_free(res);
+
+	res = ldns_test_resolver(port, nodata);
+	ldns_test_search(res, "www", LDNS_RCODE_NOERROR, "www.nodata.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 3);
+	ldns_test_search(res, "www", LDNS_RCODE_NOERROR, "www.nodata.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 0);
+	ldns_resolver_deep_free(res);
+
+	/* a soa minimum of 0 means it is not kept */
+	res = ldns_test_resolver(port, uncached);
+	ldns_test_search(res, "www", LDNS_RCODE_NXDOMAIN, "www.zero.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 2);
+	ldns_test_search(res, "www", LDNS_RCODE_NXDOMAIN, "www.zero.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 1);
+	ldns_resolver_deep_free(res);
+}
+
+static void
+test_negative_parallel(ldns_test_server *server, uint16_t port)
+{
+	const char *domains[] = { "nx.test.", "nodata.test.", "good.test.", NULL };
+	const char *misses[] = { "nx.test.", "nodata.test.", NULL };
+	ldns_resolver *res;
+
+	res = ldns_test_resolver(port, domains);
+	ldns_resolver_set_search_parallel(res, true);
+	ldns_test_search(res, "www", LDNS_RCODE_NOERROR, "www.good.test.",
+			__LINE__);
+	/* all the names at once */
+	CHECK(ldns_test_queries_wait(server, 4) == 4);
+	/* only good.test. and the name itself are left, the name itself
+	 * is known when its answer came before that of good.test. */
+	ldns_test_search(res, "www", LDNS_RCODE_NOERROR, "www.good.test.",
+			__LINE__);
+	CHECK(ldns_test_queries_wait(server, 2) <= 2);
+	ldns_resolver_deep_free(res);
+
+	res = ldns_test_resolver(port, misses);
+	ldns_resolver_set_search_parallel(res, true);
+	ldns_test_search(res, "www", LDNS_RCODE_NXDOMAIN, "www.nx.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 3);
+	ldns_test_search(res, "www", LDNS_RCODE_NXDOMAIN, "www.nx.test.",
+			__LINE__);
+	CHECK(ldns_test_queries(server) == 0);
+	ldns_resolver_deep_free(res);
+}
+
+int
+main(void)
+{
+	ldns_test_server server;
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	struct timeval timeout;
+	pthread_t thread;
+
+	server.sock = socket(AF_INET, SOCK_DGRAM, 0);
+	server.queries = 0;
+	server.stop = false;
+	pthread_mutex_init(&server.lock, NULL);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	/* so the server sees that it has to stop */
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 100000;
+	if (server.sock < 0 ||
+	    bind(server.sock, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+	    getsockname(server.sock, (struct sockaddr *) &addr, &addr_len)
+			!= 0 ||
+	    setsockopt(server.sock, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+			sizeof(timeout)) != 0 ||
+	    pthread_create(&thread, NULL, ldns_test_server_run, &server)
+			!= 0) {
+		perror("no nameserver on the loopback address");
+		return EXIT_FAILURE;
+	}
+
+	test_negative(&server, ntohs(addr.sin_port));
+	test_negative_parallel(&server, ntohs(addr.sin_port));
+
+	pthread_mutex_lock(&server.lock);
+	server.stop = true;
+	pthread_mutex_unlock(&server.lock);
+	pthread_join(thread, NULL);
+	close(server.sock);
+	pthread_mutex_destroy(&server.lock);
+	if (failures > 0) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all checks passed\n");
+	return EXIT_SUCCESS;
+}
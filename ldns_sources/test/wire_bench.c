@@ -0,0 +1,143 @@
+/*
+ * wire_bench.c
+ *
+ * measures how fast packets are put in wire format, with and without
+ * name compression, and read back
+ *
+ * usage: wire_bench [rounds], each rounds runs every case once
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+#include "ldns/config.h"
+
+#include "ldns.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_PACKETS 200000
+
+static double
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench_report(const char *what, size_t count, double start)
+{
+	printf("%-44s %7.0f ns\n", what,
+			(bench_now() - start) / count * 1e9);
+}
+
+static void
+bench_push(ldns_pkt *pkt, ldns_pkt_section section, const char *str)
+{
+	ldns_rr *rr = NULL;
+
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "can not parse %s\n", str);
+		exit(EXIT_FAILURE);
+	}
+	(void) ldns_pkt_push_rr(pkt, section, rr);
+}
+
+/*
+ * the answer to an ENUM query: NAPTRs of the name asked for, the servers
+ * of the zone and their addresses
+ */
+static ldns_pkt *
+bench_answer(size_t naptrs)
+{
+	ldns_pkt *pkt = ldns_pkt_new();
+	char str[256];
+	size_t i;
+
+	bench_push(pkt, LDNS_SECTION_QUESTION,
+			"1.2.3.4.5.6.7.8.9.1.3.e164.arpa. IN NAPTR");
+	for (i = 0; i < naptrs; i++) {
+		snprintf(str, sizeof(str), "1.2.3.4.5.6.7.8.9.1.3.e164.arpa. "
+				"3600 IN NAPTR %d 10 \"u\" \"E2U+web:http\" "
+				"\"!^.*$!http://www%d.example.nl/!\" .",
+				(int) i, (int) i);
+		bench_push(pkt, LDNS_SECTION_ANSWER, str);
+	}
+	for (i = 0; i < 4; i++) {
+		snprintf(str, sizeof(str),
+				"3.e164.arpa. 3600 IN NS ns%d.dns.nl.", (int) i);
+		bench_push(pkt, LDNS_SECTION_AUTHORITY, str);
+		snprintf(str, sizeof(str),
+				"ns%d.dns.nl. 3600 IN A 10.0.0.%d", (int) i, (int) i);
+		bench_push(pkt, LDNS_SECTION_ADDITIONAL, str);
+	}
+	return pkt;
+}
+
+static void
+bench_packet(const char *what, ldns_pkt *pkt)
+{
+	ldns_buffer *buf = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	ldns_pkt *decoded;
+	char label[64];
+	size_t plain_size, compressed_size;
+	size_t i;
+	double start;
+
+	start = bench_now();
+	for (i = 0; i < BENCH_PACKETS; i++) {
+		ldns_buffer_clear(buf);
+		(void) ldns_pkt2buffer_wire_compress(buf, pkt, false);
+	}
+	snprintf(label, sizeof(label), "%s, uncompressed", what);
+	bench_report(label, BENCH_PACKETS, start);
+	plain_size = ldns_buffer_position(buf);
+
+	start = bench_now();
+	for (i = 0; i < BENCH_PACKETS; i++) {
+		ldns_buffer_clear(buf);
+		(void) ldns_pkt2buffer_wire(buf, pkt);
+	}
+	snprintf(label, sizeof(label), "%s, compressed", what);
+	bench_report(label, BENCH_PACKETS, start);
+	compressed_size = ldns_buffer_position(buf);
+
+	/* what the receiver pays, the pointers are followed */
+	start = bench_now();
+	for (i = 0; i < BENCH_PACKETS / 4; i++) {
+		if (ldns_wire2pkt(&decoded, ldns_buffer_begin(buf),
+				compressed_size) == LDNS_STATUS_OK) {
+			ldns_pkt_free(decoded);
+		}
+	}
+	snprintf(label, sizeof(label), "%s, compressed, read", what);
+	bench_report(label, BENCH_PACKETS / 4, start);
+
+	printf("%-44s %7u -> %u octets\n", what, (unsigned int) plain_size,
+			(unsigned int) compressed_size);
+	ldns_buffer_free(buf);
+}
+
+int
+main(int argc, char **argv)
+{
+	ldns_pkt *small = bench_answer(1);
+	ldns_pkt *large = bench_answer(20);
+	int rounds = 1;
+	int round;
+
+	if (argc > 1) {
+		rounds = atoi(argv[1]);
+	}
+	for (round = 0; round < rounds; round++) {
+		bench_packet("1 NAPTR, 4 NS, 4 A", small);
+		bench_packet("20 NAPTRs, 4 NS, 4 A", large);
+	}
+	ldns_pkt_free(small);
+	ldns_pkt_free(large);
+	return EXIT_SUCCESS;
+}
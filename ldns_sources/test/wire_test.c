@@ -0,0 +1,194 @@
+/*
+ * wire_test.c
+ *
+ * checks that packets put in wire format with name compression read
+ * back the same as they were
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+#include "ldns/config.h"
+
+#include "ldns.h"
+
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond) ldns_test_check((cond), #cond, __FILE__, __LINE__)
+
+static void
+ldns_test_check(bool ok, const char *what, const char *file, int line)
+{
+	if (!ok) {
+		fprintf(stderr, "%s:%d: failed: %s\n", file, line, what);
+		failures++;
+	}
+}
+
+static void
+ldns_test_push(ldns_pkt *pkt, ldns_pkt_section section, const char *str)
+{
+	ldns_rr *rr;
+
+	if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s: can not parse %s\n", __FILE__, str);
+		exit(EXIT_FAILURE);
+	}
+	(void) ldns_pkt_push_rr(pkt, section, rr);
+}
+
+/* puts pkt in wire format with and without compression, checks that the
+ * compressed one is no larger and that both read back as pkt. Returns
+ * the size of the compressed one */
+static size_t
+ldns_test_roundtrip(ldns_pkt *pkt, int line)
+{
+	ldns_buffer *plain = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	ldns_buffer *compressed = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	ldns_buffer *wire;
+	ldns_pkt *decoded;
+	char *expected, *got;
+	size_t size;
+	int i;
+
+	CHECK(ldns_pkt2buffer_wire_compress(plain, pkt, false)
+			== LDNS_STATUS_OK);
+	CHECK(ldns_pkt2buffer_wire(compressed, pkt) == LDNS_STATUS_OK);
+	size = ldns_buffer_position(compressed);
+	if (size > ldns_buffer_position(plain)) {
+		fprintf(stderr, "%s:%d: compressed %u octets, plain %u\n",
+				__FILE__, line, (unsigned int) size,
+				(unsigned int) ldns_buffer_position(plain));
+		failures++;
+	}
+
+	for (i = 0; i < 2; i++) {
+		wire = i ? compressed : plain;
+		decoded = NULL;
+		if (ldns_wire2pkt(&decoded, ldns_buffer_begin(wire),
+				ldns_buffer_position(wire)) != LDNS_STATUS_OK) {
+			fprintf(stderr, "%s:%d: the %s packet does not read\n",
+					__FILE__, line,
+					i ? "compressed" : "plain");
+			failures++;
+			continue;
+		}
+		/* the text has the size of the answer */
+		ldns_pkt_set_size(pkt, ldns_pkt_size(decoded));
+		expected = ldns_pkt2str(pkt);
+		got = ldns_pkt2str(decoded);
+		if (!expected || !got || strcmp(expected, got) != 0) {
+			fprintf(stderr, "%s:%d: the %s packet reads back as\n"
+					"%s\nnot as\n%s\n", __FILE__, line,
+					i ? "compressed" : "plain",
+					got ? got : "(null)",
+					expected ? expected : "(null)");
+			failures++;
+		}
+		LDNS_FREE(expected);
+		LDNS_FREE(got);
+		ldns_pkt_free(decoded);
+	}
+	ldns_buffer_free(plain);
+	ldns_buffer_free(compressed);
+	return size;
+}
+
+static void
+test_pointers(void)
+{
+	ldns_pkt *pkt = ldns_pkt_new();
+	ldns_buffer *wire = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	uint8_t *data;
+	/* the question name, at offset 12 */
+	const uint8_t question[] = {
+		3, 'w', 'w', 'w', 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e',
+		2, 'n', 'l', 0, 0, 1, 0, 1
+	};
+
+	ldns_test_push(pkt, LDNS_SECTION_QUESTION, "www.example.nl. IN A");
+	ldns_test_push(pkt, LDNS_SECTION_ANSWER,
+			"www.example.nl. 3600 IN A 192.0.2.1");
+	ldns_test_push(pkt, LDNS_SECTION_AUTHORITY,
+			"example.nl. 3600 IN NS ns.example.nl.");
+	CHECK(ldns_pkt2buffer_wire(wire, pkt) == LDNS_STATUS_OK);
+	data = ldns_buffer_begin(wire);
+
+	CHECK(ldns_buffer_position(wire) == 12 + sizeof(question)
+			+ 2 + 10 + 4 + 2 + 10 + 5);
+	CHECK(memcmp(data + 12, question, sizeof(question)) == 0);
+	/* the answer is at the question name */
+	data += 12 + sizeof(question);
+	CHECK(data[0] == 0xc0 && data[1] == 12);
+	/* the zone is the suffix of it, and the server a label on that */
+	data += 2 + 10 + 4;
+	CHECK(data[0] == 0xc0 && data[1] == 16);
+	data += 2 + 10;
+	CHECK(data[0] == 2 && data[1] == 'n' && data[2] == 's');
+	CHECK(data[3] == 0xc0 && data[4] == 16);
+
+	(void) ldns_test_roundtrip(pkt, __LINE__);
+	ldns_buffer_free(wire);
+	ldns_pkt_free(pkt);
+}
+
+static void
+test_case(void)
+{
+	ldns_pkt *pkt = ldns_pkt_new();
+
+	/* names that only differ in case keep the case they were given */
+	ldns_test_push(pkt, LDNS_SECTION_QUESTION, "WWW.Example.NL. IN A");
+	ldns_test_push(pkt, LDNS_SECTION_ANSWER,
+			"www.example.nl. 3600 IN CNAME Web.EXAMPLE.nl.");
+	ldns_test_push(pkt, LDNS_SECTION_ANSWER,
+			"web.example.NL. 3600 IN A 192.0.2.1");
+	ldns_test_push(pkt, LDNS_SECTION_AUTHORITY,
+			"Example.nl. 3600 IN NS ns.EXAMPLE.NL.");
+	(void) ldns_test_roundtrip(pkt, __LINE__);
+	ldns_pkt_free(pkt);
+}
+
+static void
+test_large(void)
+{
+	ldns_pkt *pkt = ldns_pkt_new();
+	char str[256];
+	size_t size;
+	int i;
+
+	/* past 16K octets names can not be pointed at any more, the
+	 * later ones have to point before that or be written out */
+	ldns_test_push(pkt, LDNS_SECTION_QUESTION,
+			"1.3.e164.arpa. IN NAPTR");
+	for (i = 0; i < 700; i++) {
+		snprintf(str, sizeof(str), "%d.%d.%d.1.3.e164.arpa. 3600 IN "
+				"NAPTR 10 10 \"u\" \"E2U+sip\" "
+				"\"!^.*$!sip:%d@example.nl!\" .",
+				i % 10, i / 10 % 10, i / 100, i);
+		ldns_test_push(pkt, LDNS_SECTION_ANSWER, str);
+		snprintf(str, sizeof(str), "a%d.%s.nl. 60 IN CNAME b%d.%s.NL.",
+				i, (i & 1) ? "Example" : "example", i % 7,
+				(i & 2) ? "example" : "EXAMPLE");
+		ldns_test_push(pkt, LDNS_SECTION_ANSWER, str);
+	}
+	size = ldns_test_roundtrip(pkt, __LINE__);
+	CHECK(size > 0x4000);
+	ldns_pkt_free(pkt);
+}
+
+int
+main(void)
+{
+	test_pointers();
+	test_case();
+	test_large();
+	if (failures > 0) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all checks passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+/*
+ * zone_bench.c
+ *
+ * measures how fast zone data is read: tokenised from a mapping and
+ * from a stream, parsed into a zone from a file and from a buffer, and
+ * how fast single rrs are parsed with and without a reused parser
+ *
+ * usage: zone_bench [rounds], each rounds runs every case once. The zone
+ * is written to a file in TMPDIR, or /tmp
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+#include "ldns/config.h"
+
+#include "ldns.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_RECORDS 200000
+/* stays below the size that is parsed on all cpus */
+#define BENCH_SMALL    5000
+
+static double
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench_report(const char *what, size_t count, double start)
+{
+	printf("%-44s %7.2f M/s\n", what, count / (bench_now() - start) / 1e6);
+}
+
+/* an ENUM zone of count numbers, with comments and a record over lines */
+static ldns_buffer *
+bench_make_zone(size_t count)
+{
+	ldns_buffer *zone = ldns_buffer_new(count * 96);
+	size_t i;
+	unsigned int n;
+
+	if (!zone) {
+		fprintf(stderr, "out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	(void) ldns_buffer_printf(zone, "$ORIGIN 1.3.e164.arpa.\n"
+			"$TTL 3600\n"
+			"@ IN SOA ns.example.nl. hostmaster.example.nl. (\n"
+			"\t2011010101 ; serial\n"
+			"\t3600 900 604800 300 )\n"
+			"@ IN NS ns.example.nl.\n");
+	for (i = 0; i < count; i++) {
+		n = (unsigned int) i;
+		if (i % 100 == 0) {
+			(void) ldns_buffer_printf(zone, "; numbers %u and up\n", n);
+		}
+		(void) ldns_buffer_printf(zone, "%u.%u.%u.%u.%u.%u.6 IN NAPTR "
+				"100 10 \"u\" \"E2U+sip\" "
+				"\"!^.*$!sip:+316%06u@example.nl!\" .\n",
+				n % 10, n / 10 % 10, n / 100 % 10,
+				n / 1000 % 10, n / 10000 % 10, n / 100000 % 10, n);
+	}
+	return zone;
+}
+
+static void
+bench_tokens(ldns_buffer *zone, const char *path)
+{
+	char token[LDNS_MAX_LINELEN + 1];
+	size_t lines;
+	int line_nr;
+	double start;
+	FILE *fp;
+
+	ldns_buffer_rewind(zone);
+	line_nr = 0;
+	lines = 0;
+	start = bench_now();
+	while (ldns_mget_token_l(zone, token, "\n", LDNS_MAX_LINELEN,
+			&line_nr) > 0) {
+		lines++;
+	}
+	bench_report("lines tokenised from memory", lines, start);
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	line_nr = 0;
+	lines = 0;
+	start = bench_now();
+	while (ldns_fget_token_l(fp, token, "\n", LDNS_MAX_LINELEN,
+			&line_nr) > 0) {
+		lines++;
+	}
+	bench_report("lines tokenised from a stream", lines, start);
+	fclose(fp);
+}
+
+static void
+bench_zone_file(const char *path, size_t count)
+{
+	ldns_zone *z;
+	int line_nr = 0;
+	double start;
+	FILE *fp;
+
+	start = bench_now();
+	if (ldns_zone_new_frm_file_l(&z, path, NULL, 0, LDNS_RR_CLASS_IN,
+			&line_nr) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s does not parse at line %d\n", path, line_nr);
+		exit(EXIT_FAILURE);
+	}
+	bench_report("zone rrs read from a mapped file", count, start);
+	ldns_zone_deep_free(z);
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	line_nr = 0;
+	start = bench_now();
+	if (ldns_zone_new_frm_fp_l(&z, fp, NULL, 0, LDNS_RR_CLASS_IN,
+			&line_nr) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s does not parse at line %d\n", path, line_nr);
+		exit(EXIT_FAILURE);
+	}
+	bench_report("zone rrs read from a stream", count, start);
+	ldns_zone_deep_free(z);
+	fclose(fp);
+}
+
+static void
+bench_rrs(void)
+{
+	ldns_rr_parser *parser = ldns_rr_parser_new();
+	char str[256];
+	ldns_rr *rr;
+	size_t i;
+	unsigned int n;
+	double start;
+
+	if (!parser) {
+		fprintf(stderr, "out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	start = bench_now();
+	for (i = 0; i < BENCH_RECORDS; i++) {
+		n = (unsigned int) i;
+		snprintf(str, sizeof(str), "%u.%u.%u.6.1.3.e164.arpa. 3600 IN NAPTR "
+				"100 10 \"u\" \"E2U+sip\" \"!^.*$!sip:%u@example.nl!\" .",
+				n % 10, n / 10 % 10, n / 100 % 10, n);
+		if (ldns_rr_new_frm_str(&rr, str, 0, NULL, NULL) != LDNS_STATUS_OK) {
+			fprintf(stderr, "can not parse %s\n", str);
+			exit(EXIT_FAILURE);
+		}
+		ldns_rr_free(rr);
+	}
+	bench_report("rrs parsed one by one", BENCH_RECORDS, start);
+
+	start = bench_now();
+	for (i = 0; i < BENCH_RECORDS; i++) {
+		n = (unsigned int) i;
+		snprintf(str, sizeof(str), "%u.%u.%u.6.1.3.e164.arpa. 3600 IN NAPTR "
+				"100 10 \"u\" \"E2U+sip\" \"!^.*$!sip:%u@example.nl!\" .",
+				n % 10, n / 10 % 10, n / 100 % 10, n);
+		if (ldns_rr_parser_frm_str(parser, &rr, str, 0, NULL, NULL)
+				!= LDNS_STATUS_OK) {
+			fprintf(stderr, "can not parse %s\n", str);
+			exit(EXIT_FAILURE);
+		}
+		ldns_rr_free(rr);
+	}
+	bench_report("rrs parsed with one parser", BENCH_RECORDS, start);
+	ldns_rr_parser_free(parser);
+}
+
+static void
+bench_zone_buffer(const char *what, ldns_buffer *zone, size_t count,
+		int times)
+{
+	ldns_zone *z;
+	int line_nr;
+	int i;
+	double start;
+
+	start = bench_now();
+	for (i = 0; i < times; i++) {
+		ldns_buffer_rewind(zone);
+		line_nr = 0;
+		if (ldns_zone_new_frm_buffer_l(&z, zone, NULL, 0,
+				LDNS_RR_CLASS_IN, &line_nr) != LDNS_STATUS_OK) {
+			fprintf(stderr, "the zone does not parse at line %d\n",
+					line_nr);
+			exit(EXIT_FAILURE);
+		}
+		ldns_zone_deep_free(z);
+	}
+	bench_report(what, count * times, start);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *tmpdir = getenv("TMPDIR");
+	char path[256];
+	ldns_buffer *zone;
+	ldns_buffer *small;
+	char what[64];
+	int rounds = 1;
+	int round;
+	int fd;
+	FILE *fp;
+
+	if (argc > 1) {
+		rounds = atoi(argv[1]);
+	}
+	snprintf(path, sizeof(path), "%s/zone_bench.XXXXXX",
+			tmpdir ? tmpdir : "/tmp");
+	fd = mkstemp(path);
+	fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+	if (!fp) {
+		perror(path);
+		return EXIT_FAILURE;
+	}
+	zone = bench_make_zone(BENCH_RECORDS);
+	if (fwrite(ldns_buffer_begin(zone), 1, ldns_buffer_position(zone), fp)
+			!= ldns_buffer_position(zone)) {
+		perror(path);
+		fclose(fp);
+		unlink(path);
+		return EXIT_FAILURE;
+	}
+	fclose(fp);
+	ldns_buffer_flip(zone);
+	small = bench_make_zone(BENCH_SMALL);
+	ldns_buffer_flip(small);
+	snprintf(what, sizeof(what), "zone rrs read from a buffer, %ld cpus",
+			sysconf(_SC_NPROCESSORS_ONLN));
+
+	for (round = 0; round < rounds; round++) {
+		bench_tokens(zone, path);
+		bench_zone_file(path, BENCH_RECORDS + 2);
+		bench_rrs();
+		bench_zone_buffer("zone rrs read from a small buffer, one cpu",
+				small, BENCH_SMALL + 2, BENCH_RECORDS / BENCH_SMALL);
+		bench_zone_buffer(what, zone, BENCH_RECORDS + 2, 1);
+	}
+	ldns_buffer_free(small);
+	ldns_buffer_free(zone);
+	unlink(path);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,661 @@
+/*
+ * zone_test.c
+ *
+ * checks the lookups in a zone index, a zone snapshot and the ENUM index
+ * and filter of a zone against a fixed zone, and how incremental
+ * transfers from a nameserver on the loopback address change a zone
+ *
+ * a Net::DNS like library for C
+ *
+ * See the file LICENSE for the license
+ */
+#include "ldns/config.h"
+
+#include "ldns.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+static int failures = 0;
+
+#define CHECK(cond) ldns_test_check((cond), #cond, __FILE__, __LINE__)
+
+static void
+ldns_test_check(bool ok, const char *what, const char *file, int line)
+{
+	if (!ok) {
+		fprintf(stderr, "%s:%d: failed: %s\n", file, line, what);
+		failures++;
+	}
+}
+
+static ldns_rr *
+ldns_test_rr(const char *str)
+{
+	ldns_rr *rr;
+
+	if (ldns_rr_new_frm_str(&rr, str, 3600, NULL, NULL) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s: can not parse %s\n", __FILE__, str);
+		exit(EXIT_FAILURE);
+	}
+	return rr;
+}
+
+static const char ldns_test_zone_text[] =
+	"$ORIGIN 1.3.e164.arpa.\n"
+	"$TTL 3600\n"
+	"@ IN SOA ns.example.nl. hostmaster.example.nl. 1 3600 900 604800 300\n"
+	"@ IN NS ns.example.nl.\n"
+	"7.6.5.4.3.2.1.0.2 IN NAPTR 10 10 \"u\" \"E2U+sip\" "
+		"\"!^.*$!sip:info@example.nl!\" .\n"
+	"7.6.5.4.3.2.1.0.2 IN NAPTR 20 10 \"u\" \"E2U+web:http\" "
+		"\"!^.*$!http://www.example.nl/!\" .\n"
+	"7.6.5.4.3.2.1.0.2 IN TXT \"a number\"\n"
+	"8.6.5.4.3.2.1.0.2 IN NAPTR 10 10 \"u\" \"E2U+sip\" "
+		"\"!^.*$!sip:sales@example.nl!\" .\n"
+	"0.2 IN NAPTR 10 10 \"u\" \"E2U+sip\" "
+		"\"!^.*$!sip:amsterdam@example.nl!\" .\n"
+	"www IN NAPTR 10 10 \"u\" \"E2U+sip\" \"!^.*$!sip:www@example.nl!\" .\n"
+	"www IN A 192.0.2.80\n"
+	"sub IN NS ns.sub\n"
+	"ns.sub IN A 192.0.2.53\n";
+
+static ldns_zone *
+ldns_test_zone(void)
+{
+	ldns_buffer *text = ldns_buffer_new(sizeof(ldns_test_zone_text));
+	ldns_zone *zone;
+	int line_nr = 0;
+
+	ldns_buffer_write(text, ldns_test_zone_text,
+			sizeof(ldns_test_zone_text) - 1);
+	ldns_buffer_flip(text);
+	if (ldns_zone_new_frm_buffer_l(&zone, text, NULL, 0, LDNS_RR_CLASS_IN,
+			&line_nr) != LDNS_STATUS_OK) {
+		fprintf(stderr, "%s: the zone does not parse at line %d\n",
+				__FILE__, line_nr);
+		exit(EXIT_FAILURE);
+	}
+	ldns_buffer_free(text);
+	return zone;
+}
+
+/* the number of rrs in a list that may be NULL */
+static size_t
+ldns_test_count(const ldns_rr_list *rrs)
+{
+	return rrs ? ldns_rr_list_rr_count(rrs) : 0;
+}
+
+static void
+test_index(void)
+{
+	ldns_zone *zone = ldns_test_zone();
+	ldns_zone_index *index = ldns_zone_index_new(zone);
+	ldns_rdf *number = ldns_dname_new_frm_str("7.6.5.4.3.2.1.0.2.1.3.E164.ARPA.");
+	ldns_rdf *www = ldns_dname_new_frm_str("www.1.3.e164.arpa.");
+	ldns_rdf *below = ldns_dname_new_frm_str("a.b.sub.1.3.e164.arpa.");
+	ldns_rdf *apex = ldns_dname_new_frm_str("1.3.e164.arpa.");
+	ldns_rdf *ns = ldns_dname_new_frm_str("ns.sub.1.3.e164.arpa.");
+	ldns_rr_list *rrs;
+	ldns_rr *rr;
+	size_t glue;
+	size_t i;
+
+	CHECK(index != NULL);
+	/* the apex, three numbers, www, sub and ns.sub */
+	CHECK(ldns_zone_index_name_count(index) == 7);
+
+	rrs = ldns_zone_index_rrset(index, number, LDNS_RR_TYPE_NAPTR);
+	CHECK(ldns_test_count(rrs) == 2);
+	if (ldns_test_count(rrs) == 2) {
+		/* in zone order */
+		CHECK(ldns_rdf2native_int16(ldns_rr_rdf(
+				ldns_rr_list_rr(rrs, 0), 0)) == 10);
+		CHECK(ldns_rdf2native_int16(ldns_rr_rdf(
+				ldns_rr_list_rr(rrs, 1), 0)) == 20);
+	}
+	CHECK(ldns_zone_index_rrset(index, number, LDNS_RR_TYPE_A) == NULL);
+	CHECK(ldns_zone_index_rrset(index, apex, LDNS_RR_TYPE_SOA) != NULL);
+
+	rrs = ldns_zone_index_name_rrs(index, number);
+	CHECK(ldns_test_count(rrs) == 3);
+	if (ldns_test_count(rrs) == 3) {
+		CHECK(ldns_rr_get_type(ldns_rr_list_rr(rrs, 0))
+				== LDNS_RR_TYPE_NAPTR);
+		CHECK(ldns_rr_get_type(ldns_rr_list_rr(rrs, 2))
+				== LDNS_RR_TYPE_TXT);
+	}
+	ldns_rr_list_free(rrs);
+	CHECK(ldns_zone_index_name_rrs(index, below) == NULL);
+
+	/* sub is delegated, the apex is not a cut */
+	rrs = ldns_zone_index_zone_cut(index, below);
+	CHECK(ldns_test_count(rrs) == 1);
+	CHECK(ldns_zone_index_zone_cut(index, www) == NULL);
+	CHECK(ldns_zone_index_zone_cut(index, apex) == NULL);
+
+	/* only the address of ns.sub is glue */
+	glue = 0;
+	for (i = 0; i < ldns_rr_list_rr_count(ldns_zone_rrs(zone)); i++) {
+		rr = ldns_rr_list_rr(ldns_zone_rrs(zone), i);
+		if (ldns_zone_index_is_glue(index, rr)) {
+			CHECK(ldns_rr_get_type(rr) == LDNS_RR_TYPE_A);
+			CHECK(ldns_dname_compare(ldns_rr_owner(rr), ns) == 0);
+			glue++;
+		}
+	}
+	CHECK(glue == 1);
+
+	ldns_rdf_deep_free(number);
+	ldns_rdf_deep_free(www);
+	ldns_rdf_deep_free(below);
+	ldns_rdf_deep_free(apex);
+	ldns_rdf_deep_free(ns);
+	ldns_zone_index_free(index);
+	ldns_zone_deep_free(zone);
+}
+
+/* checks a snapshot lookup against the same one in an index */
+static void
+ldns_test_same(ldns_rr_list *got, const ldns_rr_list *expected, int line)
+{
+	if (ldns_test_count(got) != ldns_test_count(expected) ||
+	    (got && ldns_rr_list_compare(got, expected) != 0)) {
+		fprintf(stderr, "%s:%d: the snapshot has other rrs than the "
+				"zone\n", __FILE__, line);
+		failures++;
+	}
+}
+
+static void
+test_snapshot(void)
+{
+	ldns_zone *zone = ldns_test_zone();
+	ldns_zone_index *index = ldns_zone_index_new(zone);
+	ldns_zone_snapshot *snapshot;
+	ldns_zone *copy;
+	ldns_rr_list *rrs, *expected;
+	ldns_rr *soa;
+	ldns_rdf *names[4];
+	const char *tmpdir = getenv("TMPDIR");
+	char path[256];
+	uint8_t *data;
+	size_t size;
+	long end;
+	size_t i;
+	int fd;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/zone_test.XXXXXX",
+			tmpdir ? tmpdir : "/tmp");
+	fd = mkstemp(path);
+	CHECK(fd >= 0);
+	if (fd < 0) {
+		return;
+	}
+	close(fd);
+	CHECK(ldns_zone_snapshot_write_file(path, zone) == LDNS_STATUS_OK);
+	CHECK(ldns_zone_snapshot_new_frm_file(&snapshot, path)
+			== LDNS_STATUS_OK);
+
+	CHECK(ldns_zone_snapshot_rr_count(snapshot) ==
+			ldns_rr_list_rr_count(ldns_zone_rrs(zone)) + 1);
+	soa = ldns_zone_snapshot_soa(snapshot);
+	CHECK(soa && ldns_rr_compare(soa, ldns_zone_soa(zone)) == 0);
+	ldns_rr_free(soa);
+
+	names[0] = ldns_dname_new_frm_str("7.6.5.4.3.2.1.0.2.1.3.E164.arpa.");
+	names[1] = ldns_dname_new_frm_str("WWW.1.3.e164.arpa.");
+	names[2] = ldns_dname_new_frm_str("a.b.sub.1.3.e164.arpa.");
+	names[3] = ldns_dname_new_frm_str("6.6.5.4.3.2.1.0.2.1.3.e164.arpa.");
+	for (i = 0; i < 4; i++) {
+		rrs = ldns_zone_snapshot_rrset(snapshot, names[i],
+				LDNS_RR_TYPE_NAPTR);
+		ldns_test_same(rrs, ldns_zone_index_rrset(index, names[i],
+				LDNS_RR_TYPE_NAPTR), __LINE__);
+		ldns_rr_list_deep_free(rrs);
+
+		rrs = ldns_zone_snapshot_name_rrs(snapshot, names[i]);
+		expected = ldns_zone_index_name_rrs(index, names[i]);
+		ldns_test_same(rrs, expected, __LINE__);
+		ldns_rr_list_deep_free(rrs);
+		ldns_rr_list_free(expected);
+
+		rrs = ldns_zone_snapshot_zone_cut(snapshot, names[i]);
+		ldns_test_same(rrs, ldns_zone_index_zone_cut(index, names[i]),
+				__LINE__);
+		ldns_rr_list_deep_free(rrs);
+		ldns_rdf_deep_free(names[i]);
+	}
+
+	/* all of it back is the zone in canonical order */
+	CHECK(ldns_zone_new_frm_snapshot(&copy, snapshot) == LDNS_STATUS_OK);
+	ldns_zone_sort(zone);
+	CHECK(ldns_rr_compare(ldns_zone_soa(copy), ldns_zone_soa(zone)) == 0);
+	CHECK(ldns_rr_list_compare(ldns_zone_rrs(copy), ldns_zone_rrs(zone))
+			== 0);
+	ldns_zone_deep_free(copy);
+	ldns_zone_snapshot_free(snapshot);
+
+	/* damaged data is turned down */
+	fp = fopen(path, "r");
+	CHECK(fp != NULL);
+	if (fp) {
+		fseek(fp, 0, SEEK_END);
+		end = ftell(fp);
+		rewind(fp);
+		size = end > 0 ? (size_t) end : 0;
+		data = LDNS_XMALLOC(uint8_t, size);
+		CHECK(fread(data, 1, size, fp) == size);
+		fclose(fp);
+
+		CHECK(ldns_zone_snapshot_new_frm_data(&snapshot, data, size)
+				== LDNS_STATUS_OK);
+		ldns_zone_snapshot_free(snapshot);
+		CHECK(ldns_zone_snapshot_new_frm_data(&snapshot, data,
+				size / 2) != LDNS_STATUS_OK);
+		data[size / 2] ^= 0x40;
+		CHECK(ldns_zone_snapshot_new_frm_data(&snapshot, data, size)
+				!= LDNS_STATUS_OK);
+		LDNS_FREE(data);
+	}
+	unlink(path);
+	ldns_zone_index_free(index);
+	ldns_zone_deep_free(zone);
+}
+
+static void
+test_enum_index(void)
+{
+	ldns_zone *zone = ldns_test_zone();
+	ldns_rdf *suffix = ldns_dname_new_frm_str("e164.arpa.");
+	ldns_rdf *name = ldns_dname_new_frm_str("0.2.1.3.E164.Arpa.");
+	ldns_zone_enum_index *apex = ldns_zone_enum_index_new(zone, NULL);
+	ldns_zone_enum_index *index = ldns_zone_enum_index_new(zone, suffix);
+	ldns_rr_list *rrs;
+
+	CHECK(apex != NULL && index != NULL);
+	/* www is not a number, the TXT not a NAPTR */
+	CHECK(ldns_zone_enum_index_number_count(apex) == 3);
+	CHECK(ldns_zone_enum_index_number_count(index) == 3);
+
+	/* relative to the apex of the zone, or to the suffix */
+	rrs = ldns_zone_enum_index_naptrs(apex, "201234567");
+	CHECK(ldns_test_count(rrs) == 2);
+	if (ldns_test_count(rrs) == 2) {
+		CHECK(ldns_rdf2native_int16(ldns_rr_rdf(
+				ldns_rr_list_rr(rrs, 0), 0)) == 10);
+	}
+	ldns_rr_list_free(rrs);
+	rrs = ldns_zone_enum_index_naptrs(index, "+31201234567");
+	CHECK(ldns_test_count(rrs) == 2);
+	ldns_rr_list_free(rrs);
+	rrs = ldns_zone_enum_index_naptrs(index, "+31201234568");
+	CHECK(ldns_test_count(rrs) == 1);
+	ldns_rr_list_free(rrs);
+
+	/* numbers on the way to others, longer ones and no digits */
+	CHECK(ldns_zone_enum_index_naptrs(index, "+312012") == NULL);
+	CHECK(ldns_zone_enum_index_naptrs(index, "+312012345678") == NULL);
+	CHECK(ldns_zone_enum_index_naptrs(index, "+") == NULL);
+	CHECK(ldns_zone_enum_index_naptrs(apex, "+31201234567") == NULL);
+
+	rrs = ldns_zone_enum_index_naptrs_frm_dname(index, name);
+	CHECK(ldns_test_count(rrs) == 1);
+	ldns_rr_list_free(rrs);
+
+	ldns_zone_enum_index_free(apex);
+	ldns_zone_enum_index_free(index);
+	ldns_rdf_deep_free(name);
+	ldns_rdf_deep_free(suffix);
+	ldns_zone_deep_free(zone);
+}
+
+static void
+test_enum_filter(void)
+{
+	ldns_zone *zone = ldns_test_zone();
+	ldns_rdf *suffix = ldns_dname_new_frm_str("e164.arpa.");
+	ldns_zone_enum_filter *filter;
+	ldns_zone_enum_filter *from_snapshot;
+	ldns_zone_snapshot *snapshot;
+	const char *numbers[3] = {
+		"+31201234567", "+31201234568", "+3120"
+	};
+	const char *tmpdir = getenv("TMPDIR");
+	char path[256];
+	char number[32];
+	size_t passed;
+	int fd;
+	int i;
+
+	filter = ldns_zone_enum_filter_new(ldns_zone_rrs(zone), suffix);
+	CHECK(filter != NULL);
+	CHECK(ldns_zone_enum_filter_number_count(filter) == 3);
+	for (i = 0; i < 3; i++) {
+		CHECK(ldns_zone_enum_filter_may_contain(filter, numbers[i]));
+	}
+	CHECK(ldns_zone_enum_filter_fp_rate(filter) < 0.01);
+
+	/* about none of the numbers that are not there get through */
+	passed = 0;
+	for (i = 0; i < 10000; i++) {
+		snprintf(number, sizeof(number), "+3130%07d", i);
+		passed += ldns_zone_enum_filter_may_contain(filter, number);
+	}
+	CHECK(passed < 100);
+
+	snprintf(path, sizeof(path), "%s/zone_test.XXXXXX",
+			tmpdir ? tmpdir : "/tmp");
+	fd = mkstemp(path);
+	CHECK(fd >= 0);
+	if (fd >= 0) {
+		close(fd);
+		CHECK(ldns_zone_snapshot_write_file(path, zone)
+				== LDNS_STATUS_OK);
+		CHECK(ldns_zone_snapshot_new_frm_file(&snapshot, path)
+				== LDNS_STATUS_OK);
+		from_snapshot = ldns_zone_enum_filter_new_frm_snapshot(
+				snapshot, suffix);
+		CHECK(ldns_zone_enum_filter_number_count(from_snapshot) == 3);
+		for (i = 0; i < 3; i++) {
+			CHECK(ldns_zone_enum_filter_may_contain(from_snapshot,
+					numbers[i]));
+		}
+		ldns_zone_enum_filter_free(from_snapshot);
+		ldns_zone_snapshot_free(snapshot);
+		unlink(path);
+	}
+
+	ldns_zone_enum_filter_free(filter);
+	ldns_rdf_deep_free(suffix);
+	ldns_zone_deep_free(zone);
+}
+
+#define SOA(serial) "example. IN SOA ns.example. h.example. " #serial " 1 1 1 1"
+
+/*
+ * what the nameserver answers to one transfer: the rrs of its messages,
+ * "" between messages and NULL after the last one
+ */
+struct ldns_test_xfr
+{
+	ldns_pkt_rcode rcode;
+	const char **rrs;
+	/* the type that was asked for */
+	ldns_rr_type type;
+};
+typedef struct ldns_test_xfr ldns_test_xfr;
+
+struct ldns_test_server
+{
+	int sock;
+	ldns_test_xfr *xfrs;
+	size_t xfr_count;
+};
+typedef struct ldns_test_server ldns_test_server;
+
+static bool
+ldns_test_recv(int sock, uint8_t *data, size_t size)
+{
+	ssize_t bytes;
+
+	while (size > 0) {
+		bytes = recv(sock, data, size, 0);
+		if (bytes <= 0) {
+			return false;
+		}
+		data += bytes;
+		size -= (size_t) bytes;
+	}
+	return true;
+}
+
+/* answers a transfer on a new connection */
+static void
+ldns_test_serve(int sock, ldns_test_xfr *xfr)
+{
+	uint8_t query[LDNS_MAX_PACKETLEN];
+	uint8_t size_wire[2];
+	ldns_pkt *pkt;
+	uint8_t *wire;
+	size_t size;
+	size_t i;
+	int conn;
+
+	conn = accept(sock, NULL, NULL);
+	if (conn < 0) {
+		return;
+	}
+	if (!ldns_test_recv(conn, size_wire, 2) ||
+	    !ldns_test_recv(conn, query, ldns_read_uint16(size_wire)) ||
+	    ldns_wire2pkt(&pkt, query, ldns_read_uint16(size_wire))
+			!= LDNS_STATUS_OK) {
+		close(conn);
+		return;
+	}
+	xfr->type = ldns_rr_get_type(ldns_rr_list_rr(ldns_pkt_question(pkt),
+			0));
+	ldns_pkt_free(pkt);
+
+	i = 0;
+	do {
+		pkt = ldns_pkt_new();
+		ldns_pkt_set_qr(pkt, true);
+		ldns_pkt_set_aa(pkt, true);
+		ldns_pkt_set_rcode(pkt, xfr->rcode);
+		for (; xfr->rrs[i] && xfr->rrs[i][0]; i++) {
+			(void) ldns_pkt_push_rr(pkt, LDNS_SECTION_ANSWER,
+					ldns_test_rr(xfr->rrs[i]));
+		}
+		if (ldns_pkt2wire(&wire, pkt, &size) == LDNS_STATUS_OK) {
+			ldns_write_uint16(size_wire, (uint16_t) size);
+			(void) send(conn, size_wire, 2, 0);
+			(void) send(conn, wire, size, 0);
+			LDNS_FREE(wire);
+		}
+		ldns_pkt_free(pkt);
+	} while (xfr->rrs[i] && xfr->rrs[i++][0] == '\0');
+	close(conn);
+}
+
+static void *
+ldns_test_server_run(void *arg)
+{
+	ldns_test_server *server = (ldns_test_server *) arg;
+	size_t i;
+
+	for (i = 0; i < server->xfr_count; i++) {
+		ldns_test_serve(server->sock, &server->xfrs[i]);
+	}
+	return NULL;
+}
+
+/* the zone that is transferred, at serial 1 */
+static ldns_zone *
+ldns_test_xfr_zone(void)
+{
+	ldns_zone *zone = ldns_zone_new();
+
+	ldns_zone_set_soa(zone, ldns_test_rr(SOA(1)));
+	(void) ldns_zone_push_rr(zone, ldns_test_rr("a.example. A 192.0.2.1"));
+	(void) ldns_zone_push_rr(zone, ldns_test_rr("a.example. A 192.0.2.2"));
+	(void) ldns_zone_push_rr(zone, ldns_test_rr("b.example. TXT \"x\""));
+	return zone;
+}
+
+/* checks that zone has soa and exactly the rrs, in any order */
+static void
+ldns_test_zone_is(ldns_zone *zone, const char *soa, const char **rrs,
+		int line)
+{
+	ldns_zone *expected = ldns_zone_new();
+	size_t i;
+
+	ldns_zone_set_soa(expected, ldns_test_rr(soa));
+	for (i = 0; rrs[i]; i++) {
+		(void) ldns_zone_push_rr(expected, ldns_test_rr(rrs[i]));
+	}
+	ldns_zone_sort(expected);
+	ldns_zone_sort(zone);
+	if (ldns_rr_compare(ldns_zone_soa(zone), ldns_zone_soa(expected)) != 0 ||
+	    ldns_rr_list_compare(ldns_zone_rrs(zone), ldns_zone_rrs(expected))
+			!= 0) {
+		fprintf(stderr, "%s:%d: the transferred zone is\n",
+				__FILE__, line);
+		ldns_zone_print(stderr, zone);
+		failures++;
+	}
+	ldns_zone_deep_free(expected);
+}
+
+static void
+test_ixfr(void)
+{
+	static const char *up_to_date[] = { SOA(1), NULL };
+	/* 1 to 2 to 3, over two messages */
+	static const char *incremental[] = {
+		SOA(3),
+		SOA(1), "a.example. A 192.0.2.1",
+		SOA(2), "c.example. A 192.0.2.3", "b.example. TXT \"y\"", "",
+		SOA(2), "c.example. A 192.0.2.3",
+		SOA(3), "d.example. A 192.0.2.4",
+		SOA(3), NULL
+	};
+	static const char *incremental_zone[] = {
+		"a.example. A 192.0.2.2", "b.example. TXT \"x\"",
+		"b.example. TXT \"y\"", "d.example. A 192.0.2.4", NULL
+	};
+	static const char *whole[] = {
+		SOA(3), "x.example. A 192.0.2.9", "",
+		"y.example. A 192.0.2.8", SOA(3), NULL
+	};
+	static const char *whole_zone[] = {
+		"x.example. A 192.0.2.9", "y.example. A 192.0.2.8", NULL
+	};
+	static const char *refused[] = { NULL };
+	static const char *axfr[] = {
+		SOA(4), "z.example. A 192.0.2.7", SOA(4), NULL
+	};
+	static const char *axfr_zone[] = { "z.example. A 192.0.2.7", NULL };
+	/* deletes an rr the zone does not have */
+	static const char *other[] = {
+		SOA(3), SOA(1), "q.example. A 192.0.2.1", SOA(3), SOA(3), NULL
+	};
+	ldns_test_xfr xfrs[] = {
+		{ LDNS_RCODE_NOERROR, up_to_date, 0 },
+		{ LDNS_RCODE_NOERROR, incremental, 0 },
+		{ LDNS_RCODE_NOERROR, whole, 0 },
+		{ LDNS_RCODE_NOTIMPL, refused, 0 },
+		{ LDNS_RCODE_NOERROR, axfr, 0 },
+		{ LDNS_RCODE_NOERROR, other, 0 }
+	};
+	ldns_test_server server;
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	pthread_t thread;
+	ldns_resolver *res;
+	ldns_rdf *ns;
+	ldns_zone *zone, *newzone;
+	ldns_rr_list *removed;
+
+	server.xfrs = xfrs;
+	server.xfr_count = sizeof(xfrs) / sizeof(xfrs[0]);
+	server.sock = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (server.sock < 0 ||
+	    bind(server.sock, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+	    listen(server.sock, 1) != 0 ||
+	    getsockname(server.sock, (struct sockaddr *) &addr, &addr_len)
+			!= 0 ||
+	    pthread_create(&thread, NULL, ldns_test_server_run, &server)
+			!= 0) {
+		perror("no nameserver on the loopback address");
+		failures++;
+		return;
+	}
+	res = ldns_resolver_new();
+	ns = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_A, "127.0.0.1");
+	(void) ldns_resolver_push_nameserver(res, ns);
+	ldns_rdf_deep_free(ns);
+	ldns_resolver_set_port(res, ntohs(addr.sin_port));
+
+	/* nothing new */
+	zone = ldns_test_xfr_zone();
+	CHECK(ldns_zone_ixfr(res, zone, &newzone, &removed) == LDNS_STATUS_OK);
+	CHECK(newzone == NULL && removed == NULL);
+	CHECK(xfrs[0].type == LDNS_RR_TYPE_IXFR);
+	ldns_zone_deep_free(zone);
+
+	/* the changes are applied, what went is handed back */
+	zone = ldns_test_xfr_zone();
+	CHECK(ldns_zone_ixfr(res, zone, &newzone, &removed) == LDNS_STATUS_OK);
+	CHECK(newzone != NULL);
+	if (newzone) {
+		ldns_test_zone_is(newzone, SOA(3), incremental_zone, __LINE__);
+		/* the old soa, a.example. and c.example. of serial 2 */
+		CHECK(ldns_rr_list_rr_count(removed) == 3);
+		ldns_zone_free(zone);
+		ldns_rr_list_deep_free(removed);
+		ldns_zone_deep_free(newzone);
+	}
+
+	/* the whole zone instead of the changes */
+	zone = ldns_test_xfr_zone();
+	CHECK(ldns_zone_ixfr(res, zone, &newzone, &removed) == LDNS_STATUS_OK);
+	CHECK(newzone != NULL);
+	if (newzone) {
+		ldns_test_zone_is(newzone, SOA(3), whole_zone, __LINE__);
+		CHECK(ldns_rr_list_rr_count(removed) == 4);
+		ldns_zone_free(zone);
+		ldns_rr_list_deep_free(removed);
+		ldns_zone_deep_free(newzone);
+	}
+
+	/* no ixfr there, an axfr then */
+	zone = ldns_test_xfr_zone();
+	CHECK(ldns_zone_ixfr(res, zone, &newzone, &removed) == LDNS_STATUS_OK);
+	CHECK(newzone != NULL);
+	CHECK(xfrs[4].type == LDNS_RR_TYPE_AXFR);
+	if (newzone) {
+		ldns_test_zone_is(newzone, SOA(4), axfr_zone, __LINE__);
+		CHECK(ldns_rr_list_rr_count(removed) == 4);
+		ldns_zone_free(zone);
+		ldns_rr_list_deep_free(removed);
+		ldns_zone_deep_free(newzone);
+	}
+
+	/* the zone is left as it was */
+	zone = ldns_test_xfr_zone();
+	CHECK(ldns_zone_ixfr(res, zone, &newzone, &removed)
+			== LDNS_STATUS_XFR_FORMAT_ERR);
+	CHECK(newzone == NULL && removed == NULL);
+	CHECK(ldns_rr_list_rr_count(ldns_zone_rrs(zone)) == 3);
+	ldns_zone_deep_free(zone);
+
+	pthread_join(thread, NULL);
+	close(server.sock);
+	ldns_resolver_deep_free(res);
+}
+
+int
+main(void)
+{
+	test_index();
+	test_snapshot();
+	test_enum_index();
+	test_enum_filter();
+	test_ixfr();
+	if (failures > 0) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("all checks passed\n");
+	return EXIT_SUCCESS;
+}
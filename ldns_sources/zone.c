@@ -12,6 +12,47 @@
 
 #include <strings.h>
 #include <limits.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* zone data this large is parsed in parts, on all cpus */
+#define LDNS_ZONE_PARALLEL_MIN  (1024 * 1024)
+#define LDNS_ZONE_MAX_THREADS   8
+
+/* initial size of the hash table of a zone index, a power of two */
+#define LDNS_ZONE_INDEX_SLOTS   1024
+#define LDNS_ZONE_INDEX_HASH_INIT  2166136261U
+#define LDNS_ZONE_INDEX_HASH_PRIME 16777619U
+
+/* zone snapshots, see ldns_zone_snapshot in zone.h */
+#define LDNS_ZONE_SNAPSHOT_MAGIC    "LDNSSNAP"
+#define LDNS_ZONE_SNAPSHOT_HEADER   48
+#define LDNS_ZONE_SNAPSHOT_CHECKSUM 44
+#define LDNS_ZONE_SNAPSHOT_NONE     0xffffffffU
+/* the offsets in it are 32 bits */
+#define LDNS_ZONE_SNAPSHOT_MAX      0xffff0000U
+
+/* nodes an enum index is built with at first */
+#define LDNS_ZONE_ENUM_NODES    1024
+
+/* enum filters: bits per number and bits set per number, about 1% false
+ * positives */
+#define LDNS_ZONE_ENUM_FILTER_BITS   10
+#define LDNS_ZONE_ENUM_FILTER_HASHES 7
+#define LDNS_ZONE_ENUM_FILTER_BLOCK  512
 
 ldns_rr *
 ldns_zone_soa(const ldns_zone *z)
@@ -56,6 +97,417 @@ ldns_zone_push_rr(ldns_zone *z, ldns_rr *rr)
 	return ldns_rr_list_push_rr( ldns_zone_rrs(z), rr);
 }
 
+/* FNV-1a over the octets of a wire name from the back. Going backwards
+ * the hash of every ancestor of a name falls out of one pass over it */
+static uint32_t
+ldns_zone_index_hash_back(uint32_t h, const uint8_t *from, const uint8_t *to)
+{
+	while (to > from) {
+		h = (h ^ *--to) * LDNS_ZONE_INDEX_HASH_PRIME;
+	}
+	return h;
+}
+
+/* lowercases name into key and fills in the offset of every label and
+ * the hash of the name that starts there, the last one is the root.
+ * Returns the number of labels plus one, or 0 when name is no dname */
+static size_t
+ldns_zone_index_key(const ldns_rdf *name, uint8_t *key,
+		uint16_t offsets[LDNS_MAX_DOMAINLEN / 2 + 2],
+		uint32_t hashes[LDNS_MAX_DOMAINLEN / 2 + 2])
+{
+	size_t size, pos, n, i;
+	uint32_t h;
+
+	if (!name || ldns_rdf_get_type(name) != LDNS_RDF_TYPE_DNAME ||
+	    ldns_rdf_size(name) == 0 || 
+	    ldns_rdf_size(name) > LDNS_MAX_DOMAINLEN) {
+		return 0;
+	}
+	size = ldns_rdf_size(name);
+	ldns_dname_octets_tolower(key, ldns_rdf_data(name), size);
+
+	n = 0;
+	pos = 0;
+	while (pos < size && key[pos] > 0 && n < LDNS_MAX_DOMAINLEN / 2 + 1) {
+		offsets[n++] = (uint16_t) pos;
+		pos += key[pos] + 1;
+	}
+	if (pos != size - 1) {
+		return 0;
+	}
+	offsets[n++] = (uint16_t) pos;
+
+	h = LDNS_ZONE_INDEX_HASH_INIT;
+	pos = size;
+	for (i = n; i > 0; i--) {
+		h = ldns_zone_index_hash_back(h, key + offsets[i - 1], key + pos);
+		hashes[i - 1] = h;
+		pos = offsets[i - 1];
+	}
+	return n;
+}
+
+static ldns_zone_name *
+ldns_zone_index_find(const ldns_zone_index *index, const uint8_t *key,
+		size_t size, uint32_t hash)
+{
+	size_t slot;
+	ldns_zone_name *name;
+
+	for (slot = hash & index->_slot_mask; index->_slots[slot] != 0;
+	     slot = (slot + 1) & index->_slot_mask) {
+		name = &index->_names[index->_slots[slot] - 1];
+		if (name->_hash == hash && name->_key_size == size &&
+		    memcmp(index->_keys + name->_key, key, size) == 0) {
+			return name;
+		}
+	}
+	return NULL;
+}
+
+static ldns_zone_rrset *
+ldns_zone_name_rrset(const ldns_zone_name *name, ldns_rr_type type)
+{
+	uint16_t i;
+
+	for (i = 0; i < name->_rrset_count; i++) {
+		if (name->_rrsets[i]._type == type) {
+			return &name->_rrsets[i];
+		}
+	}
+	return NULL;
+}
+
+static bool
+ldns_zone_index_grow_slots(ldns_zone_index *index)
+{
+	size_t *slots;
+	size_t count, slot, i;
+
+	count = (index->_slot_mask + 1) * 2;
+	slots = LDNS_XMALLOC(size_t, count);
+	if (!slots) {
+		return false;
+	}
+	memset(slots, 0, count * sizeof(size_t));
+	for (i = 0; i < index->_name_count; i++) {
+		slot = index->_names[i]._hash & (count - 1);
+		while (slots[slot] != 0) {
+			slot = (slot + 1) & (count - 1);
+		}
+		slots[slot] = i + 1;
+	}
+	LDNS_FREE(index->_slots);
+	index->_slots = slots;
+	index->_slot_mask = count - 1;
+	return true;
+}
+
+static ldns_zone_name *
+ldns_zone_index_add_name(ldns_zone_index *index, const uint8_t *key,
+		size_t size, uint32_t hash)
+{
+	ldns_zone_name *name;
+	uint8_t *keys;
+	size_t slot;
+
+	if ((index->_name_count + 1) * 2 > index->_slot_mask + 1 &&
+	    !ldns_zone_index_grow_slots(index)) {
+		return NULL;
+	}
+	if (index->_name_count == index->_name_capacity) {
+		name = LDNS_XREALLOC(index->_names, ldns_zone_name,
+				index->_name_capacity * 2);
+		if (!name) {
+			return NULL;
+		}
+		index->_names = name;
+		index->_name_capacity *= 2;
+	}
+	if (index->_keys_size + size > index->_keys_capacity) {
+		keys = LDNS_XREALLOC(index->_keys, uint8_t,
+				index->_keys_capacity * 2 + size);
+		if (!keys) {
+			return NULL;
+		}
+		index->_keys = keys;
+		index->_keys_capacity = index->_keys_capacity * 2 + size;
+	}
+	memcpy(index->_keys + index->_keys_size, key, size);
+
+	name = &index->_names[index->_name_count];
+	name->_key = index->_keys_size;
+	name->_key_size = (uint16_t) size;
+	name->_hash = hash;
+	name->_rrset_count = 0;
+	name->_rrsets = NULL;
+	index->_keys_size += size;
+	index->_name_count++;
+
+	slot = hash & index->_slot_mask;
+	while (index->_slots[slot] != 0) {
+		slot = (slot + 1) & index->_slot_mask;
+	}
+	index->_slots[slot] = index->_name_count;
+	return name;
+}
+
+static bool
+ldns_zone_index_add_rr(ldns_zone_index *index, ldns_rr *rr)
+{
+	uint8_t key[LDNS_MAX_DOMAINLEN];
+	uint16_t offsets[LDNS_MAX_DOMAINLEN / 2 + 2];
+	uint32_t hashes[LDNS_MAX_DOMAINLEN / 2 + 2];
+	ldns_zone_name *name;
+	ldns_zone_rrset *rrset;
+	size_t size;
+
+	if (ldns_zone_index_key(ldns_rr_owner(rr), key, offsets, hashes) == 0) {
+		/* nothing we can look up anyway */
+		return true;
+	}
+	size = ldns_rdf_size(ldns_rr_owner(rr));
+	name = ldns_zone_index_find(index, key, size, hashes[0]);
+	if (!name) {
+		name = ldns_zone_index_add_name(index, key, size, hashes[0]);
+		if (!name) {
+			return false;
+		}
+	}
+	rrset = ldns_zone_name_rrset(name, ldns_rr_get_type(rr));
+	if (!rrset) {
+		rrset = LDNS_XREALLOC(name->_rrsets, ldns_zone_rrset,
+				name->_rrset_count + 1);
+		if (!rrset) {
+			return false;
+		}
+		name->_rrsets = rrset;
+		rrset = &name->_rrsets[name->_rrset_count];
+		rrset->_type = ldns_rr_get_type(rr);
+		rrset->_rrs = ldns_rr_list_new();
+		if (!rrset->_rrs) {
+			return false;
+		}
+		name->_rrset_count++;
+	}
+	return ldns_rr_list_push_rr(rrset->_rrs, rr);
+}
+
+static ldns_zone_index *
+ldns_zone_index_new_frm_rrs(const ldns_rdf *apex, ldns_rr *soa,
+		const ldns_rr_list *rrs)
+{
+	ldns_zone_index *index;
+	size_t i;
+
+	index = LDNS_MALLOC(ldns_zone_index);
+	if (!index) {
+		return NULL;
+	}
+	index->_name_count = 0;
+	index->_name_capacity = LDNS_ZONE_INDEX_SLOTS / 2;
+	index->_names = LDNS_XMALLOC(ldns_zone_name, index->_name_capacity);
+	index->_keys_size = 0;
+	index->_keys_capacity = LDNS_ZONE_INDEX_SLOTS * 16;
+	index->_keys = LDNS_XMALLOC(uint8_t, index->_keys_capacity);
+	index->_slot_mask = LDNS_ZONE_INDEX_SLOTS - 1;
+	index->_slots = LDNS_XMALLOC(size_t, LDNS_ZONE_INDEX_SLOTS);
+	index->_apex = apex ? ldns_rdf_clone(apex) : NULL;
+	if (!index->_names || !index->_keys || !index->_slots ||
+	    (apex && !index->_apex)) {
+		ldns_zone_index_free(index);
+		return NULL;
+	}
+	memset(index->_slots, 0, LDNS_ZONE_INDEX_SLOTS * sizeof(size_t));
+	if (index->_apex) {
+		ldns_dname2canonical(index->_apex);
+	}
+
+	if (soa && !ldns_zone_index_add_rr(index, soa)) {
+		ldns_zone_index_free(index);
+		return NULL;
+	}
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		if (!ldns_zone_index_add_rr(index, ldns_rr_list_rr(rrs, i))) {
+			ldns_zone_index_free(index);
+			return NULL;
+		}
+	}
+	return index;
+}
+
+ldns_zone_index *
+ldns_zone_index_new(const ldns_zone *zone)
+{
+	ldns_rr *soa;
+
+	soa = ldns_zone_soa(zone);
+	return ldns_zone_index_new_frm_rrs(soa ? ldns_rr_owner(soa) : NULL,
+			soa, ldns_zone_rrs(zone));
+}
+
+void
+ldns_zone_index_free(ldns_zone_index *index)
+{
+	size_t i;
+	uint16_t j;
+
+	if (!index) {
+		return;
+	}
+	if (index->_names) {
+		for (i = 0; i < index->_name_count; i++) {
+			for (j = 0; j < index->_names[i]._rrset_count; j++) {
+				ldns_rr_list_free(
+					index->_names[i]._rrsets[j]._rrs);
+			}
+			LDNS_FREE(index->_names[i]._rrsets);
+		}
+		LDNS_FREE(index->_names);
+	}
+	LDNS_FREE(index->_keys);
+	LDNS_FREE(index->_slots);
+	if (index->_apex) {
+		ldns_rdf_deep_free(index->_apex);
+	}
+	LDNS_FREE(index);
+}
+
+size_t
+ldns_zone_index_name_count(const ldns_zone_index *index)
+{
+	return index->_name_count;
+}
+
+static ldns_zone_name *
+ldns_zone_index_name(const ldns_zone_index *index, const ldns_rdf *name)
+{
+	uint8_t key[LDNS_MAX_DOMAINLEN];
+	uint16_t offsets[LDNS_MAX_DOMAINLEN / 2 + 2];
+	uint32_t hashes[LDNS_MAX_DOMAINLEN / 2 + 2];
+
+	if (ldns_zone_index_key(name, key, offsets, hashes) == 0) {
+		return NULL;
+	}
+	return ldns_zone_index_find(index, key, ldns_rdf_size(name), hashes[0]);
+}
+
+ldns_rr_list *
+ldns_zone_index_rrset(const ldns_zone_index *index, const ldns_rdf *name,
+		ldns_rr_type type)
+{
+	ldns_zone_name *n;
+	ldns_zone_rrset *rrset;
+
+	n = ldns_zone_index_name(index, name);
+	if (!n) {
+		return NULL;
+	}
+	rrset = ldns_zone_name_rrset(n, type);
+	return rrset ? rrset->_rrs : NULL;
+}
+
+ldns_rr_list *
+ldns_zone_index_name_rrs(const ldns_zone_index *index, const ldns_rdf *name)
+{
+	ldns_zone_name *n;
+	ldns_rr_list *rrs;
+	uint16_t i;
+
+	n = ldns_zone_index_name(index, name);
+	if (!n) {
+		return NULL;
+	}
+	rrs = ldns_rr_list_new();
+	if (!rrs) {
+		return NULL;
+	}
+	for (i = 0; i < n->_rrset_count; i++) {
+		(void) ldns_rr_list_cat(rrs, n->_rrsets[i]._rrs);
+	}
+	return rrs;
+}
+
+static bool
+ldns_zone_index_is_apex(const ldns_zone_index *index, const uint8_t *key,
+		size_t size)
+{
+	return index->_apex && ldns_rdf_size(index->_apex) == size &&
+	       memcmp(ldns_rdf_data(index->_apex), key, size) == 0;
+}
+
+ldns_rr_list *
+ldns_zone_index_zone_cut(const ldns_zone_index *index, const ldns_rdf *name)
+{
+	uint8_t key[LDNS_MAX_DOMAINLEN];
+	uint16_t offsets[LDNS_MAX_DOMAINLEN / 2 + 2];
+	uint32_t hashes[LDNS_MAX_DOMAINLEN / 2 + 2];
+	ldns_zone_name *n;
+	ldns_zone_rrset *ns;
+	ldns_zone_rrset *cut;
+	size_t labels, size, i;
+
+	labels = ldns_zone_index_key(name, key, offsets, hashes);
+	size = ldns_rdf_size(name);
+	cut = NULL;
+	/* up to the apex, the last cut on the way is the one that counts */
+	for (i = 0; i < labels; i++) {
+		if (ldns_zone_index_is_apex(index, key + offsets[i],
+					size - offsets[i])) {
+			break;
+		}
+		n = ldns_zone_index_find(index, key + offsets[i],
+				size - offsets[i], hashes[i]);
+		if (n && (ns = ldns_zone_name_rrset(n, LDNS_RR_TYPE_NS))) {
+			cut = ns;
+		}
+	}
+	return cut ? cut->_rrs : NULL;
+}
+
+/* the zone cuts strictly above owner: its ancestors with NS rrs, the
+ * apex not counted. Returns how many went into cuts */
+static size_t
+ldns_zone_index_cuts_above(const ldns_zone_index *index, 
+		const ldns_rdf *owner, 
+		ldns_zone_name *cuts[LDNS_MAX_DOMAINLEN / 2 + 2])
+{
+	uint8_t key[LDNS_MAX_DOMAINLEN];
+	uint16_t offsets[LDNS_MAX_DOMAINLEN / 2 + 2];
+	uint32_t hashes[LDNS_MAX_DOMAINLEN / 2 + 2];
+	ldns_zone_name *n;
+	size_t labels, size, i, count;
+
+	labels = ldns_zone_index_key(owner, key, offsets, hashes);
+	size = ldns_rdf_size(owner);
+	count = 0;
+	for (i = 1; i < labels; i++) {
+		if (ldns_zone_index_is_apex(index, key + offsets[i],
+					size - offsets[i])) {
+			continue;
+		}
+		n = ldns_zone_index_find(index, key + offsets[i],
+				size - offsets[i], hashes[i]);
+		if (n && ldns_zone_name_rrset(n, LDNS_RR_TYPE_NS)) {
+			cuts[count++] = n;
+		}
+	}
+	return count;
+}
+
+bool
+ldns_zone_index_is_glue(const ldns_zone_index *index, const ldns_rr *rr)
+{
+	ldns_zone_name *cuts[LDNS_MAX_DOMAINLEN / 2 + 2];
+
+	if (ldns_rr_get_type(rr) != LDNS_RR_TYPE_A &&
+	    ldns_rr_get_type(rr) != LDNS_RR_TYPE_AAAA) {
+		return false;
+	}
+	return ldns_zone_index_cuts_above(index, ldns_rr_owner(rr), cuts) > 0;
+}
+
 /* return a clone of the given rr list, without the glue records
  * rr list should be the complete zone
  * if present, stripped records are added to the list *glue_records
@@ -63,74 +515,63 @@ ldns_zone_push_rr(ldns_zone *z, ldns_rr *rr)
 ldns_rr_list *
 ldns_zone_strip_glue_rrs(const ldns_rdf *zone_name, const ldns_rr_list *rrs, ldns_rr_list *glue_rrs)
 {
-	ldns_rr_list *new_list = ldns_rr_list_new();
-
 	/* when do we find glue? It means we find an IP address
 	 * (AAAA/A) for a nameserver listed in the zone
 	 *
 	 * Alg used here:
-	 * first find all the zonecuts (NS records)
-	 * find all the AAAA or A records (can be done it the 
-	 * above loop).
-	 *
-	 * Check if the aaaa/a list are subdomains under the
-	 * NS domains. If yes -> glue, if no -> not glue
+	 * index the rrs by name, then walk up from every AAAA or A
+	 * record to the zone cuts (names with NS records) above it.
+	 * If one of those NS records names the address record's owner
+	 * -> glue, if no -> not glue
 	 */
 
-	ldns_rr_list *zone_cuts;
-	ldns_rr_list *addr;
-	ldns_rr *r, *ns, *a;
-	ldns_rdf *dname_a, *dname_ns, *ns_owner;
-	uint16_t i,j;
+	ldns_zone_index *index;
+	ldns_zone_name *cuts[LDNS_MAX_DOMAINLEN / 2 + 2];
+	ldns_rr_list *new_list;
+	ldns_rr_list *ns;
+	ldns_rr *r;
+	size_t i, j, k, cut_count;
+	bool is_glue;
 
-	zone_cuts = ldns_rr_list_new();
-	addr = ldns_rr_list_new();
+	index = ldns_zone_index_new_frm_rrs(zone_name, NULL, rrs);
+	new_list = ldns_rr_list_new();
+	if (!index || !new_list) {
+		ldns_zone_index_free(index);
+		if (new_list) {
+			ldns_rr_list_free(new_list);
+		}
+		return NULL;
+	}
 
 	for(i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
 		r = ldns_rr_list_rr(rrs, i);
+		is_glue = false;
 		if (ldns_rr_get_type(r) == LDNS_RR_TYPE_A ||
 				ldns_rr_get_type(r) == LDNS_RR_TYPE_AAAA) {
-			/* possibly glue */
-			ldns_rr_list_push_rr(addr, r);
-			continue;
-		}
-		if (ldns_rr_get_type(r) == LDNS_RR_TYPE_NS) {
-			/* multiple zones will end up here -
-			 * for now; not a problem
-			 */
-			/* don't add NS records for the current zone itself */
-			if (ldns_rdf_compare(ldns_rr_owner(r), 
-						zone_name) != 0) {
-				ldns_rr_list_push_rr(zone_cuts, r);
-			}
-			continue;
-		}
-	}
-
-	/* will sorting make it quicker ?? */
-	for(i = 0; i < ldns_rr_list_rr_count(zone_cuts); i++) {
-		ns = ldns_rr_list_rr(zone_cuts, i);
-		ns_owner = ldns_rr_owner(ns);
-		dname_ns = ldns_rr_ns_nsdname(ns);
-		for(j = 0; j < ldns_rr_list_rr_count(addr); j++) {
-			a = ldns_rr_list_rr(addr, j);
-			dname_a = ldns_rr_owner(a);
-			
-			if (ldns_dname_is_subdomain(dname_a, ns_owner) &&
-			    ldns_rdf_compare(dname_ns, dname_a) == 0) {
-				/* GLUE! */
-				if (glue_rrs) {
-					ldns_rr_list_push_rr(glue_rrs, a);
+			cut_count = ldns_zone_index_cuts_above(index, 
+					ldns_rr_owner(r), cuts);
+			for (j = 0; !is_glue && j < cut_count; j++) {
+				ns = ldns_zone_name_rrset(cuts[j], 
+						LDNS_RR_TYPE_NS)->_rrs;
+				for (k = 0; k < ldns_rr_list_rr_count(ns); k++) {
+					if (ldns_dname_compare(ldns_rr_ns_nsdname(
+						ldns_rr_list_rr(ns, k)), 
+						ldns_rr_owner(r)) == 0) {
+						/* GLUE! */
+						is_glue = true;
+						break;
+					}
 				}
-				break;
-			} else {
-				ldns_rr_list_push_rr(new_list, a);
 			}
 		}
+		if (!is_glue) {
+			ldns_rr_list_push_rr(new_list, r);
+		} else if (glue_rrs) {
+			ldns_rr_list_push_rr(glue_rrs, r);
+		}
 	}
 	
-	ldns_rr_list_free(addr);
-	ldns_rr_list_free(zone_cuts);
+	ldns_zone_index_free(index);
 
 	return new_list;
 }
@@ -145,71 +586,86 @@ ldns_zone_glue_rr_list(const ldns_zone *z)
 	 * (AAAA/A) for a nameserver listed in the zone
 	 *
 	 * Alg used here:
-	 * first find all the zonecuts (NS records)
-	 * find all the AAAA or A records (can be done it the 
-	 * above loop).
-	 *
-	 * Check if the aaaa/a list are subdomains under the
-	 * NS domains. If yes -> glue, if no -> not glue
+	 * index the zone by name, then walk up from every AAAA or A
+	 * record to the zone cuts (names with NS records, the apex
+	 * excepted) above it, and note it there. 
+	 * Every NS record of a cut then brings in the addresses noted
+	 * at it, in zone order
 	 */
 
-	ldns_rr_list *zone_cuts;
-	ldns_rr_list *addr;
+	ldns_zone_index *index;
+	ldns_zone_name *cuts[LDNS_MAX_DOMAINLEN / 2 + 2];
+	ldns_zone_name *n;
+	ldns_rr_list **below;
 	ldns_rr_list *glue;
-	ldns_rr *r, *ns, *a;
-	ldns_rdf *dname_a, *dname_ns, *ns_owner;
-	uint16_t i,j;
+	ldns_rr *r;
+	size_t i, j, cut_count;
+	bool ok;
 
-	zone_cuts = ldns_rr_list_new();
-	addr = ldns_rr_list_new();
+	index = ldns_zone_index_new(z);
+	if (!index) {
+		return NULL;
+	}
+	/* the addresses under every cut, by name number */
+	below = LDNS_XMALLOC(ldns_rr_list *, index->_name_count + 1);
 	glue = ldns_rr_list_new();
+	if (!below || !glue) {
+		LDNS_FREE(below);
+		if (glue) {
+			ldns_rr_list_free(glue);
+		}
+		ldns_zone_index_free(index);
+		return NULL;
+	}
+	memset(below, 0, (index->_name_count + 1) * sizeof(ldns_rr_list *));
 
-	for(i = 0; i < ldns_zone_rr_count(z); i++) {
+	ok = true;
+	for(i = 0; ok && i < ldns_rr_list_rr_count(ldns_zone_rrs(z)); i++) {
 		r = ldns_rr_list_rr(ldns_zone_rrs(z), i);
-		if (ldns_rr_get_type(r) == LDNS_RR_TYPE_A ||
-				ldns_rr_get_type(r) == LDNS_RR_TYPE_AAAA) {
-			/* possibly glue */
-			ldns_rr_list_push_rr(addr, r);
+		if (ldns_rr_get_type(r) != LDNS_RR_TYPE_A &&
+				ldns_rr_get_type(r) != LDNS_RR_TYPE_AAAA) {
 			continue;
 		}
-		if (ldns_rr_get_type(r) == LDNS_RR_TYPE_NS) {
-			/* multiple zones will end up here -
-			 * for now; not a problem
-			 */
-			/* don't add NS records for the current zone itself */
-			if (ldns_rdf_compare(ldns_rr_owner(r), 
-						ldns_rr_owner(ldns_zone_soa(z))) != 0) {
-				ldns_rr_list_push_rr(zone_cuts, r);
+		/* possibly glue */
+		cut_count = ldns_zone_index_cuts_above(index, 
+				ldns_rr_owner(r), cuts);
+		for (j = 0; j < cut_count; j++) {
+			n = cuts[j];
+			if (!below[n - index->_names]) {
+				below[n - index->_names] = ldns_rr_list_new();
+			}
+			if (!below[n - index->_names] ||
+			    !ldns_rr_list_push_rr(below[n - index->_names], r)) {
+				ok = false;
+				break;
 			}
-			continue;
 		}
 	}
 
-	/* will sorting make it quicker ?? */
-	for(i = 0; i < ldns_rr_list_rr_count(zone_cuts); i++) {
-		ns = ldns_rr_list_rr(zone_cuts, i);
-		ns_owner = ldns_rr_owner(ns);
-
-		dname_ns = ldns_rr_ns_nsdname(ns);
-		for(j = 0; j < ldns_rr_list_rr_count(addr); j++) {
-			a = ldns_rr_list_rr(addr, j);
-			dname_a = ldns_rr_owner(a);
-			
-			/*
-			if (ldns_dname_is_subdomain(dname_a, ns_owner) &&
-			    ldns_rdf_compare(dname_ns, dname_a) == 0) {
-			*/
-			if (ldns_dname_is_subdomain(dname_a, ns_owner)) {
-				/* GLUE! */
-				ldns_rr_list_push_rr(glue, a);
-			}
+	for(i = 0; ok && i < ldns_rr_list_rr_count(ldns_zone_rrs(z)); i++) {
+		r = ldns_rr_list_rr(ldns_zone_rrs(z), i);
+		if (ldns_rr_get_type(r) != LDNS_RR_TYPE_NS) {
+			continue;
+		}
+		/* multiple zones will end up here -
+		 * for now; not a problem
+		 */
+		n = ldns_zone_index_name(index, ldns_rr_owner(r));
+		if (n && below[n - index->_names]) {
+			/* GLUE! */
+			ok = ldns_rr_list_cat(glue, below[n - index->_names]);
 		}
 	}
 	
-	ldns_rr_list_free(addr);
-	ldns_rr_list_free(zone_cuts);
+	for (i = 0; i < index->_name_count; i++) {
+		if (below[i]) {
+			ldns_rr_list_free(below[i]);
+		}
+	}
+	LDNS_FREE(below);
+	ldns_zone_index_free(index);
 
-	if (ldns_rr_list_rr_count(glue) == 0) {
+	if (!ok || ldns_rr_list_rr_count(glue) == 0) {
 		ldns_rr_list_free(glue);
 		return NULL;
 	} else {
@@ -241,68 +697,52 @@ ldns_zone_new_frm_fp(ldns_zone **z, FILE *fp, ldns_rdf *origin, uint32_t ttl, ld
 	return ldns_zone_new_frm_fp_l(z, fp, origin, ttl, c, NULL);
 }
 
-ldns_status
-ldns_zone_new_frm_fp_l(ldns_zone **z, FILE *fp, ldns_rdf *origin, uint32_t ttl, ldns_rr_class c, 
-		int *line_nr)
+/* reads the zone from fp, or from b when fp is NULL */
+/* the body of the zone reader: rrs are read from fp or b until the end,
+ * the ttl, origin, previous owner and whether the soa was seen carry
+ * over from line to line */
+static ldns_status
+ldns_zone_read_rrs(ldns_zone *newzone, ldns_rr_parser *parser, FILE *fp, 
+		ldns_buffer *b, uint32_t *my_ttl, ldns_rdf **my_origin, 
+		ldns_rdf **my_prev, bool *soa_seen, int *line_nr)
 {
-	ldns_zone *newzone;
 	ldns_rr *rr;
-	uint32_t my_ttl = ttl;
-	ldns_rr_class my_class = c;
-	ldns_rr *last_rr = NULL;
-	ldns_rdf *my_origin;
-	ldns_rdf *my_prev;
-	bool soa_seen = false; 	/* 2 soa are an error */
 	ldns_status s;
 
-	newzone = ldns_zone_new();
-	my_origin = origin;
-	my_ttl    = ttl;
-	my_class  = c;
-	
-	if (origin) {
-		my_origin = ldns_rdf_clone(origin);
-		/* also set the prev */
-		my_prev   = ldns_rdf_clone(origin);
-	} else {
-		my_origin = NULL;
-		my_prev = NULL;
-	}
-
-	while(!feof(fp)) {
-		s = ldns_rr_new_frm_fp_l(&rr, fp, &my_ttl, &my_origin, &my_prev, line_nr);
+	while(fp ? !feof(fp) : ldns_buffer_remaining(b) > 0) {
+		if (fp) {
+			s = ldns_rr_parser_frm_fp_l(parser, &rr, fp, my_ttl, 
+					my_origin, my_prev, line_nr);
+		} else {
+			s = ldns_rr_parser_frm_buffer_l(parser, &rr, b, my_ttl, 
+					my_origin, my_prev, line_nr);
+		}
 		switch (s) {
 		case LDNS_STATUS_OK:
 			if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA) {
-				if (soa_seen) {
+				if (*soa_seen) {
 					/* second SOA 
 					 * just skip, maybe we want to say
 					 * something??? */
 					ldns_rr_free(rr);
 					continue;
 				}
-				soa_seen = true;
+				*soa_seen = true;
 				ldns_zone_set_soa(newzone, rr);
 				/* set origin to soa if not specified */
-				if (!my_origin) {
-					my_origin = ldns_rdf_clone(ldns_rr_owner(rr));
+				if (!*my_origin) {
+					*my_origin = ldns_rdf_clone(ldns_rr_owner(rr));
 				}
 				continue;
 			}
 			
 			/* a normal RR - as sofar the DNS is normal */
-			last_rr = rr;
 			if (!ldns_zone_push_rr(newzone, rr)) {
-				if (my_origin) {
-					ldns_rdf_deep_free(my_origin);
-				}
-				ldns_zone_free(newzone);
 				return LDNS_STATUS_MEM_ERR;
 			}
 
 			/*my_origin = ldns_rr_owner(rr);*/
-			my_ttl    = ldns_rr_ttl(rr);
-			my_class  = ldns_rr_get_class(rr);
+			*my_ttl = ldns_rr_ttl(rr);
 		case LDNS_STATUS_SYNTAX_EMPTY:
 			/* empty line was seen */
 		case LDNS_STATUS_SYNTAX_TTL:
@@ -312,61 +752,2241 @@ ldns_zone_new_frm_fp_l(ldns_zone **z, FILE *fp, ldns_rdf *origin, uint32_t ttl,
 			/* the function set the origin */
 			break;
 		default:
-			ldns_zone_free(newzone);
 			return s;
 		}
 	}
-
-	if (my_origin) {
-		ldns_rdf_deep_free(my_origin);
-	}
-	if (my_prev) {
-		ldns_rdf_deep_free(my_prev);
-	}
-	if (z) {
-		*z = newzone;
-	}
-
 	return LDNS_STATUS_OK;
 }
 
-void
-ldns_zone_sort(ldns_zone *zone)
+#ifdef HAVE_PTHREAD_H
+/* a part of the zone data, parsed on its own thread from the state the
+ * lines before it left behind */
+struct ldns_struct_zone_chunk {
+	size_t _start;
+	ldns_buffer _buf;
+	ldns_zone *_zone;
+	uint32_t _ttl;
+	ldns_rdf *_origin;
+	ldns_rdf *_prev;
+	bool _soa_seen;
+	int _line_nr;
+	ldns_status _status;
+};
+typedef struct ldns_struct_zone_chunk ldns_zone_chunk;
+
+static void *
+ldns_zone_chunk_run(void *arg)
 {
-	ldns_rr_list *zrr;
-	assert(zone != NULL);
+	ldns_zone_chunk *chunk = (ldns_zone_chunk *) arg;
+	ldns_rr_parser *parser;
 
-	zrr = ldns_zone_rrs(zone);
-	ldns_rr_list_sort(zrr);
+	chunk->_zone = ldns_zone_new();
+	parser = ldns_rr_parser_new();
+	if (!chunk->_zone || !parser) {
+		chunk->_status = LDNS_STATUS_MEM_ERR;
+	} else {
+		chunk->_status = ldns_zone_read_rrs(chunk->_zone, parser, NULL, 
+				&chunk->_buf, &chunk->_ttl, &chunk->_origin, 
+				&chunk->_prev, &chunk->_soa_seen, 
+				&chunk->_line_nr);
+	}
+	ldns_rr_parser_free(parser);
+	return NULL;
 }
 
-#if 0
-/**
- * ixfr function. Work on a ldns_zone and remove and add
- * the rrs from the rrlist
- * \param[in] z the zone to work on
- * \param[in] del rr_list to remove from the zone
- * \param[in] add rr_list to add to the zone
- * \return Tja, wat zouden we eens returnen TODO
- */
-void
-ldns_zone_ixfr_del_add(ldns_zone *z, ldns_rr_list *del, ldns_rr_list *add)
+/* the previous owner is only kept as text while skimming, it is made
+ * into a dname when a chunk needs it or the origin changes under it */
+static bool
+ldns_zone_skim_prev(ldns_rdf **prev, char *owner, ldns_rdf *origin)
 {
-	
+	ldns_rdf *dname;
+
+	if (owner[0] == '\0') {
+		return true;
+	}
+	dname = ldns_dname_new_frm_str(owner);
+	if (!dname) {
+		return false;
+	}
+	if (!ldns_dname_str_absolute(owner) && origin &&
+	    ldns_dname_cat(dname, origin) != LDNS_STATUS_OK) {
+		ldns_rdf_deep_free(dname);
+		return false;
+	}
+	if (*prev) {
+		ldns_rdf_deep_free(*prev);
+	}
+	*prev = dname;
+	owner[0] = '\0';
+	return true;
 }
-#endif
 
-void
-ldns_zone_free(ldns_zone *zone) 
+static void
+ldns_zone_chunk_init(ldns_zone_chunk *chunk, ldns_buffer *b, size_t start, 
+		uint32_t ttl, ldns_rdf *origin, ldns_rdf *prev, bool soa_seen, 
+		int line_nr)
 {
-	ldns_rr_list_free(zone->_rrs);
-	LDNS_FREE(zone);
+	chunk->_start = start;
+	chunk->_buf._data = ldns_buffer_at(b, start);
+	chunk->_buf._position = 0;
+	chunk->_buf._limit = chunk->_buf._capacity = 
+		ldns_buffer_limit(b) - start;
+	chunk->_buf._fixed = 1;
+	chunk->_buf._status = LDNS_STATUS_OK;
+	chunk->_zone = NULL;
+	chunk->_ttl = ttl;
+	chunk->_origin = origin ? ldns_rdf_clone(origin) : NULL;
+	chunk->_prev = prev ? ldns_rdf_clone(prev) : NULL;
+	chunk->_soa_seen = soa_seen;
+	chunk->_line_nr = line_nr;
+	chunk->_status = LDNS_STATUS_OK;
 }
 
-void
-ldns_zone_deep_free(ldns_zone *zone) 
+/*
+ * Reads the zone in b with all cpus. A first pass skims the lines for
+ * what carries over between them ($ORIGIN, $TTL, the previous owner and
+ * the SOA) and cuts the data at line boundaries into chunks, each one is
+ * parsed on its own thread as soon as its end is known. Only the head of
+ * an rr is read in the first pass; an SOA or $ORIGIN line, and anything
+ * that does not read cleanly, gets the full treatment or ends the
+ * cutting, so the last chunk takes the rest. The chunks are put back
+ * together in file order, the first error wins, as it would when read
+ * in one go.
+ * Returns false when there is only one cpu.
+ */
+static bool
+ldns_zone_read_rrs_parallel(ldns_zone *newzone, ldns_buffer *b, 
+		ldns_rdf *origin, uint32_t ttl, int *line_nr, ldns_status *status)
 {
-	ldns_rr_free(zone->_soa);
-	ldns_rr_list_deep_free(zone->_rrs);
-	LDNS_FREE(zone);
+	pthread_t threads[LDNS_ZONE_MAX_THREADS];
+	bool started[LDNS_ZONE_MAX_THREADS];
+	ldns_zone_chunk chunks[LDNS_ZONE_MAX_THREADS];
+	char owner[LDNS_MAX_DOMAINLEN + 1];
+	ldns_rr_parser *parser;
+	ldns_buffer skim;
+	ldns_rdf *my_origin;
+	ldns_rdf *my_prev;
+	ldns_rdf *tmp;
+	ldns_rr *rr;
+	uint32_t my_ttl;
+	uint32_t rr_ttl;
+	ldns_rr_type rr_type;
+	const char *rr_owner;
+	const char *keyword;
+	const char *endptr;
+	bool soa_seen;
+	int lines;
+	size_t parts, n, i, step, next;
+	ssize_t size;
+	long cpus;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 2) {
+		return false;
+	}
+	parts = cpus > LDNS_ZONE_MAX_THREADS ?
+	        LDNS_ZONE_MAX_THREADS : (size_t) cpus;
+	parser = ldns_rr_parser_new();
+	if (!parser) {
+		return false;
+	}
+
+	my_ttl = ttl;
+	my_origin = origin ? ldns_rdf_clone(origin) : NULL;
+	my_prev = origin ? ldns_rdf_clone(origin) : NULL;
+	soa_seen = false;
+	lines = line_nr ? *line_nr : 0;
+	owner[0] = '\0';
+	skim = *b;
+	step = ldns_buffer_remaining(b) / parts;
+	next = ldns_buffer_position(b) + step;
+
+	n = 0;
+	ldns_zone_chunk_init(&chunks[0], b, ldns_buffer_position(b), my_ttl, 
+			my_origin, my_prev, soa_seen, lines);
+	while (n + 1 < parts && ldns_buffer_remaining(&skim) > 0) {
+		if (ldns_buffer_position(&skim) >= next) {
+			/* cut here, the part before can be parsed */
+			if (!ldns_zone_skim_prev(&my_prev, owner, my_origin)) {
+				break;
+			}
+			chunks[n]._buf._limit = chunks[n]._buf._capacity = 
+				ldns_buffer_position(&skim) - chunks[n]._start;
+			started[n] = pthread_create(&threads[n], NULL, 
+					ldns_zone_chunk_run, &chunks[n]) == 0;
+			n++;
+			ldns_zone_chunk_init(&chunks[n], b, 
+					ldns_buffer_position(&skim), my_ttl, 
+					my_origin, my_prev, soa_seen, lines);
+			next = ldns_buffer_position(&skim) + step;
+			continue;
+		}
+
+		size = ldns_mget_token_l(&skim, parser->_line, 
+				LDNS_PARSE_SKIP_SPACE, LDNS_MAX_LINELEN, &lines);
+		if (size == -1) {
+			break;
+		}
+		if (size == 0) {
+			continue;
+		}
+		/* the same order as ldns_rr_new_frm_fp_l() */
+		if ((keyword = strstr(parser->_line, "$ORIGIN "))) {
+			if (!ldns_zone_skim_prev(&my_prev, owner, my_origin)) {
+				break;
+			}
+			tmp = ldns_rdf_new_frm_str(LDNS_RDF_TYPE_DNAME, 
+					keyword + 8);
+			if (!tmp) {
+				break;
+			}
+			if (my_origin) {
+				ldns_rdf_deep_free(my_origin);
+			}
+			my_origin = tmp;
+		} else if ((keyword = strstr(parser->_line, "$TTL "))) {
+			my_ttl = ldns_str2period(keyword + 5, &endptr);
+		} else {
+			if (ldns_rr_parser_frm_str_head(parser, parser->_line, 
+					my_ttl, &rr_owner, &rr_ttl, &rr_type) 
+					!= LDNS_STATUS_OK) {
+				break;
+			}
+			if (rr_type == LDNS_RR_TYPE_SOA) {
+				if (!ldns_zone_skim_prev(&my_prev, owner, 
+							my_origin) ||
+				    ldns_rr_parser_frm_str(parser, &rr, 
+					    parser->_line, my_ttl, my_origin, 
+					    &my_prev) != LDNS_STATUS_OK) {
+					break;
+				}
+				if (!soa_seen) {
+					soa_seen = true;
+					if (!my_origin) {
+						my_origin = ldns_rdf_clone(
+							ldns_rr_owner(rr));
+					}
+				}
+				ldns_rr_free(rr);
+				continue;
+			}
+			if (rr_owner[0] != '\0' && strcmp(rr_owner, "@") != 0) {
+				memcpy(owner, rr_owner, strlen(rr_owner) + 1);
+			}
+			my_ttl = rr_ttl;
+		}
+	}
+	/* the last chunk takes the rest */
+	started[n] = false;
+	for (i = 0; i <= n; i++) {
+		if (!started[i]) {
+			(void) ldns_zone_chunk_run(&chunks[i]);
+		}
+	}
+	for (i = 0; i <= n; i++) {
+		if (started[i]) {
+			(void) pthread_join(threads[i], NULL);
+		}
+	}
+
+	*status = LDNS_STATUS_OK;
+	for (i = 0; i <= n; i++) {
+		if (*status == LDNS_STATUS_OK) {
+			*status = chunks[i]._status;
+			if (line_nr) {
+				*line_nr = chunks[i]._line_nr;
+			}
+			ldns_buffer_set_position(b, chunks[i]._start + 
+					ldns_buffer_position(&chunks[i]._buf));
+		}
+		if (*status == LDNS_STATUS_OK) {
+			if (ldns_zone_soa(chunks[i]._zone)) {
+				ldns_zone_set_soa(newzone, 
+						ldns_zone_soa(chunks[i]._zone));
+			}
+			if (!ldns_zone_push_rr_list(newzone, 
+						ldns_zone_rrs(chunks[i]._zone))) {
+				*status = LDNS_STATUS_MEM_ERR;
+			}
+			ldns_zone_free(chunks[i]._zone);
+		} else if (chunks[i]._zone) {
+			ldns_zone_deep_free(chunks[i]._zone);
+		}
+		if (chunks[i]._origin) {
+			ldns_rdf_deep_free(chunks[i]._origin);
+		}
+		if (chunks[i]._prev) {
+			ldns_rdf_deep_free(chunks[i]._prev);
+		}
+	}
+
+	if (my_origin) {
+		ldns_rdf_deep_free(my_origin);
+	}
+	if (my_prev) {
+		ldns_rdf_deep_free(my_prev);
+	}
+	ldns_rr_parser_free(parser);
+	return true;
+}
+#endif /* HAVE_PTHREAD_H */
+
+static ldns_status
+ldns_zone_new_frm_reader(ldns_zone **z, FILE *fp, ldns_buffer *b, ldns_rdf *origin, 
+		uint32_t ttl, ldns_rr_class c, int *line_nr)
+{
+	ldns_zone *newzone;
+	uint32_t my_ttl;
+	ldns_rdf *my_origin;
+	ldns_rdf *my_prev;
+	bool soa_seen = false; 	/* 2 soa are an error */
+	ldns_status s;
+	ldns_rr_parser *parser;
+
+	(void) c;
+	newzone = ldns_zone_new();
+	if (!newzone) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+#ifdef HAVE_PTHREAD_H
+	if (b && ldns_buffer_remaining(b) >= LDNS_ZONE_PARALLEL_MIN &&
+	    ldns_zone_read_rrs_parallel(newzone, b, origin, ttl, line_nr, &s)) {
+		if (s != LDNS_STATUS_OK) {
+			ldns_zone_free(newzone);
+			return s;
+		}
+		if (z) {
+			*z = newzone;
+		}
+		return LDNS_STATUS_OK;
+	}
+#endif
+	/* one set of scratch buffers for all the rrs */
+	parser = ldns_rr_parser_new();
+	if (!parser) {
+		ldns_zone_free(newzone);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	my_ttl    = ttl;
+	
+	if (origin) {
+		my_origin = ldns_rdf_clone(origin);
+		/* also set the prev */
+		my_prev   = ldns_rdf_clone(origin);
+	} else {
+		my_origin = NULL;
+		my_prev = NULL;
+	}
+
+	s = ldns_zone_read_rrs(newzone, parser, fp, b, &my_ttl, &my_origin, 
+			&my_prev, &soa_seen, line_nr);
+
+	if (my_origin) {
+		ldns_rdf_deep_free(my_origin);
+	}
+	if (my_prev) {
+		ldns_rdf_deep_free(my_prev);
+	}
+	ldns_rr_parser_free(parser);
+	if (s != LDNS_STATUS_OK) {
+		ldns_zone_free(newzone);
+		return s;
+	}
+	if (z) {
+		*z = newzone;
+	}
+
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_zone_new_frm_fp_l(ldns_zone **z, FILE *fp, ldns_rdf *origin, uint32_t ttl, ldns_rr_class c, 
+		int *line_nr)
+{
+	return ldns_zone_new_frm_reader(z, fp, NULL, origin, ttl, c, line_nr);
+}
+
+ldns_status
+ldns_zone_new_frm_buffer_l(ldns_zone **z, ldns_buffer *b, ldns_rdf *origin, uint32_t ttl, 
+		ldns_rr_class c, int *line_nr)
+{
+	return ldns_zone_new_frm_reader(z, NULL, b, origin, ttl, c, line_nr);
+}
+
+ldns_status
+ldns_zone_new_frm_file(ldns_zone **z, const char *filename, ldns_rdf *origin, uint32_t ttl, 
+		ldns_rr_class c)
+{
+	return ldns_zone_new_frm_file_l(z, filename, origin, ttl, c, NULL);
+}
+
+ldns_status
+ldns_zone_new_frm_file_l(ldns_zone **z, const char *filename, ldns_rdf *origin, uint32_t ttl, 
+		ldns_rr_class c, int *line_nr)
+{
+	FILE *fp;
+	ldns_status s;
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+	int fd;
+	struct stat st;
+	void *map;
+	ldns_buffer b;
+
+	fd = open(filename, O_RDONLY);
+	if (fd == -1) {
+		return LDNS_STATUS_FILE_ERR;
+	}
+	/* only regular files can be mapped, and an empty one can't. Those
+	 * go through stdio */
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+	    (uintmax_t) st.st_size <= (uintmax_t) SIZE_MAX) {
+		map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			close(fd);
+#ifdef MADV_SEQUENTIAL
+			(void) madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+#endif
+			/* the buffer only borrows the mapping, it is
+			 * never grown or freed */
+			b._position = 0;
+			b._limit = b._capacity = (size_t) st.st_size;
+			b._data = (uint8_t *) map;
+			b._fixed = 1;
+			b._status = LDNS_STATUS_OK;
+			s = ldns_zone_new_frm_buffer_l(z, &b, origin, ttl, c, 
+					line_nr);
+			munmap(map, (size_t) st.st_size);
+			return s;
+		}
+	}
+	fp = fdopen(fd, "r");
+	if (!fp) {
+		close(fd);
+		return LDNS_STATUS_FILE_ERR;
+	}
+#else
+	fp = fopen(filename, "r");
+	if (!fp) {
+		return LDNS_STATUS_FILE_ERR;
+	}
+#endif
+	s = ldns_zone_new_frm_fp_l(z, fp, origin, ttl, c, line_nr);
+	fclose(fp);
+	return s;
+}
+
+void
+ldns_zone_sort(ldns_zone *zone)
+{
+	ldns_rr_list *zrr;
+	assert(zone != NULL);
+
+	zrr = ldns_zone_rrs(zone);
+	ldns_rr_list_sort(zrr);
+}
+
+/* puts the rrs of an axfr in a zone as they come in */
+static ldns_status
+ldns_zone_axfr_push(ldns_rr *rr, void *arg)
+{
+	ldns_zone *z = (ldns_zone *) arg;
+
+	if (!ldns_zone_soa(z)) {
+		ldns_zone_set_soa(z, rr);
+	} else if (!ldns_zone_push_rr(z, rr)) {
+		ldns_rr_free(rr);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_zone_new_frm_axfr(ldns_zone **z, ldns_resolver *resolver,
+		ldns_rdf *origin, ldns_rr_class c)
+{
+	ldns_zone *newzone;
+	ldns_status status;
+
+	newzone = ldns_zone_new();
+	if (!newzone || !ldns_zone_rrs(newzone)) {
+		if (newzone) {
+			ldns_zone_free(newzone);
+		}
+		return LDNS_STATUS_MEM_ERR;
+	}
+	status = ldns_axfr_stream(resolver, origin, c, ldns_zone_axfr_push,
+			newzone);
+	if (status != LDNS_STATUS_OK) {
+		ldns_zone_deep_free(newzone);
+		return status;
+	}
+	*z = newzone;
+	return LDNS_STATUS_OK;
+}
+
+/* reads the answers of a zone transfer one rr at a time */
+struct ldns_struct_zone_xfr
+{
+	ldns_resolver *_resolver;
+	ldns_pkt *_pkt;
+	size_t _i;
+	/* messages read so far */
+	size_t _pkt_count;
+	ldns_status _status;
+	ldns_pkt_rcode _rcode;
+};
+typedef struct ldns_struct_zone_xfr ldns_zone_xfr;
+
+/* the next rr of the transfer, owned by the reader and only good until
+ * the next call. NULL at errors, see xfr->_status */
+static ldns_rr *
+ldns_zone_xfr_next(ldns_zone_xfr *xfr)
+{
+	uint8_t *wire;
+	size_t wire_size;
+
+	while (!xfr->_pkt || xfr->_i == ldns_pkt_ancount(xfr->_pkt)) {
+		if (xfr->_pkt) {
+			ldns_pkt_free(xfr->_pkt);
+			xfr->_pkt = NULL;
+		}
+		wire = ldns_tcp_read_wire(xfr->_resolver->_socket, &wire_size);
+		if (!wire) {
+			xfr->_status = LDNS_STATUS_NETWORK_ERR;
+			return NULL;
+		}
+		xfr->_status = ldns_wire2pkt(&xfr->_pkt, wire, wire_size);
+		LDNS_FREE(wire);
+		if (xfr->_status != LDNS_STATUS_OK) {
+			xfr->_pkt = NULL;
+			return NULL;
+		}
+		xfr->_pkt_count++;
+		xfr->_i = 0;
+		xfr->_rcode = ldns_pkt_get_rcode(xfr->_pkt);
+		if (xfr->_rcode != LDNS_RCODE_NOERROR) {
+			xfr->_status = LDNS_STATUS_XFR_RCODE_ERR;
+			return NULL;
+		}
+	}
+	return ldns_rr_list_rr(ldns_pkt_answer(xfr->_pkt), xfr->_i++);
+}
+
+static void
+ldns_zone_xfr_end(ldns_zone_xfr *xfr)
+{
+	if (xfr->_pkt) {
+		ldns_pkt_free(xfr->_pkt);
+		xfr->_pkt = NULL;
+	}
+	if (xfr->_resolver->_socket != 0) {
+		close(xfr->_resolver->_socket);
+		xfr->_resolver->_socket = 0;
+	}
+}
+
+static uint32_t
+ldns_zone_soa_serial(const ldns_rr *soa)
+{
+	return ldns_rdf2native_int32(ldns_rr_rdf(soa, 2));
+}
+
+/* the rr from rrs equal to rr, taken out of it, or NULL */
+static ldns_rr *
+ldns_zone_index_take_rr(ldns_zone_index *index, const ldns_rr *rr)
+{
+	ldns_zone_name *name;
+	ldns_zone_rrset *rrset;
+	ldns_rr *found;
+	size_t count, i;
+
+	name = ldns_zone_index_name(index, ldns_rr_owner(rr));
+	if (!name) {
+		return NULL;
+	}
+	rrset = ldns_zone_name_rrset(name, ldns_rr_get_type(rr));
+	if (!rrset) {
+		return NULL;
+	}
+	count = ldns_rr_list_rr_count(rrset->_rrs);
+	for (i = 0; i < count; i++) {
+		found = ldns_rr_list_rr(rrset->_rrs, i);
+		if (ldns_rr_compare(found, rr) == 0) {
+			/* keep the order of the rest */
+			for (; i + 1 < count; i++) {
+				ldns_rr_list_set_rr(rrset->_rrs,
+					ldns_rr_list_rr(rrset->_rrs, i + 1), i);
+			}
+			ldns_rr_list_set_rr(rrset->_rrs, found, count - 1);
+			return ldns_rr_list_pop_rr(rrset->_rrs);
+		}
+	}
+	return NULL;
+}
+
+/* applies the differences of an incremental transfer, the deletions of
+ * the first one are next in xfr */
+static ldns_status
+ldns_zone_ixfr_apply(ldns_zone_xfr *xfr, const ldns_zone *zone,
+		uint32_t serial, ldns_zone **newzone, ldns_rr_list *removed)
+{
+	ldns_zone_index *index;
+	ldns_rr_list *added;
+	ldns_rr *rr, *copy;
+	ldns_zone *z;
+	ldns_status status;
+	bool adding;
+	size_t i;
+	uint16_t j;
+
+	index = ldns_zone_index_new_frm_rrs(NULL, NULL, ldns_zone_rrs(zone));
+	added = ldns_rr_list_new();
+	if (!index || !added) {
+		ldns_zone_index_free(index);
+		ldns_rr_list_free(added);
+		return LDNS_STATUS_MEM_ERR;
+	}
+
+	status = LDNS_STATUS_OK;
+	adding = false;
+	while (status == LDNS_STATUS_OK) {
+		rr = ldns_zone_xfr_next(xfr);
+		if (!rr) {
+			status = xfr->_status;
+		} else if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA) {
+			if (adding && ldns_zone_soa_serial(rr) == serial) {
+				break;
+			}
+			/* the soa of the next version starts its additions,
+			 * the soa of that version its next deletions */
+			adding = !adding;
+		} else if (!adding) {
+			copy = ldns_zone_index_take_rr(index, rr);
+			if (!copy) {
+				/* the nameserver and we do not agree on
+				 * what the zone is */
+				status = LDNS_STATUS_XFR_FORMAT_ERR;
+			} else if (!ldns_rr_list_push_rr(removed, copy)) {
+				status = LDNS_STATUS_MEM_ERR;
+			}
+		} else {
+			copy = ldns_rr_clone(rr);
+			if (!copy || !ldns_rr_list_push_rr(added, copy)) {
+				ldns_rr_free(copy);
+				status = LDNS_STATUS_MEM_ERR;
+			} else if (!ldns_zone_index_add_rr(index, copy)) {
+				status = LDNS_STATUS_MEM_ERR;
+			}
+		}
+	}
+
+	z = NULL;
+	if (status == LDNS_STATUS_OK) {
+		z = ldns_zone_new();
+		if (!z || !ldns_zone_rrs(z) ||
+		    !(copy = ldns_rr_clone(rr))) {
+			status = LDNS_STATUS_MEM_ERR;
+		} else {
+			ldns_zone_set_soa(z, copy);
+		}
+	}
+	for (i = 0; status == LDNS_STATUS_OK && i < index->_name_count; i++) {
+		for (j = 0; j < index->_names[i]._rrset_count; j++) {
+			if (!ldns_rr_list_cat(ldns_zone_rrs(z),
+					index->_names[i]._rrsets[j]._rrs)) {
+				status = LDNS_STATUS_MEM_ERR;
+				break;
+			}
+		}
+	}
+	ldns_zone_index_free(index);
+
+	if (status != LDNS_STATUS_OK) {
+		/* the rrs taken out of zone are still in zone, the ones
+		 * added might be in removed as well */
+		if (z) {
+			ldns_rr_free(ldns_zone_soa(z));
+			ldns_zone_free(z);
+		}
+		ldns_rr_list_deep_free(added);
+		return status;
+	}
+	ldns_rr_list_free(added);
+	*newzone = z;
+	return LDNS_STATUS_OK;
+}
+
+/* the zone as a whole in the answer to an ixfr, rr is the first after
+ * the soa */
+static ldns_status
+ldns_zone_ixfr_whole(ldns_zone_xfr *xfr, ldns_rr *soa, ldns_rr *rr,
+		ldns_zone **newzone)
+{
+	ldns_zone *z;
+	ldns_rr *copy;
+	ldns_status status;
+	uint32_t serial;
+
+	z = ldns_zone_new();
+	copy = ldns_rr_clone(soa);
+	if (!z || !ldns_zone_rrs(z) || !copy) {
+		if (z) {
+			ldns_zone_free(z);
+		}
+		ldns_rr_free(copy);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	ldns_zone_set_soa(z, copy);
+	serial = ldns_zone_soa_serial(soa);
+
+	status = LDNS_STATUS_OK;
+	while (ldns_rr_get_type(rr) != LDNS_RR_TYPE_SOA ||
+	       ldns_zone_soa_serial(rr) != serial) {
+		copy = ldns_rr_clone(rr);
+		if (!copy || !ldns_zone_push_rr(z, copy)) {
+			ldns_rr_free(copy);
+			status = LDNS_STATUS_MEM_ERR;
+			break;
+		}
+		rr = ldns_zone_xfr_next(xfr);
+		if (!rr) {
+			status = xfr->_status;
+			break;
+		}
+	}
+	if (status != LDNS_STATUS_OK) {
+		ldns_zone_deep_free(z);
+		return status;
+	}
+	*newzone = z;
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_zone_ixfr(ldns_resolver *resolver, const ldns_zone *zone,
+		ldns_zone **newzone, ldns_rr_list **removed)
+{
+	ldns_zone_xfr xfr;
+	ldns_rr *soa, *rr;
+	ldns_rr *first;
+	ldns_rr_list *gone;
+	ldns_zone *z;
+	ldns_status status;
+	uint32_t serial;
+	bool incremental;
+
+	if (!resolver || !zone || !newzone || !removed) {
+		return LDNS_STATUS_NULL;
+	}
+	*newzone = NULL;
+	*removed = NULL;
+	soa = ldns_zone_soa(zone);
+	if (!soa || ldns_rr_rd_count(soa) < 3) {
+		return LDNS_STATUS_ERR;
+	}
+	serial = ldns_zone_soa_serial(soa);
+	gone = ldns_rr_list_new();
+	if (!gone) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+
+	status = ldns_ixfr_start(resolver, ldns_rr_owner(soa),
+			ldns_rr_get_class(soa), soa);
+	if (status != LDNS_STATUS_OK) {
+		ldns_rr_list_free(gone);
+		return status;
+	}
+	xfr._resolver = resolver;
+	xfr._pkt = NULL;
+	xfr._i = 0;
+	xfr._pkt_count = 0;
+	xfr._status = LDNS_STATUS_OK;
+	xfr._rcode = LDNS_RCODE_NOERROR;
+
+	first = NULL;
+	z = NULL;
+	incremental = false;
+	rr = ldns_zone_xfr_next(&xfr);
+	if (!rr) {
+		status = xfr._status;
+		if (status == LDNS_STATUS_XFR_RCODE_ERR &&
+		    xfr._pkt_count == 1 &&
+		    (xfr._rcode == LDNS_RCODE_NOTIMPL ||
+		     xfr._rcode == LDNS_RCODE_FORMERR)) {
+			/* no ixfr there */
+			ldns_zone_xfr_end(&xfr);
+			status = ldns_zone_new_frm_axfr(&z, resolver,
+					ldns_rr_owner(soa),
+					ldns_rr_get_class(soa));
+		}
+	} else if (ldns_rr_get_type(rr) != LDNS_RR_TYPE_SOA ||
+		   ldns_rr_rd_count(rr) < 3) {
+		status = LDNS_STATUS_XFR_FORMAT_ERR;
+	} else if (ldns_zone_soa_serial(rr) == serial) {
+		/* up to date, this soa is all there is */
+		ldns_zone_xfr_end(&xfr);
+		ldns_rr_list_free(gone);
+		return LDNS_STATUS_OK;
+	} else if (!(first = ldns_rr_clone(rr))) {
+		status = LDNS_STATUS_MEM_ERR;
+	} else if (!(rr = ldns_zone_xfr_next(&xfr))) {
+		status = xfr._status;
+	} else if (ldns_rr_get_type(rr) == LDNS_RR_TYPE_SOA &&
+		   ldns_zone_soa_serial(rr) == serial) {
+		/* differences, the old soa goes with the first deletions */
+		incremental = true;
+		if (!ldns_rr_list_push_rr(gone, soa)) {
+			status = LDNS_STATUS_MEM_ERR;
+		} else {
+			status = ldns_zone_ixfr_apply(&xfr, zone,
+				ldns_zone_soa_serial(first), &z, gone);
+		}
+	} else {
+		status = ldns_zone_ixfr_whole(&xfr, first, rr, &z);
+	}
+	ldns_zone_xfr_end(&xfr);
+	ldns_rr_free(first);
+
+	/* a whole zone, all of the old one makes way for it */
+	if (status == LDNS_STATUS_OK && !incremental &&
+	    (!ldns_rr_list_push_rr(gone, soa) ||
+	     !ldns_rr_list_cat(gone, ldns_zone_rrs(zone)))) {
+		ldns_zone_deep_free(z);
+		status = LDNS_STATUS_MEM_ERR;
+	}
+	if (status != LDNS_STATUS_OK) {
+		ldns_rr_list_free(gone);
+		return status;
+	}
+	*newzone = z;
+	*removed = gone;
+	return LDNS_STATUS_OK;
+}
+
+void
+ldns_zone_free(ldns_zone *zone) 
+{
+	ldns_rr_list_free(zone->_rrs);
+	LDNS_FREE(zone);
+}
+
+void
+ldns_zone_deep_free(ldns_zone *zone) 
+{
+	ldns_rr_free(zone->_soa);
+	ldns_rr_list_deep_free(zone->_rrs);
+	LDNS_FREE(zone);
+}
+
+/* a name and an rrset while a snapshot is written */
+struct ldns_struct_zone_snapshot_name_entry {
+	uint32_t _key;
+	uint16_t _key_size;
+	uint16_t _rrset_count;
+	uint32_t _hash;
+	uint32_t _first_rrset;
+};
+typedef struct ldns_struct_zone_snapshot_name_entry ldns_zone_snapshot_name_entry;
+
+struct ldns_struct_zone_snapshot_rrset_entry {
+	uint16_t _type;
+	uint16_t _class;
+	uint32_t _first_rr;
+	uint32_t _rr_count;
+};
+typedef struct ldns_struct_zone_snapshot_rrset_entry ldns_zone_snapshot_rrset_entry;
+
+/* crc32 of the bytes 0 to 255, polynomial 0xedb88320 */
+static const uint32_t ldns_zone_snapshot_crc_table[256] = {
+	0x00000000U, 0x77073096U, 0xee0e612cU, 0x990951baU, 0x076dc419U,
+	0x706af48fU, 0xe963a535U, 0x9e6495a3U, 0x0edb8832U, 0x79dcb8a4U,
+	0xe0d5e91eU, 0x97d2d988U, 0x09b64c2bU, 0x7eb17cbdU, 0xe7b82d07U,
+	0x90bf1d91U, 0x1db71064U, 0x6ab020f2U, 0xf3b97148U, 0x84be41deU,
+	0x1adad47dU, 0x6ddde4ebU, 0xf4d4b551U, 0x83d385c7U, 0x136c9856U,
+	0x646ba8c0U, 0xfd62f97aU, 0x8a65c9ecU, 0x14015c4fU, 0x63066cd9U,
+	0xfa0f3d63U, 0x8d080df5U, 0x3b6e20c8U, 0x4c69105eU, 0xd56041e4U,
+	0xa2677172U, 0x3c03e4d1U, 0x4b04d447U, 0xd20d85fdU, 0xa50ab56bU,
+	0x35b5a8faU, 0x42b2986cU, 0xdbbbc9d6U, 0xacbcf940U, 0x32d86ce3U,
+	0x45df5c75U, 0xdcd60dcfU, 0xabd13d59U, 0x26d930acU, 0x51de003aU,
+	0xc8d75180U, 0xbfd06116U, 0x21b4f4b5U, 0x56b3c423U, 0xcfba9599U,
+	0xb8bda50fU, 0x2802b89eU, 0x5f058808U, 0xc60cd9b2U, 0xb10be924U,
+	0x2f6f7c87U, 0x58684c11U, 0xc1611dabU, 0xb6662d3dU, 0x76dc4190U,
+	0x01db7106U, 0x98d220bcU, 0xefd5102aU, 0x71b18589U, 0x06b6b51fU,
+	0x9fbfe4a5U, 0xe8b8d433U, 0x7807c9a2U, 0x0f00f934U, 0x9609a88eU,
+	0xe10e9818U, 0x7f6a0dbbU, 0x086d3d2dU, 0x91646c97U, 0xe6635c01U,
+	0x6b6b51f4U, 0x1c6c6162U, 0x856530d8U, 0xf262004eU, 0x6c0695edU,
+	0x1b01a57bU, 0x8208f4c1U, 0xf50fc457U, 0x65b0d9c6U, 0x12b7e950U,
+	0x8bbeb8eaU, 0xfcb9887cU, 0x62dd1ddfU, 0x15da2d49U, 0x8cd37cf3U,
+	0xfbd44c65U, 0x4db26158U, 0x3ab551ceU, 0xa3bc0074U, 0xd4bb30e2U,
+	0x4adfa541U, 0x3dd895d7U, 0xa4d1c46dU, 0xd3d6f4fbU, 0x4369e96aU,
+	0x346ed9fcU, 0xad678846U, 0xda60b8d0U, 0x44042d73U, 0x33031de5U,
+	0xaa0a4c5fU, 0xdd0d7cc9U, 0x5005713cU, 0x270241aaU, 0xbe0b1010U,
+	0xc90c2086U, 0x5768b525U, 0x206f85b3U, 0xb966d409U, 0xce61e49fU,
+	0x5edef90eU, 0x29d9c998U, 0xb0d09822U, 0xc7d7a8b4U, 0x59b33d17U,
+	0x2eb40d81U, 0xb7bd5c3bU, 0xc0ba6cadU, 0xedb88320U, 0x9abfb3b6U,
+	0x03b6e20cU, 0x74b1d29aU, 0xead54739U, 0x9dd277afU, 0x04db2615U,
+	0x73dc1683U, 0xe3630b12U, 0x94643b84U, 0x0d6d6a3eU, 0x7a6a5aa8U,
+	0xe40ecf0bU, 0x9309ff9dU, 0x0a00ae27U, 0x7d079eb1U, 0xf00f9344U,
+	0x8708a3d2U, 0x1e01f268U, 0x6906c2feU, 0xf762575dU, 0x806567cbU,
+	0x196c3671U, 0x6e6b06e7U, 0xfed41b76U, 0x89d32be0U, 0x10da7a5aU,
+	0x67dd4accU, 0xf9b9df6fU, 0x8ebeeff9U, 0x17b7be43U, 0x60b08ed5U,
+	0xd6d6a3e8U, 0xa1d1937eU, 0x38d8c2c4U, 0x4fdff252U, 0xd1bb67f1U,
+	0xa6bc5767U, 0x3fb506ddU, 0x48b2364bU, 0xd80d2bdaU, 0xaf0a1b4cU,
+	0x36034af6U, 0x41047a60U, 0xdf60efc3U, 0xa867df55U, 0x316e8eefU,
+	0x4669be79U, 0xcb61b38cU, 0xbc66831aU, 0x256fd2a0U, 0x5268e236U,
+	0xcc0c7795U, 0xbb0b4703U, 0x220216b9U, 0x5505262fU, 0xc5ba3bbeU,
+	0xb2bd0b28U, 0x2bb45a92U, 0x5cb36a04U, 0xc2d7ffa7U, 0xb5d0cf31U,
+	0x2cd99e8bU, 0x5bdeae1dU, 0x9b64c2b0U, 0xec63f226U, 0x756aa39cU,
+	0x026d930aU, 0x9c0906a9U, 0xeb0e363fU, 0x72076785U, 0x05005713U,
+	0x95bf4a82U, 0xe2b87a14U, 0x7bb12baeU, 0x0cb61b38U, 0x92d28e9bU,
+	0xe5d5be0dU, 0x7cdcefb7U, 0x0bdbdf21U, 0x86d3d2d4U, 0xf1d4e242U,
+	0x68ddb3f8U, 0x1fda836eU, 0x81be16cdU, 0xf6b9265bU, 0x6fb077e1U,
+	0x18b74777U, 0x88085ae6U, 0xff0f6a70U, 0x66063bcaU, 0x11010b5cU,
+	0x8f659effU, 0xf862ae69U, 0x616bffd3U, 0x166ccf45U, 0xa00ae278U,
+	0xd70dd2eeU, 0x4e048354U, 0x3903b3c2U, 0xa7672661U, 0xd06016f7U,
+	0x4969474dU, 0x3e6e77dbU, 0xaed16a4aU, 0xd9d65adcU, 0x40df0b66U,
+	0x37d83bf0U, 0xa9bcae53U, 0xdebb9ec5U, 0x47b2cf7fU, 0x30b5ffe9U,
+	0xbdbdf21cU, 0xcabac28aU, 0x53b39330U, 0x24b4a3a6U, 0xbad03605U,
+	0xcdd70693U, 0x54de5729U, 0x23d967bfU, 0xb3667a2eU, 0xc4614ab8U,
+	0x5d681b02U, 0x2a6f2b94U, 0xb40bbe37U, 0xc30c8ea1U, 0x5a05df1bU,
+	0x2d02ef8dU
+};
+
+/* crc32 (IEEE 802.3), continued from crc */
+static uint32_t
+ldns_zone_snapshot_crc(uint32_t crc, const uint8_t *data, size_t len)
+{
+	size_t i;
+
+	crc = ~crc;
+	for (i = 0; i < len; i++) {
+		crc = ldns_zone_snapshot_crc_table[(crc ^ data[i]) & 0xff] ^
+			(crc >> 8);
+	}
+	return ~crc;
+}
+
+/* the header minus the checksum, and everything after it */
+static uint32_t
+ldns_zone_snapshot_checksum(const uint8_t *header, const uint8_t *rest,
+		size_t rest_size)
+{
+	uint32_t crc;
+
+	crc = ldns_zone_snapshot_crc(0, header, LDNS_ZONE_SNAPSHOT_CHECKSUM);
+	return ldns_zone_snapshot_crc(crc, rest, rest_size);
+}
+
+ldns_status
+ldns_zone_snapshot_write(FILE *fp, const ldns_zone *zone)
+{
+	uint8_t key[LDNS_MAX_DOMAINLEN];
+	uint16_t offsets[LDNS_MAX_DOMAINLEN / 2 + 2];
+	uint32_t hashes[LDNS_MAX_DOMAINLEN / 2 + 2];
+	uint8_t header[LDNS_ZONE_SNAPSHOT_HEADER];
+	ldns_rr_list *rrs;
+	ldns_rr *rr;
+	ldns_rr *prev_rr;
+	ldns_zone_snapshot_name_entry *names;
+	ldns_zone_snapshot_rrset_entry *rrsets;
+	uint32_t *rr_offsets;
+	uint32_t *slots;
+	ldns_buffer *tables;
+	ldns_buffer *keys;
+	ldns_buffer *data;
+	size_t rr_count, name_count, rrset_count, slot_count;
+	size_t i, slot, size;
+	uint32_t soa;
+	uint32_t crc;
+	ldns_status s;
+
+	rrs = ldns_rr_list_new();
+	if (!rrs) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	if (ldns_zone_soa(zone)) {
+		(void) ldns_rr_list_push_rr(rrs, ldns_zone_soa(zone));
+	}
+	if (!ldns_rr_list_cat(rrs, ldns_zone_rrs(zone)) || 
+	    ldns_rr_list_rr_count(rrs) != ldns_rr_list_rr_count(
+		    ldns_zone_rrs(zone)) + (ldns_zone_soa(zone) ? 1 : 0)) {
+		ldns_rr_list_free(rrs);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	ldns_rr_list_sort(rrs);
+	rr_count = ldns_rr_list_rr_count(rrs);
+
+	/* at worst every rr has its own name */
+	names = LDNS_XMALLOC(ldns_zone_snapshot_name_entry, rr_count + 1);
+	rrsets = LDNS_XMALLOC(ldns_zone_snapshot_rrset_entry, rr_count + 1);
+	rr_offsets = LDNS_XMALLOC(uint32_t, rr_count + 1);
+	slot_count = 1;
+	while (slot_count <= rr_count * 2) {
+		slot_count *= 2;
+	}
+	slots = LDNS_XMALLOC(uint32_t, slot_count);
+	tables = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	keys = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	data = ldns_buffer_new(LDNS_MAX_PACKETLEN);
+	s = LDNS_STATUS_OK;
+	if (!names || !rrsets || !rr_offsets || !slots || !tables || 
+	    !keys || !data) {
+		s = LDNS_STATUS_MEM_ERR;
+		goto done;
+	}
+
+	soa = LDNS_ZONE_SNAPSHOT_NONE;
+	name_count = 0;
+	rrset_count = 0;
+	prev_rr = NULL;
+	for (i = 0; i < rr_count; i++) {
+		rr = ldns_rr_list_rr(rrs, i);
+		if (rr == ldns_zone_soa(zone)) {
+			soa = (uint32_t) i;
+		}
+		if (ldns_zone_index_key(ldns_rr_owner(rr), key, offsets, 
+					hashes) == 0) {
+			s = LDNS_STATUS_DOMAINNAME_UNDERFLOW;
+			goto done;
+		}
+		size = ldns_rdf_size(ldns_rr_owner(rr));
+		/* canonical order keeps a name, and a type of a class
+		 * at it, together */
+		if (name_count == 0 || 
+		    names[name_count - 1]._key_size != size ||
+		    memcmp(ldns_buffer_at(keys, names[name_count - 1]._key), 
+			    key, size) != 0) {
+			names[name_count]._key = 
+				(uint32_t) ldns_buffer_position(keys);
+			names[name_count]._key_size = (uint16_t) size;
+			names[name_count]._rrset_count = 0;
+			names[name_count]._hash = hashes[0];
+			names[name_count]._first_rrset = (uint32_t) rrset_count;
+			name_count++;
+			if (ldns_buffer_reserve(keys, size)) {
+				ldns_buffer_write(keys, key, size);
+			}
+			prev_rr = NULL;
+		}
+		if (!prev_rr || 
+		    ldns_rr_get_type(prev_rr) != ldns_rr_get_type(rr) ||
+		    ldns_rr_get_class(prev_rr) != ldns_rr_get_class(rr)) {
+			rrsets[rrset_count]._type = ldns_rr_get_type(rr);
+			rrsets[rrset_count]._class = ldns_rr_get_class(rr);
+			rrsets[rrset_count]._first_rr = (uint32_t) i;
+			rrsets[rrset_count]._rr_count = 0;
+			rrset_count++;
+			names[name_count - 1]._rrset_count++;
+		}
+		rrsets[rrset_count - 1]._rr_count++;
+		prev_rr = rr;
+
+		rr_offsets[i] = (uint32_t) ldns_buffer_position(data);
+		(void) ldns_rr2buffer_wire(data, rr, LDNS_SECTION_ANSWER);
+		if (ldns_buffer_position(data) > LDNS_ZONE_SNAPSHOT_MAX) {
+			s = LDNS_STATUS_MEM_ERR;
+			goto done;
+		}
+	}
+	rr_offsets[rr_count] = (uint32_t) ldns_buffer_position(data);
+	/* the keys end on a four octet boundary */
+	while (ldns_buffer_position(keys) % 4 != 0 && 
+	       ldns_buffer_reserve(keys, 1)) {
+		ldns_buffer_write_u8(keys, 0);
+	}
+	if (ldns_buffer_status(keys) != LDNS_STATUS_OK || 
+	    ldns_buffer_status(data) != LDNS_STATUS_OK) {
+		s = LDNS_STATUS_MEM_ERR;
+		goto done;
+	}
+
+	memset(slots, 0, slot_count * sizeof(uint32_t));
+	for (i = 0; i < name_count; i++) {
+		slot = names[i]._hash & (slot_count - 1);
+		while (slots[slot] != 0) {
+			slot = (slot + 1) & (slot_count - 1);
+		}
+		slots[slot] = (uint32_t) i + 1;
+	}
+
+	if (!ldns_buffer_reserve(tables, name_count * 16 + rrset_count * 12 +
+				(rr_count + 1) * 4 + slot_count * 4)) {
+		s = LDNS_STATUS_MEM_ERR;
+		goto done;
+	}
+	for (i = 0; i < name_count; i++) {
+		ldns_buffer_write_u32(tables, names[i]._key);
+		ldns_buffer_write_u16(tables, names[i]._key_size);
+		ldns_buffer_write_u16(tables, names[i]._rrset_count);
+		ldns_buffer_write_u32(tables, names[i]._hash);
+		ldns_buffer_write_u32(tables, names[i]._first_rrset);
+	}
+	for (i = 0; i < rrset_count; i++) {
+		ldns_buffer_write_u16(tables, rrsets[i]._type);
+		ldns_buffer_write_u16(tables, rrsets[i]._class);
+		ldns_buffer_write_u32(tables, rrsets[i]._first_rr);
+		ldns_buffer_write_u32(tables, rrsets[i]._rr_count);
+	}
+	for (i = 0; i <= rr_count; i++) {
+		ldns_buffer_write_u32(tables, rr_offsets[i]);
+	}
+	for (i = 0; i < slot_count; i++) {
+		ldns_buffer_write_u32(tables, slots[i]);
+	}
+	if (ldns_buffer_position(tables) + ldns_buffer_position(keys) + 
+	    ldns_buffer_position(data) > LDNS_ZONE_SNAPSHOT_MAX) {
+		s = LDNS_STATUS_MEM_ERR;
+		goto done;
+	}
+
+	memcpy(header, LDNS_ZONE_SNAPSHOT_MAGIC, 8);
+	ldns_write_uint32(header + 8, LDNS_ZONE_SNAPSHOT_VERSION);
+	ldns_write_uint32(header + 12, 0);
+	ldns_write_uint32(header + 16, soa);
+	ldns_write_uint32(header + 20, (uint32_t) rr_count);
+	ldns_write_uint32(header + 24, (uint32_t) rrset_count);
+	ldns_write_uint32(header + 28, (uint32_t) name_count);
+	ldns_write_uint32(header + 32, (uint32_t) slot_count);
+	ldns_write_uint32(header + 36, (uint32_t) ldns_buffer_position(keys));
+	ldns_write_uint32(header + 40, (uint32_t) ldns_buffer_position(data));
+	crc = ldns_zone_snapshot_checksum(header, ldns_buffer_begin(tables),
+			ldns_buffer_position(tables));
+	crc = ldns_zone_snapshot_crc(crc, ldns_buffer_begin(keys), 
+			ldns_buffer_position(keys));
+	crc = ldns_zone_snapshot_crc(crc, ldns_buffer_begin(data), 
+			ldns_buffer_position(data));
+	ldns_write_uint32(header + LDNS_ZONE_SNAPSHOT_CHECKSUM, crc);
+
+	if (fwrite(header, 1, sizeof(header), fp) != sizeof(header) ||
+	    fwrite(ldns_buffer_begin(tables), 1, ldns_buffer_position(tables), 
+		    fp) != ldns_buffer_position(tables) ||
+	    fwrite(ldns_buffer_begin(keys), 1, ldns_buffer_position(keys), 
+		    fp) != ldns_buffer_position(keys) ||
+	    fwrite(ldns_buffer_begin(data), 1, ldns_buffer_position(data), 
+		    fp) != ldns_buffer_position(data)) {
+		s = LDNS_STATUS_FILE_ERR;
+	}
+
+done:
+	LDNS_FREE(names);
+	LDNS_FREE(rrsets);
+	LDNS_FREE(rr_offsets);
+	LDNS_FREE(slots);
+	if (tables) {
+		ldns_buffer_free(tables);
+	}
+	if (keys) {
+		ldns_buffer_free(keys);
+	}
+	if (data) {
+		ldns_buffer_free(data);
+	}
+	ldns_rr_list_free(rrs);
+	return s;
+}
+
+ldns_status
+ldns_zone_snapshot_write_file(const char *filename, const ldns_zone *zone)
+{
+	char *tmpname;
+	size_t len;
+	FILE *fp;
+	int fd;
+	ldns_status s;
+
+	/* a temporary file next to it, so the rename stays on the same file
+	 * system */
+	len = strlen(filename);
+	tmpname = LDNS_XMALLOC(char, len + 8);
+	if (!tmpname) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	memcpy(tmpname, filename, len);
+	memcpy(tmpname + len, ".XXXXXX", 8);
+	fd = mkstemp(tmpname);
+	if (fd == -1) {
+		LDNS_FREE(tmpname);
+		return LDNS_STATUS_FILE_ERR;
+	}
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		close(fd);
+		unlink(tmpname);
+		LDNS_FREE(tmpname);
+		return LDNS_STATUS_FILE_ERR;
+	}
+	s = ldns_zone_snapshot_write(fp, zone);
+	if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+		s = LDNS_STATUS_FILE_ERR;
+	}
+	if (fclose(fp) != 0 && s == LDNS_STATUS_OK) {
+		s = LDNS_STATUS_FILE_ERR;
+	}
+	/* readers that have the old file mapped keep it, those that open 
+	 * the name after this get the new one */
+	if (s == LDNS_STATUS_OK && rename(tmpname, filename) != 0) {
+		s = LDNS_STATUS_FILE_ERR;
+	}
+	if (s != LDNS_STATUS_OK) {
+		unlink(tmpname);
+	}
+	LDNS_FREE(tmpname);
+	return s;
+}
+
+static ldns_status
+ldns_zone_snapshot_init(ldns_zone_snapshot *snapshot, const uint8_t *data, 
+		size_t size)
+{
+	uint64_t total;
+	const uint8_t *p;
+
+	if (size < LDNS_ZONE_SNAPSHOT_HEADER ||
+	    memcmp(data, LDNS_ZONE_SNAPSHOT_MAGIC, 8) != 0) {
+		return LDNS_STATUS_SNAPSHOT_FORMAT_ERR;
+	}
+	if (ldns_read_uint32(data + 8) != LDNS_ZONE_SNAPSHOT_VERSION) {
+		return LDNS_STATUS_SNAPSHOT_VERSION_ERR;
+	}
+	snapshot->_soa = ldns_read_uint32(data + 16);
+	snapshot->_rr_count = ldns_read_uint32(data + 20);
+	snapshot->_rrset_count = ldns_read_uint32(data + 24);
+	snapshot->_name_count = ldns_read_uint32(data + 28);
+	snapshot->_slot_count = ldns_read_uint32(data + 32);
+	snapshot->_keys_size = ldns_read_uint32(data + 36);
+	snapshot->_rr_data_size = ldns_read_uint32(data + 40);
+
+	total = LDNS_ZONE_SNAPSHOT_HEADER + 
+		(uint64_t) snapshot->_name_count * 16 +
+		(uint64_t) snapshot->_rrset_count * 12 +
+		((uint64_t) snapshot->_rr_count + 1) * 4 +
+		(uint64_t) snapshot->_slot_count * 4 +
+		snapshot->_keys_size + snapshot->_rr_data_size;
+	if (total != size || 
+	    snapshot->_slot_count <= snapshot->_name_count ||
+	    (snapshot->_slot_count & (snapshot->_slot_count - 1)) != 0 ||
+	    (snapshot->_soa != LDNS_ZONE_SNAPSHOT_NONE && 
+	     snapshot->_soa >= snapshot->_rr_count)) {
+		return LDNS_STATUS_SNAPSHOT_FORMAT_ERR;
+	}
+	if (ldns_zone_snapshot_checksum(data, 
+			data + LDNS_ZONE_SNAPSHOT_HEADER, 
+			size - LDNS_ZONE_SNAPSHOT_HEADER) != 
+	    ldns_read_uint32(data + LDNS_ZONE_SNAPSHOT_CHECKSUM)) {
+		return LDNS_STATUS_SNAPSHOT_CHECKSUM_ERR;
+	}
+
+	p = data + LDNS_ZONE_SNAPSHOT_HEADER;
+	snapshot->_names = p;
+	p += (size_t) snapshot->_name_count * 16;
+	snapshot->_rrsets = p;
+	p += (size_t) snapshot->_rrset_count * 12;
+	snapshot->_rr_offsets = p;
+	p += ((size_t) snapshot->_rr_count + 1) * 4;
+	snapshot->_slots = p;
+	p += (size_t) snapshot->_slot_count * 4;
+	snapshot->_keys = p;
+	p += snapshot->_keys_size;
+	snapshot->_rr_data = p;
+	snapshot->_data = data;
+	snapshot->_size = size;
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_zone_snapshot_new_frm_data(ldns_zone_snapshot **snapshot, 
+		const uint8_t *data, size_t size)
+{
+	ldns_zone_snapshot *snap;
+	ldns_status s;
+
+	snap = LDNS_MALLOC(ldns_zone_snapshot);
+	if (!snap) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	snap->_mapped = false;
+	snap->_alloced = false;
+	s = ldns_zone_snapshot_init(snap, data, size);
+	if (s != LDNS_STATUS_OK) {
+		LDNS_FREE(snap);
+		return s;
+	}
+	*snapshot = snap;
+	return LDNS_STATUS_OK;
+}
+
+ldns_status
+ldns_zone_snapshot_new_frm_file(ldns_zone_snapshot **snapshot, 
+		const char *filename)
+{
+	FILE *fp;
+	uint8_t *data;
+	uint8_t *grown;
+	size_t size;
+	size_t got;
+	ldns_status s;
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+	int fd;
+	struct stat st;
+	void *map;
+
+	fd = open(filename, O_RDONLY);
+	if (fd == -1) {
+		return LDNS_STATUS_FILE_ERR;
+	}
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+	    (uintmax_t) st.st_size <= (uintmax_t) SIZE_MAX) {
+		map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, 
+				fd, 0);
+		if (map != MAP_FAILED) {
+			close(fd);
+			s = ldns_zone_snapshot_new_frm_data(snapshot, 
+					(const uint8_t *) map, 
+					(size_t) st.st_size);
+			if (s != LDNS_STATUS_OK) {
+				munmap(map, (size_t) st.st_size);
+				return s;
+			}
+			(*snapshot)->_mapped = true;
+			return LDNS_STATUS_OK;
+		}
+	}
+	fp = fdopen(fd, "r");
+	if (!fp) {
+		close(fd);
+		return LDNS_STATUS_FILE_ERR;
+	}
+#else
+	fp = fopen(filename, "r");
+	if (!fp) {
+		return LDNS_STATUS_FILE_ERR;
+	}
+#endif
+	/* no mapping, read it in */
+	size = 0;
+	data = LDNS_XMALLOC(uint8_t, LDNS_MAX_PACKETLEN);
+	if (!data) {
+		fclose(fp);
+		return LDNS_STATUS_MEM_ERR;
+	}
+	while ((got = fread(data + size, 1, LDNS_MAX_PACKETLEN, fp)) 
+			== LDNS_MAX_PACKETLEN) {
+		size += got;
+		grown = LDNS_XREALLOC(data, uint8_t, size + LDNS_MAX_PACKETLEN);
+		if (!grown) {
+			fclose(fp);
+			LDNS_FREE(data);
+			return LDNS_STATUS_MEM_ERR;
+		}
+		data = grown;
+	}
+	size += got;
+	if (ferror(fp)) {
+		fclose(fp);
+		LDNS_FREE(data);
+		return LDNS_STATUS_FILE_ERR;
+	}
+	fclose(fp);
+	s = ldns_zone_snapshot_new_frm_data(snapshot, data, size);
+	if (s != LDNS_STATUS_OK) {
+		LDNS_FREE(data);
+		return s;
+	}
+	(*snapshot)->_alloced = true;
+	return LDNS_STATUS_OK;
+}
+
+void
+ldns_zone_snapshot_free(ldns_zone_snapshot *snapshot)
+{
+	if (!snapshot) {
+		return;
+	}
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+	if (snapshot->_mapped) {
+		munmap((void *) snapshot->_data, snapshot->_size);
+	}
+#endif
+	if (snapshot->_alloced) {
+		free((void *) snapshot->_data);
+	}
+	LDNS_FREE(snapshot);
+}
+
+size_t
+ldns_zone_snapshot_rr_count(const ldns_zone_snapshot *snapshot)
+{
+	return snapshot->_rr_count;
+}
+
+/* makes rr number i. Everything is checked, a snapshot with a good
+ * checksum can still be made up */
+static ldns_status
+ldns_zone_snapshot_rr(const ldns_zone_snapshot *snapshot, uint32_t i, 
+		ldns_rr **rr)
+{
+	uint32_t start, end;
+	size_t pos;
+	ldns_status s;
+
+	if (i >= snapshot->_rr_count) {
+		return LDNS_STATUS_SNAPSHOT_FORMAT_ERR;
+	}
+	start = ldns_read_uint32(snapshot->_rr_offsets + (size_t) i * 4);
+	end = ldns_read_uint32(snapshot->_rr_offsets + (size_t) i * 4 + 4);
+	if (start > end || end > snapshot->_rr_data_size) {
+		return LDNS_STATUS_SNAPSHOT_FORMAT_ERR;
+	}
+	pos = 0;
+	s = ldns_wire2rr(rr, snapshot->_rr_data + start, end - start, &pos, 
+			LDNS_SECTION_ANSWER);
+	if (s == LDNS_STATUS_OK && pos != end - start) {
+		ldns_rr_free(*rr);
+		return LDNS_STATUS_SNAPSHOT_FORMAT_ERR;
+	}
+	return s;
+}
+
+ldns_rr *
+ldns_zone_snapshot_soa(const ldns_zone_snapshot *snapshot)
+{
+	ldns_rr *soa;
+
+	if (snapshot->_soa == LDNS_ZONE_SNAPSHOT_NONE ||
+	    ldns_zone_snapshot_rr(snapshot, snapshot->_soa, &soa) != 
+			LDNS_STATUS_OK) {
+		return NULL;
+	}
+	return soa;
+}
+
+/* the rrsets of the name with key, first rrset and count, false when it
+ * is not there */
+static bool
+ldns_zone_snapshot_find(const ldns_zone_snapshot *snapshot, 
+		const uint8_t *key, size_t size, uint32_t hash, 
+		uint32_t *first, uint32_t *count)
+{
+	const uint8_t *name;
+	uint32_t slot, nr, probes, key_at;
+
+	slot = hash & (snapshot->_slot_count - 1);
+	for (probes = 0; probes < snapshot->_slot_count; probes++) {
+		nr = ldns_read_uint32(snapshot->_slots + (size_t) slot * 4);
+		if (nr == 0 || nr > snapshot->_name_count) {
+			return false;
+		}
+		name = snapshot->_names + (size_t) (nr - 1) * 16;
+		key_at = ldns_read_uint32(name);
+		if (ldns_read_uint32(name + 8) == hash && 
+		    ldns_read_uint16(name + 4) == size &&
+		    key_at <= snapshot->_keys_size && 
+		    size <= snapshot->_keys_size - key_at &&
+		    memcmp(snapshot->_keys + key_at, key, size) == 0) {
+			*first = ldns_read_uint32(name + 12);
+			*count = ldns_read_uint16(name + 6);
+			return *first <= snapshot->_rrset_count &&
+			       *count <= snapshot->_rrset_count - *first;
+		}
+		slot = (slot + 1) & (snapshot->_slot_count - 1);
+	}
+	return false;
+}
+
+/* adds the rrs of the rrsets at a name with type to rrs, or all of them
+ * when type is 0 */
+static bool
+ldns_zone_snapshot_push_rrsets(const ldns_zone_snapshot *snapshot, 
+		uint32_t first, uint32_t count, ldns_rr_type type, 
+		ldns_rr_list *rrs)
+{
+	const uint8_t *rrset;
+	uint32_t i, j, first_rr, rr_count;
+	ldns_rr *rr;
+
+	for (i = first; i < first + count; i++) {
+		rrset = snapshot->_rrsets + (size_t) i * 12;
+		if (type != 0 && ldns_read_uint16(rrset) != type) {
+			continue;
+		}
+		first_rr = ldns_read_uint32(rrset + 4);
+		rr_count = ldns_read_uint32(rrset + 8);
+		if (first_rr > snapshot->_rr_count || 
+		    rr_count > snapshot->_rr_count - first_rr) {
+			return false;
+		}
+		for (j = first_rr; j < first_rr + rr_count; j++) {
+			if (ldns_zone_snapshot_rr(snapshot, j, &rr) != 
+					LDNS_STATUS_OK) {
+				return false;
+			}
+			if (!ldns_rr_list_push_rr(rrs, rr)) {
+				ldns_rr_free(rr);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static ldns_rr_list *
+ldns_zone_snapshot_lookup(const ldns_zone_snapshot *snapshot, 
+		const ldns_rdf *name, ldns_rr_type type)
+{
+	uint8_t key[LDNS_MAX_DOMAINLEN];
+	uint16_t offsets[LDNS_MAX_DOMAINLEN / 2 + 2];
+	uint32_t hashes[LDNS_MAX_DOMAINLEN / 2 + 2];
+	uint32_t first, count;
+	ldns_rr_list *rrs;
+
+	if (ldns_zone_index_key(name, key, offsets, hashes) == 0 ||
+	    !ldns_zone_snapshot_find(snapshot, key, ldns_rdf_size(name), 
+		    hashes[0], &first, &count)) {
+		return NULL;
+	}
+	rrs = ldns_rr_list_new();
+	if (!rrs) {
+		return NULL;
+	}
+	if (!ldns_zone_snapshot_push_rrsets(snapshot, first, count, type, 
+				rrs) ||
+	    (type != 0 && ldns_rr_list_rr_count(rrs) == 0)) {
+		ldns_rr_list_deep_free(rrs);
+		return NULL;
+	}
+	return rrs;
+}
+
+ldns_rr_list *
+ldns_zone_snapshot_rrset(const ldns_zone_snapshot *snapshot, 
+		const ldns_rdf *name, ldns_rr_type type)
+{
+	if (type == 0) {
+		return NULL;
+	}
+	return ldns_zone_snapshot_lookup(snapshot, name, type);
+}
+
+ldns_rr_list *
+ldns_zone_snapshot_name_rrs(const ldns_zone_snapshot *snapshot, 
+		const ldns_rdf *name)
+{
+	return ldns_zone_snapshot_lookup(snapshot, name, 0);
+}
+
+/* whether the rrsets from first on include one of type */
+static bool
+ldns_zone_snapshot_has_type(const ldns_zone_snapshot *snapshot, 
+		uint32_t first, uint32_t count, ldns_rr_type type)
+{
+	uint32_t i;
+
+	for (i = first; i < first + count; i++) {
+		if (ldns_read_uint16(snapshot->_rrsets + (size_t) i * 12) == 
+				type) {
+			return true;
+		}
+	}
+	return false;
+}
+
+ldns_rr_list *
+ldns_zone_snapshot_zone_cut(const ldns_zone_snapshot *snapshot, 
+		const ldns_rdf *name)
+{
+	uint8_t key[LDNS_MAX_DOMAINLEN];
+	uint16_t offsets[LDNS_MAX_DOMAINLEN / 2 + 2];
+	uint32_t hashes[LDNS_MAX_DOMAINLEN / 2 + 2];
+	uint32_t first, count, cut_first, cut_count;
+	size_t labels, size, i;
+	bool cut;
+	ldns_rr_list *rrs;
+
+	labels = ldns_zone_index_key(name, key, offsets, hashes);
+	size = ldns_rdf_size(name);
+	cut = false;
+	cut_first = 0;
+	cut_count = 0;
+	/* up to the apex, the name with the soa */
+	for (i = 0; i < labels; i++) {
+		if (!ldns_zone_snapshot_find(snapshot, key + offsets[i], 
+				size - offsets[i], hashes[i], &first, &count)) {
+			continue;
+		}
+		if (ldns_zone_snapshot_has_type(snapshot, first, count, 
+					LDNS_RR_TYPE_SOA)) {
+			break;
+		}
+		if (ldns_zone_snapshot_has_type(snapshot, first, count, 
+					LDNS_RR_TYPE_NS)) {
+			cut = true;
+			cut_first = first;
+			cut_count = count;
+		}
+	}
+	if (!cut) {
+		return NULL;
+	}
+	rrs = ldns_rr_list_new();
+	if (rrs && !ldns_zone_snapshot_push_rrsets(snapshot, cut_first, 
+				cut_count, LDNS_RR_TYPE_NS, rrs)) {
+		ldns_rr_list_deep_free(rrs);
+		return NULL;
+	}
+	return rrs;
+}
+
+ldns_status
+ldns_zone_new_frm_snapshot(ldns_zone **z, const ldns_zone_snapshot *snapshot)
+{
+	ldns_zone *newzone;
+	ldns_rr *rr;
+	uint32_t i;
+	ldns_status s;
+
+	newzone = ldns_zone_new();
+	if (!newzone) {
+		return LDNS_STATUS_MEM_ERR;
+	}
+	for (i = 0; i < snapshot->_rr_count; i++) {
+		s = ldns_zone_snapshot_rr(snapshot, i, &rr);
+		if (s != LDNS_STATUS_OK) {
+			ldns_zone_deep_free(newzone);
+			return s;
+		}
+		if (i == snapshot->_soa) {
+			ldns_zone_set_soa(newzone, rr);
+		} else if (!ldns_zone_push_rr(newzone, rr)) {
+			ldns_rr_free(rr);
+			ldns_zone_deep_free(newzone);
+			return LDNS_STATUS_MEM_ERR;
+		}
+	}
+	*z = newzone;
+	return LDNS_STATUS_OK;
+}
+
+/* a node of an enum index while it is built, with a child per digit and
+ * the naptrs of its number linked through an array next to the zone */
+struct ldns_struct_zone_enum_build {
+	uint32_t _children[10];
+	/* zone rr number + 1, or 0 */
+	uint32_t _first;
+	uint32_t _last;
+	uint32_t _rr_count;
+};
+typedef struct ldns_struct_zone_enum_build ldns_zone_enum_build;
+
+/* puts the digits of the number an ENUM name in wire format is for in
+ * digits, in number order. Returns how many there are, or -1 when name
+ * is not all single digit labels under suffix */
+static int
+ldns_zone_enum_wire_digits(const ldns_rdf *suffix, const uint8_t *data,
+		size_t size, uint8_t digits[LDNS_MAX_DOMAINLEN / 2])
+{
+	uint8_t tail[LDNS_MAX_DOMAINLEN];
+	size_t suffix_size, pos;
+	int n, i;
+
+	suffix_size = ldns_rdf_size(suffix);
+	if (size < suffix_size || size > LDNS_MAX_DOMAINLEN ||
+	    (size - suffix_size) % 2 != 0) {
+		return -1;
+	}
+	n = (int) ((size - suffix_size) / 2);
+	for (i = 0, pos = 0; i < n; i++, pos += 2) {
+		if (data[pos] != 1 || data[pos + 1] < '0' || 
+		    data[pos + 1] > '9') {
+			return -1;
+		}
+		digits[n - 1 - i] = (uint8_t) (data[pos + 1] - '0');
+	}
+	/* the labels before it end on a label boundary of the name */
+	ldns_dname_octets_tolower(tail, data + pos, suffix_size);
+	if (memcmp(tail, ldns_rdf_data(suffix), suffix_size) != 0) {
+		return -1;
+	}
+	return n;
+}
+
+static int
+ldns_zone_enum_digits(const ldns_rdf *suffix, const ldns_rdf *name,
+		uint8_t digits[LDNS_MAX_DOMAINLEN / 2])
+{
+	if (!name || ldns_rdf_get_type(name) != LDNS_RDF_TYPE_DNAME) {
+		return -1;
+	}
+	return ldns_zone_enum_wire_digits(suffix, ldns_rdf_data(name), 
+			ldns_rdf_size(name), digits);
+}
+
+/* the child of node for digit, which must be there. The children are
+ * in digit order, so it comes after as many as there are bits below
+ * that of digit */
+static uint32_t
+ldns_zone_enum_child(const ldns_zone_enum_node *node, uint8_t digit)
+{
+	uint32_t below;
+
+	below = node->_digits & ((1U << digit) - 1);
+	below = below - ((below >> 1) & 0x5555);
+	below = (below & 0x3333) + ((below >> 2) & 0x3333);
+	below = (below + (below >> 4)) & 0x0f0f;
+	return node->_children + ((below + (below >> 8)) & 0x1f);
+}
+
+static ldns_rr_list *
+ldns_zone_enum_node_rrs(const ldns_zone_enum_index *index,
+		const ldns_zone_enum_node *node)
+{
+	ldns_rr_list *rrs;
+	uint16_t i;
+
+	if (node->_rr_count == 0) {
+		return NULL;
+	}
+	rrs = ldns_rr_list_new();
+	if (!rrs) {
+		return NULL;
+	}
+	for (i = 0; i < node->_rr_count; i++) {
+		if (!ldns_rr_list_push_rr(rrs, index->_rrs[node->_rrs + i])) {
+			ldns_rr_list_free(rrs);
+			return NULL;
+		}
+	}
+	return rrs;
+}
+
+/* adds the path for digits to the trie, returns the node it ends at or 0
+ * when out of memory */
+static uint32_t
+ldns_zone_enum_build_add(ldns_zone_enum_build **build, size_t *count,
+		size_t *capacity, const uint8_t *digits, int n)
+{
+	ldns_zone_enum_build *nodes;
+	uint32_t node, child;
+	int i;
+
+	node = 0;
+	for (i = 0; i < n; i++) {
+		child = (*build)[node]._children[digits[i]];
+		if (child == 0) {
+			if (*count == *capacity) {
+				if (*capacity >= UINT32_MAX / 2) {
+					return 0;
+				}
+				nodes = LDNS_XREALLOC(*build, 
+						ldns_zone_enum_build, 
+						*capacity * 2);
+				if (!nodes) {
+					return 0;
+				}
+				*build = nodes;
+				*capacity *= 2;
+			}
+			child = (uint32_t) *count;
+			memset(&(*build)[child], 0, sizeof(ldns_zone_enum_build));
+			(*build)[node]._children[digits[i]] = child;
+			(*count)++;
+		}
+		node = child;
+	}
+	return node;
+}
+
+/* lays the trie out with the children of every node next to each other,
+ * breadth first, and the naptrs of every number after each other */
+static bool
+ldns_zone_enum_index_flatten(ldns_zone_enum_index *index,
+		const ldns_zone_enum_build *build, size_t count,
+		const uint32_t *next, const ldns_rr_list *rrs)
+{
+	uint32_t *order;
+	size_t tail, i;
+	uint32_t rr;
+	uint8_t d;
+
+	index->_nodes = LDNS_XMALLOC(ldns_zone_enum_node, count);
+	order = LDNS_XMALLOC(uint32_t, count);
+	if (!index->_nodes || !order) {
+		LDNS_FREE(order);
+		return false;
+	}
+	index->_node_count = count;
+	order[0] = 0;
+	tail = 1;
+	index->_rr_count = 0;
+	for (i = 0; i < count; i++) {
+		const ldns_zone_enum_build *b = &build[order[i]];
+
+		index->_nodes[i]._children = (uint32_t) tail;
+		index->_nodes[i]._digits = 0;
+		for (d = 0; d < 10; d++) {
+			if (b->_children[d] != 0) {
+				order[tail++] = b->_children[d];
+				index->_nodes[i]._digits |= 1U << d;
+			}
+		}
+		index->_nodes[i]._rrs = (uint32_t) index->_rr_count;
+		index->_nodes[i]._rr_count = (uint16_t) b->_rr_count;
+		for (rr = b->_first; rr != 0; rr = next[rr - 1]) {
+			index->_rrs[index->_rr_count++] = 
+				ldns_rr_list_rr(rrs, rr - 1);
+		}
+		if (b->_rr_count > 0) {
+			index->_number_count++;
+		}
+	}
+	LDNS_FREE(order);
+	return true;
+}
+
+ldns_zone_enum_index *
+ldns_zone_enum_index_new(const ldns_zone *zone, const ldns_rdf *suffix)
+{
+	uint8_t digits[LDNS_MAX_DOMAINLEN / 2];
+	ldns_zone_enum_index *index;
+	ldns_zone_enum_build *build;
+	const ldns_rr_list *rrs;
+	ldns_rr *rr;
+	uint32_t *next;
+	size_t count, capacity, naptrs, i;
+	uint32_t node;
+	int n;
+
+	if (!suffix) {
+		if (!ldns_zone_soa(zone)) {
+			return NULL;
+		}
+		suffix = ldns_rr_owner(ldns_zone_soa(zone));
+	}
+	rrs = ldns_zone_rrs(zone);
+	if (ldns_rr_list_rr_count(rrs) >= UINT32_MAX) {
+		return NULL;
+	}
+	index = LDNS_MALLOC(ldns_zone_enum_index);
+	if (!index) {
+		return NULL;
+	}
+	index->_suffix = ldns_rdf_clone(suffix);
+	index->_nodes = NULL;
+	index->_node_count = 0;
+	index->_rrs = NULL;
+	index->_rr_count = 0;
+	index->_number_count = 0;
+	capacity = LDNS_ZONE_ENUM_NODES;
+	build = LDNS_XMALLOC(ldns_zone_enum_build, capacity);
+	next = LDNS_XMALLOC(uint32_t, ldns_rr_list_rr_count(rrs) + 1);
+	if (!index->_suffix || !build || !next) {
+		goto error;
+	}
+	ldns_dname2canonical(index->_suffix);
+	memset(&build[0], 0, sizeof(ldns_zone_enum_build));
+	count = 1;
+
+	naptrs = 0;
+	for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+		rr = ldns_rr_list_rr(rrs, i);
+		if (ldns_rr_get_type(rr) != LDNS_RR_TYPE_NAPTR) {
+			continue;
+		}
+		n = ldns_zone_enum_digits(index->_suffix, ldns_rr_owner(rr), 
+				digits);
+		if (n < 0) {
+			continue;
+		}
+		node = ldns_zone_enum_build_add(&build, &count, &capacity, 
+				digits, n);
+		if (node == 0 && n > 0) {
+			goto error;
+		}
+		if (build[node]._rr_count == UINT16_MAX) {
+			/* more than a node can hold */
+			continue;
+		}
+		next[i] = 0;
+		if (build[node]._last != 0) {
+			next[build[node]._last - 1] = (uint32_t) i + 1;
+		} else {
+			build[node]._first = (uint32_t) i + 1;
+		}
+		build[node]._last = (uint32_t) i + 1;
+		build[node]._rr_count++;
+		naptrs++;
+	}
+
+	index->_rrs = LDNS_XMALLOC(ldns_rr *, naptrs + 1);
+	if (!index->_rrs || 
+	    !ldns_zone_enum_index_flatten(index, build, count, next, rrs)) {
+		goto error;
+	}
+	LDNS_FREE(build);
+	LDNS_FREE(next);
+	return index;
+
+error:
+	LDNS_FREE(build);
+	LDNS_FREE(next);
+	ldns_zone_enum_index_free(index);
+	return NULL;
+}
+
+void
+ldns_zone_enum_index_free(ldns_zone_enum_index *index)
+{
+	if (!index) {
+		return;
+	}
+	if (index->_suffix) {
+		ldns_rdf_deep_free(index->_suffix);
+	}
+	LDNS_FREE(index->_nodes);
+	LDNS_FREE(index->_rrs);
+	LDNS_FREE(index);
+}
+
+size_t
+ldns_zone_enum_index_number_count(const ldns_zone_enum_index *index)
+{
+	return index->_number_count;
+}
+
+ldns_rr_list *
+ldns_zone_enum_index_naptrs(const ldns_zone_enum_index *index, 
+		const char *number)
+{
+	const ldns_zone_enum_node *node;
+	uint8_t digit;
+
+	if (!number) {
+		return NULL;
+	}
+	if (*number == '+') {
+		number++;
+	}
+	if (!*number) {
+		/* the suffix itself is no number */
+		return NULL;
+	}
+	node = &index->_nodes[0];
+	for (; *number; number++) {
+		if (*number < '0' || *number > '9') {
+			return NULL;
+		}
+		digit = (uint8_t) (*number - '0');
+		if ((node->_digits & (1U << digit)) == 0) {
+			return NULL;
+		}
+		node = &index->_nodes[ldns_zone_enum_child(node, digit)];
+	}
+	return ldns_zone_enum_node_rrs(index, node);
+}
+
+ldns_rr_list *
+ldns_zone_enum_index_naptrs_frm_dname(const ldns_zone_enum_index *index, 
+		const ldns_rdf *name)
+{
+	uint8_t digits[LDNS_MAX_DOMAINLEN / 2];
+	const ldns_zone_enum_node *node;
+	int n, i;
+
+	n = ldns_zone_enum_digits(index->_suffix, name, digits);
+	if (n < 0) {
+		return NULL;
+	}
+	node = &index->_nodes[0];
+	for (i = 0; i < n; i++) {
+		if ((node->_digits & (1U << digits[i])) == 0) {
+			return NULL;
+		}
+		node = &index->_nodes[ldns_zone_enum_child(node, digits[i])];
+	}
+	return ldns_zone_enum_node_rrs(index, node);
+}
+
+/* 64 bit FNV-1a over the digits, mixed so the low and high halves can be
+ * used on their own */
+static uint64_t
+ldns_zone_enum_filter_hash(const uint8_t *digits, size_t n)
+{
+	uint64_t h;
+	size_t i;
+
+	h = 14695981039346656037ULL;
+	for (i = 0; i < n; i++) {
+		h = (h ^ digits[i]) * 1099511628211ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/* the block a hash goes in, the bits in it follow from the low half */
+static uint64_t *
+ldns_zone_enum_filter_block(const ldns_zone_enum_filter *filter,
+		uint64_t h)
+{
+	return filter->_blocks + ((h >> 32) % filter->_block_count) * 
+		(LDNS_ZONE_ENUM_FILTER_BLOCK / 64);
+}
+
+static void
+ldns_zone_enum_filter_add(ldns_zone_enum_filter *filter,
+		const uint8_t *digits, int n)
+{
+	uint64_t *block;
+	uint64_t h;
+	uint32_t bit, step;
+	int i;
+
+	h = ldns_zone_enum_filter_hash(digits, (size_t) n);
+	block = ldns_zone_enum_filter_block(filter, h);
+	bit = (uint32_t) h;
+	step = (uint32_t) (h >> 16) | 1;
+	for (i = 0; i < LDNS_ZONE_ENUM_FILTER_HASHES; i++) {
+		block[(bit % LDNS_ZONE_ENUM_FILTER_BLOCK) / 64] |= 
+			(uint64_t) 1 << (bit % 64);
+		bit += step;
+	}
+	filter->_number_count++;
+}
+
+/* a filter for count numbers, with no bits set yet */
+static ldns_zone_enum_filter *
+ldns_zone_enum_filter_alloc(size_t count)
+{
+	ldns_zone_enum_filter *filter;
+	size_t words;
+
+	filter = LDNS_MALLOC(ldns_zone_enum_filter);
+	if (!filter) {
+		return NULL;
+	}
+	filter->_block_count = (count * LDNS_ZONE_ENUM_FILTER_BITS + 
+			LDNS_ZONE_ENUM_FILTER_BLOCK - 1) / 
+		LDNS_ZONE_ENUM_FILTER_BLOCK;
+	if (filter->_block_count == 0) {
+		filter->_block_count = 1;
+	}
+	words = filter->_block_count * (LDNS_ZONE_ENUM_FILTER_BLOCK / 64);
+	filter->_blocks = LDNS_XMALLOC(uint64_t, words);
+	if (!filter->_blocks) {
+		LDNS_FREE(filter);
+		return NULL;
+	}
+	memset(filter->_blocks, 0, words * sizeof(uint64_t));
+	filter->_number_count = 0;
+	filter->_fp_rate = 0.0;
+	return filter;
+}
+
+/* a number that is not there gets through when all its bits happen to
+ * be set in the block it lands in, which is as likely as the fill of
+ * that block to the power of the bits a number sets */
+static void
+ldns_zone_enum_filter_done(ldns_zone_enum_filter *filter)
+{
+	size_t i, j, bits;
+	uint64_t w;
+	double fill, rate, total;
+
+	total = 0.0;
+	for (i = 0; i < filter->_block_count; i++) {
+		bits = 0;
+		for (j = 0; j < LDNS_ZONE_ENUM_FILTER_BLOCK / 64; j++) {
+			for (w = filter->_blocks[i * 
+					(LDNS_ZONE_ENUM_FILTER_BLOCK / 64) + j];
+			     w; w &= w - 1) {
+				bits++;
+			}
+		}
+		fill = (double) bits / LDNS_ZONE_ENUM_FILTER_BLOCK;
+		rate = 1.0;
+		for (j = 0; j < LDNS_ZONE_ENUM_FILTER_HASHES; j++) {
+			rate *= fill;
+		}
+		total += rate;
+	}
+	filter->_fp_rate = total / filter->_block_count;
+}
+
+ldns_zone_enum_filter *
+ldns_zone_enum_filter_new(const ldns_rr_list *rrs, const ldns_rdf *suffix)
+{
+	uint8_t digits[LDNS_MAX_DOMAINLEN / 2];
+	ldns_zone_enum_filter *filter;
+	ldns_rdf *suffix_lower;
+	ldns_rr *rr;
+	ldns_rdf *prev;
+	size_t count, i;
+	int n, pass;
+
+	suffix_lower = ldns_rdf_clone(suffix);
+	if (!suffix_lower) {
+		return NULL;
+	}
+	ldns_dname2canonical(suffix_lower);
+	/* count the numbers first, then add them. The rrs of a name are
+	 * usually next to each other, those are only counted once */
+	filter = NULL;
+	count = 0;
+	for (pass = 0; pass < 2; pass++) {
+		prev = NULL;
+		for (i = 0; i < ldns_rr_list_rr_count(rrs); i++) {
+			rr = ldns_rr_list_rr(rrs, i);
+			if (ldns_rr_get_type(rr) != LDNS_RR_TYPE_NAPTR ||
+			    (prev && ldns_dname_compare(prev, 
+					    ldns_rr_owner(rr)) == 0)) {
+				continue;
+			}
+			n = ldns_zone_enum_digits(suffix_lower, 
+					ldns_rr_owner(rr), digits);
+			if (n < 0) {
+				continue;
+			}
+			prev = ldns_rr_owner(rr);
+			if (filter) {
+				ldns_zone_enum_filter_add(filter, digits, n);
+			} else {
+				count++;
+			}
+		}
+		if (!filter) {
+			filter = ldns_zone_enum_filter_alloc(count);
+			if (!filter) {
+				break;
+			}
+		}
+	}
+	ldns_rdf_deep_free(suffix_lower);
+	if (filter) {
+		ldns_zone_enum_filter_done(filter);
+	}
+	return filter;
+}
+
+ldns_zone_enum_filter *
+ldns_zone_enum_filter_new_frm_snapshot(const ldns_zone_snapshot *snapshot,
+		const ldns_rdf *suffix)
+{
+	uint8_t digits[LDNS_MAX_DOMAINLEN / 2];
+	ldns_zone_enum_filter *filter;
+	ldns_rdf *suffix_lower;
+	const uint8_t *name;
+	uint32_t i, key, first, count;
+	uint16_t size;
+	size_t numbers;
+	int n, pass;
+
+	suffix_lower = ldns_rdf_clone(suffix);
+	if (!suffix_lower) {
+		return NULL;
+	}
+	ldns_dname2canonical(suffix_lower);
+	/* the names in a snapshot are unique, count the numbers among
+	 * them first, then add them */
+	filter = NULL;
+	numbers = 0;
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < snapshot->_name_count; i++) {
+			name = snapshot->_names + (size_t) i * 16;
+			key = ldns_read_uint32(name);
+			size = ldns_read_uint16(name + 4);
+			count = ldns_read_uint16(name + 6);
+			first = ldns_read_uint32(name + 12);
+			if (key > snapshot->_keys_size || 
+			    size > snapshot->_keys_size - key ||
+			    first > snapshot->_rrset_count || 
+			    count > snapshot->_rrset_count - first ||
+			    !ldns_zone_snapshot_has_type(snapshot, first, 
+				    count, LDNS_RR_TYPE_NAPTR)) {
+				continue;
+			}
+			n = ldns_zone_enum_wire_digits(suffix_lower, 
+					snapshot->_keys + key, size, digits);
+			if (n < 0) {
+				continue;
+			}
+			if (filter) {
+				ldns_zone_enum_filter_add(filter, digits, n);
+			} else {
+				numbers++;
+			}
+		}
+		if (!filter) {
+			filter = ldns_zone_enum_filter_alloc(numbers);
+			if (!filter) {
+				break;
+			}
+		}
+	}
+	ldns_rdf_deep_free(suffix_lower);
+	if (filter) {
+		ldns_zone_enum_filter_done(filter);
+	}
+	return filter;
+}
+
+void
+ldns_zone_enum_filter_free(ldns_zone_enum_filter *filter)
+{
+	if (!filter) {
+		return;
+	}
+	LDNS_FREE(filter->_blocks);
+	LDNS_FREE(filter);
+}
+
+bool
+ldns_zone_enum_filter_may_contain(const ldns_zone_enum_filter *filter,
+		const char *number)
+{
+	uint8_t digits[LDNS_MAX_DOMAINLEN / 2];
+	const uint64_t *block;
+	uint64_t h;
+	uint32_t bit, step;
+	size_t n;
+	int i;
+
+	if (!number) {
+		return false;
+	}
+	if (*number == '+') {
+		number++;
+	}
+	for (n = 0; number[n]; n++) {
+		if (n == sizeof(digits) || number[n] < '0' || 
+		    number[n] > '9') {
+			return false;
+		}
+		digits[n] = (uint8_t) (number[n] - '0');
+	}
+	h = ldns_zone_enum_filter_hash(digits, n);
+	block = ldns_zone_enum_filter_block(filter, h);
+	bit = (uint32_t) h;
+	step = (uint32_t) (h >> 16) | 1;
+	for (i = 0; i < LDNS_ZONE_ENUM_FILTER_HASHES; i++) {
+		if ((block[(bit % LDNS_ZONE_ENUM_FILTER_BLOCK) / 64] & 
+		     ((uint64_t) 1 << (bit % 64))) == 0) {
+			return false;
+		}
+		bit += step;
+	}
+	return true;
+}
+
+size_t
+ldns_zone_enum_filter_number_count(const ldns_zone_enum_filter *filter)
+{
+	return filter->_number_count;
+}
+
+double
+ldns_zone_enum_filter_fp_rate(const ldns_zone_enum_filter *filter)
+{
+	return filter->_fp_rate;
 }